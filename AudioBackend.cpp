@@ -0,0 +1,96 @@
+#include "AudioBackend.h"
+#include "WavFile.h"
+#include <chrono>
+#include <cstdio>
+#include <utility>
+
+NullBackend::NullBackend(std::string wavPath)
+    : path_(std::move(wavPath))
+{}
+
+NullBackend::~NullBackend() {
+    stop();
+}
+
+bool NullBackend::open(const Config& config, Callback cb, void* user) {
+    if (thread_.joinable()) {
+        std::fprintf(stderr, "%s backend: open while running\n", name());
+        return false;
+    }
+    if (config.channels < 1 || config.framesPerBuffer == 0 || config.sampleRate < 1.0f) {
+        std::fprintf(stderr, "%s backend: bad config\n", name());
+        return false;
+    }
+    config_ = config;
+    cb_ = cb;
+    user_ = user;
+    buffer_.assign(config.framesPerBuffer * config.channels, 0.0f);
+    recorded_.clear();
+    return true;
+}
+
+bool NullBackend::start() {
+    if (!cb_) {
+        std::fprintf(stderr, "%s backend: start before open\n", name());
+        return false;
+    }
+    if (thread_.joinable()) return true;
+    quit_.store(false);
+    thread_ = std::thread(&NullBackend::run, this);
+    return true;
+}
+
+void NullBackend::stop() {
+    if (!thread_.joinable()) return;
+    quit_.store(true);
+    thread_.join();
+
+    if (!path_.empty()) {
+        const unsigned long frames = (unsigned long)(recorded_.size() / config_.channels);
+        writeWav(path_, recorded_.data(), frames, config_.channels, (int)config_.sampleRate);
+    }
+}
+
+// Deadlines on an absolute schedule, so late wake-ups do not add up
+void NullBackend::run() {
+    typedef std::chrono::steady_clock Clock;
+    const auto period = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(config_.framesPerBuffer / (double)config_.sampleRate));
+    auto next = Clock::now();
+    while (!quit_.load(std::memory_order_relaxed)) {
+        cb_(user_, buffer_.data(), config_.framesPerBuffer, 0);
+        if (!path_.empty()) recorded_.insert(recorded_.end(), buffer_.begin(), buffer_.end());
+        next += period;
+        std::this_thread::sleep_until(next);
+    }
+}
+
+bool SimulatedBackend::open(const Config& config, Callback cb, void* user) {
+    if (config.channels < 1 || config.framesPerBuffer == 0) {
+        std::fprintf(stderr, "simulated backend: bad config\n");
+        return false;
+    }
+    config_ = config;
+    cb_ = cb;
+    user_ = user;
+    buffer_.assign(config.framesPerBuffer * config.channels, 0.0f);
+    frames_ = 0;
+    started_ = false;
+    return true;
+}
+
+bool SimulatedBackend::start() {
+    if (!cb_) {
+        std::fprintf(stderr, "simulated backend: start before open\n");
+        return false;
+    }
+    started_ = true;
+    return true;
+}
+
+bool SimulatedBackend::step(uint32_t flags) {
+    if (!started_) return false;
+    cb_(user_, buffer_.data(), config_.framesPerBuffer, flags);
+    frames_ += config_.framesPerBuffer;
+    return true;
+}
@@ -0,0 +1,88 @@
+#ifndef AUDIOBACKEND_H
+#define AUDIOBACKEND_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Where rendered audio goes. A backend owns the device, or a stand-in for
+// one, and calls the callback from its own thread whenever it needs a
+// buffer: `frames` interleaved frames of Config::channels samples into out,
+// with the buffer's Telemetry::Flags (device under/overflows).
+//
+// open() and start() print what went wrong to stderr and return false.
+// stop() returns once no callback is running; open() may follow again.
+class AudioBackend {
+public:
+    typedef void (*Callback)(void* user, float* out, unsigned long frames, uint32_t flags);
+
+    struct Config {
+        float sampleRate = 48000.0f;
+        int channels = 2;
+        unsigned long framesPerBuffer = 256;
+    };
+
+    virtual ~AudioBackend() = default;
+
+    virtual const char* name() const = 0;
+    virtual bool open(const Config& config, Callback cb, void* user) = 0;
+    virtual bool start() = 0;
+    virtual void stop() = 0;
+
+    const Config& config() const { return config_; }
+
+protected:
+    Config config_;
+    Callback cb_ = nullptr;
+    void* user_ = nullptr;
+};
+
+// No device: a thread asks for a buffer every buffer period of wall-clock
+// time, as a sound card would. Given a path, it is also a file sink: all
+// that was played is written there as a WAV file by stop().
+class NullBackend : public AudioBackend {
+public:
+    explicit NullBackend(std::string wavPath = "");
+    ~NullBackend() override;
+
+    const char* name() const override { return path_.empty() ? "null" : "file"; }
+    bool open(const Config& config, Callback cb, void* user) override;
+    bool start() override;
+    void stop() override;
+
+private:
+    void run();
+
+    std::string path_;
+    std::vector<float> buffer_;
+    std::vector<float> recorded_;
+    std::atomic<bool> quit_{false};
+    std::thread thread_;
+};
+
+// Virtual clock for tests and benchmarks: nothing happens until step(),
+// which runs one device callback on the calling thread and moves the clock
+// on by one buffer.
+class SimulatedBackend : public AudioBackend {
+public:
+    const char* name() const override { return "simulated"; }
+    bool open(const Config& config, Callback cb, void* user) override;
+    bool start() override;
+    void stop() override { started_ = false; }
+
+    // One callback with these flags; false unless started
+    bool step(uint32_t flags = 0);
+
+    // The last buffer handed out, and device frames played so far
+    const std::vector<float>& buffer() const { return buffer_; }
+    uint64_t frames() const { return frames_; }
+
+private:
+    std::vector<float> buffer_;
+    uint64_t frames_ = 0;
+    bool started_ = false;
+};
+
+#endif
@@ -0,0 +1,310 @@
+#include "Convolver.h"
+#include "FastMath.h"
+#include "WavFile.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static void waitChange(std::atomic<uint32_t>& word, uint32_t seen) {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, seen, nullptr, nullptr, 0);
+#else
+    (void)word; (void)seen;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+#endif
+}
+
+static void wakeOne(std::atomic<uint32_t>& word) {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#else
+    (void)word;
+#endif
+}
+
+// acc += x * h over n complex bins in split form; n a multiple of 4
+static void multiplyAdd(const float* xr, const float* xi, const float* hr, const float* hi,
+                        float* ar, float* ai, int n) {
+    typedef simd::Vec<4>::f V;
+    for (int j = 0; j < n; j += 4) {
+        const V a = simd::load<4>(xr + j), b = simd::load<4>(xi + j);
+        const V c = simd::load<4>(hr + j), d = simd::load<4>(hi + j);
+        simd::store<4>(ar + j, simd::load<4>(ar + j) + a * c - b * d);
+        simd::store<4>(ai + j, simd::load<4>(ai + j) + a * d + b * c);
+    }
+}
+
+// Partition spectra of ir[offset, offset + length), zero-padded to the FFT
+// size and scaled by 1 / (2 * frames) for the unnormalised inverse
+void Convolver::Segment::setup(unsigned long frames, const std::vector<float>* ir, unsigned long offset,
+                               unsigned long length) {
+    size = frames;
+    parts = (int)((length + frames - 1) / frames);
+    fft = RealFft((int)(2 * frames));
+    stride = (fft.bins() + 3) & ~3;
+    pos = 0;
+
+    std::vector<float> padded(2 * frames);
+    const float scale = 1.0f / (2 * frames);
+    for (int ch = 0; ch < kChannels; ++ch) {
+        filter[ch].assign((size_t)parts * 2 * stride, 0.0f);
+        delay[ch].assign((size_t)parts * 2 * stride, 0.0f);
+        window[ch].assign(2 * frames, 0.0f);
+        for (int k = 0; k < parts; ++k) {
+            std::fill(padded.begin(), padded.end(), 0.0f);
+            const unsigned long first = offset + k * frames;
+            const unsigned long n = std::min(frames, offset + length - first);
+            for (unsigned long i = 0; i < n; ++i) padded[i] = ir[ch][first + i] * scale;
+            float* re = filter[ch].data() + (size_t)k * 2 * stride;
+            fft.forward(padded.data(), re, re + stride);
+        }
+    }
+    accRe.assign(stride, 0.0f);
+    accIm.assign(stride, 0.0f);
+    time.assign(2 * frames, 0.0f);
+}
+
+// One partition of input in, one of output out: the newest input spectrum
+// joins the delay line, and partition k of the response meets the input
+// from k partitions ago
+void Convolver::Segment::step(const float* const* in, float* const* out) {
+    for (int ch = 0; ch < kChannels; ++ch) {
+        float* w = window[ch].data();
+        std::memmove(w, w + size, size * sizeof(float));
+        std::memcpy(w + size, in[ch], size * sizeof(float));
+
+        float* x = delay[ch].data() + (size_t)pos * 2 * stride;
+        fft.forward(w, x, x + stride);
+
+        std::fill(accRe.begin(), accRe.end(), 0.0f);
+        std::fill(accIm.begin(), accIm.end(), 0.0f);
+        for (int k = 0, slot = pos; k < parts; ++k, slot = slot == 0 ? parts - 1 : slot - 1) {
+            const float* xs = delay[ch].data() + (size_t)slot * 2 * stride;
+            const float* h = filter[ch].data() + (size_t)k * 2 * stride;
+            multiplyAdd(xs, xs + stride, h, h + stride, accRe.data(), accIm.data(), stride);
+        }
+
+        // The second half is the linear convolution; the first wrapped round
+        fft.inverse(accRe.data(), accIm.data(), time.data());
+        std::memcpy(out[ch], time.data() + size, size * sizeof(float));
+    }
+    pos = pos + 1 == parts ? 0 : pos + 1;
+}
+
+// A partition of silence, without computing its output
+void Convolver::Segment::skip() {
+    for (int ch = 0; ch < kChannels; ++ch) {
+        float* w = window[ch].data();
+        std::memmove(w, w + size, size * sizeof(float));
+        std::fill(w + size, w + 2 * size, 0.0f);
+        float* x = delay[ch].data() + (size_t)pos * 2 * stride;
+        std::fill(x, x + 2 * stride, 0.0f);
+    }
+    pos = pos + 1 == parts ? 0 : pos + 1;
+}
+
+void Convolver::Segment::clear() {
+    for (int ch = 0; ch < kChannels; ++ch) {
+        std::fill(delay[ch].begin(), delay[ch].end(), 0.0f);
+        std::fill(window[ch].begin(), window[ch].end(), 0.0f);
+    }
+    pos = 0;
+}
+
+Convolver::Convolver(unsigned long partition) {
+    unsigned long p = 16;
+    while (p < partition) p <<= 1;
+    head_.size = p;
+    setImpulse(std::vector<float>(), std::vector<float>());
+}
+
+Convolver::~Convolver() {
+    stop();
+}
+
+bool Convolver::load(const std::string& path, float sampleRate, std::string& error) {
+    std::vector<float> samples;
+    WavLayout layout;
+    if (!readWav(path, samples, layout, error)) return false;
+
+    // Linear interpolation is plenty for a response that is mostly noise
+    const double step = layout.sampleRate / (double)sampleRate;
+    const unsigned long frames = layout.frames > 0 ? (unsigned long)((layout.frames - 1) / step) + 1 : 0;
+    const int channels = std::min(layout.channels, kChannels);
+    std::vector<float> ir[kChannels];
+    double energy = 0.0;
+    for (int ch = 0; ch < channels; ++ch) {
+        ir[ch].resize(frames);
+        for (unsigned long i = 0; i < frames; ++i) {
+            const double at = i * step;
+            const uint64_t j = (uint64_t)at;
+            const float a = samples[j * layout.channels + ch];
+            const float b = j + 1 < layout.frames ? samples[(j + 1) * layout.channels + ch] : 0.0f;
+            ir[ch][i] = a + (float)(at - j) * (b - a);
+            energy += (double)ir[ch][i] * ir[ch][i];
+        }
+    }
+    if (energy <= 0.0) {
+        error = path + ": impulse response is silent";
+        return false;
+    }
+    const float scale = (float)(1.0 / std::sqrt(energy / channels));
+    for (int ch = 0; ch < channels; ++ch) {
+        for (float& s : ir[ch]) s *= scale;
+    }
+    setImpulse(ir[0], ir[1]);
+    return true;
+}
+
+void Convolver::setImpulse(const std::vector<float>& left, const std::vector<float>& right) {
+    const unsigned long p = head_.size;
+    const unsigned long q = p * kTailRatio;
+    length_ = (unsigned long)std::max(left.size(), right.size());
+
+    std::vector<float> ir[kChannels] = { left, right.empty() ? left : right };
+    for (auto& c : ir) c.resize(length_, 0.0f);
+
+    // The head ends where the tail's first output is due
+    const unsigned long headLength = std::min(length_, 2 * q);
+    head_.setup(p, ir, 0, headLength);
+    tail_.setup(q, ir, headLength, length_ - headLength);
+
+    for (int ch = 0; ch < kChannels; ++ch) {
+        headIn_[ch].assign(p, 0.0f);
+        headOut_[ch].assign(p, 0.0f);
+        tailIn_[ch].assign(q, 0.0f);
+        handIn_[ch].assign(q, 0.0f);
+        for (auto& slot : tailOut_) slot[ch].assign(q, 0.0f);
+    }
+    fill_ = 0;
+    steps_ = 0;
+    slotBlock_[0] = slotBlock_[1] = UINT64_MAX;
+    tailReady_ = false;
+    lastHanded_ = 0;
+    done_.store(0, std::memory_order_relaxed);
+}
+
+bool Convolver::start() {
+    if (thread_.joinable()) return true;
+    quit_.store(false, std::memory_order_relaxed);
+    thread_ = std::thread(&Convolver::run, this, handed_.load(std::memory_order_relaxed));
+    return true;
+}
+
+void Convolver::stop() {
+    if (!thread_.joinable()) return;
+    quit_.store(true, std::memory_order_relaxed);
+    handed_.fetch_add(1, std::memory_order_release);
+    wakeOne(handed_);
+    thread_.join();
+    // A block handed over but not started is lost; the tail goes on inline
+    lastHanded_ = done_.load(std::memory_order_acquire);
+}
+
+void Convolver::process(const float* inL, const float* inR, float* outL, float* outR, unsigned long n) {
+    const unsigned long p = head_.size;
+    for (unsigned long i = 0; i < n;) {
+        const unsigned long k = std::min(n - i, p - fill_);
+        // Input first, so out may be in
+        std::memcpy(headIn_[0].data() + fill_, inL + i, k * sizeof(float));
+        std::memcpy(headIn_[1].data() + fill_, inR + i, k * sizeof(float));
+        std::memcpy(outL + i, headOut_[0].data() + fill_, k * sizeof(float));
+        std::memcpy(outR + i, headOut_[1].data() + fill_, k * sizeof(float));
+        fill_ += k;
+        i += k;
+        if (fill_ == p) {
+            stepHead();
+            fill_ = 0;
+        }
+    }
+}
+
+// Head partition b covers output frames [b p, (b + 1) p). Tail block c,
+// input frames [c q, (c + 1) q), covers output frames [(c + 2) q,
+// (c + 3) q), so it is handed over at the end of head partition
+// (c + 1) r - 1 and read from head partition (c + 2) r on.
+void Convolver::stepHead() {
+    const unsigned long p = head_.size;
+    const float* in[kChannels] = { headIn_[0].data(), headIn_[1].data() };
+    float* out[kChannels] = { headOut_[0].data(), headOut_[1].data() };
+    if (head_.parts > 0) {
+        head_.step(in, out);
+    } else {
+        for (auto& o : headOut_) std::fill(o.begin(), o.end(), 0.0f);
+    }
+    if (tail_.parts == 0) return;
+
+    const uint64_t b = steps_++;
+    const uint64_t block = b / kTailRatio;
+    const unsigned long offset = (unsigned long)(b % kTailRatio) * p;
+
+    if (block >= 2) {
+        const uint64_t c = block - 2;
+        if (offset == 0) {
+            tailReady_ = done_.load(std::memory_order_acquire) > c && slotBlock_[c & 1] == c;
+            if (!tailReady_) late_.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (tailReady_) {
+            for (int ch = 0; ch < kChannels; ++ch) {
+                const float* t = tailOut_[c & 1][ch].data() + offset;
+                for (unsigned long i = 0; i < p; ++i) out[ch][i] += t[i];
+            }
+        }
+    }
+
+    for (int ch = 0; ch < kChannels; ++ch) std::memcpy(tailIn_[ch].data() + offset, in[ch], p * sizeof(float));
+    if (offset + p == tail_.size) handOff(block);
+}
+
+// The thread is idle whenever it has finished the last block handed to it;
+// a block arriving while it is still busy is dropped
+void Convolver::handOff(uint64_t block) {
+    if (done_.load(std::memory_order_acquire) != lastHanded_) return;
+
+    lastHanded_ = block + 1;
+    if (!thread_.joinable()) {
+        const float* in[kChannels] = { tailIn_[0].data(), tailIn_[1].data() };
+        computeTail(block, in);
+        return;
+    }
+
+    for (int ch = 0; ch < kChannels; ++ch) std::copy(tailIn_[ch].begin(), tailIn_[ch].end(), handIn_[ch].begin());
+    handBlock_ = block;
+    handed_.fetch_add(1, std::memory_order_release);
+    wakeOne(handed_);
+}
+
+// Blocks dropped since the last one are silence as far as the tail knows;
+// past the delay line's length that is a clear
+void Convolver::computeTail(uint64_t block, const float* const* in) {
+    const uint64_t next = done_.load(std::memory_order_relaxed);
+    if (block - next > (uint64_t)tail_.parts) {
+        tail_.clear();
+    } else {
+        for (uint64_t b = next; b < block; ++b) tail_.skip();
+    }
+    float* out[kChannels] = { tailOut_[block & 1][0].data(), tailOut_[block & 1][1].data() };
+    tail_.step(in, out);
+    slotBlock_[block & 1] = block;
+    done_.store(block + 1, std::memory_order_release);
+}
+
+void Convolver::run(uint32_t seen) {
+    DenormalGuard denormals;
+    for (;;) {
+        uint32_t now;
+        while ((now = handed_.load(std::memory_order_acquire)) == seen) waitChange(handed_, seen);
+        seen = now;
+        if (quit_.load(std::memory_order_relaxed)) return;
+
+        const float* in[kChannels] = { handIn_[0].data(), handIn_[1].data() };
+        computeTail(handBlock_, in);
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef CONVOLVER_H
+#define CONVOLVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Fft.h"
+
+// Convolution reverb for the master bus: each stereo channel through its
+// own channel of an impulse response, by partitioned FFT convolution
+// (overlap-save, summing a partition's spectrum against a delay line of
+// past input spectra).
+//
+// The response is split in two. The head, its first 2 * kTailRatio
+// partitions, runs on the calling thread in partitions of partition()
+// frames: one small FFT pair and a multiply-add per head partition every
+// partition() frames. The tail, the rest, runs in partitions kTailRatio
+// times longer, so a response seconds long costs a few large FFTs per
+// tail partition rather than hundreds of small ones. A tail partition's
+// output is due two tail partitions after its input starts, which leaves
+// a whole tail partition to compute it in.
+//
+// After start() a background thread computes the tail; the audio side
+// hands it input and picks up output with atomics only and never waits.
+// Tail output the thread has not finished in time is left out and counted
+// in lateBlocks(). Without start() the tail is computed inline, which is
+// exact and deterministic but makes every kTailRatio-th partition costly:
+// for offline rendering.
+//
+// The wet signal is partition() frames late, the head's input buffering.
+class Convolver {
+public:
+    static constexpr int kChannels = 2;
+    static constexpr int kTailRatio = 16;   // tail partition / head partition
+
+    // partition is rounded up to a power of two, at least 16
+    explicit Convolver(unsigned long partition = 128);
+    ~Convolver();
+
+    Convolver(const Convolver&) = delete;
+    Convolver& operator=(const Convolver&) = delete;
+
+    // The response from a WAV file: its first two channels, or its one
+    // for both. Resampled (linearly) to sampleRate and scaled to unit
+    // energy, so the bus level sets the loudness. Not while started.
+    bool load(const std::string& path, float sampleRate, std::string& error);
+
+    // The response as given; right empty uses left for both. Clears the
+    // input history. Not while started.
+    void setImpulse(const std::vector<float>& left, const std::vector<float>& right);
+
+    unsigned long partition() const { return head_.size; }
+    unsigned long latency() const { return head_.size; }
+    unsigned long length() const { return length_; }    // response frames
+
+    // Tail thread; not for the audio thread
+    bool start();
+    void stop();
+
+    // n frames of wet signal into out, latency() frames behind the input.
+    // out may be in. No locks, no allocation.
+    void process(const float* inL, const float* inR, float* outL, float* outR, unsigned long n);
+
+    // Tail partitions played without their tail output
+    uint64_t lateBlocks() const { return late_.load(std::memory_order_relaxed); }
+
+private:
+    // A run of partitions of one size, from `offset` into the response
+    struct Segment {
+        unsigned long size = 0;       // frames per partition; FFTs of 2 * size
+        int parts = 0;
+        int stride = 0;               // floats per half spectrum: bins, padded to 4
+        int pos = 0;                  // delay line slot of the newest input
+        RealFft fft{4};
+        std::vector<float> filter[kChannels];  // parts spectra, re then im
+        std::vector<float> delay[kChannels];   // parts input spectra, a ring
+        std::vector<float> window[kChannels];  // the last 2 * size input frames
+        std::vector<float> accRe, accIm, time;
+
+        void setup(unsigned long frames, const std::vector<float>* ir, unsigned long offset, unsigned long length);
+        void step(const float* const* in, float* const* out);
+        void skip();
+        void clear();
+    };
+
+    void stepHead();
+    void handOff(uint64_t block);
+    void computeTail(uint64_t block, const float* const* in);
+    void run(uint32_t seen);
+
+    Segment head_, tail_;
+    unsigned long length_ = 0;
+
+    // Head input and output in flight, fill_ frames into each
+    std::vector<float> headIn_[kChannels], headOut_[kChannels];
+    unsigned long fill_ = 0;
+    uint64_t steps_ = 0;              // head partitions done
+
+    // Tail input collecting, and the output of two tail blocks, each
+    // tagged with its block index by whoever computed it
+    std::vector<float> tailIn_[kChannels];
+    std::vector<float> tailOut_[2][kChannels];
+    uint64_t slotBlock_[2];
+    bool tailReady_ = false;
+
+    // Audio side -> thread: the block in handIn_, published by bumping
+    // handed_. Thread -> audio side: done_ is one past the last block
+    // finished; the audio side hands over only when it equals lastHanded_.
+    std::vector<float> handIn_[kChannels];
+    uint64_t handBlock_ = 0;
+    uint64_t lastHanded_ = 0;
+    alignas(64) std::atomic<uint32_t> handed_{0};
+    alignas(64) std::atomic<uint64_t> done_{0};
+    std::atomic<bool> quit_{false};
+    std::atomic<uint64_t> late_{0};
+    std::thread thread_;
+};
+
+#endif
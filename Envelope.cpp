@@ -0,0 +1,107 @@
+#include "Envelope.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+// Exponential shape: how far past the target each stage aims, as a fraction
+// of the distance travelled. Attack is gently convex, decay/release are
+// close to a true exponential (-60 dB at the end of the segment).
+static constexpr float kAttackOvershoot = 0.3f;
+static constexpr float kDecayOvershoot  = 0.001f;
+
+EnvelopeSegment Envelope::segment(Curve c, float from, float to, int32_t length, float overshoot) {
+    length = std::max<int32_t>(1, length);
+    if (from == to) return { 1.0f, 0.0f, to, length };
+
+    if (c == LINEAR) return { 1.0f, (to - from) / (float)length, to, length };
+
+    // level_k = T + (from - T) * mul^k with T past the target, chosen so that
+    // level_length == to: mul^length = overshoot / (1 + overshoot)
+    const float aim = to + (to - from) * overshoot;
+    const float mul = std::pow(overshoot / (1.0f + overshoot), 1.0f / (float)length);
+    return { mul, (1.0f - mul) * aim, to, length };
+}
+
+EnvelopeSegment Envelope::stageSegment(Stage s, float from, const Params& p, float sampleRate) {
+    auto samples = [&](float seconds) { return (int32_t)std::lround(seconds * sampleRate); };
+
+    switch (s) {
+        case ATTACK:
+            // A retrigger part way up keeps the attack slope, not its duration
+            return segment(p.curve, from, 1.0f, samples(p.attack * (1.0f - std::min(from, 1.0f))),
+                           kAttackOvershoot);
+        case DECAY:
+            return segment(p.curve, from, p.sustain, samples(p.decay), kDecayOvershoot);
+        case RELEASE:
+            return segment(p.curve, from, 0.0f, samples(p.release), kDecayOvershoot);
+        case SUSTAIN:
+            return { 1.0f, 0.0f, from, INT32_MAX };
+        case OFF:
+            break;
+    }
+    return { 1.0f, 0.0f, 0.0f, INT32_MAX };
+}
+
+Envelope::Envelope()
+    : sampleRate(48000.0f),
+      stage(OFF),
+      level(0.0f),
+      seg{ 1.0f, 0.0f, 0.0f, INT32_MAX },
+      left(INT32_MAX)
+{}
+
+void Envelope::setSampleRate(float sr) { sampleRate = std::max(1.0f, sr); }
+void Envelope::setParams(const Params& p) { params = p; }
+
+void Envelope::setAttack(float seconds)  { params.attack  = std::max(0.0f, seconds); }
+void Envelope::setDecay(float seconds)   { params.decay   = std::max(0.0f, seconds); }
+void Envelope::setSustain(float lvl)     { params.sustain = std::clamp(lvl, 0.0f, 1.0f); }
+void Envelope::setRelease(float seconds) { params.release = std::max(0.0f, seconds); }
+void Envelope::setCurve(Curve c)         { params.curve = c; }
+
+void Envelope::enter(Stage s) {
+    stage = s;
+    if (s == OFF) level = 0.0f;
+    seg = stageSegment(s, level, params, sampleRate);
+    left = seg.length;
+}
+
+void Envelope::noteOn() { enter(ATTACK); }
+
+void Envelope::noteOff() {
+    if (stage != OFF) enter(RELEASE);
+}
+
+// The last sample of a segment is the multiply-add result like any other;
+// the level snaps to the target only for the next segment's start, which
+// matches what the voice kernels produce
+float Envelope::next() {
+    level = level * seg.mul + seg.add;
+    const float out = level;
+    if (--left == 0) {
+        level = seg.target;
+        enter(nextStage(stage));
+    }
+    return out;
+}
+
+void Envelope::render(float* out, int n) {
+    while (n > 0) {
+        const int run = (int)std::min<int32_t>(left, n);
+        const float mul = seg.mul, add = seg.add;
+        float lvl = level;
+        for (int i = 0; i < run; ++i) {
+            lvl = lvl * mul + add;
+            out[i] = lvl;
+        }
+        level = lvl;
+        out += run;
+        n -= run;
+
+        left -= run;
+        if (left == 0) {
+            level = seg.target;
+            enter(nextStage(stage));
+        }
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef ENVELOPE_H
+#define ENVELOPE_H
+
+#include <cstdint>
+
+// One envelope segment: level = level * mul + add each sample, for `length`
+// samples, after which the level is snapped to `target`. Linear segments
+// have mul == 1; exponential ones approach an overshoot of the target.
+struct EnvelopeSegment {
+    float mul;
+    float add;
+    float target;
+    int32_t length;
+};
+
+// ADSR generator built from precomputed segments. All per-stage maths
+// (lengths, coefficients) happens when a stage starts, so running a stage is
+// one multiply-add per sample and stage changes land on exact samples.
+class Envelope {
+public:
+    enum Stage { ATTACK, DECAY, SUSTAIN, RELEASE, OFF };
+    enum Curve { LINEAR, EXPONENTIAL };
+
+    struct Params {
+        float attack  = 0.05f;  // seconds
+        float decay   = 0.05f;  // seconds
+        float sustain = 0.8f;   // level
+        float release = 0.1f;   // seconds
+        Curve curve   = LINEAR;
+    };
+
+    // Segment going from `from` to `to` in `length` (>= 1) samples
+    static EnvelopeSegment segment(Curve c, float from, float to, int32_t length, float overshoot);
+
+    // Segment for stage s starting at level `from`
+    static EnvelopeSegment stageSegment(Stage s, float from, const Params& p, float sampleRate);
+
+    // Stage entered when `finished` runs out; SUSTAIN and OFF never end
+    // (their segments are INT32_MAX long and simply restart)
+    static Stage nextStage(Stage finished) {
+        switch (finished) {
+            case ATTACK:  return DECAY;
+            case DECAY:   return SUSTAIN;
+            case RELEASE: return OFF;
+            default:      return finished;
+        }
+    }
+
+    Envelope();
+
+    void setSampleRate(float sr);
+    void setParams(const Params& p);
+    const Params& getParams() const { return params; }
+
+    void setAttack(float seconds);
+    void setDecay(float seconds);
+    void setSustain(float level);
+    void setRelease(float seconds);
+    void setCurve(Curve c);
+
+    void noteOn();   // attack from the current level
+    void noteOff();  // release from the current level
+
+    float next();                   // one sample
+    void render(float* out, int n); // n samples, one tight loop per segment
+
+    Stage getStage() const { return stage; }
+    float getLevel() const { return level; }
+
+private:
+    void enter(Stage s);
+
+    Params params;
+    float sampleRate;
+    Stage stage;
+    float level;
+    EnvelopeSegment seg;
+    int32_t left;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#include "FastMath.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <xmmintrin.h>
+// MXCSR flush-to-zero and denormals-are-zero
+static constexpr uint32_t kFlushBits = 0x8040;
+#elif defined(__aarch64__)
+// FPCR.FZ; inputs are flushed along with results
+static constexpr uint64_t kFlushBits = 1ull << 24;
+#endif
+
+static uint64_t floatMode() {
+#if defined(__x86_64__) || defined(__i386__)
+    return _mm_getcsr();
+#elif defined(__aarch64__)
+    uint64_t fpcr;
+    asm volatile("mrs %0, fpcr" : "=r"(fpcr));
+    return fpcr;
+#else
+    return 0;
+#endif
+}
+
+static void setFloatMode(uint64_t mode) {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_setcsr((unsigned)mode);
+#elif defined(__aarch64__)
+    asm volatile("msr fpcr, %0" : : "r"(mode));
+#else
+    (void)mode;
+#endif
+}
+
+DenormalGuard::DenormalGuard()
+    : saved_(floatMode())
+{
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+    setFloatMode(saved_ | kFlushBits);
+#endif
+}
+
+DenormalGuard::~DenormalGuard() {
+    setFloatMode(saved_);
+}
+
+bool DenormalGuard::active() {
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+    return (floatMode() & kFlushBits) == kFlushBits;
+#else
+    return false;
+#endif
+}
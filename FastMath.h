@@ -0,0 +1,139 @@
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+#include <cstdint>
+#include "Simd.h"
+
+// Polynomial approximations shared by the DSP code, as Vec<N> templates
+// (see Simd.h) with scalar overloads. Error bounds hold over every float in
+// the range given and are checked against libm in double by
+// minisynth_bench --verify (every float with --exhaustive):
+//
+//   sin2pi(x)   sin(2 pi x), |x| < 2^22        abs error < 2e-7
+//   cos2pi(x)   cos(2 pi x), |x| < 2^22        abs error < 3e-7
+//   exp2(x)     -126 <= x <= 127               rel error < 3e-7
+//   log2(x)     normal x > 0                   abs error < 2.5e-7 up to 1,
+//                                              rel error past it
+//   tanh(x)     any x                          abs error < 2.5e-7
+//   pow(x, y)   x > 0, as exp2(y log2(x))      rel error < 2.5e-7 per unit
+//                                              of |y log2 x| + 1
+//
+// No special values: no NaN or infinity in or out, and zero and denormal
+// arguments to log2 are out of range.
+namespace simd {
+namespace {
+
+// Taylor series to degree 11 after folding into [-1/4, 1/4] turns
+template <int N>
+inline typename Vec<N>::f sin2pi(typename Vec<N>::f x) {
+    typedef typename Vec<N>::f F;
+    F t = x - vround<N>(x);                                 // [-0.5, 0.5]
+    t = select<N>(t >  0.25f,  0.5f - t, t);
+    t = select<N>(t < -0.25f, -0.5f - t, t);                // [-0.25, 0.25]
+
+    const F y  = t * 6.28318530718f;
+    const F y2 = y * y;
+    F p = splat<N>(-2.50521083854e-8f);                     // -1/11!
+    p = p * y2 + 2.75573192240e-6f;                          //  1/9!
+    p = p * y2 - 1.98412698413e-4f;                          // -1/7!
+    p = p * y2 + 8.33333333333e-3f;                          //  1/5!
+    p = p * y2 - 1.66666666667e-1f;                          // -1/3!
+    return y + y * y2 * p;
+}
+
+// A quarter turn on, folded first so small x keep their precision
+template <int N>
+inline typename Vec<N>::f cos2pi(typename Vec<N>::f x) {
+    return sin2pi<N>((x - vround<N>(x)) + 0.25f);
+}
+
+// Taylor series to degree 6 on the fraction after rounding; exactly 1 at 0
+template <int N>
+inline typename Vec<N>::f exp2(typename Vec<N>::f x) {
+    typedef typename Vec<N>::i I;
+    typedef typename Vec<N>::f F;
+    const F r = vround<N>(x);
+    const F t = x - r;                                       // [-0.5, 0.5]
+    F p = splat<N>(1.54035304e-4f);                          // ln2^6/6!
+    p = p * t + 1.33335581e-3f;
+    p = p * t + 9.61812911e-3f;
+    p = p * t + 5.55041087e-2f;
+    p = p * t + 2.40226507e-1f;
+    p = p * t + 6.93147181e-1f;
+    p = p * t + 1.0f;
+    // 2^r in two halves, so r = 127 does not overflow the exponent field
+    const I e = __builtin_convertvector(r, I);
+    const I lo = (e >> 1) + 127, hi = (e - (e >> 1)) + 127;
+    return p * (F)(lo << 23) * (F)(hi << 23);
+}
+
+// Exponent plus log2 of the mantissa in [sqrt(1/2), sqrt(2)), by the
+// atanh series in t = (m - 1) / (m + 1) to degree 11
+template <int N>
+inline typename Vec<N>::f log2(typename Vec<N>::f x) {
+    typedef typename Vec<N>::i I;
+    typedef typename Vec<N>::f F;
+    const I bits = (I)x;
+    I e = ((bits >> 23) & 0xff) - 127;
+    F m = (F)((bits & 0x007fffff) | 0x3f800000);           // [1, 2)
+    const I big = m > 1.41421356f;
+    m = select<N>(big, m * 0.5f, m);
+    e -= big;                                                // true is -1
+
+    const F t = (m - 1.0f) / (m + 1.0f);
+    const F t2 = t * t;
+    F p = splat<N>(1.0f / 11.0f);
+    p = p * t2 + 1.0f / 9.0f;
+    p = p * t2 + 1.0f / 7.0f;
+    p = p * t2 + 1.0f / 5.0f;
+    p = p * t2 + 1.0f / 3.0f;
+    p = p * t2 + 1.0f;
+    return __builtin_convertvector(e, F) + t * p * 2.88539008f;  // 2/ln2
+}
+
+// 1 - 2 / (e^2|x| + 1), with the sign put back; saturates past |x| = 9
+template <int N>
+inline typename Vec<N>::f tanh(typename Vec<N>::f x) {
+    typedef typename Vec<N>::i I;
+    typedef typename Vec<N>::f F;
+    const F a = vmin<N>(vabs<N>(x), splat<N>(9.0f));
+    const F y = 1.0f - 2.0f / (exp2<N>(a * 2.88539008f) + 1.0f);  // 2/ln2
+    return (F)((I)y | ((I)x & splati<N>(INT32_MIN)));
+}
+
+template <int N>
+inline typename Vec<N>::f pow(typename Vec<N>::f x, typename Vec<N>::f y) {
+    return exp2<N>(y * log2<N>(x));
+}
+
+// Scalar forms, for per-tick and per-note code
+inline float sin2pi(float x) { return sin2pi<1>(splat<1>(x))[0]; }
+inline float cos2pi(float x) { return cos2pi<1>(splat<1>(x))[0]; }
+inline float exp2(float x)   { return exp2<1>(splat<1>(x))[0]; }
+inline float log2(float x)   { return log2<1>(splat<1>(x))[0]; }
+inline float tanh(float x)   { return tanh<1>(splat<1>(x))[0]; }
+inline float pow(float x, float y) { return pow<1>(splat<1>(x), splat<1>(y))[0]; }
+
+} // namespace
+} // namespace simd
+
+// Sets flush-to-zero and denormals-are-zero on the calling thread for its
+// lifetime and restores the previous mode after. Denormal arithmetic is
+// up to a hundred times slower on x86, and decaying filters and release
+// tails produce it; every thread that renders audio holds one.
+class DenormalGuard {
+public:
+    DenormalGuard();
+    ~DenormalGuard();
+
+    DenormalGuard(const DenormalGuard&) = delete;
+    DenormalGuard& operator=(const DenormalGuard&) = delete;
+
+    // Whether the calling thread flushes denormals now
+    static bool active();
+
+private:
+    uint64_t saved_;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include "Fft.h"
+#include "Simd.h"
+#include <cmath>
+
+RealFft::RealFft(int n) {
+    n_ = 4;
+    while (n_ < n) n_ <<= 1;
+    m_ = n_ / 2;
+
+    int bits = 0;
+    while ((1 << bits) < m_) ++bits;
+    bitrev_.resize(m_);
+    for (int i = 0; i < m_; ++i) {
+        int r = 0;
+        for (int b = 0; b < bits; ++b) r |= ((i >> b) & 1) << (bits - 1 - b);
+        bitrev_[i] = r;
+    }
+
+    // Twiddles in double so the big transforms stay accurate
+    twRe_.resize(m_);
+    twIm_.resize(m_);
+    for (int h = 1; h < m_; h <<= 1) {
+        for (int j = 0; j < h; ++j) {
+            const double a = -M_PI * j / h;
+            twRe_[h - 1 + j] = (float)std::cos(a);
+            twIm_[h - 1 + j] = (float)std::sin(a);
+        }
+    }
+    postRe_.resize(m_);
+    postIm_.resize(m_);
+    for (int k = 0; k < m_; ++k) {
+        const double a = -2.0 * M_PI * k / n_;
+        postRe_[k] = (float)std::cos(a);
+        postIm_[k] = (float)std::sin(a);
+    }
+    zr_.resize(m_);
+    zi_.resize(m_);
+}
+
+// In-place complex FFT of the bit-reversed zr_, zi_
+void RealFft::transform() {
+    typedef simd::Vec<4>::f V;
+    float* zr = zr_.data();
+    float* zi = zi_.data();
+
+    for (int h = 1; h < m_; h <<= 1) {
+        const float* wr = twRe_.data() + h - 1;
+        const float* wi = twIm_.data() + h - 1;
+        for (int s = 0; s < m_; s += 2 * h) {
+            float* ar = zr + s;
+            float* ai = zi + s;
+            float* br = ar + h;
+            float* bi = ai + h;
+            if (h >= 4) {
+                for (int j = 0; j < h; j += 4) {
+                    const V c = simd::load<4>(wr + j), d = simd::load<4>(wi + j);
+                    const V xr = simd::load<4>(br + j), xi = simd::load<4>(bi + j);
+                    const V tr = c * xr - d * xi;
+                    const V ti = c * xi + d * xr;
+                    const V ur = simd::load<4>(ar + j), ui = simd::load<4>(ai + j);
+                    simd::store<4>(br + j, ur - tr);
+                    simd::store<4>(bi + j, ui - ti);
+                    simd::store<4>(ar + j, ur + tr);
+                    simd::store<4>(ai + j, ui + ti);
+                }
+            } else {
+                for (int j = 0; j < h; ++j) {
+                    const float tr = wr[j] * br[j] - wi[j] * bi[j];
+                    const float ti = wr[j] * bi[j] + wi[j] * br[j];
+                    br[j] = ar[j] - tr;
+                    bi[j] = ai[j] - ti;
+                    ar[j] += tr;
+                    ai[j] += ti;
+                }
+            }
+        }
+    }
+}
+
+void RealFft::forward(const float* in, float* re, float* im) {
+    float* zr = zr_.data();
+    float* zi = zi_.data();
+
+    for (int i = 0; i < m_; ++i) {
+        zr[bitrev_[i]] = in[2 * i];
+        zi[bitrev_[i]] = in[2 * i + 1];
+    }
+    transform();
+
+    // Even and odd halves of Z[k] and conj(Z[m - k]), recombined with e^(-2 pi i k / n)
+    re[0] = zr[0] + zi[0];
+    im[0] = 0.0f;
+    re[m_] = zr[0] - zi[0];
+    im[m_] = 0.0f;
+    for (int k = 1; k < m_; ++k) {
+        const float ar = zr[k], ai = zi[k];
+        const float br = zr[m_ - k], bi = zi[m_ - k];
+        const float er = 0.5f * (ar + br), ei = 0.5f * (ai - bi);
+        const float orr = 0.5f * (ai + bi), oi = -0.5f * (ar - br);
+        re[k] = er + postRe_[k] * orr - postIm_[k] * oi;
+        im[k] = ei + postRe_[k] * oi + postIm_[k] * orr;
+    }
+}
+
+// Even and odd halves back out of the spectrum, E[k] + i O[k] = Z[k], then
+// an inverse complex FFT as a forward one on the conjugate. Both halves
+// come out doubled, which with the m-point transform makes the n.
+void RealFft::inverse(const float* re, const float* im, float* out) {
+    float* zr = zr_.data();
+    float* zi = zi_.data();
+
+    for (int k = 0; k < m_; ++k) {
+        const float ar = re[k], ai = im[k];
+        const float br = re[m_ - k], bi = -im[m_ - k];
+        const float er = ar + br, ei = ai + bi;
+        const float dr = ar - br, di = ai - bi;
+        // O[k] = (X[k] - conj X[m - k]) e^(2 pi i k / n)
+        const float orr = dr * postRe_[k] + di * postIm_[k];
+        const float oi = di * postRe_[k] - dr * postIm_[k];
+        zr[bitrev_[k]] = er - oi;
+        zi[bitrev_[k]] = -(ei + orr);
+    }
+    transform();
+
+    for (int i = 0; i < m_; ++i) {
+        out[2 * i] = zr[i];
+        out[2 * i + 1] = -zi[i];
+    }
+}
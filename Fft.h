@@ -0,0 +1,43 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <vector>
+
+// Real-input FFT of a fixed power-of-two size. The n reals are packed as
+// n/2 complex values (even samples real, odd imaginary), transformed by an
+// iterative radix-2 FFT on split re/im arrays, and untangled into the
+// n/2 + 1 bins of the real spectrum: half the work of a complex FFT of the
+// same size. Butterflies spanning four or more run four at a time.
+//
+// Tables are built by the constructor; forward() and inverse() do not
+// allocate. An instance has scratch space, so one thread at a time.
+class RealFft {
+public:
+    // n is rounded up to a power of two, at least 4
+    explicit RealFft(int n);
+
+    int size() const { return n_; }
+    int bins() const { return n_ / 2 + 1; }
+
+    // X[k] = sum x[t] e^(-2 pi i k t / n), unnormalised; re and im get
+    // bins() values each
+    void forward(const float* in, float* re, float* im);
+
+    // x[t] = sum X[k] e^(2 pi i k t / n) over the whole spectrum, from its
+    // bins() values: forward() then inverse() scales by n. re and im are
+    // not modified.
+    void inverse(const float* re, const float* im, float* out);
+
+private:
+    void transform();
+
+
+    int n_;
+    int m_;                               // complex points, n / 2
+    std::vector<int> bitrev_;
+    std::vector<float> twRe_, twIm_;      // stage of half-span h at offset h - 1
+    std::vector<float> postRe_, postIm_;  // e^(-2 pi i k / n), k < m
+    std::vector<float> zr_, zi_;
+};
+
+#endif
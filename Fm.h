@@ -0,0 +1,53 @@
+#ifndef FM_H
+#define FM_H
+
+#include <cstdint>
+#include "Envelope.h"
+
+// Four-operator phase modulation for Oscillator::FM voices. Each operator
+// is a sine at `ratio` times the voice's pitch with its own ADSR and
+// output level; an operator's output, in cycles, shifts the phase of the
+// operators it modulates, and feedback shifts its own by the mean of its
+// last two outputs. The carriers' outputs, averaged, are the voice's
+// oscillator, which then runs through the voice envelope, filter and
+// gains like any other waveform.
+//
+// Routing is one of kFmAlgorithms fixed graphs. Operators only modulate
+// lower-numbered ones, so evaluating 3 down to 0 sees every modulator's
+// output of the same sample.
+static constexpr int kFmOperators = 4;
+static constexpr int kFmAlgorithms = 8;
+
+struct FmAlgorithm {
+    uint8_t modulators[kFmOperators];  // per operator, a bit per modulating operator
+    uint8_t carriers;                  // a bit per carrier
+};
+
+//   0: 3 > 2 > 1 > 0          4: 3 > 2, 1 > 0
+//   1: 3 + 2 > 1 > 0          5: 3 > 2 + 1 + 0
+//   2: 3 + (2 > 1) > 0        6: 3 > 2, then 2, 1, 0 out
+//   3: (3 > 2) + 1 > 0        7: 3, 2, 1, 0 out
+static constexpr FmAlgorithm kFmAlgorithmTable[kFmAlgorithms] = {
+    { { 0x2, 0x4, 0x8, 0x0 }, 0x1 },
+    { { 0x2, 0xC, 0x0, 0x0 }, 0x1 },
+    { { 0xA, 0x4, 0x0, 0x0 }, 0x1 },
+    { { 0x6, 0x0, 0x8, 0x0 }, 0x1 },
+    { { 0x2, 0x0, 0x8, 0x0 }, 0x5 },
+    { { 0x8, 0x8, 0x8, 0x0 }, 0x7 },
+    { { 0x0, 0x0, 0x8, 0x0 }, 0x7 },
+    { { 0x0, 0x0, 0x0, 0x0 }, 0xF },
+};
+
+struct FmOperator {
+    float ratio = 1.0f;     // of the voice's pitch, > 0
+    float level = 1.0f;     // output; 1 is a full cycle of modulation
+    float feedback = 0.0f;  // 0..1
+    Envelope::Params envelope;
+};
+
+struct FmParams {
+    int algorithm = 0;
+    FmOperator op[kFmOperators];
+};
+
+#endif
@@ -0,0 +1,246 @@
+#include "Governor.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+
+// How often the log thread drains the ring
+static constexpr int kLogDrainMs = 50;
+
+// Spread of lanes, squared, below which the fit's slope means nothing and
+// the cost is taken as proportional to the lanes
+static constexpr double kMinVariance = 1.0;
+
+void Governor::Fit::add(double lanes, double ns, double keep) {
+    w  = w * keep + 1.0;
+    x  = x * keep + lanes;
+    y  = y * keep + ns;
+    xx = xx * keep + lanes * lanes;
+    xy = xy * keep + lanes * ns;
+}
+
+void Governor::Fit::line(double& base, double& perLane) const {
+    const double mx = x / w, my = y / w;
+    const double var = xx / w - mx * mx;
+    const double cov = xy / w - mx * my;
+    if (var > kMinVariance && cov > 0.0) {
+        perLane = cov / var;
+        base = my - perLane * mx;
+        if (base >= 0.0) return;
+    }
+    // Too little spread to separate the two, or a line through negative
+    // overhead: all of it per lane, which errs on the dear side as lanes grow
+    if (mx >= 1.0) {
+        base = 0.0;
+        perLane = my / mx;
+    } else {
+        base = my;
+        perLane = 0.0;
+    }
+}
+
+double Governor::Fit::predict(double lanes) const {
+    double base, perLane;
+    line(base, perLane);
+    return base + perLane * lanes;
+}
+
+int Governor::Fit::lanesWithin(double ns) const {
+    double base, perLane;
+    line(base, perLane);
+    if (perLane <= 0.0) return INT_MAX;
+    return (int)std::max(0.0, std::floor((ns - base) / perLane));
+}
+
+Governor::Governor(float sampleRate)
+    : Governor(sampleRate, Options())
+{
+}
+
+Governor::Governor(float sampleRate, const Options& options)
+    : sampleRate_(std::max(1.0f, sampleRate)),
+      options_(options)
+{
+}
+
+Governor::~Governor() {
+    stopLog();
+}
+
+// The first `level` of the allowed steps, in Step order
+int Governor::stepsFor(int allowed, int level) {
+    int s = 0;
+    for (int b = 0; b < kSteps && level > 0; ++b) {
+        if (allowed & (1 << b)) {
+            s |= 1 << b;
+            --level;
+        }
+    }
+    return s;
+}
+
+Governor::Decision Governor::plan(uint64_t frame, unsigned long frames, int lanes) {
+    frame_ = frame;
+    frames_ = frames;
+    Decision d;
+    d.steps = active_;
+    if (frames == 0) return d;
+
+    const double blockNs = frames * 1e9 / sampleRate_;
+    budgetNs_ = blockNs * std::clamp(budget.load(std::memory_order_relaxed), 0.05f, 1.0f);
+    const double high = budgetNs_ * options_.highWater;
+    const double low = budgetNs_ * options_.lowWater;
+
+    const int allowed = steps.load(std::memory_order_relaxed) & AllSteps;
+    const int top = enabled.load(std::memory_order_relaxed) ? __builtin_popcount(allowed) : 0;
+
+    // Cost of this block at level l, by the nearest fit at or below it; 0
+    // when nothing is measured yet
+    auto fitFor = [&](int l) -> const Fit* {
+        for (; l >= 0; --l) {
+            if (fits_[l].known()) return &fits_[l];
+        }
+        return nullptr;
+    };
+    auto predict = [&](int l) {
+        const Fit* f = fitFor(l);
+        return f ? f->predict(lanes) * frames : 0.0;
+    };
+
+    int target = std::min(level_, top);
+    double predicted = predict(target);
+    if (predicted > high) {
+        calmFrames_ = 0.0;
+        while (target < top) {
+            ++target;
+            predicted = predict(target);
+            if (!fits_[target].known() || predicted <= high) break;
+        }
+    } else if (target > 0 && target == level_) {
+        if (predict(target - 1) <= low) {
+            calmFrames_ += frames;
+            if (calmFrames_ >= options_.holdSec * sampleRate_) {
+                --target;
+                calmFrames_ = 0.0;
+                predicted = predict(target);
+            }
+        } else {
+            calmFrames_ = 0.0;
+        }
+    }
+
+    const int changed = target - level_;
+    level_ = target;
+    active_ = stepsFor(allowed, level_);
+    if (changed) log(changed > 0 ? GovernorEvent::StepUp : GovernorEvent::StepDown, lanes, 0, predicted);
+
+    d.steps = active_;
+    if ((active_ & DropReleased) && predicted > high) {
+        d.dropLanes = std::max(0, lanes - fitFor(level_)->lanesWithin(high / frames));
+    }
+
+    shownLevel_.store(level_, std::memory_order_relaxed);
+    shownSteps_.store(active_, std::memory_order_relaxed);
+    shownPredicted_.store(predicted * 1e-3, std::memory_order_relaxed);
+    shownBudget_.store(budgetNs_ * 1e-3, std::memory_order_relaxed);
+    return d;
+}
+
+void Governor::measured(uint64_t ns, int lanes, int dropped) {
+    if (frames_ == 0) return;
+    const double blockNs = frames_ * 1e9 / sampleRate_;
+    lastNs_ = (double)ns;
+    fits_[level_].add(lanes, lastNs_ / frames_, 1.0 - 1.0 / std::max(1.0f, options_.memoryBlocks));
+    shownLoad_.store(100.0 * lastNs_ / blockNs, std::memory_order_relaxed);
+
+    if (dropped > 0) {
+        droppedLanes_.store(droppedLanes_.load(std::memory_order_relaxed) + dropped, std::memory_order_relaxed);
+        log(GovernorEvent::Drop, lanes, dropped, 0.0);
+    }
+    if (lastNs_ > blockNs) {
+        overruns_.store(overruns_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        log(GovernorEvent::Overrun, lanes, 0, 0.0);
+    }
+}
+
+void Governor::log(int kind, int lanes, int dropped, double predictedNs) {
+    GovernorEvent e;
+    e.frame = frame_;
+    e.kind = kind;
+    e.level = level_;
+    e.steps = active_;
+    e.lanes = lanes;
+    e.dropped = dropped;
+    e.predictedUs = (float)(predictedNs * 1e-3);
+    e.measuredUs = (float)(lastNs_ * 1e-3);
+    e.budgetUs = (float)(budgetNs_ * 1e-3);
+    log_.push(e);
+}
+
+bool Governor::startLog(const std::string& path) {
+    if (logger_.joinable()) return false;
+    file_ = std::fopen(path.c_str(), "a");
+    if (!file_) {
+        std::fprintf(stderr, "Governor: cannot open %s\n", path.c_str());
+        return false;
+    }
+    quit_ = false;
+    logger_ = std::thread([this] { logLoop(); });
+    return true;
+}
+
+void Governor::stopLog() {
+    if (!logger_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        quit_ = true;
+    }
+    wake_.notify_one();
+    logger_.join();
+
+    std::fclose(file_);
+    file_ = nullptr;
+}
+
+void Governor::logLoop() {
+    for (bool last = false; !last;) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex_);
+            wake_.wait_for(lock, std::chrono::milliseconds(kLogDrainMs), [this] { return quit_; });
+            last = quit_;
+        }
+        GovernorEvent e;
+        bool wrote = false;
+        while (log_.pop(e)) {
+            writeJson(file_, e);
+            wrote = true;
+        }
+        if (wrote) std::fflush(file_);
+    }
+}
+
+const char* Governor::stepName(Step s) {
+    switch (s) {
+        case DropReleased:     return "drop_released";
+        case SlowControl:      return "slow_control";
+        case NoOversampling:   return "no_oversampling";
+        case NaiveOscillators: return "naive_oscillators";
+        default:               return "?";
+    }
+}
+
+void Governor::writeJson(std::FILE* f, const GovernorEvent& e) {
+    static const char* const kinds[] = { "step_up", "step_down", "drop", "overrun" };
+    std::fprintf(f,
+        "{\"frame\":%llu,\"event\":\"%s\",\"level\":%d,\"lanes\":%d,\"dropped\":%d,"
+        "\"predicted_us\":%.1f,\"measured_us\":%.1f,\"budget_us\":%.1f,\"steps\":[",
+        (unsigned long long)e.frame, kinds[std::clamp(e.kind, 0, 3)], e.level, e.lanes, e.dropped,
+        e.predictedUs, e.measuredUs, e.budgetUs);
+    bool first = true;
+    for (int b = 0; b < kSteps; ++b) {
+        if (!(e.steps & (1 << b))) continue;
+        std::fprintf(f, first ? "\"%s\"" : ",\"%s\"", stepName((Step)(1 << b)));
+        first = false;
+    }
+    std::fprintf(f, "]}\n");
+}
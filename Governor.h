@@ -0,0 +1,166 @@
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "MessageQueue.h"
+
+// One decision of the governor, as logged
+struct GovernorEvent {
+    enum Kind {
+        StepUp,    // to a cheaper level, ahead of a block predicted over highWater
+        StepDown,  // back one level after holdSec predicted under lowWater
+        Drop,      // released voices removed to fit the budget
+        Overrun    // a block took longer than its audio time
+    };
+    uint64_t frame;      // engine timeline at the start of the block
+    int kind;
+    int level;           // after the decision
+    int steps;           // Governor::Step bits in force after it
+    int lanes;           // sounding lanes: expected (steps), rendered (Drop, Overrun)
+    int dropped;         // lanes removed (Drop)
+    float predictedUs;   // cost of the block at the new level, by the fit plan() used
+    float measuredUs;    // cost of the last block
+    float budgetUs;
+};
+
+// CPU budget for Synth::processBlock (Synth::setGovernor()). Each block has
+// frames / sampleRate of audio time; the budget is a fraction of that,
+// leaving the rest to the device, the other threads and the unexpected.
+//
+// The governor times every block and fits its cost per frame as a line in
+// the number of sounding lanes, separately for each quality level, with
+// weights fading over memoryBlocks. Before a block it predicts the cost
+// from the lanes sounding plus those the block's commands will start, and
+// if that passes highWater of the budget it steps up to the first level
+// predicted to fit (a level not measured yet is taken one block at a
+// time). Level n applies the first n allowed steps, in Step order, from
+// cheapest in sound to dearest. It steps back down one level at a time,
+// once the level below has been predicted under lowWater for holdSec, so
+// a load near the budget does not flap between levels.
+//
+// DropReleased, while in force, removes as many of the quietest released
+// voices as the fit says are over highWater; the others change settings
+// that come back when the step is undone.
+//
+// Every step, drop and overrun is logged: a wait-free push onto a ring
+// that a log thread (startLog()) writes out as JSON lines, or that a
+// caller drains with poll(). Events that do not fit are counted in
+// logOverflows().
+class Governor {
+public:
+    enum Step {
+        DropReleased     = 1 << 0,
+        SlowControl      = 1 << 1,  // control rate kControlRateFactor times coarser
+        NoOversampling   = 1 << 2,  // voices render at the sample rate
+        NaiveOscillators = 1 << 3,  // naive shapes instead of wavetables
+        AllSteps         = (1 << 4) - 1
+    };
+    static constexpr int kSteps = 4;
+    static constexpr int kControlRateFactor = 4;
+    static constexpr size_t kLogSize = 1024;
+
+    struct Options {
+        float highWater = 0.9f;    // of the budget
+        float lowWater = 0.6f;
+        float holdSec = 1.0f;
+        float memoryBlocks = 64.0f;
+    };
+
+    // What to do for the block plan() was asked about
+    struct Decision {
+        int steps = 0;      // Step bits in force
+        int dropLanes = 0;  // released lanes to remove before rendering
+    };
+
+    explicit Governor(float sampleRate);
+    Governor(float sampleRate, const Options& options);
+    ~Governor();
+
+    Governor(const Governor&) = delete;
+    Governor& operator=(const Governor&) = delete;
+
+    // Settings, picked up at the next block; any thread. Disabled, the
+    // governor goes back to full quality but keeps measuring.
+    std::atomic<bool>  enabled{true};
+    std::atomic<float> budget{0.75f};    // of each block's audio time, 0.05..1
+    std::atomic<int>   steps{AllSteps};  // Step bits it may use
+
+    // Audio thread: plan() before a block of `frames` starting at engine
+    // frame `frame` with `lanes` expected to sound; measured() after it,
+    // with the time it took, the lanes it rendered and the lanes dropped.
+    // Wait-free, no allocation.
+    Decision plan(uint64_t frame, unsigned long frames, int lanes);
+    void measured(uint64_t ns, int lanes, int dropped);
+
+    // Latest state; any thread
+    int level() const { return shownLevel_.load(std::memory_order_relaxed); }
+    int activeSteps() const { return shownSteps_.load(std::memory_order_relaxed); }
+    double loadPercent() const { return shownLoad_.load(std::memory_order_relaxed); }  // of the audio time
+    double predictedUs() const { return shownPredicted_.load(std::memory_order_relaxed); }
+    double budgetUs() const { return shownBudget_.load(std::memory_order_relaxed); }
+    uint64_t overruns() const { return overruns_.load(std::memory_order_relaxed); }
+    uint64_t droppedLanes() const { return droppedLanes_.load(std::memory_order_relaxed); }
+    uint64_t logOverflows() const { return log_.overflows(); }
+
+    // Log thread appending each event to path as a JSON line; not for the
+    // audio thread
+    bool startLog(const std::string& path);
+    void stopLog();
+
+    // Next logged event, when no log thread is running
+    bool poll(GovernorEvent& e) { return log_.pop(e); }
+    static void writeJson(std::FILE* f, const GovernorEvent& e);
+    static const char* stepName(Step s);
+
+private:
+    // Cost per frame against sounding lanes: least squares with weights
+    // fading by `keep` per block
+    struct Fit {
+        double w = 0.0, x = 0.0, y = 0.0, xx = 0.0, xy = 0.0;
+        void add(double lanes, double ns, double keep);
+        bool known() const { return w > 0.0; }
+        void line(double& base, double& perLane) const;
+        double predict(double lanes) const;
+        int lanesWithin(double ns) const;
+    };
+
+    static int stepsFor(int allowed, int level);
+    void log(int kind, int lanes, int dropped, double predictedNs);
+    void logLoop();
+
+    const float sampleRate_;
+    const Options options_;
+
+    // Audio thread
+    Fit fits_[kSteps + 1];
+    int level_ = 0;
+    int active_ = 0;
+    uint64_t frame_ = 0;
+    unsigned long frames_ = 0;
+    double budgetNs_ = 0.0;
+    double lastNs_ = 0.0;
+    double calmFrames_ = 0.0;
+
+    std::atomic<int> shownLevel_{0};
+    std::atomic<int> shownSteps_{0};
+    std::atomic<double> shownLoad_{0.0};
+    std::atomic<double> shownPredicted_{0.0};
+    std::atomic<double> shownBudget_{0.0};
+    std::atomic<uint64_t> overruns_{0};
+    std::atomic<uint64_t> droppedLanes_{0};
+
+    SpscQueue<GovernorEvent, kLogSize> log_;
+    std::FILE* file_ = nullptr;
+    bool quit_ = false;
+    std::mutex wakeMutex_;
+    std::condition_variable wake_;
+    std::thread logger_;
+};
+
+#endif
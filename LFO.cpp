@@ -1,10 +1,7 @@
 #include "LFO.h"
+#include "FastMath.h"
 #include <cmath>
 
-static constexpr float TWO_PI = 6.28318530718f;
-
-LFO::LFO() {}
-
 void LFO::setSampleRate(float sr){
     sampleRate = (sr > 1.0f) ? sr : 1.0f;
 }
@@ -21,26 +18,38 @@ void LFO::setParameter(Parameter parameter){
     param = parameter;
 }
 
-float LFO::computeSample(){
+float LFO::valueAt(float p) const {
     float sample = 0.0f;
 
     switch(waveform){
         case SINE:
-            sample = std::sin(TWO_PI * phase);
+            sample = simd::sin2pi(p);
             break;
         case SQUARE:
-            sample = (phase < 0.5f) ? 1.0f : -1.0f;
+            sample = (p < 0.5f) ? 1.0f : -1.0f;
             break;
         case TRIANGLE:
-            sample = 4.0f * std::abs(phase - 0.5f) - 1.0f;
+            sample = 4.0f * std::abs(p - 0.5f) - 1.0f;
             break;
         case SAW:
-            sample = 2.0f * phase - 1.0f;
+            sample = 2.0f * p - 1.0f;
             break;
     }
 
+    return sample;
+}
+
+float LFO::computeSample(){
+    const float sample = valueAt(phase);
+
     phase += frequency / sampleRate;
     if (phase >= 1.0f) phase -= 1.0f;
 
     return sample; // [-1, 1]
 }
+
+float LFO::advance(int samples){
+    phase += frequency * (float)samples / sampleRate;
+    phase -= std::floor(phase);
+    return valueAt(phase);
+}
@@ -6,16 +6,21 @@ public:
     enum Waveform { SINE, SQUARE, TRIANGLE, SAW };
     enum Parameter { NONE, PITCH, AMP, FILTER };
 
-    LFO();
-
     void setSampleRate(float sr);
     void setFrequency(float freqHz);
     void setWaveform(Waveform w);
     void setParameter(Parameter parameter);
+    Parameter getParameter() const { return param; }
 
     float computeSample(); // [-1, 1]
 
+    // Control-rate use: moves the phase on by `samples` and returns the
+    // value there, [-1, 1]
+    float advance(int samples);
+
 private:
+    float valueAt(float p) const;
+
     float sampleRate = 48000.0f;
     float frequency  = 1.0f;
     float phase      = 0.0f;
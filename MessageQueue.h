@@ -0,0 +1,227 @@
+#ifndef MESSAGEQUEUE_H
+#define MESSAGEQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded lock-free queues for passing messages to and from the audio
+// thread. Capacity N is a power of two and every slot is usable; indices
+// run freely and are masked, never reduced with %.
+//
+// Producer and consumer state sit on separate cache lines so the two
+// threads do not invalidate each other's line on every message. A push
+// that finds the queue full returns false and is counted in overflows();
+// callers that retry will see each refused attempt counted.
+
+static constexpr size_t kCacheLineSize = 64;
+
+// One producer thread, one consumer thread
+template <typename T, size_t N>
+class SpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+public:
+    static constexpr size_t capacity() { return N; }
+
+    bool push(const T& v) {
+        const size_t w = write_.load(std::memory_order_relaxed);
+        if (w - readCache_ == N) {
+            readCache_ = read_.load(std::memory_order_acquire);
+            if (w - readCache_ == N) {
+                overflow(1);
+                return false;
+            }
+        }
+        buf_[w & (N - 1)] = v;
+        write_.store(w + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Pushes as many of v[0..n) as fit, in order; returns how many
+    size_t pushBatch(const T* v, size_t n) {
+        const size_t w = write_.load(std::memory_order_relaxed);
+        if (N - (w - readCache_) < n) readCache_ = read_.load(std::memory_order_acquire);
+        const size_t room = N - (w - readCache_);
+        const size_t k = n < room ? n : room;
+        for (size_t i = 0; i < k; ++i) buf_[(w + i) & (N - 1)] = v[i];
+        if (k) write_.store(w + k, std::memory_order_release);
+        if (k < n) overflow(n - k);
+        return k;
+    }
+
+    bool pop(T& v) {
+        const size_t r = read_.load(std::memory_order_relaxed);
+        if (r == writeCache_) {
+            writeCache_ = write_.load(std::memory_order_acquire);
+            if (r == writeCache_) return false;
+        }
+        v = buf_[r & (N - 1)];
+        read_.store(r + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Pops up to max entries into out; returns how many
+    size_t popBatch(T* out, size_t max) {
+        const size_t r = read_.load(std::memory_order_relaxed);
+        if (writeCache_ - r < max) writeCache_ = write_.load(std::memory_order_acquire);
+        const size_t avail = writeCache_ - r;
+        const size_t k = max < avail ? max : avail;
+        for (size_t i = 0; i < k; ++i) out[i] = buf_[(r + i) & (N - 1)];
+        if (k) read_.store(r + k, std::memory_order_release);
+        return k;
+    }
+
+    // Entries waiting; exact only on the consumer or producer thread
+    size_t size() const {
+        const size_t r = read_.load(std::memory_order_acquire);
+        const size_t w = write_.load(std::memory_order_acquire);
+        return w - r;
+    }
+
+    // Messages refused because the queue was full
+    uint64_t overflows() const { return overflows_.load(std::memory_order_relaxed); }
+
+private:
+    void overflow(size_t n) {
+        overflows_.store(overflows_.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    // Producer side
+    alignas(kCacheLineSize) std::atomic<size_t> write_{0};
+    size_t readCache_ = 0;  // last read_ seen; refreshed only when it looks full
+    std::atomic<uint64_t> overflows_{0};
+
+    // Consumer side
+    alignas(kCacheLineSize) std::atomic<size_t> read_{0};
+    size_t writeCache_ = 0;
+
+    alignas(kCacheLineSize) T buf_[N]{};
+};
+
+// Any number of producer threads, one consumer thread. Each slot carries a
+// sequence number that says whether it is free for the producer claiming
+// that position or holds a message for the consumer (Vyukov's bounded
+// queue). Producers claim positions with a CAS, so messages from one
+// producer stay in order; messages from different producers interleave.
+template <typename T, size_t N>
+class MpscQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+public:
+    static constexpr size_t capacity() { return N; }
+
+    MpscQueue() {
+        for (size_t i = 0; i < N; ++i) cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    bool push(const T& v) { return pushBatch(&v, 1) == 1; }
+
+    // Claims one contiguous run for as many of v[0..n) as fit, so a batch
+    // is never split by another producer; returns how many were pushed
+    size_t pushBatch(const T* v, size_t n) {
+        if (n == 0) return 0;
+        size_t w = write_.load(std::memory_order_relaxed);
+        size_t k = n;
+        for (;;) {
+            // The consumer frees slots in order, so if the last slot of the
+            // run is free, so are the ones before it
+            const size_t last = w + k - 1;
+            const size_t seq = cells_[last & (N - 1)].seq.load(std::memory_order_acquire);
+            const intptr_t dif = (intptr_t)seq - (intptr_t)last;
+            if (dif == 0) {
+                if (write_.compare_exchange_weak(w, w + k, std::memory_order_relaxed)) break;
+            } else if (dif < 0) {
+                // Not enough room: shrink the run to what the consumer has freed
+                const size_t r = read_.load(std::memory_order_acquire);
+                const size_t room = r + N > w ? r + N - w : 0;
+                if (room == 0) {
+                    overflows_.fetch_add(n, std::memory_order_relaxed);
+                    return 0;
+                }
+                k = room < k ? room : k;
+                w = write_.load(std::memory_order_relaxed);
+            } else {
+                w = write_.load(std::memory_order_relaxed);  // another producer got here first
+            }
+        }
+        for (size_t i = 0; i < k; ++i) {
+            Cell& c = cells_[(w + i) & (N - 1)];
+            c.value = v[i];
+            c.seq.store(w + i + 1, std::memory_order_release);
+        }
+        if (k < n) overflows_.fetch_add(n - k, std::memory_order_relaxed);
+        return k;
+    }
+
+    bool pop(T& v) { return popBatch(&v, 1) == 1; }
+
+    // Pops up to max entries into out; stops at the first slot whose
+    // producer has not finished writing it. Consumer thread only.
+    size_t popBatch(T* out, size_t max) {
+        const size_t r = read_.load(std::memory_order_relaxed);
+        size_t k = 0;
+        for (; k < max; ++k) {
+            Cell& c = cells_[(r + k) & (N - 1)];
+            if (c.seq.load(std::memory_order_acquire) != r + k + 1) break;
+            out[k] = c.value;
+            c.seq.store(r + k + N, std::memory_order_release);
+        }
+        if (k) read_.store(r + k, std::memory_order_release);
+        return k;
+    }
+
+    // Entries claimed but not yet popped; approximate while producers run
+    size_t size() const {
+        const size_t r = read_.load(std::memory_order_acquire);
+        const size_t w = write_.load(std::memory_order_acquire);
+        return w > r ? w - r : 0;
+    }
+
+    uint64_t overflows() const { return overflows_.load(std::memory_order_relaxed); }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    alignas(kCacheLineSize) std::atomic<size_t> write_{0};  // shared by producers
+    std::atomic<uint64_t> overflows_{0};
+    alignas(kCacheLineSize) std::atomic<size_t> read_{0};
+    alignas(kCacheLineSize) Cell cells_[N];
+};
+
+// Latest-value mailbox for one writer and one reader: the writer fills
+// back() and publishes it, the reader update()s and looks at front().
+// Neither side ever waits; a reader that falls behind skips to the newest
+// value. The three buffers change owner by swapping indices through one
+// atomic byte, whose top bit says the middle buffer is newer than front().
+template <typename T>
+class TripleBuffer {
+public:
+    // Writer side
+    T& back() { return buf_[back_]; }
+    void publish() {
+        back_ = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel) & kIndex;
+    }
+
+    // Reader side; true when front() changed
+    bool update() {
+        if (!(middle_.load(std::memory_order_relaxed) & kFresh)) return false;
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndex;
+        return true;
+    }
+    const T& front() const { return buf_[front_]; }
+
+private:
+    static constexpr uint8_t kIndex = 3;
+    static constexpr uint8_t kFresh = 0x80;
+
+    alignas(kCacheLineSize) uint8_t back_ = 0;
+    alignas(kCacheLineSize) std::atomic<uint8_t> middle_{1};
+    alignas(kCacheLineSize) uint8_t front_ = 2;
+    T buf_[3]{};
+};
+
+#endif
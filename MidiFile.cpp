@@ -0,0 +1,159 @@
+#include "MidiFile.h"
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+namespace {
+
+// Raw event in ticks; tempo changes ride along with status 0xFF
+struct TickEvent {
+    uint64_t tick;
+    int track;
+    uint32_t tempo;  // microseconds per quarter note, for status 0xFF
+    MidiEvent msg;
+};
+
+struct Reader {
+    const uint8_t* p;
+    const uint8_t* end;
+    bool ok = true;
+
+    uint32_t byte() {
+        if (p >= end) { ok = false; return 0; }
+        return *p++;
+    }
+    uint32_t be(int bytes) {
+        uint32_t v = 0;
+        for (int i = 0; i < bytes; ++i) v = (v << 8) | byte();
+        return v;
+    }
+    uint32_t varlen() {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; ++i) {
+            const uint32_t b = byte();
+            v = (v << 7) | (b & 0x7f);
+            if (!(b & 0x80)) return v;
+        }
+        ok = false;
+        return v;
+    }
+    void skip(uint32_t n) {
+        if ((size_t)(end - p) < n) { ok = false; p = end; return; }
+        p += n;
+    }
+};
+
+bool readTrack(Reader r, int track, std::vector<TickEvent>& out) {
+    uint64_t tick = 0;
+    uint8_t running = 0;
+
+    while (r.ok && r.p < r.end) {
+        tick += r.varlen();
+        uint32_t status = r.byte();
+
+        if (status == 0xFF) {
+            const uint32_t type = r.byte();
+            const uint32_t len = r.varlen();
+            if (type == 0x2F) break;  // end of track
+            if (type == 0x51 && len == 3) {
+                TickEvent e{ tick, track, r.be(3), { 0.0, 0xFF, 0, 0 } };
+                out.push_back(e);
+            }
+            else {
+                r.skip(len);
+            }
+            continue;
+        }
+        if (status == 0xF0 || status == 0xF7) {
+            r.skip(r.varlen());
+            continue;
+        }
+
+        // Running status: a data byte reuses the previous status
+        uint32_t data1;
+        if (status < 0x80) {
+            if (!running) return false;
+            data1 = status;
+            status = running;
+        }
+        else {
+            if (status >= 0xF0) return false;
+            running = (uint8_t)status;
+            data1 = r.byte();
+        }
+
+        const uint32_t kind = status & 0xF0;
+        const uint32_t data2 = (kind == 0xC0 || kind == 0xD0) ? 0 : r.byte();
+        TickEvent e{ tick, track, 0, { 0.0, (uint8_t)status, (uint8_t)(data1 & 0x7f), (uint8_t)(data2 & 0x7f) } };
+        out.push_back(e);
+    }
+    return r.ok;
+}
+
+} // namespace
+
+bool readMidiFile(const std::string& path, std::vector<MidiEvent>& events, std::string& error) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        error = "cannot open " + path;
+        return false;
+    }
+    const std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    Reader r{ bytes.data(), bytes.data() + bytes.size() };
+    if (r.be(4) != 0x4D546864 || r.be(4) < 6) {  // "MThd"
+        error = path + ": not a MIDI file";
+        return false;
+    }
+    const uint32_t format = r.be(2);
+    const uint32_t tracks = r.be(2);
+    const uint32_t division = r.be(2);
+    if (!r.ok || format > 1) {
+        error = path + ": only format 0 and 1 MIDI files are supported";
+        return false;
+    }
+
+    // Ticks per quarter note, or SMPTE frames * ticks per frame per second
+    const bool smpte = division & 0x8000;
+    const double ticksPerSecond = smpte ? (double)(256 - (division >> 8)) * (division & 0xff) : 0.0;
+
+    std::vector<TickEvent> all;
+    for (uint32_t t = 0; t < tracks && r.ok; ++t) {
+        const uint32_t id = r.be(4);
+        const uint32_t len = r.be(4);
+        if (!r.ok || (size_t)(r.end - r.p) < len) break;
+        if (id == 0x4D54726B) {  // "MTrk"
+            if (!readTrack(Reader{ r.p, r.p + len }, (int)t, all)) {
+                error = path + ": malformed track " + std::to_string(t);
+                return false;
+            }
+        }
+        r.p += len;
+    }
+    if (!r.ok) {
+        error = path + ": truncated";
+        return false;
+    }
+
+    std::stable_sort(all.begin(), all.end(),
+                     [](const TickEvent& a, const TickEvent& b) { return a.tick < b.tick; });
+
+    // Walk the merged events, converting ticks to seconds through the tempo map
+    uint32_t tempo = 500000;  // 120 bpm
+    uint64_t lastTick = 0;
+    double seconds = 0.0;
+    events.clear();
+    for (const TickEvent& e : all) {
+        const double dt = (double)(e.tick - lastTick);
+        seconds += smpte ? dt / ticksPerSecond : dt * tempo * 1e-6 / (division ? division : 1);
+        lastTick = e.tick;
+
+        if (e.msg.status == 0xFF) tempo = e.tempo;
+        else {
+            MidiEvent m = e.msg;
+            m.time = seconds;
+            events.push_back(m);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,21 @@
+#ifndef MIDIFILE_H
+#define MIDIFILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A channel message from a MIDI file, at its time in seconds
+struct MidiEvent {
+    double time;
+    uint8_t status;  // 0x80..0xEF, channel in the low nibble
+    uint8_t data1;
+    uint8_t data2;
+};
+
+// Reads the channel messages of a Standard MIDI File (format 0 or 1) in
+// time order, with the file's tempo map applied. Meta and SysEx events are
+// skipped.
+bool readMidiFile(const std::string& path, std::vector<MidiEvent>& events, std::string& error);
+
+#endif
@@ -0,0 +1,120 @@
+#include "ModMatrix.h"
+#include "FastMath.h"
+#include <cmath>
+
+float ModMatrix::shape(int curve, float x) {
+    switch (curve) {
+        case SQUARED: return x * std::fabs(x);
+        case ROOT:    return std::copysign(std::sqrt(std::fabs(x)), x);
+        default:      return x;
+    }
+}
+
+bool ModMatrix::setRoutes(const Route* routes, int count) {
+    bool ok = true;
+    count_ = lfoRoutes_ = 0;
+    lfoToLanes_ = false;
+    int rows[kDestinations] = {};
+    const Route* lane[kMaxRoutes];
+    int lanes = 0;
+
+    for (int i = 0; i < count; ++i) {
+        const Route& r = routes[i];
+        if (r.depth == 0.0f) continue;
+        const bool valid = r.source >= 0 && r.source < kSources && r.destination >= 0 &&
+                           r.destination < kDestinations && r.curve >= 0 && r.curve < kCurves &&
+                           std::isfinite(r.depth) && !(perVoice(r.source) && r.destination == CUTOFF);
+        if (!valid || count_ == kMaxRoutes) {
+            ok = false;
+            continue;
+        }
+        ++count_;
+        if (perVoice(r.source)) {
+            lane[lanes++] = &r;
+            ++rows[r.destination];
+            continue;
+        }
+        lfoSource_[lfoRoutes_] = (int8_t)r.source;
+        lfoDest_[lfoRoutes_] = (int8_t)r.destination;
+        lfoCurve_[lfoRoutes_] = (int8_t)r.curve;
+        lfoDepth_[lfoRoutes_] = r.depth;
+        ++lfoRoutes_;
+        lfoToLanes_ = lfoToLanes_ || r.destination == AMP || r.destination == PAN;
+    }
+
+    // Counting sort into rows, keeping route order within a row
+    rowStart_[0] = 0;
+    for (int d = 0; d < kDestinations; ++d) rowStart_[d + 1] = rowStart_[d] + rows[d];
+    int fill[kDestinations];
+    for (int d = 0; d < kDestinations; ++d) fill[d] = rowStart_[d];
+    for (int i = 0; i < lanes; ++i) {
+        const int k = fill[lane[i]->destination]++;
+        source_[k] = (int8_t)lane[i]->source;
+        curve_[k] = (int8_t)lane[i]->curve;
+        depth_[k] = lane[i]->depth;
+    }
+
+    perLane_ = lanes > 0 || lfoToLanes_;
+    for (float& g : global_) g = 0.0f;
+    return ok;
+}
+
+void ModMatrix::evaluate(const float* lfo) {
+    for (float& g : global_) g = 0.0f;
+    for (int r = 0; r < lfoRoutes_; ++r) {
+        global_[lfoDest_[r]] += lfoDepth_[r] * shape(lfoCurve_[r], lfo[lfoSource_[r] - LFO1]);
+    }
+}
+
+void ModMatrix::apply(const ModLanes& l) const {
+    typedef simd::Vec<4>::f F;
+    constexpr int N = 4;
+
+    auto shaped = [](int curve, F x) {
+        if (curve == SQUARED) return x * simd::vabs<N>(x);
+        if (curve == ROOT) {
+            // x >= 0 for both per-voice sources
+            F r;
+            for (int k = 0; k < N; ++k) r[k] = std::sqrt(x[k] > 0.0f ? x[k] : 0.0f);
+            return r;
+        }
+        return x;
+    };
+    // Row d of the sparse matrix times this vector of lanes' sources
+    auto row = [&](int d, const F* src, F acc) {
+        for (int k = rowStart_[d]; k < rowStart_[d + 1]; ++k) {
+            acc += depth_[k] * shaped(curve_[k], src[source_[k] - ENVELOPE]);
+        }
+        return acc;
+    };
+
+    const bool pitch = rowStart_[PITCH + 1] > rowStart_[PITCH];
+    const bool pan = global_[PAN] != 0.0f || rowStart_[PAN + 1] > rowStart_[PAN];
+    const F amp0 = simd::splat<N>(1.0f + global_[AMP]);
+    const F pan0 = simd::splat<N>(global_[PAN]);
+
+    for (int i = 0; i < l.count; i += N) {
+        // The dense per-voice sources, in Source order from ENVELOPE
+        const F src[kSources - ENVELOPE] = { simd::load<N>(l.env + i), simd::load<N>(l.velocity + i) };
+
+        F ratio = simd::load<N>(l.ratio + i);
+        if (pitch) ratio *= simd::exp2<N>(row(PITCH, src, F{}) * (1.0f / 12.0f));
+        simd::store<N>(l.modRatio + i, ratio);
+
+        const F level = simd::vmax<N>(row(AMP, src, amp0), F{});
+        F gainL = simd::load<N>(l.gainL + i) * level;
+        F gainR = simd::load<N>(l.gainR + i) * level;
+        if (pan) {
+            // Equal-power balance, unity at the centre: sqrt(2) cos and
+            // sin of (p + 1) pi / 4
+            const F p = simd::vmin<N>(simd::vmax<N>(row(PAN, src, pan0), simd::splat<N>(-1.0f)),
+                                      simd::splat<N>(1.0f));
+            const F x = (p + 1.0f) * 0.125f;
+            const auto centre = p == 0.0f;
+            gainL *= simd::select<N>(centre, simd::splat<N>(1.0f), 1.41421356f * simd::sin2pi<N>(x + 0.25f));
+            gainR *= simd::select<N>(centre, simd::splat<N>(1.0f), 1.41421356f * simd::sin2pi<N>(x));
+        }
+        simd::store<N>(l.modGainL + i, gainL);
+        simd::store<N>(l.modGainR + i, gainR);
+    }
+}
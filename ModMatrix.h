@@ -0,0 +1,98 @@
+#ifndef MODMATRIX_H
+#define MODMATRIX_H
+
+#include <cstdint>
+
+// Per-lane inputs and outputs of ModMatrix::apply(), count lanes from each
+// pointer on; count is a multiple of 4
+struct ModLanes {
+    const float* env;       // envelope level 0..1
+    const float* velocity;  // 0..1
+    const float* ratio;     // the voices as set...
+    const float* gainL;
+    const float* gainR;
+    float* modRatio;        // ...and as rendered
+    float* modGainL;
+    float* modGainR;
+    int count;
+};
+
+// Routes from modulation sources to voice parameters, each with a depth
+// and a response curve.
+//
+// Sources are evaluated once per control block into a dense source array:
+// evaluate() takes the LFO values, which are the same for every voice, and
+// sums their routes per destination; the per-voice sources (envelope,
+// velocity) are read straight from the voice bank's lane arrays. The
+// per-voice routes are kept as a sparse matrix, rows by destination, and
+// apply() runs it four lanes at a time: per lane and block a multiply-add
+// per route, and nothing per sample.
+//
+// Destinations and their units, with s the curved source value:
+//   PITCH   semitones, depth * s
+//   CUTOFF  octaves of filter cutoff; shared by all voices, so LFOs only
+//   AMP     level x max(0, 1 + depth * s)
+//   PAN     -1 (left) .. 1 (right), equal power, on top of unison spread
+//
+// LFO routes to PITCH and CUTOFF move the shared phase increment and filter
+// coefficients at control rate (Synth does that with global()); apply()
+// only adds the per-voice routes to PITCH. Not thread-safe; audio thread.
+class ModMatrix {
+public:
+    enum Source { LFO1, LFO2, LFO3, LFO4, ENVELOPE, VELOCITY, kSources };
+    enum Destination { PITCH, CUTOFF, AMP, PAN, kDestinations };
+    // s = x, x * |x| (gentle near zero), sign(x) * sqrt(|x|) (steep)
+    enum Curve { LINEAR, SQUARED, ROOT, kCurves };
+
+    static constexpr int kLfos = LFO4 - LFO1 + 1;
+    static constexpr int kMaxRoutes = 8;
+
+    struct Route {
+        int source = LFO1;
+        int destination = PITCH;
+        float depth = 0.0f;     // 0 is off
+        int curve = LINEAR;
+    };
+
+    static bool perVoice(int source) { return source == ENVELOPE || source == VELOCITY; }
+    static float shape(int curve, float x);
+
+    // Replaces the routes. Routes with zero depth are skipped; so are
+    // invalid ones (out of range, or a per-voice source to CUTOFF), and
+    // then it returns false.
+    bool setRoutes(const Route* routes, int count);
+    int routes() const { return count_; }
+
+    // Once per control block, with the LFO values (kLfos of them, -1..1)
+    void evaluate(const float* lfo);
+
+    // Sum of the LFO routes into d at the last evaluate()
+    float global(Destination d) const { return global_[d]; }
+
+    // Whether apply() has any work: per-voice routes, or LFO routes to
+    // AMP or PAN
+    bool perLane() const { return perLane_; }
+
+    // The rendered pitch ratio and gains of l.count lanes
+    void apply(const ModLanes& l) const;
+
+private:
+    int count_ = 0;
+
+    // LFO routes
+    int8_t lfoSource_[kMaxRoutes], lfoDest_[kMaxRoutes], lfoCurve_[kMaxRoutes];
+    float lfoDepth_[kMaxRoutes];
+    int lfoRoutes_ = 0;
+    float global_[kDestinations] = {};
+    bool lfoToLanes_ = false;   // any LFO route to AMP or PAN
+
+    // Per-voice routes, sorted by destination: row d is
+    // [rowStart_[d], rowStart_[d + 1])
+    int8_t source_[kMaxRoutes], curve_[kMaxRoutes];
+    float depth_[kMaxRoutes];
+    int rowStart_[kDestinations + 1] = {};
+
+    bool perLane_ = false;
+};
+
+#endif
@@ -1,49 +1,42 @@
 #include "Oscillator.h"
+#include "FastMath.h"
 #include <cmath>
 #include <algorithm>
 
-static constexpr float TWO_PI = 6.28318530718f;
-
 Oscillator::Oscillator()
     : frequency(440.0f),
       sampleRate(48000.0f),
       phase(0.0f),
-      stage(OFF),
-      env(0.0f),
-      attack(0.05f),
-      decay(0.05f),
-      sustain(0.8f),
-      release(0.1f),
-      releaseStep(0.0f),
       waveform(SINE)
 {}
 
 void Oscillator::setSampleRate(float sr) {
     sampleRate = std::max(1.0f, sr);
+    envelope.setSampleRate(sampleRate);
 }
 
 void Oscillator::setWaveform(Waveform w) {
     waveform = w;
 }
 
-void Oscillator::setAttack(float seconds)  { attack  = std::max(0.0f, seconds); }
-void Oscillator::setDecay(float seconds)   { decay   = std::max(0.0f, seconds); }
-void Oscillator::setSustain(float level)   { sustain = std::clamp(level, 0.0f, 1.0f); }
-void Oscillator::setRelease(float seconds) { release = std::max(0.0f, seconds); }
+void Oscillator::setAttack(float seconds)  { envelope.setAttack(seconds); }
+void Oscillator::setDecay(float seconds)   { envelope.setDecay(seconds); }
+void Oscillator::setSustain(float level)   { envelope.setSustain(level); }
+void Oscillator::setRelease(float seconds) { envelope.setRelease(seconds); }
+void Oscillator::setEnvelope(const Envelope::Params& p) { envelope.setParams(p); }
+
+void Oscillator::setFilter(VoiceFilter::Type t, const float* c) {
+    filterType = t;
+    for (int k = 0; k < VoiceFilter::kCoefs; ++k) filterCoef[k] = c[k];
+}
 
 void Oscillator::noteOn(float frequencyHz) {
     frequency = frequencyHz;
-    stage = ATTACK;
+    envelope.noteOn();
 }
 
 void Oscillator::noteOff() {
-    if (release <= 0.0f) {
-        env = 0.0f;
-        stage = OFF;
-        return;
-    }
-    releaseStep = env / (release * sampleRate);
-    stage = RELEASE;
+    envelope.noteOff();
 }
 
 void Oscillator::setFrequency(float frequencyHz) {
@@ -56,9 +49,11 @@ float Oscillator::getFrequency() const {
 
 float Oscillator::computeOscillatorSample() {
     switch (waveform) {
-        case SINE:   return std::sin(TWO_PI * phase);
+        case SINE:   return simd::sin2pi(phase);
         case SQUARE: return (phase < 0.5f) ? 1.0f : -1.0f;
         case SAW:    return 2.0f * phase - 1.0f;
+        case SAMPLE:
+        case FM:     return 0.0f;
     }
     return 0.0f;
 }
@@ -70,37 +65,52 @@ float Oscillator::processSample(float freqHz) {
     float osc = computeOscillatorSample();
     phase += phaseInc;
     if (phase >= 1.0f) phase -= 1.0f;
+    if (filterType != VoiceFilter::OFF) osc = VoiceFilter::process(filterType, filterCoef, filterState, osc);
 
-    switch (stage) {
-        case ATTACK:
-            env += 1.0f / (attack * sampleRate);
-            if (env >= 1.0f) { env = 1.0f; stage = DECAY; }
-            break;
-
-        case DECAY:
-            env -= (1.0f - sustain) / (decay * sampleRate);
-            if (env <= sustain) { env = sustain; stage = SUSTAIN; }
-            break;
-
-        case SUSTAIN:
-            env = sustain;
-            break;
-
-        case RELEASE:
-            env -= releaseStep;
-            if (env <= 0.0f) { env = 0.0f; stage = OFF; }
-            break;
-
-        case OFF:
-            env = 0.0f;
-            break;
-    }
+    const float env = envelope.next();
 
     return osc * env * 0.2f;
 }
 
+template <Oscillator::Waveform W>
+static float shape(float phase) {
+    if constexpr (W == Oscillator::SINE)   return simd::sin2pi(phase);
+    if constexpr (W == Oscillator::SQUARE) return (phase < 0.5f) ? 1.0f : -1.0f;
+    if constexpr (W == Oscillator::SAMPLE || W == Oscillator::FM) return 0.0f;
+    return 2.0f * phase - 1.0f;
+}
+
+// processSample() at a fixed frequency, with the waveform picked once per
+// block and the envelope rendered a segment at a time
+template <Oscillator::Waveform W>
+void Oscillator::renderBlock(float* out, int n) {
+    const float phaseInc = std::max(1.0f, frequency) / sampleRate;
+    envelope.render(out, n);
+
+    if (filterType == VoiceFilter::OFF) {
+        for (int i = 0; i < n; ++i) {
+            const float osc = shape<W>(phase);
+            phase += phaseInc;
+            if (phase >= 1.0f) phase -= 1.0f;
+            out[i] = osc * out[i] * 0.2f;
+        }
+        return;
+    }
+    for (int i = 0; i < n; ++i) {
+        float osc = shape<W>(phase);
+        phase += phaseInc;
+        if (phase >= 1.0f) phase -= 1.0f;
+        osc = VoiceFilter::process(filterType, filterCoef, filterState, osc);
+        out[i] = osc * out[i] * 0.2f;
+    }
+}
+
 void Oscillator::processBlock(float* outBuffer, int numSamples) {
-    for (int i = 0; i < numSamples; ++i) {
-        outBuffer[i] = processSample(frequency);
+    switch (waveform) {
+        case SINE:   renderBlock<SINE>(outBuffer, numSamples); break;
+        case SQUARE: renderBlock<SQUARE>(outBuffer, numSamples); break;
+        case SAW:    renderBlock<SAW>(outBuffer, numSamples); break;
+        case SAMPLE: renderBlock<SAMPLE>(outBuffer, numSamples); break;
+        case FM:     renderBlock<FM>(outBuffer, numSamples); break;
     }
 }
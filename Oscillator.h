@@ -3,11 +3,15 @@
 
 // contents of file
 
+#include "Envelope.h"
+#include "VoiceFilter.h"
 
 class Oscillator {
 public:
-    enum Waveform { SINE, SQUARE, SAW };
-    enum ADSRStage { ATTACK, DECAY, SUSTAIN, RELEASE, OFF };
+    // SAMPLE plays a Sampler zone and FM the operators of Fm.h. Only
+    // VoiceBank voices render those; this scalar oscillator renders them
+    // as silence.
+    enum Waveform { SINE, SQUARE, SAW, SAMPLE, FM };
 
     Oscillator();
 
@@ -18,6 +22,11 @@ public:
     void setDecay(float seconds);
     void setSustain(float level);
     void setRelease(float seconds);
+    void setEnvelope(const Envelope::Params& p);
+
+    // Filter between the waveform and the envelope; c is the
+    // VoiceFilter::coefficients to use from the next sample on
+    void setFilter(VoiceFilter::Type t, const float* c);
 
     void noteOn(float frequencyHz);
     void noteOff();
@@ -34,15 +43,17 @@ public:
 
 private:
     float computeOscillatorSample();
+    template <Waveform W> void renderBlock(float* out, int n);
 
     float frequency;
     float sampleRate;
     float phase;
 
-    ADSRStage stage;
-    float env;
-    float attack, decay, sustain, release;
-    float releaseStep;
+    Envelope envelope;
+
+    VoiceFilter::Type filterType = VoiceFilter::OFF;
+    float filterCoef[VoiceFilter::kCoefs] = {};
+    float filterState[VoiceFilter::kStates] = {};
 
     Waveform waveform;
 };
@@ -0,0 +1,132 @@
+#include "OversamplerImpl.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define OVERSAMPLER_X86 1
+void decimateHalfbandAvx2(const float* even, const float* odd, const float* g, int taps,
+                          float* out, size_t n);
+#endif
+
+static void decimateHalfband4(const float* even, const float* odd, const float* g, int taps,
+                              float* out, size_t n) {
+    decimateHalfband<4>(even, odd, g, taps, out, n);
+}
+
+static HalfbandFn halfbandKernel() {
+#ifdef OVERSAMPLER_X86
+    static const HalfbandFn k = (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        ? decimateHalfbandAvx2 : decimateHalfband4;
+    return k;
+#else
+    return decimateHalfband4;
+#endif
+}
+
+const char* Oversampler::kernelName() {
+#ifdef OVERSAMPLER_X86
+    return halfbandKernel() == decimateHalfband4 ? "sse2" : "avx2";
+#else
+    return "simd4";
+#endif
+}
+
+// Zeroth-order modified Bessel function, for the Kaiser window
+static double besselI0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 50; ++k) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+void HalfbandDecimator::design(int taps) {
+    const int k = std::max(0, taps / 4);
+    const int length = 4 * k + 3;
+    const int center = (length - 1) / 2;
+    const double beta = 9.0;  // Kaiser, ~90 dB sidelobes
+    const double pi = 3.14159265358979323846;
+
+    h_.assign(length, 0.0f);
+    double oddSum = 0.0;
+    std::vector<double> h(length, 0.0);
+    for (int n = 0; n < length; ++n) {
+        const int d = n - center;
+        if (d == 0 || d % 2 == 0) continue;
+        const double r = (double)d / center;
+        const double w = besselI0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / besselI0(beta);
+        h[n] = std::sin(pi * d / 2.0) / (pi * d) * w;
+        oddSum += h[n];
+    }
+    // Unity gain at DC: the side taps sum to 0.5, the center is 0.5
+    for (int n = 0; n < length; ++n) h_[n] = (float)(h[n] * 0.5 / oddSum);
+    h_[center] = 0.5f;
+
+    evenTaps_ = 2 * k + 2;
+    oddDelay_ = k + 1;
+    g_.assign(evenTaps_ / 2, 0.0f);
+    for (int j = 0; j < evenTaps_ / 2; ++j) g_[j] = h_[2 * j];
+    reset();
+}
+
+void HalfbandDecimator::setMaxFrames(size_t n) {
+    even_.assign(evenTaps_ - 1 + n, 0.0f);
+    odd_.assign(oddDelay_ + n, 0.0f);
+}
+
+void HalfbandDecimator::reset() {
+    std::fill(even_.begin(), even_.end(), 0.0f);
+    std::fill(odd_.begin(), odd_.end(), 0.0f);
+}
+
+void HalfbandDecimator::process(const float* in, float* out, size_t n) {
+    const int history = evenTaps_ - 1;
+    float* even = even_.data() + history;
+    float* odd = odd_.data() + oddDelay_;
+    for (size_t i = 0; i < n; ++i) {
+        even[i] = in[2 * i];
+        odd[i] = in[2 * i + 1];
+    }
+
+    halfbandKernel()(even, odd_.data(), g_.data(), evenTaps_, out, n);
+
+    std::copy(even_.begin() + n, even_.begin() + n + history, even_.begin());
+    std::copy(odd_.begin() + n, odd_.begin() + n + oddDelay_, odd_.begin());
+}
+
+Oversampler::Oversampler(size_t maxFrames) {
+    // Passband to ~0.42 fs (20 kHz at 48 kHz) at the output; the earlier
+    // stages only have to stop what would fold onto that band
+    static const int kTaps[3] = { 71, 23, 19 };
+    for (int s = 0; s < 3; ++s) {
+        stage_[s].design(kTaps[s]);
+        stage_[s].setMaxFrames(maxFrames << s);
+    }
+}
+
+void Oversampler::setFactor(int factor) {
+    stages_ = 0;
+    while (stages_ < 3 && (2 << stages_) <= factor) ++stages_;
+    factor_ = 1 << stages_;
+    for (auto& s : stage_) s.reset();
+}
+
+float Oversampler::latency() const {
+    float frames = 0.0f;
+    for (int s = 0; s < stages_; ++s) {
+        frames += (stage_[s].coefficients().size() - 1) * 0.5f / (float)(2 << s);
+    }
+    return frames;
+}
+
+void Oversampler::process(float* in, float* out, size_t n) {
+    if (stages_ == 0) {
+        std::copy(in, in + n, out);
+        return;
+    }
+    // Highest rate first; each stage halves in place, the last writes out
+    for (int s = stages_ - 1; s > 0; --s) stage_[s].process(in, in, n << s);
+    stage_[0].process(in, out, n);
+}
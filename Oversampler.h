@@ -0,0 +1,68 @@
+#ifndef OVERSAMPLER_H
+#define OVERSAMPLER_H
+
+#include <cstddef>
+#include <vector>
+
+// even[0] is the newest even-phase input of output 0, earlier ones below
+// it; odd[i] is the (already delayed) odd-phase sample for output i.
+// g holds the first half of the symmetric even-phase taps.
+typedef void (*HalfbandFn)(const float* even, const float* odd, const float* g, int taps,
+                           float* out, size_t n);
+
+// 2:1 decimator with a half-band FIR, run in polyphase form: the input is
+// split into even and odd phases at the output rate, so only the outputs
+// that are kept get computed and the half-band's zero taps never do. All
+// odd phase taps but the center are zero, so that phase is a pure delay.
+class HalfbandDecimator {
+public:
+    // taps = 4k + 3 (rounded up to that); Kaiser window for ~90 dB of
+    // stopband, more taps narrow the transition around the output Nyquist
+    void design(int taps);
+    // Room for n output frames per process() call. Not for the audio thread.
+    void setMaxFrames(size_t n);
+    void reset();
+
+    // 2n input samples in, n out
+    void process(const float* in, float* out, size_t n);
+
+    // Full-length impulse response, for checking against a plain FIR
+    const std::vector<float>& coefficients() const { return h_; }
+
+private:
+    std::vector<float> h_;     // prototype
+    std::vector<float> g_;     // even-phase taps, first half
+    int evenTaps_ = 0;         // 2k + 2
+    int oddDelay_ = 0;         // k + 1
+    std::vector<float> even_, odd_;  // history followed by this call's input
+};
+
+// Voices render at factor x the output rate; process() takes them back down
+// through log2(factor) cascaded half-band stages. The stage nearest the
+// output has the narrow transition band, the earlier ones are short.
+class Oversampler {
+public:
+    static constexpr int kMaxFactor = 8;
+
+    // n is the most output frames one process() call will be given
+    explicit Oversampler(size_t maxFrames);
+
+    // 1, 2, 4 or 8 (others round down); resets the filter state
+    void setFactor(int factor);
+    int factor() const { return factor_; }
+
+    // Group delay in output frames
+    float latency() const;
+
+    // n * factor() samples in, n out. in is used as scratch.
+    void process(float* in, float* out, size_t n);
+
+    static const char* kernelName();
+
+private:
+    int factor_ = 1;
+    int stages_ = 0;
+    HalfbandDecimator stage_[3];  // [0] is nearest the output
+};
+
+#endif
@@ -0,0 +1,12 @@
+// Built with -mavx2 -mfma on x86 (see CMakeLists.txt); only reached after
+// a runtime CPU check in Oversampler.cpp.
+#if defined(__x86_64__) || defined(__i386__)
+
+#include "OversamplerImpl.h"
+
+void decimateHalfbandAvx2(const float* even, const float* odd, const float* g, int taps,
+                          float* out, size_t n) {
+    decimateHalfband<8>(even, odd, g, taps, out, n);
+}
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef OVERSAMPLERIMPL_H
+#define OVERSAMPLERIMPL_H
+
+#include "Oversampler.h"
+#include "Simd.h"
+
+// Half-band FIR, vectorized across outputs: for each tap pair the
+// coefficient is broadcast and N consecutive outputs accumulate at once.
+// The taps are symmetric, so each pair shares one multiply.
+template <int N>
+static void decimateHalfband(const float* even, const float* odd, const float* g, int taps,
+                             float* out, size_t n) {
+    using namespace simd;
+    typedef typename Vec<N>::f F;
+
+    const int half = taps / 2;
+    size_t i = 0;
+    for (; i + N <= n; i += N) {
+        F acc = load<N>(odd + i) * 0.5f;
+        for (int j = 0; j < half; ++j) {
+            acc += splat<N>(g[j]) * (load<N>(even + i - j) + load<N>(even + i - (taps - 1 - j)));
+        }
+        store<N>(out + i, acc);
+    }
+    for (; i < n; ++i) {
+        float acc = odd[i] * 0.5f;
+        for (int j = 0; j < half; ++j) acc += g[j] * (even[i - j] + even[i - (taps - 1 - j)]);
+        out[i] = acc;
+    }
+}
+
+#endif
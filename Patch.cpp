@@ -0,0 +1,141 @@
+#include "Patch.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define PATCH_MMAP 1
+#endif
+
+static_assert(sizeof(PatchHeader) == 32, "header layout");
+static_assert(sizeof(PatchRoute) == 16, "route layout");
+static_assert(sizeof(PatchFmOperator) == 28, "FM operator layout");
+static_assert(sizeof(PatchParams) == 80 + 4 + 24 + 16 * ModMatrix::kMaxRoutes + 4 + 8 + 28 * kFmOperators,
+              "params layout");
+static_assert(sizeof(PatchVoice) == 12, "voice layout");
+
+static bool littleEndian() {
+    const uint32_t one = 1;
+    unsigned char b;
+    std::memcpy(&b, &one, 1);
+    return b == 1;
+}
+
+static uint32_t fnv1a(const unsigned char* p, size_t n, uint32_t h = 2166136261u) {
+    for (size_t i = 0; i < n; ++i) h = (h ^ p[i]) * 16777619u;
+    return h;
+}
+
+bool savePatch(const std::string& path, const Patch& patch, std::string& error) {
+    if (!littleEndian()) {
+        error = "patch files need a little-endian host";
+        return false;
+    }
+    const size_t voiceBytes = patch.voices.size() * sizeof(PatchVoice);
+
+    PatchHeader h{};
+    std::memcpy(h.magic, "MSPT", 4);
+    h.version = kPatchVersion;
+    h.headerBytes = sizeof(PatchHeader);
+    h.paramsBytes = sizeof(PatchParams);
+    h.voiceBytes = sizeof(PatchVoice);
+    h.voiceCount = (uint32_t)patch.voices.size();
+    h.checksum = fnv1a(reinterpret_cast<const unsigned char*>(&patch.params), sizeof(PatchParams));
+    h.checksum = fnv1a(reinterpret_cast<const unsigned char*>(patch.voices.data()), voiceBytes, h.checksum);
+
+    const std::string tmp = path + ".tmp";
+    std::FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) {
+        error = "cannot write " + tmp;
+        return false;
+    }
+    bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1 &&
+              std::fwrite(&patch.params, sizeof(PatchParams), 1, f) == 1 &&
+              (voiceBytes == 0 || std::fwrite(patch.voices.data(), voiceBytes, 1, f) == 1);
+    ok = std::fclose(f) == 0 && ok;
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        std::remove(tmp.c_str());
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+// Header and records of a patch file already in memory
+static bool readPatch(const unsigned char* data, size_t size, Patch& patch, std::string& error) {
+    PatchHeader h;
+    if (size < sizeof(h)) {
+        error = "not a patch file";
+        return false;
+    }
+    std::memcpy(&h, data, sizeof(h));
+    if (std::memcmp(h.magic, "MSPT", 4) != 0) {
+        error = "not a patch file";
+        return false;
+    }
+    if (h.version > kPatchVersion) {
+        error = "patch version " + std::to_string(h.version) + " is newer than this build reads";
+        return false;
+    }
+    const uint64_t payload = (uint64_t)h.paramsBytes + (uint64_t)h.voiceBytes * h.voiceCount;
+    if (h.headerBytes < sizeof(h) || h.voiceBytes == 0 || h.headerBytes + payload > size) {
+        error = "truncated patch file";
+        return false;
+    }
+    const unsigned char* p = data + h.headerBytes;
+    if (fnv1a(p, (size_t)payload) != h.checksum) {
+        error = "patch file checksum mismatch";
+        return false;
+    }
+
+    patch = Patch();
+    std::memcpy(&patch.params, p, std::min<size_t>(h.paramsBytes, sizeof(PatchParams)));
+    p += h.paramsBytes;
+    patch.voices.resize(h.voiceCount);
+    const size_t take = std::min<size_t>(h.voiceBytes, sizeof(PatchVoice));
+    for (uint32_t i = 0; i < h.voiceCount; ++i, p += h.voiceBytes) std::memcpy(&patch.voices[i], p, take);
+    return true;
+}
+
+bool loadPatch(const std::string& path, Patch& patch, std::string& error) {
+    if (!littleEndian()) {
+        error = "patch files need a little-endian host";
+        return false;
+    }
+#if PATCH_MMAP
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        error = "cannot read " + path;
+        return false;
+    }
+    void* map = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        error = "cannot map " + path;
+        return false;
+    }
+    const bool ok = readPatch(static_cast<const unsigned char*>(map), (size_t)st.st_size, patch, error);
+    munmap(map, (size_t)st.st_size);
+    return ok;
+#else
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::vector<unsigned char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return readPatch(data.data(), data.size(), patch, error);
+#endif
+}
@@ -0,0 +1,107 @@
+#ifndef PATCH_H
+#define PATCH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Fm.h"
+#include "ModMatrix.h"
+
+// Everything that makes a sound: the synth settings and the voices, as
+// saved in a patch file and handed to Synth::prepare().
+//
+// File format (little-endian, all fields 4 bytes, records at fixed
+// offsets, so a mapped file is read in place without parsing):
+//
+//   header    PatchHeader
+//   params    PatchParams, header.paramsBytes long
+//   voices    header.voiceCount PatchVoice records, header.voiceBytes apart
+//
+// Newer versions only append fields to the records: a reader takes the
+// fields it knows and keeps the defaults for ones the file lacks, and
+// skips fields it does not know by the record sizes in the header. A
+// version above kPatchVersion means an incompatible layout.
+static constexpr uint32_t kPatchVersion = 1;
+
+struct PatchHeader {
+    char magic[4];          // "MSPT"
+    uint32_t version;
+    uint32_t headerBytes;
+    uint32_t paramsBytes;
+    uint32_t voiceBytes;
+    uint32_t voiceCount;
+    uint32_t checksum;      // FNV-1a of everything after the header
+    uint32_t reserved;
+};
+
+// A ModMatrix::Route; zero depth is an empty slot
+struct PatchRoute {
+    int32_t source = 0;
+    int32_t destination = 0;
+    float depth = 0.0f;
+    int32_t curve = 0;
+};
+
+// An FmOperator
+struct PatchFmOperator {
+    float ratio = 1.0f;
+    float level = 1.0f;
+    float feedback = 0.0f;
+    float attackSec = 0.05f;
+    float decaySec = 0.05f;
+    float sustainLevel = 0.8f;
+    float releaseSec = 0.1f;
+};
+
+// Defaults match a new Synth
+struct PatchParams {
+    float masterPitchHz = 440.0f;
+    float lfoRateHz = 2.0f;
+    float lfoDepthHz = 5.0f;
+    int32_t lfoTarget = 1;          // LFO::Parameter, PITCH
+    int32_t filterType = 0;         // VoiceFilter::Type, OFF
+    float filterCutoffHz = 2000.0f;
+    float filterResonance = 0.2f;
+    float filterLfoOctaves = 1.0f;
+    int32_t unisonVoices = 1;
+    float unisonDetuneCents = 20.0f;
+    float unisonSpread = 0.5f;
+    float attackSec = 0.05f;
+    float decaySec = 0.05f;
+    float sustainLevel = 0.8f;
+    float releaseSec = 0.1f;
+    int32_t envelopeCurve = 0;      // Envelope::Curve, LINEAR
+    int32_t stealPolicy = 2;        // VoiceBank::StealPolicy, StealReleasedFirst
+    int32_t bandLimited = 1;
+    int32_t controlRate = 32;
+    int32_t oversampling = 1;
+    int32_t lfoWaveform = 0;        // LFO::Waveform, SINE
+    float modLfoRateHz[ModMatrix::kLfos - 1] = { 0.5f, 1.0f, 6.0f };
+    int32_t modLfoWaveform[ModMatrix::kLfos - 1] = { 2, 0, 1 };  // TRIANGLE, SINE, SQUARE
+    PatchRoute modRoutes[ModMatrix::kMaxRoutes];
+    float reverbLevel = 0.3f;
+    int32_t noteWaveform = 2;       // Oscillator::Waveform, SAW
+    int32_t fmAlgorithm = 0;
+    PatchFmOperator fmOperators[kFmOperators];
+};
+
+struct PatchVoice {
+    float frequencyHz = 440.0f;
+    int32_t waveform = 2;           // Oscillator::Waveform, SAW
+    int32_t held = 1;               // 0: added released, silent until triggered
+};
+
+struct Patch {
+    PatchParams params;
+    std::vector<PatchVoice> voices;
+};
+
+// Written to a temporary file next to path and renamed over it, so a
+// reader never sees half a patch
+bool savePatch(const std::string& path, const Patch& patch, std::string& error);
+
+// Maps the file (reads it where there is no mmap), checks header and
+// checksum and copies the records out
+bool loadPatch(const std::string& path, Patch& patch, std::string& error);
+
+#endif
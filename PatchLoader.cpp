@@ -0,0 +1,71 @@
+#include "PatchLoader.h"
+#include <chrono>
+
+// How often retired states are looked for when no requests come in
+static constexpr auto kReclaimInterval = std::chrono::milliseconds(200);
+
+PatchLoader::PatchLoader(Synth& synth)
+    : synth_(synth),
+      thread_(&PatchLoader::run, this)
+{}
+
+PatchLoader::~PatchLoader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
+
+void PatchLoader::load(const std::string& path, int tag) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(Job{ tag, path, Patch() });
+    }
+    wake_.notify_one();
+}
+
+void PatchLoader::apply(const Patch& patch, int tag) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(Job{ tag, std::string(), patch });
+    }
+    wake_.notify_one();
+}
+
+bool PatchLoader::poll(Result& r) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (results_.empty()) return false;
+    r = std::move(results_.front());
+    results_.pop_front();
+    return true;
+}
+
+void PatchLoader::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait_for(lock, kReclaimInterval, [&] { return quit_ || !jobs_.empty(); });
+        if (quit_) break;
+        if (jobs_.empty()) {
+            synth_.reclaim();
+            continue;
+        }
+        Job job = std::move(jobs_.front());
+        jobs_.pop_front();
+        lock.unlock();
+
+        Result r;
+        r.tag = job.tag;
+        if (job.path.empty()) {
+            r.patch = std::move(job.patch);
+            r.ok = true;
+        } else {
+            r.ok = loadPatch(job.path, r.patch, r.error);
+        }
+        if (r.ok) synth_.submit(synth_.prepare(r.patch, r.tag, &r.voices));
+
+        lock.lock();
+        results_.push_back(std::move(r));
+    }
+}
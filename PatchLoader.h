@@ -0,0 +1,61 @@
+#ifndef PATCHLOADER_H
+#define PATCHLOADER_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Patch.h"
+#include "Synth.h"
+
+// Background thread that reads patch files and prepares engine states for
+// a Synth (Synth::prepare/submit), so neither the GUI nor the audio thread
+// waits on disk or allocation. It also frees the states the audio thread
+// has switched away from.
+//
+// A result is reported once the state is submitted; the switch itself
+// happens at the audio thread's next block, announced by a PatchLoaded
+// reply with the same tag. Until then the old voices keep playing.
+class PatchLoader {
+public:
+    struct Result {
+        int tag = 0;
+        bool ok = false;
+        std::string error;
+        Patch patch;                      // as loaded
+        std::vector<VoiceHandle> voices;  // handle per patch voice
+    };
+
+    explicit PatchLoader(Synth& synth);
+    ~PatchLoader();
+
+    PatchLoader(const PatchLoader&) = delete;
+    PatchLoader& operator=(const PatchLoader&) = delete;
+
+    void load(const std::string& path, int tag);
+    void apply(const Patch& patch, int tag);
+
+    // Finished requests, oldest first
+    bool poll(Result& r);
+
+private:
+    struct Job {
+        int tag;
+        std::string path;   // empty: use patch
+        Patch patch;
+    };
+
+    void run();
+
+    Synth& synth_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<Job> jobs_;
+    std::deque<Result> results_;
+    bool quit_ = false;
+    std::thread thread_;
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include "PortAudioBackend.h"
+#include "Telemetry.h"
+#include <portaudio.h>
+#include <cstdio>
+
+static_assert(Telemetry::OutputUnderflow == paOutputUnderflow, "telemetry flags follow PortAudio");
+static_assert(Telemetry::OutputOverflow == paOutputOverflow, "telemetry flags follow PortAudio");
+
+static bool check(PaError err, const char* what) {
+    if (err == paNoError) return true;
+    std::fprintf(stderr, "portaudio: %s failed: %s\n", what, Pa_GetErrorText(err));
+    return false;
+}
+
+static int streamCallback(const void* input, void* output, unsigned long frames,
+                          const PaStreamCallbackTimeInfo* timeInfo,
+                          PaStreamCallbackFlags statusFlags, void* self)
+{
+    (void)input; (void)timeInfo;
+    static_cast<PortAudioBackend*>(self)->deliver(static_cast<float*>(output), frames, (uint32_t)statusFlags);
+    return paContinue;
+}
+
+PortAudioBackend::~PortAudioBackend() {
+    stop();
+}
+
+bool PortAudioBackend::open(const Config& config, Callback cb, void* user) {
+    if (stream_) {
+        std::fprintf(stderr, "portaudio: open while a stream is open\n");
+        return false;
+    }
+    if (!initialized_) {
+        if (!check(Pa_Initialize(), "Pa_Initialize")) return false;
+        initialized_ = true;
+    }
+    config_ = config;
+    cb_ = cb;
+    user_ = user;
+
+    PaStream* stream = nullptr;
+    if (!check(Pa_OpenDefaultStream(&stream, 0, config.channels, paFloat32, config.sampleRate,
+                                    config.framesPerBuffer, streamCallback, this),
+               "Pa_OpenDefaultStream")) {
+        stop();
+        return false;
+    }
+    stream_ = stream;
+    return true;
+}
+
+bool PortAudioBackend::start() {
+    if (!stream_) {
+        std::fprintf(stderr, "portaudio: start before open\n");
+        return false;
+    }
+    if (started_) return true;
+    started_ = check(Pa_StartStream(static_cast<PaStream*>(stream_)), "Pa_StartStream");
+    return started_;
+}
+
+void PortAudioBackend::stop() {
+    PaStream* stream = static_cast<PaStream*>(stream_);
+    if (started_) check(Pa_StopStream(stream), "Pa_StopStream");
+    if (stream) check(Pa_CloseStream(stream), "Pa_CloseStream");
+    if (initialized_) check(Pa_Terminate(), "Pa_Terminate");
+    started_ = false;
+    stream_ = nullptr;
+    initialized_ = false;
+}
+
+double PortAudioBackend::outputLatency() const {
+    if (!stream_) return 0.0;
+    const PaStreamInfo* info = Pa_GetStreamInfo(static_cast<PaStream*>(stream_));
+    return info ? info->outputLatency : 0.0;
+}
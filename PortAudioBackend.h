@@ -0,0 +1,29 @@
+#ifndef PORTAUDIOBACKEND_H
+#define PORTAUDIOBACKEND_H
+
+#include "AudioBackend.h"
+
+// The default output device through PortAudio. Pa_Initialize is called by
+// open() and balanced by stop(); every Pa call's error is reported.
+class PortAudioBackend : public AudioBackend {
+public:
+    ~PortAudioBackend() override;
+
+    const char* name() const override { return "portaudio"; }
+    bool open(const Config& config, Callback cb, void* user) override;
+    bool start() override;
+    void stop() override;
+
+    // Output latency PortAudio reports for the open stream, in seconds
+    double outputLatency() const;
+
+    // From PortAudio's callback thread
+    void deliver(float* out, unsigned long frames, uint32_t flags) { cb_(user_, out, frames, flags); }
+
+private:
+    void* stream_ = nullptr;   // PaStream
+    bool initialized_ = false;
+    bool started_ = false;
+};
+
+#endif
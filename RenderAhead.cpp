@@ -0,0 +1,193 @@
+#include "RenderAhead.h"
+#include "Scope.h"
+#include "Synth.h"
+#include "Telemetry.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__) || defined(__APPLE__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// The jitter peak halves over this long without new highs
+static constexpr double kJitterHalfLifeNs = 2e9;
+// Headroom on the measured jitter when sizing the lookahead
+static constexpr double kJitterMargin = 1.5;
+
+static void waitChange(std::atomic<uint32_t>& word, uint32_t seen, double timeoutNs) {
+#if defined(__linux__)
+    timespec ts;
+    ts.tv_sec = (time_t)(timeoutNs / 1e9);
+    ts.tv_nsec = (long)(timeoutNs - ts.tv_sec * 1e9);
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, seen, &ts, nullptr, 0);
+#else
+    (void)word; (void)seen;
+    std::this_thread::sleep_for(std::chrono::nanoseconds((int64_t)(timeoutNs / 4)));
+#endif
+}
+
+static void wakeOne(std::atomic<uint32_t>& word) {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#else
+    (void)word;
+#endif
+}
+
+RenderAhead::RenderAhead(Synth& synth, float sampleRate, const Options& options, Telemetry* telemetry)
+    : synth_(synth),
+      telemetry_(telemetry),
+      sampleRate_(std::max(1.0f, sampleRate)),
+      options_(options),
+      channels_(Synth::kChannels),
+      capacity_((uint64_t)(kMaxLookahead + 1) * std::max(1ul, options.blockFrames)),
+      blockNs_(std::max(1ul, options.blockFrames) / (double)sampleRate_ * 1e9),
+      decay_(std::pow(0.5, blockNs_ / kJitterHalfLifeNs))
+{
+    ring_.assign(capacity_ * channels_, 0.0f);
+    const int minimum = std::clamp(options_.minLookahead, 1, kMaxLookahead);
+    lookahead_.store(std::clamp(options_.lookahead, minimum, kMaxLookahead));
+}
+
+RenderAhead::~RenderAhead() {
+    stop();
+}
+
+bool RenderAhead::start() {
+    if (thread_.joinable()) return true;
+    if (options_.blockFrames == 0) {
+        std::fprintf(stderr, "RenderAhead: zero-frame blocks\n");
+        return false;
+    }
+    quit_.store(false);
+    thread_ = std::thread(&RenderAhead::run, this);
+
+#if defined(__linux__) || defined(__APPLE__)
+    // Above the render pool's workers. Needs privileges; without them the
+    // thread stays SCHED_OTHER and the lookahead has to cover for it.
+    sched_param sp{};
+    sp.sched_priority = sched_get_priority_min(SCHED_FIFO) + 2;
+    pthread_setschedparam(thread_.native_handle(), SCHED_FIFO, &sp);
+#endif
+    return true;
+}
+
+void RenderAhead::stop() {
+    if (!thread_.joinable()) return;
+    quit_.store(true);
+    reads_.fetch_add(1);
+    wakeOne(reads_);
+    thread_.join();
+}
+
+uint64_t RenderAhead::queuedFrames() const {
+    return written_.load(std::memory_order_acquire) - read_.load(std::memory_order_acquire);
+}
+
+void RenderAhead::run() {
+    bool woken = false;
+    while (!quit_.load(std::memory_order_relaxed)) {
+        const uint32_t seen = reads_.load(std::memory_order_acquire);
+        if (queuedFrames() >= (uint64_t)lookahead() * options_.blockFrames) {
+            waitForRead(seen);
+            woken = true;
+            continue;
+        }
+
+        // A block rendered because the device drained the ring is timed
+        // from the drain: wake-up latency counts as jitter too
+        const uint64_t drainNs = lastReadNs_.load(std::memory_order_relaxed);
+        const uint64_t startNs = Telemetry::nowNs();
+        const uint64_t endNs = renderBlock();
+        const uint64_t fromNs = woken && drainNs && drainNs < startNs ? drainNs : startNs;
+        woken = false;
+
+        const uint64_t underruns = underruns_.load(std::memory_order_relaxed);
+        adapt(endNs - fromNs, underruns != underrunsSeen_);
+        underrunsSeen_ = underruns;
+    }
+}
+
+// Renders one block into the ring and publishes it; returns when it was done
+uint64_t RenderAhead::renderBlock() {
+    const unsigned long n = options_.blockFrames;
+    const uint64_t w = written_.load(std::memory_order_relaxed);
+    float* dst = ring_.data() + (w % capacity_) * channels_;
+
+    TelemetrySample t{};
+    t.startNs = Telemetry::nowNs();
+    t.queueDepth = (uint16_t)synth_.cmdQ.size();
+    synth_.processBlock(dst, n);
+    const uint64_t endNs = Telemetry::nowNs();
+
+    written_.store(w + n, std::memory_order_release);
+    if (scope_) scope_->push(dst, n, channels_);
+
+    if (telemetry_) {
+        t.durationNs = (uint32_t)(endNs - t.startNs);
+        t.frames = (uint32_t)n;
+        t.flags = deviceFlags_.exchange(0, std::memory_order_relaxed);
+        t.voices = (uint16_t)synth_.soundingVoices();
+        telemetry_->record(t);
+    }
+    return endNs;
+}
+
+// Enough blocks queued to ride out the worst recent refill time; an
+// underrun raises the peak past what the current lookahead covers
+void RenderAhead::adapt(uint64_t sampleNs, bool underrun) {
+    peakNs_ = std::max((double)sampleNs, peakNs_ * decay_);
+    if (underrun) peakNs_ = std::max(peakNs_, lookahead() * blockNs_);
+    jitterNs_.store((uint64_t)peakNs_, std::memory_order_relaxed);
+    if (!options_.adaptive) return;
+
+    const int minimum = std::clamp(options_.minLookahead, 1, kMaxLookahead);
+    const int target = 1 + (int)std::ceil(kJitterMargin * peakNs_ / blockNs_);
+    lookahead_.store(std::clamp(target, minimum, kMaxLookahead), std::memory_order_relaxed);
+}
+
+// Sleeps until the device reads again, or a block period passes
+void RenderAhead::waitForRead(uint32_t seen) {
+    sleeping_.store(true);
+    if (reads_.load() == seen && !quit_.load(std::memory_order_relaxed)) waitChange(reads_, seen, blockNs_);
+    sleeping_.store(false, std::memory_order_relaxed);
+}
+
+void RenderAhead::deviceCallback(void* self, float* out, unsigned long frames, uint32_t flags) {
+    static_cast<RenderAhead*>(self)->read(out, frames, flags);
+}
+
+void RenderAhead::read(float* out, unsigned long frames, uint32_t flags) {
+    const uint64_t r = read_.load(std::memory_order_relaxed);
+    const uint64_t avail = written_.load(std::memory_order_acquire) - r;
+    const unsigned long n = (unsigned long)std::min<uint64_t>(frames, avail);
+
+    // Copy in up to two pieces around the end of the ring
+    const uint64_t at = r % capacity_;
+    const unsigned long first = (unsigned long)std::min<uint64_t>(n, capacity_ - at);
+    std::memcpy(out, ring_.data() + at * channels_, first * channels_ * sizeof(float));
+    std::memcpy(out + first * channels_, ring_.data(), (n - first) * channels_ * sizeof(float));
+
+    if (n < frames) {
+        std::fill(out + n * channels_, out + frames * channels_, 0.0f);
+        // Only this thread writes the counter
+        underruns_.store(underruns_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        flags |= Telemetry::OutputUnderflow;
+    }
+    read_.store(r + n, std::memory_order_release);
+
+    if (flags) deviceFlags_.fetch_or(flags, std::memory_order_relaxed);
+    lastReadNs_.store(Telemetry::nowNs(), std::memory_order_relaxed);
+    reads_.fetch_add(1);
+    if (sleeping_.load()) wakeOne(reads_);
+}
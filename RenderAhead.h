@@ -0,0 +1,105 @@
+#ifndef RENDERAHEAD_H
+#define RENDERAHEAD_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "AudioBackend.h"
+
+class ScopeTap;
+class Synth;
+class Telemetry;
+
+// Renders the synth ahead of the device on a thread of its own. The device
+// callback only copies finished frames out of a lock-free ring, so a slow
+// block eats into the lookahead instead of missing the device's deadline.
+// The price is latency: lookahead() blocks between a command being applied
+// and it being heard.
+//
+// The render thread keeps lookahead() blocks of blockFrames queued. With
+// adaptive lookahead the target follows the render jitter it measures: the
+// worst recent time from the device draining the ring to the refill being
+// ready, decaying over a few seconds, plus a block for every underrun.
+//
+// Synth::processBlock is only called from the render thread, which also
+// does the Telemetry::record calls: one sample per rendered block, flagged
+// with the device's flags and OutputUnderflow for ring underruns.
+class RenderAhead {
+public:
+    static constexpr int kMaxLookahead = 32;
+
+    struct Options {
+        unsigned long blockFrames = 256;
+        int lookahead = 2;      // blocks; the starting point when adaptive
+        int minLookahead = 1;
+        bool adaptive = true;
+    };
+
+    RenderAhead(Synth& synth, float sampleRate, const Options& options, Telemetry* telemetry = nullptr);
+    ~RenderAhead();
+
+    RenderAhead(const RenderAhead&) = delete;
+    RenderAhead& operator=(const RenderAhead&) = delete;
+
+    // Starts the render thread, raised to real-time priority where allowed.
+    // Not for the audio thread.
+    bool start();
+    void stop();
+
+    // Feeds every rendered block to the scope; set before start()
+    void setScope(ScopeTap* scope) { scope_ = scope; }
+
+    // Device side, for AudioBackend::open(cb = deviceCallback, user = this):
+    // copies `frames` frames out, padding with silence on underrun.
+    // Lock-free and allocation-free.
+    static void deviceCallback(void* self, float* out, unsigned long frames, uint32_t flags);
+    void read(float* out, unsigned long frames, uint32_t flags);
+
+    // Blocks the render thread is keeping queued, and frames ready now
+    int lookahead() const { return lookahead_.load(std::memory_order_relaxed); }
+    uint64_t queuedFrames() const;
+
+    // Device buffers that found the ring short
+    uint64_t underruns() const { return underruns_.load(std::memory_order_relaxed); }
+    // Current jitter estimate
+    double jitterUs() const { return jitterNs_.load(std::memory_order_relaxed) / 1000.0; }
+
+private:
+    void run();
+    uint64_t renderBlock();
+    void adapt(uint64_t sampleNs, bool underrun);
+    void waitForRead(uint32_t seen);
+
+    Synth& synth_;
+    Telemetry* telemetry_;
+    ScopeTap* scope_ = nullptr;
+    const float sampleRate_;
+    const Options options_;
+    const int channels_;
+    const uint64_t capacity_;   // frames; a whole number of blocks
+    const double blockNs_;
+    const double decay_;        // per block, for the jitter peak
+
+    // Interleaved frames; blocks are written whole and never wrap
+    std::vector<float> ring_;
+
+    // Render thread
+    alignas(64) std::atomic<uint64_t> written_{0};
+    double peakNs_ = 0.0;
+    uint64_t underrunsSeen_ = 0;
+    std::atomic<int> lookahead_{2};
+    std::atomic<uint64_t> jitterNs_{0};
+    std::atomic<bool> quit_{false};
+    std::thread thread_;
+
+    // Device side
+    alignas(64) std::atomic<uint64_t> read_{0};
+    std::atomic<uint32_t> reads_{0};        // bumped per callback; the render thread waits on it
+    std::atomic<bool> sleeping_{false};     // render thread is (about to be) waiting on reads_
+    std::atomic<uint64_t> lastReadNs_{0};
+    std::atomic<uint32_t> deviceFlags_{0};  // collected until the next block's telemetry
+    std::atomic<uint64_t> underruns_{0};
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include "RenderPool.h"
+#include "FastMath.h"
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+static inline void cpuRelax() { _mm_pause(); }
+#elif defined(__aarch64__)
+static inline void cpuRelax() { asm volatile("yield"); }
+#else
+static inline void cpuRelax() {}
+#endif
+
+// Spin this long for the next job before going to sleep
+static constexpr int kSpinIterations = 20000;
+
+static void waitChange(std::atomic<uint32_t>& word, uint32_t seen) {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, seen, nullptr, nullptr, 0);
+#else
+    (void)word; (void)seen;
+    std::this_thread::yield();
+#endif
+}
+
+static void wakeAll(std::atomic<uint32_t>& word) {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+#else
+    (void)word;
+#endif
+}
+
+// Pin and raise priority only when the worker gets a core to itself; a
+// spinning SCHED_FIFO thread sharing a core would starve the audio thread
+static void configureWorker(std::thread& t, int core) {
+#if defined(__linux__)
+    if (core >= (int)std::thread::hardware_concurrency()) return;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+
+    // Needs privileges; without them the worker stays SCHED_OTHER
+    sched_param sp{};
+    sp.sched_priority = sched_get_priority_min(SCHED_FIFO) + 1;
+    pthread_setschedparam(t.native_handle(), SCHED_FIFO, &sp);
+#else
+    (void)t; (void)core;
+#endif
+}
+
+RenderPool::RenderPool(int workers) {
+    for (int i = 0; i < workers; ++i) {
+        threads_.emplace_back(&RenderPool::workerLoop, this, i);
+        configureWorker(threads_.back(), i + 1);
+    }
+}
+
+RenderPool::~RenderPool() {
+    quit_.store(true, std::memory_order_relaxed);
+    epoch_.fetch_add(1, std::memory_order_release);
+    wakeAll(epoch_);
+    for (auto& t : threads_) t.join();
+}
+
+void RenderPool::drain() {
+    for (;;) {
+        const int t = next_.fetch_add(1, std::memory_order_relaxed);
+        if (t >= tasks_) break;
+        fn_(ctx_, t);
+    }
+}
+
+void RenderPool::workerLoop(int) {
+    DenormalGuard denormals;
+
+    // Nothing has run before the constructor returns, so the first job is
+    // epoch 1 even if it is published before this thread gets going
+    uint32_t seen = 0;
+    for (;;) {
+        uint32_t now = seen;
+        for (int i = 0; i < kSpinIterations && now == seen; ++i) {
+            cpuRelax();
+            now = epoch_.load(std::memory_order_acquire);
+        }
+        while (now == seen) {
+            waitChange(epoch_, seen);
+            now = epoch_.load(std::memory_order_acquire);
+        }
+        seen = now;
+
+        if (quit_.load(std::memory_order_relaxed)) return;
+
+        drain();
+        busy_.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void RenderPool::run(TaskFn fn, void* ctx, int tasks) {
+    if (threads_.empty() || tasks <= 1) {
+        for (int t = 0; t < tasks; ++t) fn(ctx, t);
+        return;
+    }
+
+    fn_ = fn;
+    ctx_ = ctx;
+    tasks_ = tasks;
+    next_.store(0, std::memory_order_relaxed);
+    busy_.store(workers(), std::memory_order_relaxed);
+
+    // Publishes the job fields above to the workers
+    epoch_.fetch_add(1, std::memory_order_release);
+    wakeAll(epoch_);
+
+    drain();
+
+    // Workers normally finish within the spin; yielding after it keeps an
+    // oversubscribed machine from burning the workers' timeslice here
+    for (int i = 0; busy_.load(std::memory_order_acquire) != 0; ++i) {
+        if (i < kSpinIterations) cpuRelax();
+        else std::this_thread::yield();
+    }
+}
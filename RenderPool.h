@@ -0,0 +1,49 @@
+#ifndef RENDERPOOL_H
+#define RENDERPOOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Pre-spawned worker threads for splitting a block's render across cores.
+// run() is called from the audio thread: it takes no locks and allocates
+// nothing. Workers spin briefly after each job, then sleep on a futex
+// (Linux) or yield (elsewhere) until the next one.
+class RenderPool {
+public:
+    typedef void (*TaskFn)(void* ctx, int task);
+
+    // Spawns `workers` threads, pinned to cores 1..workers when the machine
+    // has that many. Not for the audio thread.
+    explicit RenderPool(int workers);
+    ~RenderPool();
+
+    RenderPool(const RenderPool&) = delete;
+    RenderPool& operator=(const RenderPool&) = delete;
+
+    int workers() const { return (int)threads_.size(); }
+
+    // Runs fn(ctx, t) for t in [0, tasks) on the workers and the calling
+    // thread, and returns once every task has finished. Tasks are claimed
+    // dynamically, so they must not depend on which thread runs them.
+    void run(TaskFn fn, void* ctx, int tasks);
+
+private:
+    void workerLoop(int id);
+    void drain();
+
+    std::vector<std::thread> threads_;
+
+    TaskFn fn_ = nullptr;
+    void* ctx_ = nullptr;
+    int tasks_ = 0;
+
+    // Each index on its own cache line; they are hammered by different threads
+    alignas(64) std::atomic<uint32_t> epoch_{0};
+    alignas(64) std::atomic<int> next_{0};
+    alignas(64) std::atomic<int> busy_{0};
+    alignas(64) std::atomic<bool> quit_{false};
+};
+
+#endif
@@ -0,0 +1,307 @@
+#include "Sampler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define SAMPLER_MMAP 1
+#endif
+
+// How often the prefetcher tops up the rings when nobody pokes it. A ring
+// holds kRingFrames, hundreds of milliseconds at any sane pitch.
+static constexpr auto kPrefetchPeriod = std::chrono::milliseconds(2);
+
+static constexpr uint64_t tagged(uint32_t generation, uint64_t count) {
+    return (uint64_t)generation << 32 | count;
+}
+
+Sampler::Sampler()
+    : streams_(new Stream[kMaxStreams])
+{
+    // Written through once, so the pages are there before any voice reads
+    rings_.assign((size_t)kMaxStreams * kRingFrames, 0.0f);
+    for (int i = 0; i < kMaxStreams; ++i) streams_[i].ring = rings_.data() + (size_t)i * kRingFrames;
+}
+
+Sampler::~Sampler() {
+    stop();
+#ifdef SAMPLER_MMAP
+    munlock(rings_.data(), rings_.size() * sizeof(float));
+    for (auto& z : zones_) {
+        munlock(z->attack.data(), z->attack.size() * sizeof(float));
+        munmap(const_cast<unsigned char*>(z->map), z->mapBytes);
+    }
+#endif
+}
+
+bool Sampler::addZone(const std::string& path, int root, int low, int high, std::string& error) {
+#ifdef SAMPLER_MMAP
+    if (thread_.joinable()) {
+        error = "zones must be added before the sampler starts";
+        return false;
+    }
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "cannot open " + path;
+        return false;
+    }
+    struct stat st;
+    void* map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) map = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        error = "cannot map " + path;
+        return false;
+    }
+
+    auto z = std::make_unique<Zone>();
+    z->path = path;
+    z->map = static_cast<const unsigned char*>(map);
+    z->mapBytes = (size_t)st.st_size;
+    if (!parseWav(z->map, z->mapBytes, z->layout, error)) {
+        munmap(map, z->mapBytes);
+        error = path + ": " + error;
+        return false;
+    }
+    z->root = std::clamp(root, 0, 127);
+    z->low = std::clamp(std::min(low, high), 0, 127);
+    z->high = std::clamp(std::max(low, high), 0, 127);
+    z->step = z->layout.sampleRate / (440.0f * std::exp2((z->root - 69) / 12.0f));
+    z->attack.resize((size_t)std::min<uint64_t>(z->layout.frames, kAttackFrames));
+    decode(*z, 0, (unsigned long)z->attack.size(), z->attack.data());
+    zones_.push_back(std::move(z));
+    return true;
+#else
+    (void)path; (void)root; (void)low; (void)high;
+    error = "memory-mapped samples need a POSIX system";
+    return false;
+#endif
+}
+
+int Sampler::zoneFor(int note) const {
+    int best = -1, bestDistance = 0;
+    for (int i = (int)zones_.size() - 1; i >= 0; --i) {
+        const Zone& z = *zones_[i];
+        const int distance = note < z.low ? z.low - note : note > z.high ? note - z.high : 0;
+        if (best < 0 || distance < bestDistance) {
+            best = i;
+            bestDistance = distance;
+        }
+    }
+    return best;
+}
+
+bool Sampler::start() {
+    if (thread_.joinable()) return true;
+#ifdef SAMPLER_MMAP
+    // Best effort: without the privilege to lock memory, the rings and
+    // attack regions stay resident only as long as they stay in use
+    mlock(rings_.data(), rings_.size() * sizeof(float));
+    for (auto& z : zones_) mlock(z->attack.data(), z->attack.size() * sizeof(float));
+#endif
+    quit_ = false;
+    thread_ = std::thread(&Sampler::run, this);
+    return true;
+}
+
+void Sampler::stop() {
+    if (!thread_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+}
+
+// Whether every open stream has half a ring, or the rest of its sample,
+// delivered past what its voice has played
+bool Sampler::ahead() const {
+    for (int i = 0; i < kMaxStreams; ++i) {
+        const Stream& s = streams_[i];
+        const uint64_t request = s.request.load(std::memory_order_acquire);
+        const int zone = (int)(uint32_t)request - 1;
+        if (zone < 0) continue;
+        const uint32_t generation = (uint32_t)(request >> 32);
+        const uint64_t written = s.written.load(std::memory_order_acquire);
+        const uint64_t consumed = s.consumed.load(std::memory_order_acquire);
+        if ((uint32_t)(written >> 32) != generation) return false;
+
+        const Zone& z = *zones_[zone];
+        const uint64_t total = std::min<uint64_t>(z.layout.frames - z.attack.size(), UINT32_MAX);
+        const uint32_t used = (uint32_t)(consumed >> 32) == generation ? (uint32_t)consumed : 0;
+        if ((uint32_t)written < total && (uint32_t)written - used < kRingFrames / 2) return false;
+    }
+    return true;
+}
+
+void Sampler::settle() {
+    if (ahead()) return;
+    if (!thread_.joinable()) {
+        for (int i = 0; i < kMaxStreams; ++i) fill(streams_[i]);
+        return;
+    }
+    // A pass already running may have gone past a stream opened just now;
+    // the one after it has not
+    std::unique_lock<std::mutex> lock(mutex_);
+    const uint64_t target = passes_ + 2;
+    poke_ = true;
+    wake_.notify_one();
+    settled_.wait(lock, [&]() { return passes_ >= target; });
+}
+
+void Sampler::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!quit_) {
+        lock.unlock();
+        for (int i = 0; i < kMaxStreams; ++i) fill(streams_[i]);
+        lock.lock();
+
+        ++passes_;
+        settled_.notify_all();
+        if (!poke_) wake_.wait_for(lock, kPrefetchPeriod, [&]() { return quit_ || poke_; });
+        poke_ = false;
+    }
+}
+
+// Frames first..first + n of the zone, mixed to mono
+void Sampler::decode(const Zone& z, uint64_t first, unsigned long n, float* out) {
+    const WavLayout& w = z.layout;
+    const int bytes = w.bits / 8;
+    const size_t frameBytes = (size_t)w.channels * bytes;
+    const unsigned char* p = z.map + w.dataOffset + first * frameBytes;
+    const float scale = 1.0f / w.channels;
+
+    for (unsigned long i = 0; i < n; ++i, p += frameBytes) {
+        float sum = 0.0f;
+        for (int c = 0; c < w.channels; ++c) sum += wavSample(p + c * bytes, w);
+        out[i] = sum * scale;
+    }
+}
+
+// Decodes whole pages into the stream's ring while there is room, each
+// published as it lands; returns whether it wrote any
+bool Sampler::fill(Stream& s) {
+    const uint64_t request = s.request.load(std::memory_order_acquire);
+    const uint32_t generation = (uint32_t)(request >> 32);
+    const int zone = (int)(uint32_t)request - 1;
+    if (zone < 0) return false;
+    if (generation != s.fillGeneration) {
+        s.fillGeneration = generation;
+        s.filled = 0;
+    }
+
+    const Zone& z = *zones_[zone];
+    const uint64_t total = std::min<uint64_t>(z.layout.frames - z.attack.size(), UINT32_MAX);
+    const uint64_t consumed = s.consumed.load(std::memory_order_acquire);
+    const uint32_t used = (uint32_t)(consumed >> 32) == generation ? (uint32_t)consumed : 0;
+
+    bool wrote = false;
+    while (s.filled < total && s.filled - used + kPageFrames <= kRingFrames) {
+        const unsigned long n = (unsigned long)std::min<uint64_t>(kPageFrames, total - s.filled);
+        decode(z, z.attack.size() + s.filled, n, s.ring + s.filled % kRingFrames);
+        s.filled += (uint32_t)n;
+        s.written.store(tagged(generation, s.filled), std::memory_order_release);
+        wrote = true;
+        // Closed or reopened meanwhile: the rest would be for nobody
+        if (s.request.load(std::memory_order_relaxed) != request) break;
+    }
+
+#ifdef SAMPLER_MMAP
+    // Start reading the next ring's worth from disk before it is needed
+    if (wrote && s.filled < total) {
+        const size_t frameBytes = (size_t)z.layout.channels * (z.layout.bits / 8);
+        const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        const size_t from = z.layout.dataOffset + (z.attack.size() + s.filled) * frameBytes;
+        const size_t to = std::min(z.mapBytes, from + kRingFrames * frameBytes);
+        const size_t aligned = from / page * page;
+        if (to > aligned) madvise(const_cast<unsigned char*>(z.map) + aligned, to - aligned, MADV_WILLNEED);
+    }
+#endif
+    return wrote;
+}
+
+int Sampler::open(int zone) {
+    if (zone < 0 || zone >= (int)zones_.size()) return -1;
+    const int first = nextStream_.load(std::memory_order_relaxed);
+    for (int k = 0; k < kMaxStreams; ++k) {
+        const int i = (first + k) % kMaxStreams;
+        Stream& s = streams_[i];
+        uint32_t free = 0;
+        if (s.taken.load(std::memory_order_relaxed) != 0 ||
+            !s.taken.compare_exchange_strong(free, 1, std::memory_order_acquire)) continue;
+
+        nextStream_.store((i + 1) % kMaxStreams, std::memory_order_relaxed);
+        const uint32_t generation = s.generation.fetch_add(1, std::memory_order_relaxed) + 1;
+        s.consumed.store(tagged(generation, 0), std::memory_order_relaxed);
+        s.request.store(tagged(generation, (uint32_t)zone + 1), std::memory_order_release);
+        return i;
+    }
+    return -1;
+}
+
+void Sampler::close(int stream) {
+    if (stream < 0 || stream >= kMaxStreams) return;
+    Stream& s = streams_[stream];
+    const uint32_t generation = s.generation.fetch_add(1, std::memory_order_relaxed) + 1;
+    s.request.store(tagged(generation, 0), std::memory_order_release);
+    s.taken.store(0, std::memory_order_release);
+}
+
+bool Sampler::render(int zone, int stream, double& position, const float* phaseInc, float ratio,
+                     float* out, unsigned long n) {
+    const Zone& z = *zones_[zone];
+    const uint64_t frames = z.layout.frames;
+    const float* attack = z.attack.data();
+    const uint64_t attackFrames = z.attack.size();
+
+    // What the prefetcher has delivered for this stream's current note
+    const float* ring = nullptr;
+    uint64_t delivered = 0;
+    uint32_t generation = 0;
+    if (stream >= 0) {
+        Stream& s = streams_[stream];
+        generation = (uint32_t)(s.request.load(std::memory_order_relaxed) >> 32);
+        const uint64_t written = s.written.load(std::memory_order_acquire);
+        if ((uint32_t)(written >> 32) == generation) delivered = (uint32_t)written;
+        ring = s.ring;
+    }
+
+    unsigned long missed = 0;
+    bool miss = false;
+    auto frame = [&](uint64_t k) {
+        if (k < attackFrames) return attack[k];
+        if (k >= frames) return 0.0f;
+        if (k - attackFrames < delivered) return ring[(k - attackFrames) % kRingFrames];
+        miss = true;
+        return 0.0f;
+    };
+
+    const double scale = (double)ratio * z.step;
+    double pos = position;
+    for (unsigned long i = 0; i < n; ++i) {
+        const uint64_t k = (uint64_t)pos;
+        const float f = (float)(pos - (double)k);
+        miss = false;
+        const float a = frame(k);
+        const float b = frame(k + 1);
+        missed += miss;
+        out[i] = a + f * (b - a);
+        pos += phaseInc[i] * scale;
+    }
+    position = pos;
+
+    // Everything before the current frame is done with; its pages are the
+    // prefetcher's again
+    if (stream >= 0) {
+        const uint64_t at = (uint64_t)pos;
+        const uint64_t used = std::min(at > attackFrames ? at - attackFrames : 0, delivered);
+        streams_[stream].consumed.store(tagged(generation, used), std::memory_order_release);
+    }
+    if (missed) missed_.fetch_add(missed, std::memory_order_relaxed);
+    return pos < (double)frames;
+}
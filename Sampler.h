@@ -0,0 +1,123 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "WavFile.h"
+
+// Multi-sample instrument played by Oscillator::SAMPLE voices, streamed
+// from memory-mapped WAV files.
+//
+// Each zone is a file mapped for a range of notes. Its first kAttackFrames
+// are decoded into memory at load, so a note starts at once; the rest is
+// streamed. A voice opens a stream, and a prefetch thread keeps the
+// stream's ring of decoded pages filled ahead of the voice, touching the
+// mapping (and taking its page faults) on its own time. The audio side
+// only ever reads the attack region and the rings: it never touches the
+// mapping, takes no locks and does not wait. Frames the prefetcher has
+// not delivered in time play as silence and are counted in missedFrames().
+//
+// Files are mixed down to mono; the voice's gains place it in the stereo
+// field. Zones are added before start(); open(), close() and render() are
+// for the audio thread and the render pool's workers.
+class Sampler {
+public:
+    static constexpr unsigned long kAttackFrames = 8192;  // resident, per zone
+    static constexpr unsigned long kPageFrames = 1024;
+    static constexpr int kRingPages = 16;                  // per stream
+    static constexpr unsigned long kRingFrames = kPageFrames * kRingPages;
+    static constexpr int kMaxStreams = 256;
+
+    Sampler();
+    ~Sampler();
+
+    Sampler(const Sampler&) = delete;
+    Sampler& operator=(const Sampler&) = delete;
+
+    // Maps the WAV file at path for notes low..high, sounding at its own
+    // pitch on note `root`. Where zones overlap, the later one wins.
+    bool addZone(const std::string& path, int root, int low, int high, std::string& error);
+    int zones() const { return (int)zones_.size(); }
+
+    // Zone for a MIDI note: the one covering it, else the nearest; -1
+    // with no zones
+    int zoneFor(int note) const;
+
+    // Prefetch thread
+    bool start();
+    void stop();
+
+    // Returns once every open stream has half a ring or the rest of its
+    // sample delivered ahead of its voice, waking the prefetcher if need
+    // be. For offline rendering, between blocks; not for the audio thread.
+    void settle();
+
+    // A stream for a voice starting at the beginning of the zone, or -1
+    // when all kMaxStreams are taken (the voice then plays the attack
+    // region only). Lock-free.
+    int open(int zone);
+    void close(int stream);
+
+    // Resamples n frames of the zone into out, starting at source frame
+    // `position` and stepping phaseInc[i] * ratio * the zone's frames per
+    // cycle at its root. Returns false once past the end of the sample.
+    bool render(int zone, int stream, double& position, const float* phaseInc, float ratio,
+                float* out, unsigned long n);
+
+    uint64_t missedFrames() const { return missed_.load(std::memory_order_relaxed); }
+
+private:
+    struct Zone {
+        std::string path;
+        int root = 69, low = 0, high = 127;
+        const unsigned char* map = nullptr;
+        size_t mapBytes = 0;
+        WavLayout layout;
+        float step = 1.0f;          // source frames per cycle of the phase increment
+        std::vector<float> attack;  // the first kAttackFrames, decoded
+    };
+
+    // Generation-tagged counters: generation in the high 32 bits, frames
+    // past the attack region in the low 32. A stream's generation changes
+    // with every open() and close(), so either side can tell the other's
+    // counts from an earlier note apart from the current ones.
+    struct alignas(64) Stream {
+        std::atomic<uint32_t> taken{0};
+        std::atomic<uint32_t> generation{0};
+        std::atomic<uint64_t> request{0};   // generation | zone + 1, 0 when idle
+        std::atomic<uint64_t> written{0};   // by the prefetcher
+        std::atomic<uint64_t> consumed{0};  // by the voice
+        float* ring = nullptr;              // kRingFrames
+
+        // Prefetcher's own
+        uint32_t fillGeneration = 0;
+        uint32_t filled = 0;
+    };
+
+    static void decode(const Zone& z, uint64_t first, unsigned long n, float* out);
+    bool fill(Stream& s);
+    bool ahead() const;
+    void run();
+
+    std::vector<std::unique_ptr<Zone>> zones_;
+    std::unique_ptr<Stream[]> streams_;
+    std::vector<float> rings_;
+    std::atomic<int> nextStream_{0};
+    std::atomic<uint64_t> missed_{0};
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable settled_;
+    bool quit_ = false;
+    bool poke_ = false;
+    uint64_t passes_ = 0;
+};
+
+#endif
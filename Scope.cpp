@@ -0,0 +1,100 @@
+#include "Scope.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Below this the output counts as silent (about -100 dBFS)
+static constexpr float kSilence = 1e-5f;
+
+ScopeTap::ScopeTap(float sampleRate, int decimation, float refreshHz)
+    : sampleRate_(sampleRate),
+      decimation_(std::max(1, decimation)),
+      hop_(std::max(1, (int)(sampleRate / decimation_ / std::max(1.0f, refreshHz))))
+{}
+
+void ScopeTap::push(const float* interleaved, unsigned long frames, int channels) {
+    const float scale = 1.0f / (float)(decimation_ * channels);
+    for (unsigned long i = 0; i < frames; ++i) {
+        const float* f = interleaved + i * channels;
+        for (int c = 0; c < channels; ++c) acc_ += f[c];
+        if (++accCount_ < decimation_) continue;
+
+        const float v = acc_ * scale;
+        acc_ = 0.0f;
+        accCount_ = 0;
+        history_[pos_] = v;
+        pos_ = (pos_ + 1) & (ScopeFrame::kSamples - 1);
+        silentRun_ = std::fabs(v) < kSilence ? std::min(silentRun_ + 1, ScopeFrame::kSamples) : 0;
+        if (++sinceFrame_ >= hop_) publish();
+    }
+}
+
+void ScopeTap::publish() {
+    sinceFrame_ = 0;
+    const bool silent = silentRun_ >= ScopeFrame::kSamples;
+    if (silent && silentShown_) return;
+    silentShown_ = silent;
+
+    ScopeFrame& f = frames_.back();
+    const int older = ScopeFrame::kSamples - pos_;
+    std::memcpy(f.samples, history_ + pos_, older * sizeof(float));
+    std::memcpy(f.samples + older, history_, pos_ * sizeof(float));
+    f.sampleRate = sampleRate_ / decimation_;
+    f.serial = ++serial_;
+    frames_.publish();
+}
+
+Spectrum::Spectrum(int bands, float minHz)
+    : fft_(ScopeFrame::kSamples),
+      minHz_(std::max(1.0f, minHz))
+{
+    const int n = fft_.size();
+    window_.resize(n);
+    double sum = 0.0;
+    for (int i = 0; i < n; ++i) {
+        window_[i] = (float)(0.5 - 0.5 * std::cos(2.0 * M_PI * i / n));
+        sum += window_[i];
+    }
+    // A sine of amplitude 1 peaks at sum / 2
+    windowGain_ = (float)(2.0 / sum);
+    in_.resize(n);
+    re_.resize(fft_.bins());
+    im_.resize(fft_.bins());
+    levels_.assign(std::max(1, bands), kFloorDb);
+}
+
+float Spectrum::bandHz(int b) const {
+    const float ratio = std::log(std::max(nyquist_, 2.0f * minHz_) / minHz_);
+    return minHz_ * std::exp(ratio * (b + 0.5f) / bands());
+}
+
+void Spectrum::analyze(const ScopeFrame& frame, float fallDb) {
+    const int n = fft_.size();
+    for (int i = 0; i < n; ++i) in_[i] = frame.samples[i] * window_[i];
+    fft_.forward(in_.data(), re_.data(), im_.data());
+
+    nyquist_ = 0.5f * frame.sampleRate;
+    const float binHz = frame.sampleRate / n;
+    const int last = fft_.bins() - 1;
+    const float ratio = std::log(std::max(nyquist_, 2.0f * minHz_) / minHz_) / bands();
+    auto power = [&](int k) { return re_[k] * re_[k] + im_[k] * im_[k]; };
+
+    for (int b = 0; b < bands(); ++b) {
+        const float lo = minHz_ * std::exp(ratio * b) / binHz;
+        const float hi = minHz_ * std::exp(ratio * (b + 1)) / binHz;
+        const int k0 = std::min(last, (int)std::ceil(lo));
+        const int k1 = std::min(last, (int)std::floor(hi));
+        float p = 0.0f;
+        if (k0 <= k1) {
+            for (int k = k0; k <= k1; ++k) p = std::max(p, power(k));
+        } else {
+            // Narrower than a bin: interpolate at the band centre
+            const float c = std::min((float)last, 0.5f * (lo + hi));
+            const int k = std::min(last - 1, (int)c);
+            const float t = c - k;
+            p = power(k) + t * (power(k + 1) - power(k));
+        }
+        const float db = std::max(kFloorDb, 10.0f * std::log10(p * windowGain_ * windowGain_ + 1e-30f));
+        levels_[b] = std::max(db, levels_[b] - fallDb);
+    }
+}
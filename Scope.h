@@ -0,0 +1,81 @@
+#ifndef SCOPE_H
+#define SCOPE_H
+
+#include <cstdint>
+#include <vector>
+#include "Fft.h"
+#include "MessageQueue.h"
+
+// The last kSamples of output, mixed to mono and decimated
+struct ScopeFrame {
+    static constexpr int kSamples = 4096;  // power of two
+
+    float samples[kSamples];  // oldest first
+    float sampleRate;         // of samples[], after decimation
+    uint64_t serial;          // counts published frames
+};
+
+// Taps the rendered output for the GUI's scope and spectrum. The audio side
+// only sums channels, averages `decimation` frames into one sample and
+// keeps a history ring; refreshHz times a second it copies the ring into a
+// triple buffer, so neither side waits and the GUI always gets the newest
+// frame. Once the whole history is silent, one silent frame is published
+// and then nothing until sound returns, letting an idle GUI sleep.
+class ScopeTap {
+public:
+    explicit ScopeTap(float sampleRate, int decimation = 2, float refreshHz = 60.0f);
+
+    // Audio thread: wait-free, no allocation
+    void push(const float* interleaved, unsigned long frames, int channels);
+
+    // GUI thread: true when a newer frame than latest() was published
+    bool poll() { return frames_.update(); }
+    const ScopeFrame& latest() const { return frames_.front(); }
+
+private:
+    void publish();
+
+    const float sampleRate_;
+    const int decimation_;
+    const int hop_;          // decimated samples between frames
+
+    float history_[ScopeFrame::kSamples] = {};
+    int pos_ = 0;
+    float acc_ = 0.0f;
+    int accCount_ = 0;
+    int sinceFrame_ = 0;
+    int silentRun_ = 0;
+    bool silentShown_ = false;
+    uint64_t serial_ = 0;
+
+    TripleBuffer<ScopeFrame> frames_;
+};
+
+// Log-frequency spectrum of a ScopeFrame for display: Hann window, real
+// FFT, and per band the loudest bin, in dB where a full-scale sine is 0.
+// Levels rise at once and fall by at most fallDb per analyze(), so
+// transients stay readable at GUI frame rates. GUI thread only.
+class Spectrum {
+public:
+    explicit Spectrum(int bands = 240, float minHz = 20.0f);
+
+    void analyze(const ScopeFrame& frame, float fallDb = 2.0f);
+
+    int bands() const { return (int)levels_.size(); }
+    const float* levelsDb() const { return levels_.data(); }
+    // Centre of band b for the last analysed sample rate
+    float bandHz(int b) const;
+
+    static constexpr float kFloorDb = -120.0f;
+
+private:
+    RealFft fft_;
+    const float minHz_;
+    float nyquist_ = 0.0f;
+    std::vector<float> window_;
+    float windowGain_;
+    std::vector<float> in_, re_, im_;
+    std::vector<float> levels_;
+};
+
+#endif
@@ -0,0 +1,520 @@
+#include "Session.h"
+#include "MidiFile.h"
+#include "Sampler.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+bool Session::load(const std::string& path, std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "cannot open " + path;
+        return false;
+    }
+    return parse(in, error);
+}
+
+bool Session::parse(std::istream& in, std::string& error) {
+    std::string line;
+    int lineNo = 0;
+
+    while (std::getline(in, line)) {
+        ++lineNo;
+        const auto hash = line.find('#');
+        if (hash != std::string::npos) line.erase(hash);
+
+        std::istringstream ls(line);
+        std::string word;
+        if (!(ls >> word)) continue;
+
+        auto fail = [&](const std::string& what) {
+            error = "line " + std::to_string(lineNo) + ": " + what;
+            return false;
+        };
+
+        if (word == "samplerate") {
+            if (!(ls >> sampleRate) || sampleRate < 1.0f) return fail("bad samplerate");
+            continue;
+        }
+        if (word == "block") {
+            if (!(ls >> blockSize) || blockSize == 0) return fail("bad block size");
+            continue;
+        }
+        if (word == "duration") {
+            if (!(ls >> duration) || duration < 0.0) return fail("bad duration");
+            continue;
+        }
+        if (word == "polyphony") {
+            if (!(ls >> maxVoices) || maxVoices < 1) return fail("bad polyphony");
+            continue;
+        }
+        if (word == "steal") {
+            std::string policy;
+            ls >> policy;
+            if      (policy == "oldest")   stealPolicy = VoiceBank::StealOldest;
+            else if (policy == "quietest") stealPolicy = VoiceBank::StealQuietest;
+            else if (policy == "released") stealPolicy = VoiceBank::StealReleasedFirst;
+            else return fail("steal policy must be oldest, quietest or released");
+            continue;
+        }
+        if (word == "controlrate") {
+            if (!(ls >> controlRate) || controlRate < 1 || controlRate > Synth::kMaxControlRate)
+                return fail("bad control rate");
+            continue;
+        }
+        if (word == "oversample") {
+            if (!(ls >> oversampling) || (oversampling != 1 && oversampling != 2 &&
+                                          oversampling != 4 && oversampling != 8))
+                return fail("oversample must be 1, 2, 4 or 8");
+            continue;
+        }
+        if (word == "filter") {
+            std::string type;
+            ls >> type;
+            if      (type == "off")      filterType = VoiceFilter::OFF;
+            else if (type == "lowpass")  filterType = VoiceFilter::SVF_LOWPASS;
+            else if (type == "bandpass") filterType = VoiceFilter::SVF_BANDPASS;
+            else if (type == "highpass") filterType = VoiceFilter::SVF_HIGHPASS;
+            else if (type == "ladder")   filterType = VoiceFilter::LADDER;
+            else return fail("filter must be off, lowpass, bandpass, highpass or ladder");
+            if (ls >> filterCutoff) ls >> filterResonance;
+            if (filterCutoff <= 0.0f || filterResonance < 0.0f || filterResonance > 1.0f)
+                return fail("bad filter cutoff or resonance");
+            continue;
+        }
+        if (word == "lfo_target") {
+            std::string target;
+            ls >> target;
+            if      (target == "none")   lfoTarget = LFO::NONE;
+            else if (target == "pitch")  lfoTarget = LFO::PITCH;
+            else if (target == "filter") lfoTarget = LFO::FILTER;
+            else return fail("lfo_target must be none, pitch or filter");
+            if (lfoTarget == LFO::FILTER) ls >> filterLfoOctaves;
+            continue;
+        }
+        if (word == "lfo") {
+            int n = 0;
+            std::string shape;
+            if (!(ls >> n >> shape) || n < 1 || n > ModMatrix::kLfos)
+                return fail("expected 'lfo <1.." + std::to_string(ModMatrix::kLfos) + "> <waveform> [rate]'");
+            LFO::Waveform& w = lfoWaveform[n - 1];
+            if      (shape == "sine")     w = LFO::SINE;
+            else if (shape == "square")   w = LFO::SQUARE;
+            else if (shape == "triangle") w = LFO::TRIANGLE;
+            else if (shape == "saw")      w = LFO::SAW;
+            else return fail("lfo waveform must be sine, square, triangle or saw");
+            float rate;
+            if (ls >> rate) {
+                if (n == 1) return fail("LFO 1 runs at lfo_rate");
+                if (rate < 0.0f) return fail("bad lfo rate");
+                modLfoRate[n - 2] = rate;
+            }
+            continue;
+        }
+        if (word == "mod") {
+            std::string source, destination, curve = "linear";
+            ModMatrix::Route route;
+            if (!(ls >> source >> destination >> route.depth))
+                return fail("expected 'mod <source> <destination> <depth> [curve]'");
+            ls >> curve;
+            if      (source == "env")      route.source = ModMatrix::ENVELOPE;
+            else if (source == "velocity") route.source = ModMatrix::VELOCITY;
+            else if (source.size() == 4 && source.compare(0, 3, "lfo") == 0 &&
+                     source[3] >= '1' && source[3] < '1' + ModMatrix::kLfos)
+                route.source = ModMatrix::LFO1 + (source[3] - '1');
+            else return fail("mod source must be lfo1.." + std::to_string(ModMatrix::kLfos) + ", env or velocity");
+            if      (destination == "pitch")  route.destination = ModMatrix::PITCH;
+            else if (destination == "cutoff") route.destination = ModMatrix::CUTOFF;
+            else if (destination == "amp")    route.destination = ModMatrix::AMP;
+            else if (destination == "pan")    route.destination = ModMatrix::PAN;
+            else return fail("mod destination must be pitch, cutoff, amp or pan");
+            if      (curve == "linear")  route.curve = ModMatrix::LINEAR;
+            else if (curve == "squared") route.curve = ModMatrix::SQUARED;
+            else if (curve == "root")    route.curve = ModMatrix::ROOT;
+            else return fail("mod curve must be linear, squared or root");
+            if (ModMatrix::perVoice(route.source) && route.destination == ModMatrix::CUTOFF)
+                return fail("the cutoff is shared by all voices; only LFOs can move it");
+            if ((int)modRoutes.size() == ModMatrix::kMaxRoutes)
+                return fail("at most " + std::to_string(ModMatrix::kMaxRoutes) + " mod routes");
+            modRoutes.push_back(route);
+            continue;
+        }
+        if (word == "unison") {
+            if (!(ls >> unisonVoices) || unisonVoices < 1 || unisonVoices > VoiceBank::kMaxUnison)
+                return fail("unison must be 1 to " + std::to_string(VoiceBank::kMaxUnison) + " voices");
+            if (ls >> unisonDetune) ls >> unisonSpread;
+            if (unisonDetune < 0.0f || unisonSpread < 0.0f || unisonSpread > 1.0f)
+                return fail("bad unison detune or spread");
+            continue;
+        }
+        if (word == "envelope") {
+            Envelope::Params& p = envelope;
+            std::string curve = "linear";
+            if (!(ls >> p.attack >> p.decay >> p.sustain >> p.release) ||
+                p.attack < 0.0f || p.decay < 0.0f || p.release < 0.0f || p.sustain < 0.0f || p.sustain > 1.0f)
+                return fail("expected 'envelope <attack> <decay> <sustain> <release> [curve]'");
+            ls >> curve;
+            if      (curve == "linear")      p.curve = Envelope::LINEAR;
+            else if (curve == "exponential") p.curve = Envelope::EXPONENTIAL;
+            else return fail("envelope curve must be linear or exponential");
+            continue;
+        }
+        if (word == "notes") {
+            std::string kind;
+            ls >> kind;
+            if      (kind == "saw")    noteWaveform = Oscillator::SAW;
+            else if (kind == "square") noteWaveform = Oscillator::SQUARE;
+            else if (kind == "sine")   noteWaveform = Oscillator::SINE;
+            else if (kind == "fm")     noteWaveform = Oscillator::FM;
+            else return fail("notes must be saw, square, sine or fm");
+            continue;
+        }
+        if (word == "fm") {
+            if (!(ls >> fm.algorithm) || fm.algorithm < 0 || fm.algorithm >= kFmAlgorithms)
+                return fail("fm algorithm must be 0 to " + std::to_string(kFmAlgorithms - 1));
+            continue;
+        }
+        if (word == "operator") {
+            int k = -1;
+            FmOperator op;
+            if (!(ls >> k >> op.ratio >> op.level >> op.feedback) || k < 0 || k >= kFmOperators ||
+                op.ratio <= 0.0f || op.feedback < 0.0f || op.feedback > 1.0f)
+                return fail("expected 'operator <0.." + std::to_string(kFmOperators - 1) +
+                            "> <ratio> <level> <feedback> [attack decay sustain release]'");
+            Envelope::Params& e = op.envelope;
+            if ((ls >> e.attack) && (!(ls >> e.decay >> e.sustain >> e.release) ||
+                e.attack < 0.0f || e.decay < 0.0f || e.release < 0.0f || e.sustain < 0.0f || e.sustain > 1.0f))
+                return fail("bad operator envelope");
+            fm.op[k] = op;
+            continue;
+        }
+        if (word == "threads") {
+            if (!(ls >> renderThreads) || renderThreads < 1) return fail("bad thread count");
+            continue;
+        }
+        if (word == "oscillators") {
+            std::string kind;
+            ls >> kind;
+            if      (kind == "wavetable") bandLimited = true;
+            else if (kind == "naive")     bandLimited = false;
+            else return fail("oscillators must be wavetable or naive");
+            continue;
+        }
+        if (word == "midi") {
+            std::string path, midiError;
+            if (!(ls >> path)) return fail("expected 'midi <file>'");
+            if (!loadMidi(path, midiError)) return fail(midiError);
+            continue;
+        }
+        if (word == "sample") {
+            SampleFile s{ "", 0, 0, 127 };
+            if (!(ls >> s.path >> s.root) || s.root < 0 || s.root > 127)
+                return fail("expected 'sample <file> <root note> [low high]'");
+            if ((ls >> s.low) && !(ls >> s.high)) return fail("a sample's note range needs both ends");
+            if (s.low < 0 || s.high > 127 || s.low > s.high) return fail("bad sample note range");
+            samples.push_back(s);
+            continue;
+        }
+        if (word == "reverb") {
+            float level;
+            if (!(ls >> reverbPath)) return fail("expected 'reverb <file> [level]'");
+            if (ls >> level) {
+                if (level < 0.0f) return fail("bad reverb level");
+                reverbLevel = level;
+            }
+            continue;
+        }
+        if (word == "patch") {
+            std::string path, patchError;
+            if (!(ls >> path)) return fail("expected 'patch <file>'");
+            if (voiceCount != 1 || usePatch) return fail("'patch' must come once, before any 'add'");
+            if (!loadPatch(path, patch, patchError)) return fail(patchError);
+            const PatchParams& p = patch.params;
+            stealPolicy = (VoiceBank::StealPolicy)p.stealPolicy;
+            bandLimited = p.bandLimited != 0;
+            controlRate = p.controlRate;
+            oversampling = p.oversampling;
+            reverbLevel = p.reverbLevel;
+            filterType = (VoiceFilter::Type)p.filterType;
+            filterCutoff = p.filterCutoffHz;
+            filterResonance = p.filterResonance;
+            lfoTarget = (LFO::Parameter)p.lfoTarget;
+            filterLfoOctaves = p.filterLfoOctaves;
+            lfoWaveform[0] = (LFO::Waveform)p.lfoWaveform;
+            for (int k = 1; k < ModMatrix::kLfos; ++k) {
+                lfoWaveform[k] = (LFO::Waveform)p.modLfoWaveform[k - 1];
+                modLfoRate[k - 1] = p.modLfoRateHz[k - 1];
+            }
+            modRoutes.clear();
+            for (const PatchRoute& r : p.modRoutes) {
+                if (r.depth != 0.0f) modRoutes.push_back({ r.source, r.destination, r.depth, r.curve });
+            }
+            unisonVoices = p.unisonVoices;
+            unisonDetune = p.unisonDetuneCents;
+            unisonSpread = p.unisonSpread;
+            envelope.attack = p.attackSec;
+            envelope.decay = p.decaySec;
+            envelope.sustain = p.sustainLevel;
+            envelope.release = p.releaseSec;
+            envelope.curve = (Envelope::Curve)p.envelopeCurve;
+            noteWaveform = (Oscillator::Waveform)p.noteWaveform;
+            fm.algorithm = p.fmAlgorithm;
+            for (int k = 0; k < kFmOperators; ++k) {
+                const PatchFmOperator& o = p.fmOperators[k];
+                fm.op[k].ratio = o.ratio;
+                fm.op[k].level = o.level;
+                fm.op[k].feedback = o.feedback;
+                fm.op[k].envelope.attack = o.attackSec;
+                fm.op[k].envelope.decay = o.decaySec;
+                fm.op[k].envelope.sustain = o.sustainLevel;
+                fm.op[k].envelope.release = o.releaseSec;
+            }
+            usePatch = true;
+            voiceCount = (int)patch.voices.size();
+            continue;
+        }
+        if (word != "at") return fail("unknown statement '" + word + "'");
+
+        Event e{};
+        e.repeat = 1;
+        std::string what;
+        if (!(ls >> e.time >> what) || e.time < 0.0) return fail("expected 'at <seconds> <command>'");
+
+        // Voice commands hold the session's voice number in index until render()
+
+        if (what == "pitch" || what == "lfo_rate" || what == "lfo_depth" ||
+            what == "cutoff" || what == "resonance" ||
+            what == "unison" || what == "detune" || what == "spread") {
+            e.cmd = { SynthCmd::SetParam, what == "pitch" ? SynthCmd::MasterPitch
+                                        : what == "lfo_rate" ? SynthCmd::LfoRate
+                                        : what == "lfo_depth" ? SynthCmd::LfoDepth
+                                        : what == "cutoff" ? SynthCmd::FilterCutoff
+                                        : what == "resonance" ? SynthCmd::FilterResonance
+                                        : what == "unison" ? SynthCmd::UnisonVoices
+                                        : what == "detune" ? SynthCmd::UnisonDetune
+                                        : SynthCmd::UnisonSpread, 0.0f };
+            if (!(ls >> e.cmd.value)) return fail("missing value for " + what);
+        }
+        else if (what == "note") {
+            e.cmd = { SynthCmd::NoteOn, 0, 1.0f };
+            if (!(ls >> e.cmd.index) || e.cmd.index < 0 || e.cmd.index > 127) return fail("expected 'note <0..127> [velocity]'");
+            if (!(ls >> e.cmd.value)) e.cmd.value = 1.0f;
+        }
+        else if (what == "noteoff") {
+            e.cmd = { SynthCmd::NoteOff, 0, 0.0f };
+            if (!(ls >> e.cmd.index) || e.cmd.index < 0 || e.cmd.index > 127) return fail("expected 'noteoff <0..127>'");
+        }
+        else if (what == "add") {
+            e.cmd = { SynthCmd::AddOsc, voiceCount, 0.0f };
+            if (!(ls >> e.repeat)) e.repeat = 1;
+            if (e.repeat < 1) return fail("bad add count");
+            voiceCount += e.repeat;
+        }
+        else if (what == "remove") {
+            e.cmd = { SynthCmd::RemoveOsc, 0, 0.0f };
+            if (!(ls >> e.cmd.index) || e.cmd.index < 0) return fail("missing voice for remove");
+        }
+        else if (what == "release" || what == "trigger") {
+            e.cmd = { what == "release" ? SynthCmd::ReleaseOsc : SynthCmd::TriggerOsc, 0, 0.0f };
+            if (!(ls >> e.cmd.index) || e.cmd.index < 0) return fail("missing voice for " + what);
+        }
+        else if (what == "freq") {
+            e.cmd = { SynthCmd::SetOscFreq, 0, 0.0f };
+            if (!(ls >> e.cmd.index >> e.cmd.value) || e.cmd.index < 0) return fail("expected 'freq <voice> <hz>'");
+        }
+        else {
+            return fail("unknown command '" + what + "'");
+        }
+
+        events.push_back(e);
+    }
+
+    std::stable_sort(events.begin(), events.end(),
+                     [](const Event& a, const Event& b) { return a.time < b.time; });
+    return true;
+}
+
+bool Session::loadMidi(const std::string& path, std::string& error) {
+    std::vector<MidiEvent> midi;
+    if (!readMidiFile(path, midi, error)) return false;
+
+    for (const MidiEvent& m : midi) {
+        const int kind = m.status & 0xF0;
+        Event e{};
+        e.time = m.time;
+        e.repeat = 1;
+        if (kind == 0x90 && m.data2 > 0) e.cmd = { SynthCmd::NoteOn, m.data1, m.data2 / 127.0f };
+        else if (kind == 0x80 || kind == 0x90) e.cmd = { SynthCmd::NoteOff, m.data1, 0.0f };
+        else continue;
+        events.push_back(e);
+    }
+    return true;
+}
+
+unsigned long Session::render(Synth& synth, std::vector<float>& out, Telemetry* telemetry) const {
+    synth.setSampleRate(sampleRate);
+    synth.stealPolicy.store(stealPolicy);
+    synth.bandLimited.store(bandLimited);
+    synth.controlRate.store(controlRate);
+    synth.oversampling.store(oversampling);
+    synth.attackSec.store(envelope.attack);
+    synth.decaySec.store(envelope.decay);
+    synth.sustainLevel.store(envelope.sustain);
+    synth.releaseSec.store(envelope.release);
+    synth.envelopeCurve.store(envelope.curve);
+    synth.filterType.store(filterType);
+    synth.filterCutoffHz.store(filterCutoff);
+    synth.filterResonance.store(filterResonance);
+    synth.lfoTarget.store(lfoTarget);
+    synth.filterLfoOctaves.store(filterLfoOctaves);
+    synth.lfoWaveform.store(lfoWaveform[0]);
+    for (int k = 1; k < ModMatrix::kLfos; ++k) {
+        synth.modLfoWaveform[k - 1].store(lfoWaveform[k]);
+        synth.modLfoRateHz[k - 1].store(modLfoRate[k - 1]);
+    }
+    for (int i = 0; i < ModMatrix::kMaxRoutes; ++i) {
+        const ModMatrix::Route r = i < (int)modRoutes.size() ? modRoutes[i] : ModMatrix::Route();
+        synth.modSource[i].store(r.source);
+        synth.modDestination[i].store(r.destination);
+        synth.modDepth[i].store(r.depth);
+        synth.modCurve[i].store(r.curve);
+    }
+    synth.unisonVoices.store(unisonVoices);
+    synth.unisonDetuneCents.store(unisonDetune);
+    synth.unisonSpread.store(unisonSpread);
+    synth.reverbLevel.store(reverbLevel);
+    synth.noteWaveform.store(noteWaveform);
+    synth.fmAlgorithm.store(fm.algorithm);
+    for (int k = 0; k < kFmOperators; ++k) {
+        const FmOperator& op = fm.op[k];
+        synth.fmRatio[k].store(op.ratio);
+        synth.fmLevel[k].store(op.level);
+        synth.fmFeedback[k].store(op.feedback);
+        synth.fmAttackSec[k].store(op.envelope.attack);
+        synth.fmDecaySec[k].store(op.envelope.decay);
+        synth.fmSustainLevel[k].store(op.envelope.sustain);
+        synth.fmReleaseSec[k].store(op.envelope.release);
+    }
+
+    const unsigned long total = (unsigned long)(duration * sampleRate + 0.5);
+    out.assign(total * Synth::kChannels, 0.0f);
+
+    // Session time 0 is wherever the synth's timeline is now
+    const uint64_t origin = synth.frameTime();
+
+    std::vector<VoiceHandle> handles(voiceCount, kNoVoice);
+    auto collectReplies = [&]() {
+        SynthReply r;
+        while (synth.replyQ.pop(r)) {
+            if (r.type == SynthReply::VoiceAdded && r.tag >= 0 && r.tag < voiceCount) handles[r.tag] = r.voice;
+        }
+    };
+    collectReplies();
+
+    // The patch with the script's settings over it; the first block takes it
+    if (usePatch) {
+        Patch p = patch;
+        p.params.stealPolicy = stealPolicy;
+        p.params.bandLimited = bandLimited ? 1 : 0;
+        p.params.controlRate = controlRate;
+        p.params.oversampling = oversampling;
+        p.params.filterType = filterType;
+        p.params.filterCutoffHz = filterCutoff;
+        p.params.filterResonance = filterResonance;
+        p.params.lfoTarget = lfoTarget;
+        p.params.filterLfoOctaves = filterLfoOctaves;
+        p.params.lfoWaveform = lfoWaveform[0];
+        for (int k = 1; k < ModMatrix::kLfos; ++k) {
+            p.params.modLfoWaveform[k - 1] = lfoWaveform[k];
+            p.params.modLfoRateHz[k - 1] = modLfoRate[k - 1];
+        }
+        for (int i = 0; i < ModMatrix::kMaxRoutes; ++i) {
+            const ModMatrix::Route r = i < (int)modRoutes.size() ? modRoutes[i] : ModMatrix::Route();
+            p.params.modRoutes[i] = { r.source, r.destination, r.depth, r.curve };
+        }
+        p.params.unisonVoices = unisonVoices;
+        p.params.unisonDetuneCents = unisonDetune;
+        p.params.unisonSpread = unisonSpread;
+        p.params.attackSec = envelope.attack;
+        p.params.decaySec = envelope.decay;
+        p.params.sustainLevel = envelope.sustain;
+        p.params.releaseSec = envelope.release;
+        p.params.envelopeCurve = envelope.curve;
+        p.params.reverbLevel = reverbLevel;
+        p.params.noteWaveform = noteWaveform;
+        p.params.fmAlgorithm = fm.algorithm;
+        for (int k = 0; k < kFmOperators; ++k) {
+            const FmOperator& op = fm.op[k];
+            p.params.fmOperators[k] = { op.ratio, op.level, op.feedback, op.envelope.attack,
+                                        op.envelope.decay, op.envelope.sustain, op.envelope.release };
+        }
+        std::vector<VoiceHandle> patchVoices;
+        synth.submit(synth.prepare(p, 0, &patchVoices));
+        std::copy(patchVoices.begin(), patchVoices.end(), handles.begin());
+    }
+
+    Sampler* sampler = synth.sampler();
+    auto process = [&](float* dst, unsigned long n) {
+        if (sampler) sampler->settle();
+        if (!telemetry) {
+            synth.processBlock(dst, n);
+            return;
+        }
+        TelemetrySample t{};
+        t.startNs = Telemetry::nowNs();
+        t.queueDepth = (uint16_t)synth.cmdQ.size();
+        synth.processBlock(dst, n);
+        t.durationNs = (uint32_t)(Telemetry::nowNs() - t.startNs);
+        t.frames = (uint32_t)n;
+        t.voices = (uint16_t)synth.soundingVoices();
+        telemetry->record(t);
+    };
+    // Frames are interleaved stereo
+    auto processAndCollect = [&](unsigned long at, unsigned long n) {
+        process(out.data() + at * Synth::kChannels, n);
+        collectReplies();
+    };
+
+    size_t next = 0;
+    unsigned long pos = 0;
+    while (pos < total) {
+        const unsigned long end = pos + std::min(blockSize, total - pos);
+
+        // Queue everything due before the end of this block. When the queue
+        // fills, render up to the command that did not fit; that applies
+        // the ones ahead of it.
+        for (; next < events.size(); ++next) {
+            const unsigned long frame = (unsigned long)std::llround(events[next].time * sampleRate);
+            if (frame >= end) break;
+
+            SynthCmd c = events[next].cmd;
+            c.frame = origin + frame;
+
+            const bool voiceCmd = c.type == SynthCmd::RemoveOsc || c.type == SynthCmd::SetOscFreq ||
+                                  c.type == SynthCmd::TriggerOsc || c.type == SynthCmd::ReleaseOsc;
+            if (voiceCmd) {
+                if (c.index >= voiceCount) continue;
+                // Added but not acknowledged yet: run up to this frame, which
+                // applies the add
+                if (handles[c.index] == kNoVoice) {
+                    processAndCollect(pos, frame - pos);
+                    pos = frame;
+                }
+                c.voice = handles[c.index];
+            }
+
+            for (int i = 0; i < events[next].repeat; ++i) {
+                while (!synth.cmdQ.push(c)) {
+                    processAndCollect(pos, frame - pos);
+                    pos = frame;
+                }
+                if (c.type == SynthCmd::AddOsc) ++c.index;
+            }
+        }
+
+        processAndCollect(pos, end - pos);
+        pos = end;
+    }
+    return total;
+}
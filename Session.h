@@ -0,0 +1,132 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <string>
+#include <vector>
+#include <istream>
+#include "Synth.h"
+#include "Telemetry.h"
+
+// Scripted offline session: a list of timed SynthCmds that is played into a
+// Synth block by block, without an audio device.
+//
+// Script format, one statement per line, '#' starts a comment:
+//
+//   samplerate 48000
+//   block 256
+//   duration 4.0
+//   polyphony 1024            # voice pool size (Synth maxVoices)
+//   steal oldest              # oldest | quietest | released
+//   oscillators wavetable     # wavetable (band-limited) | naive
+//   threads 4                 # voice render threads (Synth::setRenderThreads)
+//   controlrate 32            # samples per modulation tick
+//   oversample 4              # voices render at 1, 2, 4 or 8x the sample rate
+//   filter ladder 800 0.5     # off | lowpass | bandpass | highpass (SVF) | ladder, cutoff Hz, resonance 0..1
+//   lfo_target filter 2       # pitch | filter (with octaves of cutoff swing) | none
+//   lfo 2 triangle 0.5        # LFO 1..4: sine | square | triangle | saw, rate Hz (LFOs 2..4)
+//   mod env cutoff 2 squared  # route lfo1..lfo4 | env | velocity to pitch (semitones) |
+//                             # cutoff (octaves) | amp | pan, depth, linear | squared | root
+//   unison 7 25 0.8           # lanes per voice 1..16, detune cents, stereo spread 0..1
+//   envelope 0.05 0.05 0.8 0.1 linear   # attack decay sustain release, linear | exponential
+//   notes fm                  # what notes play: saw | square | sine | fm
+//   fm 4                      # FM algorithm 0..7 (see Fm.h)
+//   operator 1 2 0.5 0.3 0.01 0.4 0.2 0.2   # FM operator 0..3: ratio, level, feedback [, ADSR]
+//   at 0.0 pitch 440          # masterPitchHz
+//   at 0.0 lfo_rate 2         # lfoRateHz
+//   at 0.0 lfo_depth 5        # lfoDepthHz
+//   at 0.0 cutoff 1200        # filterCutoffHz
+//   at 0.0 resonance 0.7      # filterResonance
+//   at 0.0 unison 5           # unisonVoices, for voices started from then on
+//   at 0.0 detune 30          # unisonDetuneCents
+//   at 0.0 spread 1           # unisonSpread
+//   at 0.0 add 15             # AddOsc x15
+//   at 1.0 freq 0 880         # SetOscFreq voice value
+//   at 2.0 remove 3           # RemoveOsc voice
+//   at 2.5 release 1          # ReleaseOsc voice (note off)
+//   at 3.0 trigger 1          # TriggerOsc voice (retrigger)
+//   at 3.0 note 60 0.8        # NoteOn MIDI note, velocity 0..1 (default 1)
+//   at 3.5 noteoff 60         # NoteOff MIDI note
+//   midi song.mid             # note on/off from a MIDI file, all channels
+//   patch lead.mspt           # settings and voices from a patch file
+//   sample piano_c4.wav 60 0 64   # notes play samples: file, root note, note range
+//   reverb hall.wav 0.3       # master bus convolution reverb: impulse response, level
+//
+// Timed statements are stamped with their sample frame and take effect at
+// exactly that frame, whatever the block size. The Synth starts with one
+// voice sounding; 'at 0 release 0' silences it for note-driven sessions.
+//
+// Voices are numbered once and never renumbered: 0 is the Synth's initial
+// voice, then each voice from an 'add' statement in script order. The
+// numbers are mapped to VoiceHandles from the Synth's VoiceAdded replies.
+//
+// With 'sample' statements notes play the files (Sampler zones) instead of
+// saws; the caller maps them (see samples) and hands the Sampler to the
+// Synth. Blocks then wait for the sampler's prefetch, so a render never
+// plays a frame the stream did not deliver.
+//
+// A 'reverb' statement loads its impulse response into a Convolver the
+// caller hands to the Synth (see reverbPath); the tail is computed inline,
+// so the render is the same on any machine.
+//
+// A 'patch' statement comes before any 'add'. Its settings are where the
+// script starts from, and statements after it override them; its voices
+// replace the initial one and are numbered from 0 in patch order. The
+// synth switches to it before the first frame.
+class Session {
+public:
+    struct Event {
+        double time;
+        int repeat;
+        SynthCmd cmd;
+    };
+
+    // A 'sample' statement, for Sampler::addZone()
+    struct SampleFile {
+        std::string path;
+        int root, low, high;
+    };
+
+    bool parse(std::istream& in, std::string& error);
+    bool load(const std::string& path, std::string& error);
+
+    // Renders the whole session into out, interleaved stereo. Returns
+    // frames rendered.
+    // Each processBlock call is timed into telemetry when given.
+    unsigned long render(Synth& synth, std::vector<float>& out, Telemetry* telemetry = nullptr) const;
+
+    float sampleRate = 48000.0f;
+    unsigned long blockSize = 256;
+    int maxVoices = Synth::kDefaultMaxVoices;
+    VoiceBank::StealPolicy stealPolicy = VoiceBank::StealReleasedFirst;
+    bool bandLimited = true;
+    int renderThreads = 1;
+    int controlRate = 32;
+    int oversampling = 1;
+    VoiceFilter::Type filterType = VoiceFilter::OFF;
+    float filterCutoff = 2000.0f;
+    float filterResonance = 0.2f;
+    LFO::Parameter lfoTarget = LFO::PITCH;
+    float filterLfoOctaves = 1.0f;
+    LFO::Waveform lfoWaveform[ModMatrix::kLfos] = { LFO::SINE, LFO::TRIANGLE, LFO::SINE, LFO::SQUARE };
+    float modLfoRate[ModMatrix::kLfos - 1] = { 0.5f, 1.0f, 6.0f };
+    std::vector<ModMatrix::Route> modRoutes;  // up to ModMatrix::kMaxRoutes
+    int unisonVoices = 1;
+    float unisonDetune = 20.0f;
+    float unisonSpread = 0.5f;
+    Envelope::Params envelope;
+    Oscillator::Waveform noteWaveform = Oscillator::SAW;
+    FmParams fm;         // operator envelopes take envelope.curve
+    double duration = 1.0;
+    std::vector<Event> events;
+    int voiceCount = 1;  // numbered voices: the initial one plus every add
+    bool usePatch = false;
+    Patch patch;         // settings other than the ones above, and voices
+    std::vector<SampleFile> samples;
+    std::string reverbPath;  // empty for no reverb
+    float reverbLevel = 0.3f;
+
+private:
+    bool loadMidi(const std::string& path, std::string& error);
+};
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Thin wrapper over GCC/Clang vector extensions. Kernels are written once
+// against Vec<N> and instantiated per instruction set: N = 4 maps to SSE2
+// (or NEON on arm64), N = 8 to AVX2 when the TU is built with -mavx2.
+//
+// Everything in here has internal linkage on purpose. The same templates are
+// compiled with different -m flags in different TUs, and the linker must not
+// fold an AVX2 instantiation into the baseline path.
+namespace simd {
+namespace {
+
+template <int N>
+struct Vec {
+    typedef float   f __attribute__((vector_size(N * 4)));
+    typedef int32_t i __attribute__((vector_size(N * 4)));
+};
+
+template <int N>
+inline typename Vec<N>::f load(const float* p) {
+    typename Vec<N>::f v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+template <int N>
+inline typename Vec<N>::i loadi(const int32_t* p) {
+    typename Vec<N>::i v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+template <int N>
+inline void store(float* p, typename Vec<N>::f v) { std::memcpy(p, &v, sizeof(v)); }
+
+template <int N>
+inline void storei(int32_t* p, typename Vec<N>::i v) { std::memcpy(p, &v, sizeof(v)); }
+
+template <int N>
+inline typename Vec<N>::f splat(float x) { return typename Vec<N>::f{} + x; }
+
+template <int N>
+inline typename Vec<N>::i splati(int32_t x) { return typename Vec<N>::i{} + x; }
+
+// mask lanes are all-ones (true) or zero (false), as produced by comparisons
+template <int N>
+inline typename Vec<N>::f select(typename Vec<N>::i mask, typename Vec<N>::f a, typename Vec<N>::f b) {
+    return mask ? a : b;
+}
+
+template <int N>
+inline typename Vec<N>::i selecti(typename Vec<N>::i mask, typename Vec<N>::i a, typename Vec<N>::i b) {
+    return mask ? a : b;
+}
+
+// out[k] = base[idx[k]]; hardware gather where the TU has AVX2
+template <int N>
+inline typename Vec<N>::f gather(const float* base, typename Vec<N>::i idx) {
+    typename Vec<N>::f r;
+#if defined(__AVX2__)
+    if constexpr (N == 8) {
+        __m256i i;
+        std::memcpy(&i, &idx, sizeof(i));
+        const __m256 g = _mm256_i32gather_ps(base, i, 4);
+        std::memcpy(&r, &g, sizeof(r));
+        return r;
+    }
+#endif
+    for (int k = 0; k < N; ++k) r[k] = base[idx[k]];
+    return r;
+}
+
+template <int N>
+inline typename Vec<N>::f vmin(typename Vec<N>::f a, typename Vec<N>::f b) { return select<N>(a < b, a, b); }
+
+template <int N>
+inline typename Vec<N>::f vmax(typename Vec<N>::f a, typename Vec<N>::f b) { return select<N>(a > b, a, b); }
+
+template <int N>
+inline typename Vec<N>::f vabs(typename Vec<N>::f a) {
+    typedef typename Vec<N>::i I;
+    return (typename Vec<N>::f)((I)a & splati<N>(0x7fffffff));
+}
+
+// Round to nearest via int conversion; |x| must stay well inside int range
+template <int N>
+inline typename Vec<N>::f vround(typename Vec<N>::f x) {
+    typedef typename Vec<N>::i I;
+    typedef typename Vec<N>::f F;
+    const F half = select<N>(x < 0.0f, splat<N>(-0.5f), splat<N>(0.5f));
+    return __builtin_convertvector(__builtin_convertvector(x + half, I), F);
+}
+
+template <int N>
+inline typename Vec<N>::f vfloor(typename Vec<N>::f x) {
+    typedef typename Vec<N>::i I;
+    typedef typename Vec<N>::f F;
+    const F t = __builtin_convertvector(__builtin_convertvector(x, I), F);
+    return t - select<N>(t > x, splat<N>(1.0f), splat<N>(0.0f));
+}
+
+template <int N>
+inline bool any(typename Vec<N>::i mask) {
+    int32_t r = 0;
+    for (int k = 0; k < N; ++k) r |= mask[k];
+    return r != 0;
+}
+
+template <int N>
+inline float hsum(typename Vec<N>::f v) {
+    float s = 0.0f;
+    for (int k = 0; k < N; ++k) s += v[k];
+    return s;
+}
+
+template <int N>
+inline int32_t hmini(typename Vec<N>::i v) {
+    int32_t m = v[0];
+    for (int k = 1; k < N; ++k) m = v[k] < m ? v[k] : m;
+    return m;
+}
+
+} // namespace
+} // namespace simd
+
+#endif
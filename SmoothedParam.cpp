@@ -0,0 +1,42 @@
+#include "SmoothedParam.h"
+#include <algorithm>
+#include <cmath>
+
+SmoothedParam::SmoothedParam(Mode m)
+    : mode(m)
+{}
+
+void SmoothedParam::setRampTicks(int ticks) {
+    rampTicks = std::max(1, ticks);
+
+    // One-pole reaching ~99% of the way (-40 dB) in rampTicks
+    coeff = 1.0f - std::pow(0.01f, 1.0f / rampTicks);
+}
+
+void SmoothedParam::reset(float v) {
+    current = target = v;
+    remaining = 0;
+}
+
+void SmoothedParam::setTarget(float v) {
+    if (v == target) return;
+    target = v;
+    remaining = rampTicks;
+    step = (target - current) / rampTicks;
+}
+
+float SmoothedParam::next() {
+    if (remaining == 0) return current;
+
+    if (mode == Linear) {
+        current = (--remaining == 0) ? target : current + step;
+    } else {
+        // Runs until the gap is below float resolution, not for rampTicks
+        current += coeff * (target - current);
+        if (std::fabs(target - current) <= 1e-6f * std::max(1.0f, std::fabs(target))) {
+            current = target;
+            remaining = 0;
+        }
+    }
+    return current;
+}
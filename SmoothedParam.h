@@ -0,0 +1,32 @@
+#ifndef SMOOTHEDPARAM_H
+#define SMOOTHEDPARAM_H
+
+// A control value that glides to new targets instead of jumping, advanced
+// once per control tick. Linear ramps reach the target in a fixed number of
+// ticks; one-pole ramps close a fixed fraction of the gap per tick.
+class SmoothedParam {
+public:
+    enum Mode { Linear, OnePole };
+
+    explicit SmoothedParam(Mode mode = Linear);
+
+    // Glide time expressed in control ticks (>= 1)
+    void setRampTicks(int ticks);
+
+    void reset(float v);
+    void setTarget(float v);
+
+    float next();
+    float value() const { return current; }
+
+private:
+    Mode mode;
+    int rampTicks = 1;
+    int remaining = 0;
+    float current = 0.0f;
+    float target  = 0.0f;
+    float step    = 0.0f;
+    float coeff   = 1.0f;
+};
+
+#endif
@@ -1,68 +1,639 @@
 #include "Synth.h"
+#include "Convolver.h"
+#include "FastMath.h"
+#include "Governor.h"
+#include "RenderPool.h"
+#include "Telemetry.h"
 #include <algorithm>
+#include <cmath>
 
-Synth::Synth() {
-    oscillators_.emplace_back();
-    oscillators_[0].setSampleRate(sampleRate_);
-    oscillators_[0].setWaveform(Oscillator::SAW);
-    oscillators_[0].noteOn(masterPitchHz.load());
+Synth::Synth(int maxVoices)
+    : tables_(Wavetables::get()),
+      maxVoices_(std::clamp(maxVoices, 0, 1 << VoiceBank::kSlotBits)),
+      voices_(std::make_unique<VoiceBank>())
+{
+    kernelName_ = voices_->kernel().name;
+    voices_->setCapacity(maxVoices_);
+    voices_->setSampleRate(sampleRate_);
+    reply(SynthReply::VoiceAdded, 0, voices_->add(Oscillator::SAW, masterPitchHz.load()));
 
-    // Use LFO module
-    lfo_.setSampleRate(sampleRate_);
-    lfo_.setWaveform(LFO::SINE);
-    lfo_.setFrequency(lfoRateHz.load());
+    for (LFO& l : lfos_) l.setSampleRate(sampleRate_);
+    lfos_[0].setFrequency(lfoRateHz.load());
+
+    pitch_.reset(guiPitch_ = masterPitchHz.load());
+    lfoRate_.reset(guiLfoRate_ = lfoRateHz.load());
+    lfoDepth_.reset(guiLfoDepth_ = lfoDepthHz.load());
+    cutoff_.reset(guiCutoff_ = filterCutoffHz.load());
+    resonance_.reset(guiResonance_ = filterResonance.load());
+    lfos_[0].setParameter((LFO::Parameter)lfoTarget.load());
+    applyModulation();
+    for (int k = 0; k < VoiceFilter::kCoefs; ++k) filterFrames_[k] = filterCoef_[k];
+    curInc_ = tickInc_ = masterPitchHz.load() / sampleRate_;
+    setControlRate(controlRate.load());
+}
+
+Synth::~Synth() {
+    delete pendingState_.exchange(nullptr);
+    reclaim();
 }
 
 void Synth::setSampleRate(float sr) {
     sampleRate_ = std::max(1.0f, sr);
-    for (auto& o : oscillators_) o.setSampleRate(sampleRate_);
+    voices_->setSampleRate(sampleRate_ * oversampler_[0].factor());
+
+    for (LFO& l : lfos_) l.setSampleRate(sampleRate_);
+
+    curInc_ = tickInc_ = pitch_.value() / sampleRate_;
+    tickLeft_ = 0;
+    setControlRate(controlRate_);
+}
+
+void Synth::setControlRate(int samples) {
+    controlRate_ = std::clamp(samples, 1, kMaxControlRate);
+    const int ticks = (int)std::ceil(kSmoothingSeconds * sampleRate_ / controlRate_);
+    pitch_.setRampTicks(ticks);
+    lfoRate_.setRampTicks(ticks);
+    lfoDepth_.setRampTicks(ticks);
+    cutoff_.setRampTicks(ticks);
+    resonance_.setRampTicks(ticks);
+}
 
-    // Keep LFO in sync
-    lfo_.setSampleRate(sampleRate_);
+// Running envelope segments finish at the old rate; the decimators start
+// from silence, so switch while quiet to avoid a click
+void Synth::setOversampling(int factor) {
+    for (auto& o : oversampler_) o.setFactor(factor);
+    voices_->setSampleRate(sampleRate_ * oversampler_[0].factor());
 }
 
-void Synth::applyGuiCommands() {
-    SynthCmd c;
-    while (cmdQ.pop(c)) {
-        if (c.type == SynthCmd::AddOsc) {
-            Oscillator o;
-            o.setSampleRate(sampleRate_);
-            o.setWaveform(Oscillator::SAW);
-            o.noteOn(masterPitchHz.load());
-            oscillators_.push_back(o);
+// Once per control tick: advance the smoothed parameters and the LFOs,
+// evaluate the modulation matrix's LFO routes, and work out the increment
+// the voices should reach by the end of the tick.
+// Per sample only the linear ramp towards it remains, run a tick at a time
+// so the loop has no tick or filter checks in it.
+void Synth::fillPhaseIncrements(unsigned long n) {
+    const bool filtered = voices_->filterType() != VoiceFilter::OFF;
+    for (unsigned long i = 0; i < n;) {
+        if (tickLeft_ == 0) {
+            lfos_[0].setFrequency(lfoRate_.next());
+            for (int k = 0; k < ModMatrix::kLfos; ++k) lfoValues_[k] = lfos_[k].advance(controlRate_);
+            matrix_.evaluate(lfoValues_);
+
+            const float lfo = lfoValues_[0];
+            const float depth = lfoDepth_.next(); // Hz
+            const bool toPitch = lfos_[0].getParameter() == LFO::PITCH;
+            tickInc_ = std::max(1.0f, pitch_.next() + (toPitch ? lfo * depth : 0.0f)) / sampleRate_;
+            const float semitones = matrix_.global(ModMatrix::PITCH);
+            if (semitones != 0.0f) tickInc_ *= simd::exp2(semitones / 12.0f);
+            tickStep_ = (tickInc_ - curInc_) / controlRate_;
+            tickLeft_ = controlRate_;
+            if (filtered) tickFilter(lfo);
         }
-        else if (c.type == SynthCmd::RemoveOsc) {
-            if (c.index >= 0 && c.index < (int)oscillators_.size()) {
-                oscillators_.erase(oscillators_.begin() + c.index);
-            }
+
+        const unsigned long start = i;
+        const unsigned long end = i + std::min((unsigned long)tickLeft_, n - i);
+        tickLeft_ -= (int)(end - i);
+
+        // The tick's last sample lands exactly on its target
+        const unsigned long ramp = tickLeft_ == 0 ? end - 1 : end;
+        for (; i < ramp; ++i) phaseInc_[i] = curInc_ += tickStep_;
+        if (i < end) phaseInc_[i++] = curInc_ = tickInc_;
+
+        if (filtered) {
+            for (int k = 0; k < VoiceFilter::kCoefs; ++k) std::fill(filterCoef_[k] + start, filterCoef_[k] + end, tickCoef_[k]);
         }
-        else if (c.type == SynthCmd::SetOscFreq) {
-            if (c.index >= 0 && c.index < (int)oscillators_.size()) {
-                oscillators_[c.index].setFrequency(c.value);
+    }
+}
+
+// Filter coefficients for the coming tick, at the rate the voices run at
+void Synth::tickFilter(float lfo) {
+    float cutoff = cutoff_.next();
+    const float resonance = resonance_.next();
+    if (lfos_[0].getParameter() == LFO::FILTER) cutoff *= simd::exp2(lfo * filterLfoOctaves_);
+    const float octaves = matrix_.global(ModMatrix::CUTOFF);
+    if (octaves != 0.0f) cutoff *= simd::exp2(octaves);
+    VoiceFilter::coefficients(voices_->filterType(), cutoff, resonance,
+                              sampleRate_ * oversampler_[0].factor(), tickCoef_);
+}
+
+void Synth::applyGuiSettings() {
+    voices_->setStealPolicy((VoiceBank::StealPolicy)stealPolicy.load(std::memory_order_relaxed));
+    const bool naive = governed_ & Governor::NaiveOscillators;
+    voices_->setWavetables(bandLimited.load(std::memory_order_relaxed) && !naive ? &tables_ : nullptr);
+
+    Envelope::Params env;
+    env.attack  = std::max(0.0f, attackSec.load(std::memory_order_relaxed));
+    env.decay   = std::max(0.0f, decaySec.load(std::memory_order_relaxed));
+    env.sustain = std::clamp(sustainLevel.load(std::memory_order_relaxed), 0.0f, 1.0f);
+    env.release = std::max(0.0f, releaseSec.load(std::memory_order_relaxed));
+    env.curve   = (Envelope::Curve)envelopeCurve.load(std::memory_order_relaxed);
+    voices_->setEnvelope(env);
+
+    FmParams fm;
+    fm.algorithm = fmAlgorithm.load(std::memory_order_relaxed);
+    for (int k = 0; k < kFmOperators; ++k) {
+        FmOperator& op = fm.op[k];
+        op.ratio = fmRatio[k].load(std::memory_order_relaxed);
+        op.level = fmLevel[k].load(std::memory_order_relaxed);
+        op.feedback = fmFeedback[k].load(std::memory_order_relaxed);
+        op.envelope.attack  = std::max(0.0f, fmAttackSec[k].load(std::memory_order_relaxed));
+        op.envelope.decay   = std::max(0.0f, fmDecaySec[k].load(std::memory_order_relaxed));
+        op.envelope.sustain = std::clamp(fmSustainLevel[k].load(std::memory_order_relaxed), 0.0f, 1.0f);
+        op.envelope.release = std::max(0.0f, fmReleaseSec[k].load(std::memory_order_relaxed));
+        op.envelope.curve   = env.curve;
+    }
+    voices_->setFm(fm);
+
+    int rate = std::clamp(controlRate.load(std::memory_order_relaxed), 1, kMaxControlRate);
+    if (governed_ & Governor::SlowControl) rate = std::min(rate * Governor::kControlRateFactor, kMaxControlRate);
+    if (rate != controlRate_) setControlRate(rate);
+
+    int os = oversampling.load(std::memory_order_relaxed);
+    if (governed_ & Governor::NoOversampling) os = 1;
+    if (os != guiOversampling_) setOversampling(guiOversampling_ = os);
+
+    applyUnison();
+    reverbTarget_ = std::max(0.0f, reverbLevel.load(std::memory_order_relaxed));
+
+    const VoiceFilter::Type filter = (VoiceFilter::Type)filterType.load(std::memory_order_relaxed);
+    if (filter != voices_->filterType()) {
+        voices_->setFilterType(filter);
+        if (filter != VoiceFilter::OFF) tickFilter(lfoValues_[0]);  // until the next tick
+    }
+    lfos_[0].setParameter((LFO::Parameter)lfoTarget.load(std::memory_order_relaxed));
+    filterLfoOctaves_ = filterLfoOctaves.load(std::memory_order_relaxed);
+    applyModulation();
+
+    const float pitch = masterPitchHz.load(std::memory_order_relaxed);
+    const float lfoRate = lfoRateHz.load(std::memory_order_relaxed);
+    const float lfoDepth = lfoDepthHz.load(std::memory_order_relaxed);
+    if (pitch != guiPitch_)       pitch_.setTarget(guiPitch_ = pitch);
+    if (lfoRate != guiLfoRate_)   lfoRate_.setTarget(guiLfoRate_ = lfoRate);
+    if (lfoDepth != guiLfoDepth_) lfoDepth_.setTarget(guiLfoDepth_ = lfoDepth);
+
+    const float cutoff = filterCutoffHz.load(std::memory_order_relaxed);
+    const float resonance = filterResonance.load(std::memory_order_relaxed);
+    if (cutoff != guiCutoff_)       cutoff_.setTarget(guiCutoff_ = cutoff);
+    if (resonance != guiResonance_) resonance_.setTarget(guiResonance_ = resonance);
+}
+
+// LFO shapes and rates, and the routes. Rebuilding the matrix is a pass
+// over kMaxRoutes slots, cheap enough to do every block.
+void Synth::applyModulation() {
+    lfos_[0].setWaveform((LFO::Waveform)lfoWaveform.load(std::memory_order_relaxed));
+    for (int k = 1; k < ModMatrix::kLfos; ++k) {
+        lfos_[k].setWaveform((LFO::Waveform)modLfoWaveform[k - 1].load(std::memory_order_relaxed));
+        lfos_[k].setFrequency(modLfoRateHz[k - 1].load(std::memory_order_relaxed));
+    }
+
+    ModMatrix::Route routes[ModMatrix::kMaxRoutes];
+    for (int i = 0; i < ModMatrix::kMaxRoutes; ++i) {
+        routes[i].source = modSource[i].load(std::memory_order_relaxed);
+        routes[i].destination = modDestination[i].load(std::memory_order_relaxed);
+        routes[i].depth = modDepth[i].load(std::memory_order_relaxed);
+        routes[i].curve = modCurve[i].load(std::memory_order_relaxed);
+    }
+    matrix_.setRoutes(routes, ModMatrix::kMaxRoutes);
+    matrix_.evaluate(lfoValues_);
+}
+
+void Synth::applyUnison() {
+    voices_->setUnison(unisonVoices.load(std::memory_order_relaxed),
+                      unisonDetuneCents.load(std::memory_order_relaxed),
+                      unisonSpread.load(std::memory_order_relaxed));
+}
+
+// Parameter changes from the command queue also show up in the GUI atomics
+void Synth::setParam(int param, float value) {
+    switch (param) {
+        case SynthCmd::MasterPitch:
+            masterPitchHz.store(guiPitch_ = value, std::memory_order_relaxed);
+            pitch_.setTarget(value);
+            break;
+        case SynthCmd::LfoRate:
+            lfoRateHz.store(guiLfoRate_ = value, std::memory_order_relaxed);
+            lfoRate_.setTarget(value);
+            break;
+        case SynthCmd::LfoDepth:
+            lfoDepthHz.store(guiLfoDepth_ = value, std::memory_order_relaxed);
+            lfoDepth_.setTarget(value);
+            break;
+        case SynthCmd::FilterCutoff:
+            filterCutoffHz.store(guiCutoff_ = value, std::memory_order_relaxed);
+            cutoff_.setTarget(value);
+            break;
+        case SynthCmd::FilterResonance:
+            filterResonance.store(guiResonance_ = value, std::memory_order_relaxed);
+            resonance_.setTarget(value);
+            break;
+        case SynthCmd::UnisonVoices:
+            unisonVoices.store((int)std::lround(value), std::memory_order_relaxed);
+            applyUnison();
+            break;
+        case SynthCmd::UnisonDetune:
+            unisonDetuneCents.store(value, std::memory_order_relaxed);
+            applyUnison();
+            break;
+        case SynthCmd::UnisonSpread:
+            unisonSpread.store(value, std::memory_order_relaxed);
+            applyUnison();
+            break;
+    }
+}
+
+// Replies are best effort: with the GUI not draining, they are dropped
+// rather than blocking the audio thread
+void Synth::reply(SynthReply::Type type, int tag, VoiceHandle v) {
+    replyQ.push(SynthReply{ type, tag, v });
+}
+
+void Synth::applyCommand(const SynthCmd& c) {
+    switch (c.type) {
+        case SynthCmd::AddOsc: {
+            const VoiceHandle v = voices_->add(Oscillator::SAW, masterPitchHz.load());
+            for (VoiceHandle s : voices_->stolen()) reply(SynthReply::VoiceEnded, 0, s);
+            reply(SynthReply::VoiceAdded, c.index, v);
+            break;
+        }
+        case SynthCmd::RemoveOsc:
+            if (voices_->remove(c.voice)) reply(SynthReply::VoiceEnded, 0, c.voice);
+            break;
+        case SynthCmd::SetOscFreq: voices_->setFrequency(c.voice, c.value); break;
+        case SynthCmd::TriggerOsc: voices_->noteOn(c.voice); break;
+        case SynthCmd::ReleaseOsc: voices_->noteOff(c.voice); break;
+        case SynthCmd::NoteOn:
+            voices_->playNote(sampler_ ? Oscillator::SAMPLE
+                                       : (Oscillator::Waveform)std::clamp(noteWaveform.load(std::memory_order_relaxed),
+                                                                          0, (int)Oscillator::FM),
+                              c.index, c.value);
+            for (VoiceHandle s : voices_->stolen()) reply(SynthReply::VoiceEnded, 0, s);
+            break;
+        case SynthCmd::NoteOff:    voices_->releaseNote(c.index); break;
+        case SynthCmd::SetParam:   setParam(c.index, c.value); break;
+    }
+}
+
+// Moves queued commands into scheduled_, keeping it sorted by frame.
+// Each producer's commands arrive in order, so the insertion usually stops
+// at once; equal frames keep their arrival order.
+void Synth::collectCommands() {
+    if (schedBegin_ == schedEnd_) {
+        schedBegin_ = schedEnd_ = 0;
+    } else if (schedBegin_ > 0 && schedEnd_ == kCmdQueueSize) {
+        std::copy(scheduled_ + schedBegin_, scheduled_ + schedEnd_, scheduled_);
+        schedEnd_ -= schedBegin_;
+        schedBegin_ = 0;
+    }
+
+    const size_t first = schedEnd_;
+    schedEnd_ += cmdQ.popBatch(scheduled_ + schedEnd_, kCmdQueueSize - schedEnd_);
+    for (size_t i = first; i < schedEnd_; ++i) {
+        const SynthCmd c = scheduled_[i];
+        size_t j = i;
+        for (; j > schedBegin_ && scheduled_[j - 1].frame > c.frame; --j) scheduled_[j] = scheduled_[j - 1];
+        scheduled_[j] = c;
+    }
+}
+
+// Next command due at or before `now`
+bool Synth::popDue(SynthCmd& c, uint64_t now) {
+    if (schedBegin_ == schedEnd_ || scheduled_[schedBegin_].frame > now) return false;
+    c = scheduled_[schedBegin_++];
+    return true;
+}
+
+// Per-lane modulation holds for a VoiceBank::render() call, so with
+// per-lane routes the calls are kept to kModFrames
+void Synth::renderSpan(float* out, unsigned long nFrames) {
+    const int os = oversampler_[0].factor();
+    const ModMatrix* mod = matrix_.perLane() ? &matrix_ : nullptr;
+    const unsigned long chunk = mod ? std::min(kModFrames, kRenderChunk / os) : kRenderChunk / os;
+    for (unsigned long pos = 0; pos < nFrames; pos += chunk) {
+        const unsigned long n = std::min(chunk, nFrames - pos);
+
+        fillPhaseIncrements(n);
+        const float* const* filter = voices_->filterType() != VoiceFilter::OFF ? filterFrames_ : nullptr;
+        if (os == 1) {
+            for (auto& m : mix_) std::fill(m, m + n, 0.0f);
+            voices_->render(mix_[0], mix_[1], phaseInc_, n, filter, mod);
+        } else {
+            // Hold each increment for os voice samples (in place, back to
+            // front), and the filter coefficients with them
+            for (unsigned long i = n; i-- > 0;) {
+                const float inc = phaseInc_[i] / os;
+                for (int j = 0; j < os; ++j) phaseInc_[i * os + j] = inc;
             }
+            if (filter) {
+                for (auto& c : filterCoef_) {
+                    for (unsigned long i = n; i-- > 0;) {
+                        const float v = c[i];
+                        std::fill(c + i * os, c + i * os + os, v);
+                    }
+                }
+            }
+            for (auto& b : osBuf_) std::fill(b, b + n * os, 0.0f);
+            voices_->render(osBuf_[0], osBuf_[1], phaseInc_, n * os, filter, mod);
+            for (int ch = 0; ch < kChannels; ++ch) oversampler_[ch].process(osBuf_[ch], mix_[ch], n);
+        }
+
+        if (reverb_) applyReverb(n);
+
+        float* dst = out + pos * kChannels;
+        for (unsigned long i = 0; i < n; ++i) {
+            dst[i * kChannels]     = mix_[0][i];
+            dst[i * kChannels + 1] = mix_[1][i];
         }
     }
 }
 
+// The master bus. The level ramps linearly to its target over the span.
+void Synth::applyReverb(unsigned long n) {
+    reverb_->process(mix_[0], mix_[1], wet_[0], wet_[1], n);
+    const float step = (reverbTarget_ - reverbGain_) / n;
+    for (unsigned long i = 0; i < n; ++i) {
+        reverbGain_ += step;
+        mix_[0][i] += reverbGain_ * wet_[0][i];
+        mix_[1][i] += reverbGain_ * wet_[1][i];
+    }
+    reverbGain_ = reverbTarget_;
+}
+
+// Asks the governor about the block ahead: the lanes sounding plus those
+// its note and voice starts will add. Its steps take effect in
+// applyGuiSettings(); the released voices it wants gone go now.
+void Synth::govern(uint64_t start, unsigned long nFrames) {
+    int lanes = voices_->sounding();
+    for (size_t i = schedBegin_; i < schedEnd_ && scheduled_[i].frame < start + nFrames; ++i) {
+        const SynthCmd::Type t = scheduled_[i].type;
+        if (t == SynthCmd::NoteOn || t == SynthCmd::AddOsc) lanes += voices_->unison();
+    }
+    const Governor::Decision d = governor_->plan(start, nFrames, std::min(lanes, voices_->capacity()));
+    governed_ = d.steps;
+    governorDropped_ = 0;
+    if (d.dropLanes > 0) {
+        governorDropped_ = voices_->dropReleased(d.dropLanes);
+        for (VoiceHandle v : voices_->dropped()) reply(SynthReply::VoiceEnded, 0, v);
+    }
+}
+
 void Synth::processBlock(float* out, unsigned long nFrames) {
-    applyGuiCommands();
+    DenormalGuard denormals;
+    const uint64_t began = governor_ ? Telemetry::nowNs() : 0;
+    adoptState();
+    const uint64_t start = frames_.load(std::memory_order_relaxed);
+    collectCommands();
+    if (governor_) govern(start, nFrames);
+    applyGuiSettings();
 
-    const float pitch    = masterPitchHz.load(std::memory_order_relaxed);
-    const float lfoRate  = lfoRateHz.load(std::memory_order_relaxed);
-    const float lfoDepth = lfoDepthHz.load(std::memory_order_relaxed);
+    // Apply what is due, render up to the next command's frame, repeat.
+    // The control-rate state carries across the splits, so only the
+    // commands themselves land mid-block.
+    unsigned long pos = 0;
+    for (;;) {
+        SynthCmd c;
+        while (popDue(c, start + pos)) applyCommand(c);
+        if (pos == nFrames) break;
 
-    // Drive the LFO module from GUI
-    lfo_.setFrequency(lfoRate);
+        unsigned long end = nFrames;
+        if (schedBegin_ < schedEnd_ && scheduled_[schedBegin_].frame - start < end)
+            end = (unsigned long)(scheduled_[schedBegin_].frame - start);
 
-    for (unsigned long i = 0; i < nFrames; ++i) {
-        // LFO output is [-1, 1]
-        const float lfo = lfo_.computeSample() * lfoDepth; // depth in Hz
-        float sample = 0.0f;
+        renderSpan(out + pos * kChannels, end - pos);
+        pos = end;
+    }
 
-        for (auto& osc : oscillators_) {
-            sample += osc.processSample(pitch + lfo);
-        }
+    frames_.store(start + nFrames, std::memory_order_release);
+    if (governor_) governor_->measured(Telemetry::nowNs() - began, voices_->sounding(), governorDropped_);
+}
 
-        out[i] = sample;
+void Synth::setRenderThreads(int threads) {
+    voices_->setRenderPool(nullptr);
+    pool_.reset();
+    if (threads > 1) {
+        pool_ = std::make_unique<RenderPool>(threads - 1);
+        voices_->setRenderPool(pool_.get());
     }
 }
+
+int Synth::renderThreads() const {
+    return pool_ ? pool_->workers() + 1 : 1;
+}
+
+void Synth::setSampler(Sampler* sampler) {
+    sampler_ = sampler;
+    voices_->setSampler(sampler);
+}
+
+void Synth::setReverb(Convolver* reverb) {
+    reverb_ = reverb;
+    reverbGain_ = reverbTarget_ = std::max(0.0f, reverbLevel.load());
+}
+
+void Synth::setGovernor(Governor* governor) {
+    governor_ = governor;
+    governed_ = 0;
+}
+
+bool Synth::setVoiceKernel(const char* name) {
+    if (!voices_->setKernel(name)) return false;
+    kernelName_ = voices_->kernel().name;
+    return true;
+}
+
+std::unique_ptr<Synth::EngineState> Synth::prepare(const Patch& patch, int tag,
+                                                   std::vector<VoiceHandle>* handles) const {
+    auto state = std::make_unique<EngineState>();
+    state->tag = tag;
+    PatchParams& p = state->params = patch.params;
+    p.controlRate = std::clamp((int)p.controlRate, 1, kMaxControlRate);
+    p.unisonVoices = std::clamp((int)p.unisonVoices, 1, VoiceBank::kMaxUnison);
+    p.oversampling = p.oversampling >= 8 ? 8 : p.oversampling >= 4 ? 4 : p.oversampling >= 2 ? 2 : 1;
+
+    Envelope::Params env;
+    env.attack  = std::max(0.0f, p.attackSec);
+    env.decay   = std::max(0.0f, p.decaySec);
+    env.sustain = std::clamp(p.sustainLevel, 0.0f, 1.0f);
+    env.release = std::max(0.0f, p.releaseSec);
+    env.curve   = (Envelope::Curve)p.envelopeCurve;
+
+    state->voices = std::make_unique<VoiceBank>();
+    VoiceBank& bank = *state->voices;
+    bank.setCapacity(maxVoices_);
+    bank.setKernel(kernelName_);
+    bank.setRenderPool(pool_.get());
+    bank.setSampleRate(sampleRate_ * p.oversampling);
+    bank.setWavetables(p.bandLimited ? &tables_ : nullptr);
+    bank.setSampler(sampler_);
+    bank.setEnvelope(env);
+
+    FmParams fm;
+    fm.algorithm = p.fmAlgorithm;
+    for (int k = 0; k < kFmOperators; ++k) {
+        const PatchFmOperator& o = p.fmOperators[k];
+        FmOperator& op = fm.op[k];
+        op.ratio = o.ratio;
+        op.level = o.level;
+        op.feedback = o.feedback;
+        op.envelope.attack  = std::max(0.0f, o.attackSec);
+        op.envelope.decay   = std::max(0.0f, o.decaySec);
+        op.envelope.sustain = std::clamp(o.sustainLevel, 0.0f, 1.0f);
+        op.envelope.release = std::max(0.0f, o.releaseSec);
+        op.envelope.curve   = env.curve;
+    }
+    bank.setFm(fm);
+    bank.setStealPolicy((VoiceBank::StealPolicy)p.stealPolicy);
+    bank.setFilterType((VoiceFilter::Type)p.filterType);
+    bank.setUnison(p.unisonVoices, p.unisonDetuneCents, p.unisonSpread);
+
+    // Voices past the pool's capacity are dropped rather than stealing
+    // the patch's own
+    if (handles) handles->clear();
+    for (const PatchVoice& v : patch.voices) {
+        if (bank.size() + bank.unison() > bank.capacity()) break;
+        const VoiceHandle h = bank.add((Oscillator::Waveform)std::clamp((int)v.waveform, 0, (int)Oscillator::FM),
+                                       std::max(1.0f, v.frequencyHz));
+        if (!v.held) bank.noteOff(h);
+        if (handles) handles->push_back(h);
+    }
+    return state;
+}
+
+void Synth::submit(std::unique_ptr<EngineState> state) {
+    reclaim();
+    // One the audio thread never took is still ours
+    delete pendingState_.exchange(state.release(), std::memory_order_acq_rel);
+}
+
+void Synth::reclaim() {
+    EngineState* s;
+    while (retiredStates_.pop(s)) delete s;
+}
+
+// Constant time: a pointer swap and the settings
+void Synth::adoptState() {
+    if (!pendingState_.load(std::memory_order_relaxed)) return;
+    EngineState* s = pendingState_.exchange(nullptr, std::memory_order_acquire);
+    if (!s) return;
+    voices_.swap(s->voices);
+    applyParams(s->params);
+    reply(SynthReply::PatchLoaded, s->tag, kNoVoice);
+    retiredStates_.push(s);
+}
+
+// The patch's settings, as the GUI sees them and as the engine runs them,
+// starting at once rather than gliding from the old patch's
+void Synth::applyParams(const PatchParams& p) {
+    masterPitchHz.store(guiPitch_ = p.masterPitchHz, std::memory_order_relaxed);
+    lfoRateHz.store(guiLfoRate_ = p.lfoRateHz, std::memory_order_relaxed);
+    lfoDepthHz.store(guiLfoDepth_ = p.lfoDepthHz, std::memory_order_relaxed);
+    filterCutoffHz.store(guiCutoff_ = p.filterCutoffHz, std::memory_order_relaxed);
+    filterResonance.store(guiResonance_ = p.filterResonance, std::memory_order_relaxed);
+    pitch_.reset(p.masterPitchHz);
+    lfoRate_.reset(p.lfoRateHz);
+    lfoDepth_.reset(p.lfoDepthHz);
+    cutoff_.reset(p.filterCutoffHz);
+    resonance_.reset(p.filterResonance);
+
+    lfoTarget.store(p.lfoTarget, std::memory_order_relaxed);
+    filterType.store(p.filterType, std::memory_order_relaxed);
+    filterLfoOctaves.store(p.filterLfoOctaves, std::memory_order_relaxed);
+    unisonVoices.store(p.unisonVoices, std::memory_order_relaxed);
+    unisonDetuneCents.store(p.unisonDetuneCents, std::memory_order_relaxed);
+    unisonSpread.store(p.unisonSpread, std::memory_order_relaxed);
+    attackSec.store(p.attackSec, std::memory_order_relaxed);
+    decaySec.store(p.decaySec, std::memory_order_relaxed);
+    sustainLevel.store(p.sustainLevel, std::memory_order_relaxed);
+    releaseSec.store(p.releaseSec, std::memory_order_relaxed);
+    envelopeCurve.store(p.envelopeCurve, std::memory_order_relaxed);
+    reverbLevel.store(p.reverbLevel, std::memory_order_relaxed);
+    noteWaveform.store(p.noteWaveform, std::memory_order_relaxed);
+    fmAlgorithm.store(p.fmAlgorithm, std::memory_order_relaxed);
+    for (int k = 0; k < kFmOperators; ++k) {
+        const PatchFmOperator& o = p.fmOperators[k];
+        fmRatio[k].store(o.ratio, std::memory_order_relaxed);
+        fmLevel[k].store(o.level, std::memory_order_relaxed);
+        fmFeedback[k].store(o.feedback, std::memory_order_relaxed);
+        fmAttackSec[k].store(o.attackSec, std::memory_order_relaxed);
+        fmDecaySec[k].store(o.decaySec, std::memory_order_relaxed);
+        fmSustainLevel[k].store(o.sustainLevel, std::memory_order_relaxed);
+        fmReleaseSec[k].store(o.releaseSec, std::memory_order_relaxed);
+    }
+    stealPolicy.store(p.stealPolicy, std::memory_order_relaxed);
+    bandLimited.store(p.bandLimited != 0, std::memory_order_relaxed);
+    controlRate.store(p.controlRate, std::memory_order_relaxed);
+    oversampling.store(p.oversampling, std::memory_order_relaxed);
+
+    lfoWaveform.store(p.lfoWaveform, std::memory_order_relaxed);
+    for (int k = 0; k < ModMatrix::kLfos - 1; ++k) {
+        modLfoRateHz[k].store(p.modLfoRateHz[k], std::memory_order_relaxed);
+        modLfoWaveform[k].store(p.modLfoWaveform[k], std::memory_order_relaxed);
+    }
+    for (int i = 0; i < ModMatrix::kMaxRoutes; ++i) {
+        modSource[i].store(p.modRoutes[i].source, std::memory_order_relaxed);
+        modDestination[i].store(p.modRoutes[i].destination, std::memory_order_relaxed);
+        modDepth[i].store(p.modRoutes[i].depth, std::memory_order_relaxed);
+        modCurve[i].store(p.modRoutes[i].curve, std::memory_order_relaxed);
+    }
+
+    lfos_[0].setParameter((LFO::Parameter)p.lfoTarget);
+    filterLfoOctaves_ = p.filterLfoOctaves;
+    setControlRate(p.controlRate);
+    if (p.oversampling != guiOversampling_) setOversampling(guiOversampling_ = p.oversampling);
+
+    // Start a fresh control tick at the new pitch; it works out the
+    // filter coefficients too
+    tickLeft_ = 0;
+    curInc_ = tickInc_ = p.masterPitchHz / sampleRate_;
+}
+
+PatchParams Synth::patchParams() const {
+    PatchParams p;
+    p.masterPitchHz = masterPitchHz.load();
+    p.lfoRateHz = lfoRateHz.load();
+    p.lfoDepthHz = lfoDepthHz.load();
+    p.lfoTarget = lfoTarget.load();
+    p.filterType = filterType.load();
+    p.filterCutoffHz = filterCutoffHz.load();
+    p.filterResonance = filterResonance.load();
+    p.filterLfoOctaves = filterLfoOctaves.load();
+    p.unisonVoices = unisonVoices.load();
+    p.unisonDetuneCents = unisonDetuneCents.load();
+    p.unisonSpread = unisonSpread.load();
+    p.attackSec = attackSec.load();
+    p.decaySec = decaySec.load();
+    p.sustainLevel = sustainLevel.load();
+    p.releaseSec = releaseSec.load();
+    p.envelopeCurve = envelopeCurve.load();
+    p.reverbLevel = reverbLevel.load();
+    p.noteWaveform = noteWaveform.load();
+    p.fmAlgorithm = fmAlgorithm.load();
+    for (int k = 0; k < kFmOperators; ++k) {
+        PatchFmOperator& o = p.fmOperators[k];
+        o.ratio = fmRatio[k].load();
+        o.level = fmLevel[k].load();
+        o.feedback = fmFeedback[k].load();
+        o.attackSec = fmAttackSec[k].load();
+        o.decaySec = fmDecaySec[k].load();
+        o.sustainLevel = fmSustainLevel[k].load();
+        o.releaseSec = fmReleaseSec[k].load();
+    }
+    p.stealPolicy = stealPolicy.load();
+    p.bandLimited = bandLimited.load() ? 1 : 0;
+    p.controlRate = controlRate.load();
+    p.oversampling = oversampling.load();
+    p.lfoWaveform = lfoWaveform.load();
+    for (int k = 0; k < ModMatrix::kLfos - 1; ++k) {
+        p.modLfoRateHz[k] = modLfoRateHz[k].load();
+        p.modLfoWaveform[k] = modLfoWaveform[k].load();
+    }
+    for (int i = 0; i < ModMatrix::kMaxRoutes; ++i) {
+        p.modRoutes[i].source = modSource[i].load();
+        p.modRoutes[i].destination = modDestination[i].load();
+        p.modRoutes[i].depth = modDepth[i].load();
+        p.modRoutes[i].curve = modCurve[i].load();
+    }
+    return p;
+}
+
+const char* Synth::voiceKernelName() const {
+    return voices_->kernel().name;
+}
@@ -1,48 +1,77 @@
 #pragma once
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 #include <atomic>
+#include <memory>
 #include "Oscillator.h"
+#include "VoiceBank.h"
 #include "LFO.h"
+#include "ModMatrix.h"
+#include "Oversampler.h"
+#include "MessageQueue.h"
+#include "Patch.h"
+#include "SmoothedParam.h"
 
 
 
 #ifndef SYNTH_H
 #define SYNTH_H
 
+// A command for the audio thread, applied at sample frame `frame` of the
+// engine's timeline (see Synth::frameTime()). Frames already past apply at
+// the start of the next block, so 0 means "as soon as possible". Each
+// producer should send its commands in non-decreasing frame order; the
+// engine merges producers by frame.
 struct SynthCmd {
-    enum Type { AddOsc, RemoveOsc, SetOscFreq } type;
+    enum Type {
+        AddOsc,     // index = tag echoed in the VoiceAdded reply
+        RemoveOsc,  // voice
+        SetOscFreq, // voice, value = Hz
+        TriggerOsc, // voice
+        ReleaseOsc, // voice
+        NoteOn,     // index = MIDI note, value = velocity 0..1
+        NoteOff,    // index = MIDI note
+        SetParam    // index = Param, value
+    } type;
     int index;
     float value;
-};
+    uint64_t frame = 0;
+    VoiceHandle voice = kNoVoice;
 
-template <size_t N>
-class SpscRing {
-public:
-    bool push(const SynthCmd& c) {
-        auto w = write_.load(std::memory_order_relaxed);
-        auto n = (w + 1) % N;
-        if (n == read_.load(std::memory_order_acquire)) return false;
-        buf_[w] = c;
-        write_.store(n, std::memory_order_release);
-        return true;
-    }
-
-    bool pop(SynthCmd& c) {
-        auto r = read_.load(std::memory_order_relaxed);
-        if (r == write_.load(std::memory_order_acquire)) return false;
-        c = buf_[r];
-        read_.store((r + 1) % N, std::memory_order_release);
-        return true;
-    }
+    enum Param { MasterPitch, LfoRate, LfoDepth, FilterCutoff, FilterResonance,
+                 UnisonVoices, UnisonDetune, UnisonSpread };
+};
 
-private:
-    SynthCmd buf_[N]{};
-    std::atomic<size_t> write_{0}, read_{0};
+// Engine -> GUI notifications on Synth::replyQ
+struct SynthReply {
+    enum Type {
+        VoiceAdded,  // answer to AddOsc; voice is kNoVoice if it failed
+        VoiceEnded,  // removed or stolen; the handle is dead
+        PatchLoaded  // tag from Synth::prepare(); every earlier handle is dead
+    } type;
+    int tag;
+    VoiceHandle voice;
 };
 
+class Convolver;
+class Governor;
+class Sampler;
+
 class Synth {
 public:
-    Synth();
+    static constexpr int kDefaultMaxVoices = 1024;
+    static constexpr int kMaxControlRate = 256;
+    static constexpr float kSmoothingSeconds = 0.02f;
+    static constexpr size_t kCmdQueueSize = 256;
+    // An AddOsc can answer with a VoiceEnded for each voice it stole (up to
+    // VoiceBank::kMaxUnison) and a VoiceAdded
+    static constexpr size_t kReplyQueueSize = 32 * kCmdQueueSize;
+    static constexpr int kChannels = 2;
+
+    // Voice storage is allocated here, once; the audio thread never allocates
+    explicit Synth(int maxVoices = kDefaultMaxVoices);
+    ~Synth();
 
     void setSampleRate(float sr);
 
@@ -50,19 +79,226 @@ public:
     std::atomic<float> masterPitchHz{440.0f};
     std::atomic<float> lfoRateHz{2.0f};
     std::atomic<float> lfoDepthHz{5.0f};
+    std::atomic<int>   stealPolicy{VoiceBank::StealReleasedFirst};
+    std::atomic<bool>  bandLimited{true}; // wavetable oscillators vs. naive shapes
+    std::atomic<int>   controlRate{32};   // samples per control tick, 1..kMaxControlRate
+    std::atomic<int>   oversampling{1};   // voices render at 1, 2, 4 or 8x the sample rate
+
+    // Per-voice filter (VoiceFilter::Type) and what the LFO modulates
+    // (LFO::Parameter: PITCH by lfoDepthHz, FILTER by filterLfoOctaves of
+    // cutoff either way, NONE; AMP is not wired and acts as NONE)
+    std::atomic<int>   filterType{VoiceFilter::OFF};
+    std::atomic<float> filterCutoffHz{2000.0f};
+    std::atomic<float> filterResonance{0.2f};   // 0..1
+    std::atomic<int>   lfoTarget{LFO::PITCH};
+    std::atomic<float> filterLfoOctaves{1.0f};
+    std::atomic<int>   lfoWaveform{LFO::SINE};
+
+    // Modulation matrix (ModMatrix). LFO 1 is the LFO above; LFOs 2 to
+    // ModMatrix::kLfos run at these rates and shapes, unsmoothed. Each of
+    // the kMaxRoutes slots holds a ModMatrix::Route; slots with zero depth
+    // are off. Picked up at the next block.
+    std::atomic<float> modLfoRateHz[ModMatrix::kLfos - 1]{ {0.5f}, {1.0f}, {6.0f} };
+    std::atomic<int>   modLfoWaveform[ModMatrix::kLfos - 1]{ {LFO::TRIANGLE}, {LFO::SINE}, {LFO::SQUARE} };
+    std::atomic<int>   modSource[ModMatrix::kMaxRoutes]{};
+    std::atomic<int>   modDestination[ModMatrix::kMaxRoutes]{};
+    std::atomic<float> modDepth[ModMatrix::kMaxRoutes]{};
+    std::atomic<int>   modCurve[ModMatrix::kMaxRoutes]{};
 
-    SpscRing<256> cmdQ;
+    // Unison: lanes per voice (1..VoiceBank::kMaxUnison), detune in cents
+    // from lowest to highest lane and stereo spread 0..1. Voices keep the
+    // settings they started with.
+    std::atomic<int>   unisonVoices{1};
+    std::atomic<float> unisonDetuneCents{20.0f};
+    std::atomic<float> unisonSpread{0.5f};
 
+    // Voice envelope (Envelope::Params), picked up at the next block
+    std::atomic<float> attackSec{0.05f};
+    std::atomic<float> decaySec{0.05f};
+    std::atomic<float> sustainLevel{0.8f};
+    std::atomic<float> releaseSec{0.1f};
+    std::atomic<int>   envelopeCurve{Envelope::LINEAR};
+
+    // What notes play (Oscillator::Waveform), unless a sampler is set
+    std::atomic<int>   noteWaveform{Oscillator::SAW};
+
+    // FM voices (Fm.h): the algorithm and, per operator, its frequency
+    // ratio, output level, feedback and ADSR, which takes the voice
+    // envelope's curve. Picked up at the next block.
+    std::atomic<int>   fmAlgorithm{0};
+    std::atomic<float> fmRatio[kFmOperators]{ {1.0f}, {1.0f}, {1.0f}, {1.0f} };
+    std::atomic<float> fmLevel[kFmOperators]{ {1.0f}, {1.0f}, {1.0f}, {1.0f} };
+    std::atomic<float> fmFeedback[kFmOperators]{};
+    std::atomic<float> fmAttackSec[kFmOperators]{ {0.05f}, {0.05f}, {0.05f}, {0.05f} };
+    std::atomic<float> fmDecaySec[kFmOperators]{ {0.05f}, {0.05f}, {0.05f}, {0.05f} };
+    std::atomic<float> fmSustainLevel[kFmOperators]{ {0.8f}, {0.8f}, {0.8f}, {0.8f} };
+    std::atomic<float> fmReleaseSec[kFmOperators]{ {0.1f}, {0.1f}, {0.1f}, {0.1f} };
+
+    // Master bus, after the voices: the reverb (setReverb()) is added to
+    // the dry mix at this level, gliding to it over a block
+    std::atomic<float> reverbLevel{0.3f};
+
+    // Any thread may send (GUI, MIDI input, automation)
+    MpscQueue<SynthCmd, kCmdQueueSize> cmdQ;
+    // Voice handles for AddOsc and ends of voices; one GUI-side reader
+    // drains it. The voice the engine starts with is announced here with
+    // tag 0. Replies that do not fit are dropped (replyQ.overflows()).
+    SpscQueue<SynthReply, kReplyQueueSize> replyQ;
+
+    // Renders nFrames of interleaved stereo (kChannels samples per frame),
+    // applying each queued command at its own frame
     void processBlock(float* out, unsigned long nFrames);
 
+    // Frames rendered so far; the timeline SynthCmd::frame refers to
+    uint64_t frameTime() const { return frames_.load(std::memory_order_acquire); }
+
+    // Voice render kernel ("avx2", "sse2", ...); false if unavailable here
+    bool setVoiceKernel(const char* name);
+    const char* voiceKernelName() const;
+
+    int maxVoices() const { return maxVoices_; }
+    // Voices rendered by the last block; audio thread
+    int soundingVoices() const { return voices_->sounding(); }
+
+    // A complete engine state for a patch: a voice bank holding the
+    // patch's voices, set up with its settings, and the settings
+    struct EngineState {
+        std::unique_ptr<VoiceBank> voices;
+        PatchParams params;
+        int tag = 0;
+    };
+
+    // Patch changes without replaying commands. prepare() builds the state
+    // (and lists the new voices' handles, in patch order, when asked);
+    // submit() hands it over, replacing one not yet taken. The audio thread
+    // takes it at the start of its next block with one pointer exchange,
+    // whatever the patch size, and answers PatchLoaded with its tag. The
+    // state it leaves is freed by reclaim(), which submit() also calls, so
+    // nothing is freed on the audio thread. Not for the audio thread; one
+    // thread at a time.
+    std::unique_ptr<EngineState> prepare(const Patch& patch, int tag,
+                                         std::vector<VoiceHandle>* handles = nullptr) const;
+    void submit(std::unique_ptr<EngineState> state);
+    void reclaim();
+
+    // The GUI settings as patch params; voices are the caller's to list
+    PatchParams patchParams() const;
+
+    // Renders voice slices on this many threads (the audio thread plus
+    // threads - 1 workers); 1 renders inline. Output is bit-identical for
+    // any count. Not for the audio thread; call while the stream is stopped.
+    void setRenderThreads(int threads);
+    int renderThreads() const;
+
+    // Notes play the sampler's zones (Oscillator::SAMPLE voices) instead of
+    // noteWaveform; nullptr goes back to noteWaveform. The sampler must outlive the synth,
+    // or be replaced first. Not for the audio thread; call while the stream
+    // is stopped.
+    void setSampler(Sampler* sampler);
+    Sampler* sampler() const { return sampler_; }
+
+    // The master bus's convolution reverb; nullptr for none. The convolver
+    // must outlive the synth, or be replaced first. Not for the audio
+    // thread; call while the stream is stopped.
+    void setReverb(Convolver* reverb);
+    Convolver* reverb() const { return reverb_; }
+
+    // CPU budget: the governor times every block and, ahead of blocks it
+    // predicts over budget, drops released voices and lowers quality
+    // (Governor::Step) on top of the GUI settings; the settings themselves
+    // are left alone. nullptr for none. The governor must outlive the
+    // synth, or be replaced first. Not for the audio thread; call while
+    // the stream is stopped.
+    void setGovernor(Governor* governor);
+    Governor* governor() const { return governor_; }
+
 private:
-    void applyGuiCommands();
+    void adoptState();
+    void applyParams(const PatchParams& p);
+    void applyGuiSettings();
+    void applyModulation();
+    void applyUnison();
+    void applyCommand(const SynthCmd& c);
+    void reply(SynthReply::Type type, int tag, VoiceHandle v);
+    void collectCommands();
+    bool popDue(SynthCmd& c, uint64_t now);
+    void setParam(int param, float value);
+    void setControlRate(int samples);
+    void setOversampling(int factor);
+    void fillPhaseIncrements(unsigned long n);
+    void tickFilter(float lfo);
+    void renderSpan(float* out, unsigned long n);
+    void applyReverb(unsigned long n);
+    void govern(uint64_t start, unsigned long nFrames);
+
+    static constexpr unsigned long kRenderChunk = VoiceBank::kMaxFrames;
+    // Frames per VoiceBank::render() call while the matrix has per-lane
+    // routes, which hold for a call
+    static constexpr unsigned long kModFrames = 128;
 
     float sampleRate_ = 48000.0f;
-    float lfoPhase_ = 0.0f;
 
-    std::vector<Oscillator> oscillators_;
-    LFO lfo_;
+    // Engine timeline, and commands taken off cmdQ that are not applied
+    // yet, sorted by frame: [schedBegin_, schedEnd_)
+    std::atomic<uint64_t> frames_{0};
+    SynthCmd scheduled_[kCmdQueueSize];
+    size_t schedBegin_ = 0, schedEnd_ = 0;
+
+    // Last GUI values seen; only changes become smoother targets, so
+    // SetParam commands are not overwritten every block
+    float guiPitch_ = 0.0f, guiLfoRate_ = 0.0f, guiLfoDepth_ = 0.0f;
+    float guiCutoff_ = 0.0f, guiResonance_ = 0.0f;
+    int guiOversampling_ = 1;   // as applied, after the governor
+
+    // Control-rate state: GUI values glide over kSmoothingSeconds, and the
+    // shared phase increment ramps linearly from tick to tick
+    int controlRate_ = 0;
+    int tickLeft_ = 0;
+    float tickInc_ = 0.0f;
+    float tickStep_ = 0.0f;
+    float curInc_ = 0.0f;
+    SmoothedParam pitch_{SmoothedParam::Linear};
+    SmoothedParam lfoRate_{SmoothedParam::OnePole};
+    SmoothedParam lfoDepth_{SmoothedParam::Linear};
+    SmoothedParam cutoff_{SmoothedParam::OnePole};
+    SmoothedParam resonance_{SmoothedParam::Linear};
+    float filterLfoOctaves_ = 1.0f;
+    float lfoValues_[ModMatrix::kLfos] = {};  // at the last tick
+
+    // Filter coefficients: this tick's, and held per frame for the voices
+    float tickCoef_[VoiceFilter::kCoefs] = {};
+    float filterCoef_[VoiceFilter::kCoefs][kRenderChunk];
+    const float* filterFrames_[VoiceFilter::kCoefs];
+
+    const Wavetables& tables_;
+    const int maxVoices_;
+    const char* kernelName_;
+    std::unique_ptr<RenderPool> pool_;
+    Sampler* sampler_ = nullptr;
+    Convolver* reverb_ = nullptr;
+    float reverbTarget_ = 0.0f;
+    float reverbGain_ = 0.0f;
+    Governor* governor_ = nullptr;
+    int governed_ = 0;          // Governor::Step bits in force this block
+    int governorDropped_ = 0;   // lanes dropped for this block
+    std::unique_ptr<VoiceBank> voices_;
+    LFO lfos_[ModMatrix::kLfos];
+    ModMatrix matrix_;
+
+    // A prepared state waiting for the audio thread, and the ones it has
+    // replaced, waiting for reclaim(). Only one state is in flight at a
+    // time, so the queue never fills.
+    std::atomic<EngineState*> pendingState_{nullptr};
+    SpscQueue<EngineState*, 4> retiredStates_;
+
+    // Voices render into osBuf_ at the oversampling factor x the sample
+    // rate, and each channel comes down to mix_ through its own oversampler
+    Oversampler oversampler_[kChannels]{ Oversampler(kRenderChunk), Oversampler(kRenderChunk) };
+    float osBuf_[kChannels][kRenderChunk];
+    float mix_[kChannels][kRenderChunk];
+    float wet_[kChannels][kRenderChunk];
+
+    float phaseInc_[kRenderChunk];
 };
 
 #endif
\ No newline at end of file
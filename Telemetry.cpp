@@ -0,0 +1,163 @@
+#include "Telemetry.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// How often the reader drains the ring, independent of the report interval
+static constexpr int kDrainMs = 10;
+
+Telemetry::Telemetry(float sampleRate)
+    : sampleRate_(std::max(1.0f, sampleRate)),
+      ring_(kRingSize)
+{
+    window_.reserve(kRingSize);
+    durations_.reserve(kRingSize);
+}
+
+Telemetry::~Telemetry() {
+    stop();
+}
+
+uint64_t Telemetry::nowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Telemetry::record(const TelemetrySample& s) {
+    const uint32_t w = write_.load(std::memory_order_relaxed);
+    if (w - read_.load(std::memory_order_acquire) == kRingSize) {
+        // Only this thread writes the counter, so no read-modify-write needed
+        dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    ring_[w & (kRingSize - 1)] = s;
+    write_.store(w + 1, std::memory_order_release);
+}
+
+bool Telemetry::start(const std::string& jsonPath, int intervalMs) {
+    if (reader_.joinable()) return false;
+
+    if (!jsonPath.empty()) {
+        json_ = std::fopen(jsonPath.c_str(), "a");
+        if (!json_) {
+            std::fprintf(stderr, "Telemetry: cannot open %s\n", jsonPath.c_str());
+            return false;
+        }
+    }
+
+    intervalMs_ = std::max(kDrainMs, intervalMs);
+    quit_ = false;
+    windowStartNs_ = nowNs();
+    reader_ = std::thread([this] { readerLoop(); });
+    return true;
+}
+
+void Telemetry::stop() {
+    if (!reader_.joinable()) return;
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        quit_ = true;
+    }
+    wake_.notify_one();
+    reader_.join();
+
+    if (json_) {
+        std::fclose(json_);
+        json_ = nullptr;
+    }
+}
+
+TelemetryStats Telemetry::stats() const {
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    return stats_;
+}
+
+void Telemetry::readerLoop() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex_);
+            wake_.wait_for(lock, std::chrono::milliseconds(kDrainMs), [this] { return quit_; });
+            if (quit_) break;
+        }
+
+        drain();
+        const uint64_t now = nowNs();
+        if (now - windowStartNs_ >= (uint64_t)intervalMs_ * 1000000u) {
+            publish((now - windowStartNs_) * 1e-9);
+            windowStartNs_ = now;
+        }
+    }
+
+    drain();
+    publish((nowNs() - windowStartNs_) * 1e-9);
+}
+
+void Telemetry::drain() {
+    const uint32_t r = read_.load(std::memory_order_relaxed);
+    const uint32_t w = write_.load(std::memory_order_acquire);
+    for (uint32_t i = r; i != w; ++i) window_.push_back(ring_[i & (kRingSize - 1)]);
+    read_.store(w, std::memory_order_release);
+}
+
+void Telemetry::publish(double windowSec) {
+    TelemetryStats s;
+    s.windowSec = windowSec;
+    s.callbacks = window_.size();
+
+    double busy = 0.0, audio = 0.0;
+    durations_.clear();
+    for (const TelemetrySample& t : window_) {
+        const double us = t.durationNs * 1e-3;
+        const double deadlineUs = t.frames * 1e6 / sampleRate_;
+        busy += us;
+        audio += deadlineUs;
+        durations_.push_back((float)us);
+
+        if (deadlineUs > 0.0) s.peakLoadPercent = std::max(s.peakLoadPercent, 100.0 * us / deadlineUs);
+        const int bucket = us < 1.0 ? 0 : std::min(TelemetryStats::kHistogramBuckets - 1, (int)std::log2(us));
+        ++s.histogram[bucket];
+        s.voicesMax = std::max(s.voicesMax, (int)t.voices);
+        s.queueMax = std::max(s.queueMax, (int)t.queueDepth);
+        if (t.flags & Xrun) ++s.xruns;
+    }
+
+    if (!durations_.empty()) {
+        std::sort(durations_.begin(), durations_.end());
+        auto pct = [&](double p) { return (double)durations_[(size_t)(p * (durations_.size() - 1) + 0.5)]; };
+        s.p50Us = pct(0.50);
+        s.p95Us = pct(0.95);
+        s.p99Us = pct(0.99);
+        s.maxUs = durations_.back();
+        s.budgetUs = audio / durations_.size();
+        s.loadPercent = audio > 0.0 ? 100.0 * busy / audio : 0.0;
+    }
+
+    totalCallbacks_ += s.callbacks;
+    totalXruns_ += s.xruns;
+    s.totalCallbacks = totalCallbacks_;
+    s.totalXruns = totalXruns_;
+    s.dropped = dropped_.load(std::memory_order_relaxed);
+    window_.clear();
+
+    if (json_) writeJson(s);
+
+    std::lock_guard<std::mutex> lock(statsMutex_);
+    stats_ = s;
+}
+
+void Telemetry::writeJson(const TelemetryStats& s) {
+    std::fprintf(json_,
+        "{\"t_ns\":%llu,\"window_s\":%.3f,\"callbacks\":%llu,\"load_pct\":%.2f,\"peak_load_pct\":%.2f,"
+        "\"budget_us\":%.1f,\"p50_us\":%.1f,\"p95_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f,"
+        "\"voices_max\":%d,\"queue_max\":%d,\"xruns\":%llu,\"total_callbacks\":%llu,"
+        "\"total_xruns\":%llu,\"dropped\":%llu,\"hist_log2_us\":[",
+        (unsigned long long)nowNs(), s.windowSec, (unsigned long long)s.callbacks, s.loadPercent,
+        s.peakLoadPercent, s.budgetUs, s.p50Us, s.p95Us, s.p99Us, s.maxUs, s.voicesMax, s.queueMax,
+        (unsigned long long)s.xruns, (unsigned long long)s.totalCallbacks,
+        (unsigned long long)s.totalXruns, (unsigned long long)s.dropped);
+    for (int b = 0; b < TelemetryStats::kHistogramBuckets; ++b) {
+        std::fprintf(json_, b ? ",%u" : "%u", s.histogram[b]);
+    }
+    std::fprintf(json_, "]}\n");
+    std::fflush(json_);
+}
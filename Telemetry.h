@@ -0,0 +1,114 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One audio callback, as seen by the audio thread
+struct TelemetrySample {
+    uint64_t startNs;     // steady clock
+    uint32_t durationNs;  // time spent producing the block
+    uint32_t frames;
+    uint32_t flags;       // Telemetry::Flags
+    uint16_t voices;      // sounding after the block
+    uint16_t queueDepth;  // commands waiting before the block
+};
+
+// Aggregate over one reporting window, plus running totals
+struct TelemetryStats {
+    static constexpr int kHistogramBuckets = 16;
+
+    double windowSec = 0.0;
+    uint64_t callbacks = 0;
+    double loadPercent = 0.0;     // render time / audio time
+    double peakLoadPercent = 0.0; // worst single callback against its deadline
+    double budgetUs = 0.0;        // mean audio time per callback
+    double p50Us = 0.0, p95Us = 0.0, p99Us = 0.0, maxUs = 0.0;
+    uint32_t histogram[kHistogramBuckets] = {};  // bucket b: [2^b, 2^(b+1)) us
+    int voicesMax = 0;
+    int queueMax = 0;
+    uint64_t xruns = 0;
+
+    uint64_t totalCallbacks = 0;
+    uint64_t totalXruns = 0;
+    uint64_t dropped = 0;  // samples lost to a full ring
+};
+
+// Callback timing and counters from the audio thread. record() is
+// wait-free: it writes into a fixed ring and, if the reader has fallen
+// behind, drops the sample and counts it. A reader thread drains the ring,
+// aggregates windows of intervalMs into TelemetryStats and optionally
+// appends each window as a JSON line to a file.
+class Telemetry {
+public:
+    // Same meaning as PortAudio's PaStreamCallbackFlags
+    enum Flags {
+        InputUnderflow  = 1 << 0,
+        InputOverflow   = 1 << 1,
+        OutputUnderflow = 1 << 2,
+        OutputOverflow  = 1 << 3,
+        PrimingOutput   = 1 << 4,
+        Xrun = InputUnderflow | InputOverflow | OutputUnderflow | OutputOverflow
+    };
+
+    static constexpr uint32_t kRingSize = 8192;  // power of two
+
+    explicit Telemetry(float sampleRate);
+    ~Telemetry();
+
+    Telemetry(const Telemetry&) = delete;
+    Telemetry& operator=(const Telemetry&) = delete;
+
+    static uint64_t nowNs();
+
+    // Audio thread only
+    void record(const TelemetrySample& s);
+
+    // Starts the reader thread; jsonPath empty means no dump. Not for the
+    // audio thread.
+    bool start(const std::string& jsonPath, int intervalMs = 500);
+    // Aggregates what is left as a last window and joins the reader
+    void stop();
+
+    // Latest window; any thread
+    TelemetryStats stats() const;
+
+private:
+    void readerLoop();
+    void drain();
+    void publish(double windowSec);
+    void writeJson(const TelemetryStats& s);
+
+    const float sampleRate_;
+
+    // Ring: written by the audio thread, read by the reader thread
+    std::vector<TelemetrySample> ring_;
+    alignas(64) std::atomic<uint32_t> write_{0};
+    alignas(64) std::atomic<uint32_t> read_{0};
+    alignas(64) std::atomic<uint64_t> dropped_{0};
+
+    // Reader state
+    std::vector<TelemetrySample> window_;
+    std::vector<float> durations_;
+    uint64_t totalCallbacks_ = 0;
+    uint64_t totalXruns_ = 0;
+    uint64_t windowStartNs_ = 0;
+    std::FILE* json_ = nullptr;
+
+    int intervalMs_ = 500;
+    bool quit_ = false;
+    std::mutex wakeMutex_;
+    std::condition_variable wake_;
+    std::thread reader_;
+
+    mutable std::mutex statsMutex_;
+    TelemetryStats stats_;
+};
+
+#endif
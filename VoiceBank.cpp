@@ -0,0 +1,621 @@
+#include "VoiceBank.h"
+#include "ModMatrix.h"
+#include "RenderPool.h"
+#include "Sampler.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <utility>
+
+static constexpr uint32_t kSlotMask = (1u << VoiceBank::kSlotBits) - 1;
+static constexpr uint32_t kMaxGeneration = (1u << (32 - VoiceBank::kSlotBits)) - 1;
+static_assert(VoiceBank::kSliceLanes <= 64, "renderSlice keeps a bit per lane");
+
+// Equal-power pan, -1 (left) .. 1 (right), scaled so a centred voice keeps
+// its gain in both channels
+static void panGains(float pan, float gain, float& l, float& r) {
+    if (pan == 0.0f) {
+        l = r = gain;
+        return;
+    }
+    const float a = (std::clamp(pan, -1.0f, 1.0f) + 1.0f) * 0.785398163f;  // 0..pi/2
+    l = gain * 1.41421356f * std::cos(a);
+    r = gain * 1.41421356f * std::sin(a);
+}
+
+VoiceBank::VoiceBank()
+    : kernel_(&bestVoiceKernel())
+{}
+
+// A bank retired by a patch switch gives its streams back here
+VoiceBank::~VoiceBank() {
+    for (int l = 0; l < count_; ++l) closeSample(l);
+}
+
+void VoiceBank::setCapacity(int maxVoices) {
+    capacity_ = std::clamp(maxVoices, 0, (int)kSlotMask + 1);
+    count_ = 0;
+    sounding_ = 0;
+
+    const int padded = (capacity_ + kVoiceLaneAlign - 1) / kVoiceLaneAlign * kVoiceLaneAlign;
+
+    // Unused lanes sit in OFF with a zero envelope and render silence
+    phase_.assign(padded, 0.0f);
+    env_.assign(padded, 0.0f);
+    stage_.assign(padded, Envelope::OFF);
+    waveform_.assign(padded, Oscillator::SAW);
+    ratio_.assign(padded, 1.0f);
+    gainL_.assign(padded, 0.0f);
+    gainR_.assign(padded, 0.0f);
+    envMul_.assign(padded, 1.0f);
+    envAdd_.assign(padded, 0.0f);
+    envTarget_.assign(padded, 0.0f);
+    envLeft_.assign(padded, INT32_MAX);
+    for (auto& s : filterState_) s.assign(padded, 0.0f);
+    velocity_.assign(padded, 0.0f);
+    modRatio_.assign(padded, 1.0f);
+    modGainL_.assign(padded, 0.0f);
+    modGainR_.assign(padded, 0.0f);
+
+    frequency_.assign(padded, 440.0f);
+    note_.assign(padded, -1);
+    for (int l = 0; l < (int)stream_.size(); ++l) closeSample(l);
+    zone_.assign(padded, -1);
+    stream_.assign(padded, -1);
+    samplePos_.assign(padded, 0.0);
+    for (auto& o : fmOp_) {
+        o.phase.assign(padded, 0.0f);
+        o.env.assign(padded, 0.0f);
+        o.stage.assign(padded, Envelope::OFF);
+        o.envMul.assign(padded, 1.0f);
+        o.envAdd.assign(padded, 0.0f);
+        o.envTarget.assign(padded, 0.0f);
+        o.envLeft.assign(padded, INT32_MAX);
+        for (auto& h : o.last) h.assign(padded, 0.0f);
+    }
+    sourceOut_.assign((size_t)padded * kMaxFrames, 0.0f);
+
+    started_.assign(padded, 0);
+    slotOf_.assign(padded, -1);
+    laneOf_.assign(capacity_, -1);
+    generation_.assign(capacity_, 1);
+    groupHead_.assign(capacity_, -1);
+    groupNext_.assign(capacity_, -1);
+    stolen_.clear();
+    stolen_.reserve(kMaxUnison);
+    dropped_.clear();
+    dropped_.reserve(capacity_);
+    releasing_.clear();
+    releasing_.reserve(capacity_);
+
+    // Lowest slots are handed out first
+    freeSlots_.clear();
+    freeSlots_.reserve(capacity_);
+    for (int slot = capacity_ - 1; slot >= 0; --slot) freeSlots_.push_back(slot);
+
+    const int slices = (padded + kSliceLanes - 1) / kSliceLanes;
+    sliceOut_.assign((size_t)slices * 2 * kMaxFrames, 0.0f);
+}
+
+void VoiceBank::setSampler(Sampler* sampler) {
+    for (int l = 0; l < count_; ++l) closeSample(l);
+    sampler_ = sampler;
+}
+
+void VoiceBank::setFm(const FmParams& p) {
+    fm_ = p;
+    fm_.algorithm = std::clamp(p.algorithm, 0, kFmAlgorithms - 1);
+    for (auto& op : fm_.op) {
+        op.ratio = std::max(op.ratio, 0.001f);
+        op.feedback = std::clamp(op.feedback, 0.0f, 1.0f);
+    }
+}
+
+void VoiceBank::setSampleRate(float sr) {
+    sampleRate_ = std::max(1.0f, sr);
+}
+
+void VoiceBank::setEnvelope(const Envelope::Params& p) {
+    const bool newSustain = p.sustain != envelope_.sustain;
+    envelope_ = p;
+    if (!newSustain) return;
+    for (int l = 0; l < sounding_; ++l) {
+        if (stage_[l] == Envelope::SUSTAIN) enterStage(l, Envelope::DECAY);
+    }
+}
+
+void VoiceBank::setUnison(int lanes, float detuneCents, float spread) {
+    unison_ = std::clamp(lanes, 1, kMaxUnison);
+    unisonDetune_ = std::max(0.0f, detuneCents);
+    unisonSpread_ = std::clamp(spread, 0.0f, 1.0f);
+}
+
+void VoiceBank::setFilterType(VoiceFilter::Type t) {
+    if (t == filterType_) return;
+    filterType_ = t;
+    for (auto& s : filterState_) std::fill(s.begin(), s.end(), 0.0f);
+}
+
+void VoiceBank::enterStage(int l, Envelope::Stage s) {
+    if (s == Envelope::OFF) env_[l] = 0.0f;
+    const EnvelopeSegment seg = Envelope::stageSegment(s, env_[l], envelope_, sampleRate_);
+    stage_[l] = s;
+    envMul_[l] = seg.mul;
+    envAdd_[l] = seg.add;
+    envTarget_[l] = seg.target;
+    envLeft_[l] = seg.length;
+    if (waveform_[l] == Oscillator::FM && s != Envelope::DECAY && s != Envelope::SUSTAIN) enterFmStage(l, s);
+}
+
+// Operators follow the voice into its attack, release and silence; their
+// decays run on their own
+void VoiceBank::enterFmStage(int l, Envelope::Stage s) {
+    for (int k = 0; k < kFmOperators; ++k) {
+        FmOperatorLanes& o = fmOp_[k];
+        if (s == Envelope::OFF) o.env[l] = 0.0f;
+        const EnvelopeSegment seg = Envelope::stageSegment(s, o.env[l], fm_.op[k].envelope, sampleRate_);
+        o.stage[l] = s;
+        o.envMul[l] = seg.mul;
+        o.envAdd[l] = seg.add;
+        o.envTarget[l] = seg.target;
+        o.envLeft[l] = seg.length;
+    }
+}
+
+void VoiceBank::swapLanes(int a, int b) {
+    if (a == b) return;
+    std::swap(phase_[a], phase_[b]);
+    std::swap(env_[a], env_[b]);
+    std::swap(stage_[a], stage_[b]);
+    std::swap(waveform_[a], waveform_[b]);
+    std::swap(ratio_[a], ratio_[b]);
+    std::swap(gainL_[a], gainL_[b]);
+    std::swap(gainR_[a], gainR_[b]);
+    std::swap(envMul_[a], envMul_[b]);
+    std::swap(envAdd_[a], envAdd_[b]);
+    std::swap(envTarget_[a], envTarget_[b]);
+    std::swap(envLeft_[a], envLeft_[b]);
+    for (auto& s : filterState_) std::swap(s[a], s[b]);
+    std::swap(velocity_[a], velocity_[b]);
+    std::swap(frequency_[a], frequency_[b]);
+    std::swap(note_[a], note_[b]);
+    std::swap(zone_[a], zone_[b]);
+    std::swap(stream_[a], stream_[b]);
+    std::swap(samplePos_[a], samplePos_[b]);
+    for (auto& o : fmOp_) {
+        std::swap(o.phase[a], o.phase[b]);
+        std::swap(o.env[a], o.env[b]);
+        std::swap(o.stage[a], o.stage[b]);
+        std::swap(o.envMul[a], o.envMul[b]);
+        std::swap(o.envAdd[a], o.envAdd[b]);
+        std::swap(o.envTarget[a], o.envTarget[b]);
+        std::swap(o.envLeft[a], o.envLeft[b]);
+        for (auto& h : o.last) std::swap(h[a], h[b]);
+    }
+    std::swap(started_[a], started_[b]);
+    std::swap(slotOf_[a], slotOf_[b]);
+
+    if (slotOf_[a] >= 0) laneOf_[slotOf_[a]] = a;
+    if (slotOf_[b] >= 0) laneOf_[slotOf_[b]] = b;
+}
+
+// Lane of the voice's first slot; only those slots are handed out
+int VoiceBank::laneOf(VoiceHandle v) const {
+    const uint32_t slot = v & kSlotMask;
+    if (slot >= (uint32_t)capacity_ || generation_[slot] != (v >> kSlotBits)) return -1;
+    if (groupHead_[slot] != (int32_t)slot) return -1;
+    return laneOf_[slot];
+}
+
+VoiceHandle VoiceBank::handleOf(int lane) const {
+    const uint32_t slot = (uint32_t)slotOf_[lane];
+    return ((uint32_t)generation_[slot] << kSlotBits) | slot;
+}
+
+// Invalidates every handle to the slot; generations skip 0, so no handle
+// is ever kNoVoice
+void VoiceBank::renew(int slot) {
+    generation_[slot] = (uint16_t)(generation_[slot] % kMaxGeneration + 1);
+}
+
+// Moves an allocated lane into the rendered range
+void VoiceBank::wake(int lane) {
+    if (lane < sounding_) return;
+    swapLanes(lane, sounding_++);
+}
+
+int VoiceBank::pickVictim() const {
+    // A finished voice is both the quietest and the most released one
+    if (policy_ != StealOldest && sounding_ < count_) return sounding_;
+
+    int best = 0;
+    for (int l = 1; l < count_; ++l) {
+        bool better = false;
+        switch (policy_) {
+            case StealOldest:
+                better = (int32_t)(started_[l] - started_[best]) < 0;
+                break;
+            case StealQuietest:
+                better = env_[l] < env_[best];
+                break;
+            case StealReleasedFirst: {
+                const bool rl = stage_[l] == Envelope::RELEASE;
+                const bool rb = stage_[best] == Envelope::RELEASE;
+                better = (rl != rb) ? rl
+                       : rl ? env_[l] < env_[best]
+                            : (int32_t)(started_[l] - started_[best]) < 0;
+                break;
+            }
+        }
+        if (better) best = l;
+    }
+    return best;
+}
+
+VoiceHandle VoiceBank::add(Oscillator::Waveform w, float frequencyHz) {
+    return addGroup(w, frequencyHz, -1, 1.0f, 1.0f);
+}
+
+int VoiceBank::allocLane() {
+    const int l = count_++;
+    const int slot = freeSlots_.back();
+    freeSlots_.pop_back();
+    slotOf_[l] = slot;
+    laneOf_[slot] = l;
+    return l;
+}
+
+// Steals whole voices until the group fits, then links and starts it
+VoiceHandle VoiceBank::addGroup(Oscillator::Waveform w, float frequencyHz, int note, float ratio, float velocity) {
+    stolen_.clear();
+    if (capacity_ == 0) return kNoVoice;
+
+    const int lanes = std::min(unison_, capacity_);
+    while (capacity_ - count_ < lanes) {
+        const VoiceHandle victim = handleOf(laneOf_[groupHead_[slotOf_[pickVictim()]]]);
+        remove(victim);
+        stolen_.push_back(victim);
+    }
+
+    int head = -1, prev = -1;
+    for (int k = 0; k < lanes; ++k) {
+        const int l = allocLane();
+        const int slot = slotOf_[l];
+        if (head < 0) head = slot;
+        else          groupNext_[prev] = slot;
+        groupHead_[slot] = head;
+        groupNext_[slot] = -1;
+        frequency_[l] = frequencyHz;
+        prev = slot;
+    }
+
+    startGroup(head, w, note, ratio, velocity);
+    return handleOf(laneOf_[head]);
+}
+
+// Detune and pan run evenly across the group, lowest pitch on the left, at
+// 1/sqrt(lanes) of the level so a group is about as loud as a single lane.
+// A single lane starts at phase 0; unison lanes start at random phases, or
+// the group would begin as one phase-aligned spike.
+void VoiceBank::startGroup(int head, Oscillator::Waveform w, int note, float ratio, float velocity) {
+    int lanes = 0;
+    for (int s = head; s >= 0; s = groupNext_[s]) ++lanes;
+    const float level = 0.2f * velocity / std::sqrt((float)lanes);
+
+    int k = 0;
+    for (int s = head; s >= 0; s = groupNext_[s], ++k) {
+        const float x = lanes > 1 ? 2.0f * k / (lanes - 1) - 1.0f : 0.0f;  // -1..1
+        float gainL, gainR;
+        panGains(x * unisonSpread_, level, gainL, gainR);
+
+        float phase = 0.0f;
+        if (lanes > 1) {
+            random_ = random_ * 1664525u + 1013904223u;
+            phase = (random_ >> 8) * (1.0f / 16777216.0f);
+        }
+        const float detune = std::exp2(x * 0.5f * unisonDetune_ / 1200.0f);
+        start(laneOf_[s], w, note, ratio * detune, gainL, gainR, phase, velocity);
+    }
+}
+
+// Fresh note on lane l: level from zero, then the attack
+void VoiceBank::start(int l, Oscillator::Waveform w, int note, float ratio, float gainL, float gainR,
+                      float phase, float velocity) {
+    if (w == Oscillator::SAMPLE && !sampler_) w = Oscillator::SAW;
+    phase_[l] = phase;
+    env_[l] = 0.0f;
+    for (auto& s : filterState_) s[l] = 0.0f;
+    waveform_[l] = w;
+    ratio_[l] = ratio;
+    gainL_[l] = gainL;
+    gainR_[l] = gainR;
+    velocity_[l] = velocity;
+    note_[l] = note;
+    for (auto& o : fmOp_) {
+        o.phase[l] = 0.0f;
+        o.env[l] = 0.0f;
+        for (auto& h : o.last) h[l] = 0.0f;
+    }
+    openSample(l);
+    enterStage(l, Envelope::ATTACK);
+    started_[l] = serial_++;
+    wake(l);
+}
+
+// From the start of the zone for the lane's note (or, for voices added
+// with add(), the note nearest its frequency), on a new stream
+void VoiceBank::openSample(int l) {
+    closeSample(l);
+    if (waveform_[l] != Oscillator::SAMPLE) return;
+    const int note = note_[l] >= 0 ? note_[l] : (int)std::lround(69.0f + 12.0f * std::log2(frequency_[l] / 440.0f));
+    zone_[l] = sampler_->zoneFor(note);
+    stream_[l] = sampler_->open(zone_[l]);
+    samplePos_[l] = 0.0;
+}
+
+void VoiceBank::closeSample(int l) {
+    if (stream_[l] >= 0) sampler_->close(stream_[l]);
+    stream_[l] = -1;
+}
+
+VoiceHandle VoiceBank::playNote(Oscillator::Waveform w, int note, float velocity) {
+    const float ratio = std::exp2((note - 69) / 12.0f);
+    velocity = std::clamp(velocity, 0.0f, 1.0f);
+    const int lanes = std::min(unison_, capacity_);
+
+    // A finished note voice of the current unison size is reused whole
+    for (int l = sounding_; l < count_; ++l) {
+        if (note_[l] < 0) continue;
+        const int head = groupHead_[slotOf_[l]];
+        int size = 0;
+        bool finished = true;
+        for (int s = head; s >= 0; s = groupNext_[s], ++size) finished = finished && laneOf_[s] >= sounding_;
+        if (!finished || size != lanes) continue;
+
+        stolen_.clear();
+        renew(head);
+        startGroup(head, w, note, ratio, velocity);
+        return handleOf(laneOf_[head]);
+    }
+
+    return addGroup(w, 440.0f * ratio, note, ratio, velocity);
+}
+
+void VoiceBank::releaseNote(int note) {
+    for (int l = 0; l < sounding_; ++l) {
+        if (note_[l] != note || stage_[l] == Envelope::RELEASE || stage_[l] == Envelope::OFF) continue;
+        enterStage(l, Envelope::RELEASE);
+    }
+}
+
+bool VoiceBank::remove(VoiceHandle v) {
+    const int l = laneOf(v);
+    if (l < 0) return false;
+    for (int s = slotOf_[l]; s >= 0;) {
+        const int next = groupNext_[s];
+        groupNext_[s] = -1;
+        removeLane(laneOf_[s]);
+        s = next;
+    }
+    return true;
+}
+
+int VoiceBank::dropReleased(int lanes) {
+    dropped_.clear();
+    if (lanes <= 0) return 0;
+
+    // Group heads carry the voice's envelope for all its lanes
+    releasing_.clear();
+    for (int l = 0; l < sounding_; ++l) {
+        if (stage_[l] == Envelope::RELEASE && groupHead_[slotOf_[l]] == slotOf_[l])
+            releasing_.push_back({ env_[l], handleOf(l) });
+    }
+    std::sort(releasing_.begin(), releasing_.end(),
+              [](const Releasing& a, const Releasing& b) { return a.env < b.env; });
+
+    int gone = 0;
+    for (const Releasing& r : releasing_) {
+        if (gone >= lanes) break;
+        const int before = count_;
+        remove(r.voice);
+        gone += before - count_;
+        dropped_.push_back(r.voice);
+    }
+    return gone;
+}
+
+void VoiceBank::removeLane(int l) {
+    // Take the lane out of the rendered range, then out of the allocated one
+    if (l < sounding_) {
+        swapLanes(l, --sounding_);
+        l = sounding_;
+    }
+    swapLanes(l, --count_);
+    l = count_;
+
+    const int slot = slotOf_[l];
+    renew(slot);
+    laneOf_[slot] = -1;
+    freeSlots_.push_back(slot);
+
+    slotOf_[l] = -1;
+    phase_[l] = 0.0f;
+    closeSample(l);
+    enterStage(l, Envelope::OFF);
+}
+
+void VoiceBank::setFrequency(VoiceHandle v, float frequencyHz) {
+    const int l = laneOf(v);
+    if (l < 0) return;
+    for (int s = slotOf_[l]; s >= 0; s = groupNext_[s]) frequency_[laneOf_[s]] = std::max(1.0f, frequencyHz);
+}
+
+float VoiceBank::getFrequency(VoiceHandle v) const {
+    const int l = laneOf(v);
+    return l >= 0 ? frequency_[l] : 0.0f;
+}
+
+void VoiceBank::noteOn(VoiceHandle v) {
+    const int l = laneOf(v);
+    if (l < 0) return;
+    for (int s = slotOf_[l]; s >= 0; s = groupNext_[s]) {
+        const int k = laneOf_[s];
+        openSample(k);
+        enterStage(k, Envelope::ATTACK);
+        started_[k] = serial_++;
+        wake(k);
+    }
+}
+
+void VoiceBank::noteOff(VoiceHandle v) {
+    const int l = laneOf(v);
+    if (l < 0) return;
+    for (int s = slotOf_[l]; s >= 0; s = groupNext_[s]) {
+        const int k = laneOf_[s];
+        if (stage_[k] != Envelope::OFF) enterStage(k, Envelope::RELEASE);
+    }
+}
+
+void VoiceBank::cullFinished() {
+    for (int l = 0; l < sounding_;) {
+        if (stage_[l] == Envelope::OFF) {
+            closeSample(l);
+            swapLanes(l, --sounding_);
+        }
+        else ++l;
+    }
+}
+
+void VoiceBank::renderSlice(int slice) {
+    const int first = slice * kSliceLanes;
+
+    VoiceLanes lanes = job_;
+    lanes.phase += first;
+    lanes.env += first;
+    lanes.stage += first;
+    lanes.waveform += first;
+    lanes.ratio += first;
+    lanes.gainL += first;
+    lanes.gainR += first;
+    lanes.envMul += first;
+    lanes.envAdd += first;
+    lanes.envTarget += first;
+    lanes.envLeft += first;
+    for (auto& s : lanes.filterState) s += first;
+    lanes.count = std::min(kSliceLanes, job_.count - first);
+
+    if (jobMod_) {
+        ModLanes m;
+        m.env = env_.data() + first;
+        m.velocity = velocity_.data() + first;
+        m.ratio = ratio_.data() + first;
+        m.gainL = gainL_.data() + first;
+        m.gainR = gainR_.data() + first;
+        m.modRatio = modRatio_.data() + first;
+        m.modGainL = modGainL_.data() + first;
+        m.modGainR = modGainR_.data() + first;
+        m.count = lanes.count;
+        jobMod_->apply(m);
+    }
+
+    // Sample and FM audio at the lanes' (modulated) pitch, ahead of the
+    // kernel
+    lanes.source += (size_t)first * kMaxFrames;
+    uint64_t ended = 0;
+    bool fm = false;
+    for (int k = 0; k < lanes.count; ++k) {
+        const int l = first + k;
+        fm = fm || waveform_[l] == Oscillator::FM;
+        if (waveform_[l] != Oscillator::SAMPLE || stage_[l] == Envelope::OFF || zone_[l] < 0) continue;
+        float* dst = sourceOut_.data() + (size_t)l * kMaxFrames;
+        if (!sampler_->render(zone_[l], stream_[l], samplePos_[l], jobInc_, lanes.ratio[k], dst, jobFrames_))
+            ended |= 1ull << k;
+    }
+    if (fm) {
+        FmLanes f;
+        for (int k = 0; k < kFmOperators; ++k) {
+            FmOperatorLanes& o = fmOp_[k];
+            f.phase[k] = o.phase.data() + first;
+            f.env[k] = o.env.data() + first;
+            f.stage[k] = o.stage.data() + first;
+            f.envMul[k] = o.envMul.data() + first;
+            f.envAdd[k] = o.envAdd.data() + first;
+            f.envTarget[k] = o.envTarget.data() + first;
+            f.envLeft[k] = o.envLeft.data() + first;
+            for (int h = 0; h < 2; ++h) f.last[k][h] = o.last[h].data() + first;
+        }
+        f.waveform = lanes.waveform;
+        f.ratio = lanes.ratio;
+        f.params = &fm_;
+        f.sampleRate = sampleRate_;
+        f.out = sourceOut_.data() + (size_t)first * kMaxFrames;
+        f.outStride = (int)kMaxFrames;
+        f.count = lanes.count;
+        kernel_->renderFm(f, jobInc_, jobFrames_);
+    }
+
+    float* outL = sliceOut_.data() + (size_t)slice * 2 * kMaxFrames;
+    float* outR = outL + kMaxFrames;
+    std::fill(outL, outL + jobFrames_, 0.0f);
+    std::fill(outR, outR + jobFrames_, 0.0f);
+    kernel_->render(lanes, jobInc_, outL, outR, jobFrames_);
+
+    // Lanes whose sample ran out are done; the next render() culls them
+    for (int k = 0; ended; ++k, ended >>= 1) {
+        if (ended & 1) enterStage(first + k, Envelope::OFF);
+    }
+}
+
+void VoiceBank::renderSliceTask(void* self, int slice) {
+    static_cast<VoiceBank*>(self)->renderSlice(slice);
+}
+
+void VoiceBank::render(float* outL, float* outR, const float* phaseInc, unsigned long n,
+                       const float* const* filterCoef, const ModMatrix* mod) {
+    cullFinished();
+    if (sounding_ == 0 || n == 0) return;
+    n = std::min(n, kMaxFrames);
+
+    job_.phase = phase_.data();
+    job_.env = env_.data();
+    job_.stage = stage_.data();
+    job_.waveform = waveform_.data();
+    jobMod_ = mod && mod->perLane() ? mod : nullptr;
+    job_.ratio = (jobMod_ ? modRatio_ : ratio_).data();
+    job_.gainL = (jobMod_ ? modGainL_ : gainL_).data();
+    job_.gainR = (jobMod_ ? modGainR_ : gainR_).data();
+    job_.envMul = envMul_.data();
+    job_.envAdd = envAdd_.data();
+    job_.envTarget = envTarget_.data();
+    job_.envLeft = envLeft_.data();
+    job_.envelope = &envelope_;
+    job_.sampleRate = sampleRate_;
+    job_.tables = tables_;
+    job_.filterType = filterCoef ? filterType_ : VoiceFilter::OFF;
+    for (int k = 0; k < VoiceFilter::kStates; ++k) job_.filterState[k] = filterState_[k].data();
+    for (int k = 0; k < VoiceFilter::kCoefs; ++k) job_.filterCoef[k] = filterCoef ? filterCoef[k] : nullptr;
+    job_.source = sourceOut_.data();
+    job_.sourceStride = (int)kMaxFrames;
+    job_.count = (sounding_ + kVoiceLaneAlign - 1) / kVoiceLaneAlign * kVoiceLaneAlign;
+    jobInc_ = phaseInc;
+    jobFrames_ = n;
+
+    const int slices = (job_.count + kSliceLanes - 1) / kSliceLanes;
+    if (pool_) pool_->run(renderSliceTask, this, slices);
+    else       for (int s = 0; s < slices; ++s) renderSlice(s);
+
+    // Fixed reduction order, whoever rendered the slices
+    for (int s = 0; s < slices; ++s) {
+        const float* srcL = sliceOut_.data() + (size_t)s * 2 * kMaxFrames;
+        const float* srcR = srcL + kMaxFrames;
+        for (unsigned long i = 0; i < n; ++i) outL[i] += srcL[i];
+        for (unsigned long i = 0; i < n; ++i) outR[i] += srcR[i];
+    }
+}
+
+bool VoiceBank::setKernel(const char* name) {
+    const VoiceKernel* k = findVoiceKernel(name);
+    if (!k) return false;
+    kernel_ = k;
+    return true;
+}
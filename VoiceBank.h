@@ -0,0 +1,254 @@
+#ifndef VOICEBANK_H
+#define VOICEBANK_H
+
+#include <cstdint>
+#include <vector>
+#include "Envelope.h"
+#include "Fm.h"
+#include "Oscillator.h"
+#include "VoiceKernels.h"
+#include "Wavetable.h"
+
+class ModMatrix;
+class RenderPool;
+class Sampler;
+
+// Stable voice id: slot in the low VoiceBank::kSlotBits, generation above.
+// A handle stops resolving once its voice is removed or stolen, and does
+// not come back to life when the slot is reused (until the generation wraps
+// after 4095 reuses of that slot).
+typedef uint32_t VoiceHandle;
+static constexpr VoiceHandle kNoVoice = 0;
+
+// Fixed-capacity, structure-of-arrays voice pool. Each voice is a lane;
+// phase, envelope and stage live in contiguous arrays so a SIMD kernel can
+// render a whole block for many voices at once.
+//
+// All storage is allocated by setCapacity(); nothing else allocates, so the
+// pool is safe to drive from the audio thread. Lanes are kept partitioned:
+//
+//   [0, sounding)      rendered every block
+//   [sounding, count)  finished their release, skipped until retriggered
+//   [count, capacity)  free
+//
+// Voices are addressed by VoiceHandle. A slot table maps handles to lanes,
+// so add, remove and lookup are O(1) and nothing shifts when a voice goes.
+//
+// In unison mode a voice is a group of 2..kMaxUnison lanes, detuned and
+// spread across the stereo field, that take every command together; their
+// envelopes stay identical. The group's first slot gives the handle.
+// Capacity, size() and sounding() count lanes.
+//
+// Sounding lanes are rendered in fixed slices of kSliceLanes, each into its
+// own buffer, and the slices are summed in slice order. The result does not
+// depend on how many RenderPool threads rendered the slices.
+//
+// Oscillator::SAMPLE lanes play the Sampler zone for their note through a
+// stream of their own, opened at note start and closed when the lane
+// finishes. Each slice resamples its SAMPLE lanes into a per-lane buffer
+// before the kernel runs, and the kernel reads them there in place of a
+// waveform; envelope, filter, gains and modulation are the same as for any
+// other lane. A lane whose sample runs out finishes.
+//
+// Oscillator::FM lanes go through the same buffer: each slice first runs
+// the operators of its FM lanes (VoiceKernel::renderFm, with the settings
+// of setFm()). Every lane carries operator state, so FM voices allocate
+// nothing either. Operator envelopes restart with the voice's attack and
+// release with it.
+class VoiceBank {
+public:
+    enum StealPolicy { StealOldest, StealQuietest, StealReleasedFirst };
+
+    static constexpr int kSliceLanes = 64;
+    static constexpr unsigned long kMaxFrames = 1024;  // per render() call
+    static constexpr int kSlotBits = 20;                // up to 2^20 voices
+    static constexpr int kMaxUnison = 16;
+
+    VoiceBank();
+    ~VoiceBank();
+
+    // Allocates storage for maxVoices (at most 2^kSlotBits); drops all
+    // voices. Not for the audio thread.
+    void setCapacity(int maxVoices);
+    int capacity() const { return capacity_; }
+
+    void setSampleRate(float sr);
+
+    // ADSR shared by all voices. Running segments finish as they are;
+    // sustaining voices glide to a changed sustain level over the decay time.
+    void setEnvelope(const Envelope::Params& p);
+    const Envelope::Params& envelope() const { return envelope_; }
+
+    void setStealPolicy(StealPolicy p) { policy_ = p; }
+
+    // Lanes per voice (1..kMaxUnison), their spread in cents from lowest
+    // to highest, and stereo width 0..1; for voices started from now on
+    void setUnison(int lanes, float detuneCents, float spread);
+    int unison() const { return unison_; }
+
+    int size() const { return count_; }
+    int sounding() const { return sounding_; }
+
+    // Adds a voice and starts its attack (Oscillator::noteOn). When the
+    // pool is short of lanes, voices are stolen first; see stolen().
+    // Returns kNoVoice only if capacity is zero.
+    VoiceHandle add(Oscillator::Waveform w, float frequencyHz);
+    bool remove(VoiceHandle v);
+
+    // Voices stolen by the last add() or playNote(); their handles are dead
+    const std::vector<VoiceHandle>& stolen() const { return stolen_; }
+
+    // Removes released voices, quietest first, until at least `lanes`
+    // sounding lanes are gone or none are left releasing; returns the lanes
+    // removed. For shedding load.
+    int dropReleased(int lanes);
+    // Voices removed by the last dropReleased(); their handles are dead
+    const std::vector<VoiceHandle>& dropped() const { return dropped_; }
+
+    bool contains(VoiceHandle v) const { return laneOf(v) >= 0; }
+
+    void setFrequency(VoiceHandle v, float frequencyHz);
+    float getFrequency(VoiceHandle v) const;
+
+    void noteOn(VoiceHandle v);  // retrigger from the current level
+    void noteOff(VoiceHandle v);
+
+    // Starts a voice for MIDI note `note` (69 plays the shared pitch, other
+    // notes equal-tempered relative to it) at velocity 0..1. Reuses a
+    // finished note voice (under a new handle) when there is one,
+    // otherwise adds a voice, stealing as add() does.
+    VoiceHandle playNote(Oscillator::Waveform w, int note, float velocity);
+    // Releases every voice still holding `note`
+    void releaseNote(int note);
+
+    // Filter on every voice; a change of type clears the filter state.
+    // Coefficients come with each render() call.
+    void setFilterType(VoiceFilter::Type t);
+    VoiceFilter::Type filterType() const { return filterType_; }
+
+    // Adds n (<= kMaxFrames) frames of all sounding voices into outL and
+    // outR; phaseInc is per frame, and so is filterCoef[k] (VoiceFilter
+    // coefficients; only read when a filter is set). With mod, each slice
+    // first runs the matrix's per-lane routes (ModMatrix::apply) over its
+    // lanes, and the voices render at the pitch and gains that gives for
+    // the whole call.
+    void render(float* outL, float* outR, const float* phaseInc, unsigned long n,
+                const float* const* filterCoef = nullptr, const ModMatrix* mod = nullptr);
+
+    // Slices go to this pool's workers; nullptr renders them inline
+    void setRenderPool(RenderPool* pool) { pool_ = pool; }
+
+    // Band-limited wavetable oscillators, or nullptr for the naive shapes
+    void setWavetables(const Wavetables* tables) { tables_ = tables; }
+
+    // Instrument for SAMPLE voices; without one they play saws. Set it
+    // before any SAMPLE voice starts.
+    void setSampler(Sampler* sampler);
+
+    // Operators of the FM voices. Running operator segments finish as they
+    // are; the algorithm, ratios, levels and feedback apply from the next
+    // render() call.
+    void setFm(const FmParams& p);
+    const FmParams& fm() const { return fm_; }
+
+    bool setKernel(const char* name);
+    const VoiceKernel& kernel() const { return *kernel_; }
+
+private:
+    int laneOf(VoiceHandle v) const;
+    VoiceHandle handleOf(int lane) const;
+    void renew(int slot);
+    void enterStage(int lane, Envelope::Stage s);
+    void enterFmStage(int lane, Envelope::Stage s);
+    int allocLane();
+    void removeLane(int lane);
+    VoiceHandle addGroup(Oscillator::Waveform w, float frequencyHz, int note, float ratio, float velocity);
+    void startGroup(int head, Oscillator::Waveform w, int note, float ratio, float velocity);
+    void start(int lane, Oscillator::Waveform w, int note, float ratio, float gainL, float gainR, float phase,
+               float velocity);
+    void swapLanes(int a, int b);
+    void wake(int lane);
+    void cullFinished();
+    void openSample(int lane);
+    void closeSample(int lane);
+    int pickVictim() const;
+    void renderSlice(int slice);
+    static void renderSliceTask(void* self, int slice);
+
+    float sampleRate_ = 48000.0f;
+    int capacity_ = 0;
+    int count_ = 0;
+    int sounding_ = 0;
+    StealPolicy policy_ = StealReleasedFirst;
+    uint32_t serial_ = 0;
+    const VoiceKernel* kernel_;
+    const Wavetables* tables_ = nullptr;
+    Sampler* sampler_ = nullptr;
+    Envelope::Params envelope_;
+    FmParams fm_;
+    VoiceFilter::Type filterType_ = VoiceFilter::OFF;
+    RenderPool* pool_ = nullptr;
+    int unison_ = 1;
+    float unisonDetune_ = 0.0f;  // cents
+    float unisonSpread_ = 0.0f;
+    uint32_t random_ = 0x9E3779B9u;  // unison start phases
+
+    // Render state (padded to kVoiceLaneAlign lanes)
+    std::vector<float>   phase_, env_;
+    std::vector<int32_t> stage_, waveform_;
+    std::vector<float>   ratio_, gainL_, gainR_;
+    std::vector<float>   envMul_, envAdd_, envTarget_;
+    std::vector<int32_t> envLeft_;
+    std::vector<float>   filterState_[VoiceFilter::kStates];
+    std::vector<float>   velocity_;  // 0..1, a modulation source
+
+    // Pitch and gains after modulation; scratch, written per render() call
+    std::vector<float>   modRatio_, modGainL_, modGainR_;
+
+    std::vector<float> frequency_;
+    std::vector<int32_t> note_;  // MIDI note, or -1 for voices added with add()
+
+    // SAMPLE lanes: zone and stream (-1 for none), and the play position
+    // in source frames
+    std::vector<int32_t> zone_, stream_;
+    std::vector<double>  samplePos_;
+
+    // FM lanes: per operator, as the voice's own state above
+    struct FmOperatorLanes {
+        std::vector<float>   phase, env;
+        std::vector<int32_t> stage;
+        std::vector<float>   envMul, envAdd, envTarget;
+        std::vector<int32_t> envLeft;
+        std::vector<float>   last[2];
+    };
+    FmOperatorLanes fmOp_[kFmOperators];
+
+    // kMaxFrames of SAMPLE or FM audio per lane, rendered ahead of the kernel
+    std::vector<float> sourceOut_;
+
+    // Bookkeeping
+    std::vector<uint32_t> started_;  // note-on serial per lane, for StealOldest
+    std::vector<int32_t>  slotOf_;   // lane -> slot
+    std::vector<int32_t>  laneOf_;   // slot -> lane, -1 when free
+    std::vector<uint16_t> generation_;  // per slot
+    std::vector<int32_t>  freeSlots_;   // stack; reserved, never reallocates
+    std::vector<int32_t>  groupHead_;   // slot -> first slot of its voice
+    std::vector<int32_t>  groupNext_;   // slot -> next slot of its voice, or -1
+    std::vector<VoiceHandle> stolen_;   // reserved for kMaxUnison
+    std::vector<VoiceHandle> dropped_;  // reserved for capacity
+    struct Releasing {
+        float env;
+        VoiceHandle voice;
+    };
+    std::vector<Releasing> releasing_;  // dropReleased() scratch, reserved for capacity
+
+    // Per-slice mix buffers (left then right) and the job the slices are
+    // rendering
+    std::vector<float> sliceOut_;
+    VoiceLanes job_{};
+    const float* jobInc_ = nullptr;
+    const ModMatrix* jobMod_ = nullptr;
+    unsigned long jobFrames_ = 0;
+};
+
+#endif
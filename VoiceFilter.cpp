@@ -0,0 +1,59 @@
+#include "VoiceFilter.h"
+#include <algorithm>
+#include <cmath>
+
+// SVF:    c = { a1, a2, a3, k }, k = 1/Q
+// LADDER: c = { G, k, 1 / (1 + k G^4), 1 - G }, G = g / (1 + g)
+void VoiceFilter::coefficients(Type t, float cutoffHz, float resonance, float sampleRate, float* c) {
+    const float fc = std::clamp(cutoffHz, 10.0f, 0.45f * sampleRate);
+    const float g = std::tan(3.14159265f * fc / sampleRate);
+    const float r = std::clamp(resonance, 0.0f, 1.0f);
+
+    if (t == LADDER) {
+        const float G = g / (1.0f + g);
+        const float k = 3.9f * r;
+        const float G4 = G * G * G * G;
+        c[0] = G;
+        c[1] = k;
+        c[2] = 1.0f / (1.0f + k * G4);
+        c[3] = 1.0f - G;
+        return;
+    }
+
+    const float k = 2.0f - 1.98f * r;
+    const float a1 = 1.0f / (1.0f + g * (g + k));
+    c[0] = a1;
+    c[1] = g * a1;
+    c[2] = g * g * a1;
+    c[3] = k;
+}
+
+float VoiceFilter::process(Type t, const float* c, float* s, float x) {
+    switch (t) {
+        case OFF:
+            return x;
+        case LADDER: {
+            const float G = c[0];
+            // Output of the cascade is G^4 u + S; solve the feedback for u,
+            // with the input raised by 1 + k against the resonance's loss
+            const float S = (((s[0] * G + s[1]) * G + s[2]) * G + s[3]) * c[3];
+            float y = (x + c[1] * (x - S)) * c[2];
+            for (int j = 0; j < 4; ++j) {
+                const float v = (y - s[j]) * G;
+                y = v + s[j];
+                s[j] = y + v;
+            }
+            return y;
+        }
+        default: {
+            const float v3 = x - s[1];
+            const float v1 = c[0] * s[0] + c[1] * v3;
+            const float v2 = s[1] + c[1] * s[0] + c[2] * v3;
+            s[0] = 2.0f * v1 - s[0];
+            s[1] = 2.0f * v2 - s[1];
+            if (t == SVF_LOWPASS)  return v2;
+            if (t == SVF_BANDPASS) return v1;
+            return x - c[3] * v1 - v2;
+        }
+    }
+}
@@ -0,0 +1,37 @@
+#ifndef VOICEFILTER_H
+#define VOICEFILTER_H
+
+// Resonant filter run on every voice inside the voice kernels, between the
+// waveform and the envelope, so a finished envelope also silences the ring
+// and the voice can be culled. The type, cutoff and resonance are shared by
+// all voices and each lane keeps its own state. Coefficients are worked out
+// once per control tick and handed to the kernels per frame, so the
+// per-sample work is the filter itself.
+//
+// Both types are zero-delay-feedback (trapezoidal) designs, which stay
+// stable and keep their tuning under fast cutoff modulation:
+//   SVF_*   Simper's state-variable filter, 12 dB/oct; 2 state values
+//   LADDER  four one-pole stages with resonance feedback, 24 dB/oct
+//           lowpass; 4 state values, passband gain held up as resonance
+//           rises
+class VoiceFilter {
+public:
+    enum Type { OFF, SVF_LOWPASS, SVF_BANDPASS, SVF_HIGHPASS, LADDER };
+
+    static constexpr int kCoefs = 4;
+    static constexpr int kStates = 4;
+
+    // State values this small are flushed to zero between kernel runs,
+    // before a decaying voice can reach denormals
+    static constexpr float kFlush = 1e-15f;
+
+    // c[kCoefs] for cutoffHz (clamped to 10 Hz .. 0.45 sampleRate) and
+    // resonance 0..1 (self-oscillation is never quite reached)
+    static void coefficients(Type t, float cutoffHz, float resonance, float sampleRate, float* c);
+
+    // One sample through one voice's state; the scalar reference for the
+    // kernels
+    static float process(Type t, const float* c, float* state, float x);
+};
+
+#endif
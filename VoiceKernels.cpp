@@ -0,0 +1,105 @@
+#include "VoiceKernelsImpl.h"
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VOICE_KERNELS_X86 1
+void renderVoiceLanesAvx2(const VoiceLanes& lanes, const float* phaseInc, float* outL, float* outR,
+                          unsigned long n);
+void renderVoiceLanesAvx2Generic(const VoiceLanes& lanes, const float* phaseInc, float* outL, float* outR,
+                                 unsigned long n);
+void renderFmLanesAvx2(const FmLanes& lanes, const float* phaseInc, unsigned long n);
+#endif
+
+static void renderVoiceLanes4(const VoiceLanes& lanes, const float* phaseInc, float* outL, float* outR,
+                              unsigned long n) {
+    renderVoiceLanes<4, false>(lanes, phaseInc, outL, outR, n);
+}
+
+static void renderVoiceLanes4Generic(const VoiceLanes& lanes, const float* phaseInc, float* outL, float* outR,
+                                     unsigned long n) {
+    renderVoiceLanes<4, true>(lanes, phaseInc, outL, outR, n);
+}
+
+static void renderFmLanes4(const FmLanes& lanes, const float* phaseInc, unsigned long n) {
+    renderFmLanes<4>(lanes, phaseInc, n);
+}
+
+// The -generic kernels skip the per-group oscillator specializations; they
+// render the same output and are kept for comparison
+#ifdef VOICE_KERNELS_X86
+static const VoiceKernel kAvx2            = { "avx2", 8, renderVoiceLanesAvx2, renderFmLanesAvx2 };
+static const VoiceKernel kAvx2Generic     = { "avx2-generic", 8, renderVoiceLanesAvx2Generic, renderFmLanesAvx2 };
+static const VoiceKernel kBaseline        = { "sse2", 4, renderVoiceLanes4, renderFmLanes4 };
+static const VoiceKernel kBaselineGeneric = { "sse2-generic", 4, renderVoiceLanes4Generic, renderFmLanes4 };
+#else
+static const VoiceKernel kBaseline        = { "simd4", 4, renderVoiceLanes4, renderFmLanes4 };
+static const VoiceKernel kBaselineGeneric = { "simd4-generic", 4, renderVoiceLanes4Generic, renderFmLanes4 };
+#endif
+
+int availableVoiceKernels(const VoiceKernel** out, int max) {
+    int n = 0;
+#ifdef VOICE_KERNELS_X86
+    const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if (n < max && avx2) out[n++] = &kAvx2;
+#endif
+    if (n < max) out[n++] = &kBaseline;
+#ifdef VOICE_KERNELS_X86
+    if (n < max && avx2) out[n++] = &kAvx2Generic;
+#endif
+    if (n < max) out[n++] = &kBaselineGeneric;
+    return n;
+}
+
+const VoiceKernel& bestVoiceKernel() {
+    static const VoiceKernel* best = [] {
+        const VoiceKernel* k[4];
+        availableVoiceKernels(k, 4);
+        return k[0];
+    }();
+    return *best;
+}
+
+const VoiceKernel* findVoiceKernel(const char* name) {
+    const VoiceKernel* k[4];
+    const int n = availableVoiceKernels(k, 4);
+    for (int i = 0; i < n; ++i) {
+        if (std::strcmp(k[i]->name, name) == 0) return k[i];
+    }
+    return nullptr;
+}
+
+void advanceEnvelopes(const VoiceLanes& v, int first, int count) {
+    for (int l = first; l < first + count; ++l) {
+        if (v.envLeft[l] != 0) continue;
+
+        // Land exactly on the segment's target, then start the next stage
+        const Envelope::Stage s = Envelope::nextStage((Envelope::Stage)v.stage[l]);
+        v.env[l] = (s == Envelope::OFF) ? 0.0f : v.envTarget[l];
+
+        const EnvelopeSegment seg = Envelope::stageSegment(s, v.env[l], *v.envelope, v.sampleRate);
+        v.stage[l] = s;
+        v.envMul[l] = seg.mul;
+        v.envAdd[l] = seg.add;
+        v.envTarget[l] = seg.target;
+        v.envLeft[l] = seg.length;
+    }
+}
+
+void advanceFmEnvelopes(const FmLanes& v, int first, int count) {
+    for (int k = 0; k < kFmOperators; ++k) {
+        const Envelope::Params& p = v.params->op[k].envelope;
+        for (int l = first; l < first + count; ++l) {
+            if (v.envLeft[k][l] != 0) continue;
+
+            const Envelope::Stage s = Envelope::nextStage((Envelope::Stage)v.stage[k][l]);
+            v.env[k][l] = (s == Envelope::OFF) ? 0.0f : v.envTarget[k][l];
+
+            const EnvelopeSegment seg = Envelope::stageSegment(s, v.env[k][l], p, v.sampleRate);
+            v.stage[k][l] = s;
+            v.envMul[k][l] = seg.mul;
+            v.envAdd[k][l] = seg.add;
+            v.envTarget[k][l] = seg.target;
+            v.envLeft[k][l] = seg.length;
+        }
+    }
+}
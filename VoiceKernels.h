@@ -0,0 +1,102 @@
+#ifndef VOICEKERNELS_H
+#define VOICEKERNELS_H
+
+#include <cstdint>
+#include "Envelope.h"
+#include "Fm.h"
+#include "VoiceFilter.h"
+
+class Wavetables;
+
+// Structure-of-arrays view of a voice bank handed to the render kernels.
+// All arrays hold `count` entries, and `count` is a multiple of
+// kVoiceLaneAlign so any kernel width can load whole vectors.
+struct VoiceLanes {
+    float*   phase;
+    float*   env;
+    int32_t* stage;        // Envelope::Stage
+    const int32_t* waveform; // Oscillator::Waveform
+    const float* ratio;    // pitch relative to the shared phase increment
+    const float* gainL;    // output level per channel; equal for
+    const float* gainR;    // centred voices
+
+    // Current envelope segment (see EnvelopeSegment); envLeft counts the
+    // samples until it ends
+    float*   envMul;
+    float*   envAdd;
+    float*   envTarget;
+    int32_t* envLeft;
+
+    // Shared ADSR settings, for starting the next segment
+    const Envelope::Params* envelope;
+    float sampleRate;
+
+    // Band-limited tables, or nullptr for the naive waveforms
+    const Wavetables* tables;
+
+    // Per-voice filter (VoiceFilter::Type). State is per lane; the
+    // coefficients are per frame, like the phase increments, and shared
+    float* filterState[VoiceFilter::kStates];
+    const float* filterCoef[VoiceFilter::kCoefs];
+    int32_t filterType;
+
+    // Audio of the SAMPLE and FM lanes, rendered ahead of the kernel: lane
+    // l's frame i is source[l * sourceStride + i]
+    const float* source;
+    int sourceStride;
+
+    int count;
+};
+
+static constexpr int kVoiceLaneAlign = 8;
+
+// The operators of the FM lanes (see Fm.h), one set of arrays per
+// operator, laid out like VoiceLanes
+struct FmLanes {
+    float*   phase[kFmOperators];
+    float*   env[kFmOperators];
+    int32_t* stage[kFmOperators];
+    float*   envMul[kFmOperators];
+    float*   envAdd[kFmOperators];
+    float*   envTarget[kFmOperators];
+    int32_t* envLeft[kFmOperators];
+    float*   last[kFmOperators][2];   // the last two outputs, for feedback
+
+    const int32_t* waveform; // only Oscillator::FM lanes are written
+    const float* ratio;
+    const FmParams* params;
+    float sampleRate;
+
+    float* out;            // lane l's frame i at out[l * outStride + i]
+    int outStride;
+    int count;
+};
+
+// Renders n frames of every lane and adds the mix into outL and outR.
+// phaseInc[i] is the shared per-sample phase increment; each lane advances
+// by phaseInc[i] * ratio (limited to half a cycle per sample).
+typedef void (*VoiceRenderFn)(const VoiceLanes& lanes, const float* phaseInc,
+                              float* outL, float* outR, unsigned long n);
+
+// Renders n frames of every FM lane's operators into lanes.out, with the
+// same phase increments and limit as VoiceRenderFn
+typedef void (*FmRenderFn)(const FmLanes& lanes, const float* phaseInc, unsigned long n);
+
+struct VoiceKernel {
+    const char* name;
+    int width;
+    VoiceRenderFn render;
+    FmRenderFn renderFm;
+};
+
+// Starts the next stage of every lane in [first, first + count) whose
+// segment has run out. Scalar; kernels call it only at segment boundaries.
+void advanceEnvelopes(const VoiceLanes& lanes, int first, int count);
+void advanceFmEnvelopes(const FmLanes& lanes, int first, int count);
+
+// Kernels usable on this CPU, best first
+int availableVoiceKernels(const VoiceKernel** out, int max);
+const VoiceKernel& bestVoiceKernel();
+const VoiceKernel* findVoiceKernel(const char* name);
+
+#endif
@@ -0,0 +1,21 @@
+// Built with -mavx2 -mfma on x86 (see CMakeLists.txt); only reached after
+// a runtime CPU check in VoiceKernels.cpp.
+#if defined(__x86_64__) || defined(__i386__)
+
+#include "VoiceKernelsImpl.h"
+
+void renderVoiceLanesAvx2(const VoiceLanes& lanes, const float* phaseInc, float* outL, float* outR,
+                          unsigned long n) {
+    renderVoiceLanes<8, false>(lanes, phaseInc, outL, outR, n);
+}
+
+void renderVoiceLanesAvx2Generic(const VoiceLanes& lanes, const float* phaseInc, float* outL, float* outR,
+                                 unsigned long n) {
+    renderVoiceLanes<8, true>(lanes, phaseInc, outL, outR, n);
+}
+
+void renderFmLanesAvx2(const FmLanes& lanes, const float* phaseInc, unsigned long n) {
+    renderFmLanes<8>(lanes, phaseInc, n);
+}
+
+#endif
@@ -0,0 +1,495 @@
+#ifndef VOICEKERNELSIMPL_H
+#define VOICEKERNELSIMPL_H
+
+// Kernel bodies shared by VoiceKernels.cpp and VoiceKernelsAvx2.cpp.
+// Include only from those TUs; see the linkage note in Simd.h.
+
+#include <array>
+#include <utility>
+#include "FastMath.h"
+#include "VoiceKernels.h"
+#include "Oscillator.h"
+#include "Wavetable.h"
+
+namespace {
+
+// Frames rendered per pass; bounds the lane accumulator on the stack
+static constexpr unsigned long kChunk = 256;
+
+// What a group's oscillators need, decided once per group and chunk:
+// wavetables, one naive shape or pre-rendered audio for every lane, or
+// per-lane selects
+enum OscClass { OSC_TABLE, OSC_SAW, OSC_SQUARE, OSC_SINE, OSC_SOURCE, OSC_MIXED, kOscClasses };
+static constexpr int kFilterTypes = VoiceFilter::LADDER + 1;
+
+// Waveforms rendered ahead of the kernel into VoiceLanes::source
+inline bool isSourceWave(int32_t w) { return w == Oscillator::SAMPLE || w == Oscillator::FM; }
+
+// Renders U vectors of N lanes starting at lane g. The phase update is a
+// loop-carried add/compare/select chain, so several independent vectors are
+// kept in flight to cover its latency. maxInc is the chunk's highest shared
+// increment; with v.tables set each lane uses the mip level for its own
+// highest pitch, otherwise the naive shapes.
+//
+// Envelopes run as segments: between boundaries every lane is a plain
+// multiply-add, so the chunk is cut into runs up to the nearest segment end
+// of any lane and the stage changes are handled in scalar code in between.
+//
+// FT is the VoiceFilter::Type, fixed per instantiation so the unfiltered
+// path has no filter code at all. coef[k] + i is frame i's coefficient k.
+// OSC is the group's OscClass, so the per-sample oscillator is a single
+// shape with no branches or selects unless the lanes really are mixed.
+// SAMPLE and FM lanes read their audio from v.source; among other lanes
+// (in OSC_TABLE and OSC_MIXED groups) they are selected per lane.
+// ST groups hold panned lanes and mix into accL and accR; the others have
+// one gain for both channels and mix into accL only.
+template <int N, int U, int FT, int OSC, bool ST>
+void renderGroup(const VoiceLanes& v, int g, const float* phaseInc, const float* const* coef,
+                 float maxInc, typename simd::Vec<N>::f* accL, typename simd::Vec<N>::f* accR,
+                 unsigned long len)
+{
+    typedef typename simd::Vec<N>::f F;
+    typedef typename simd::Vec<N>::i I;
+    constexpr int S = VoiceFilter::kStates;
+
+    F phase[U], ratio[U], gainL[U], gainR[U], env[U], mul[U], add[U];
+    I left[U], isSine[U], isSquare[U], isSource[U], sourceAt[U], table[U];
+    F state[U][S];
+    bool anySine = false, anySource = false;
+
+    for (int u = 0; u < U; ++u) {
+        const int l = g + u * N;
+        phase[u] = simd::load<N>(v.phase + l);
+        gainL[u] = simd::load<N>(v.gainL + l);
+        if constexpr (ST) gainR[u] = simd::load<N>(v.gainR + l);
+
+        // Keeps every lane under half a cycle per sample, so one
+        // conditional subtract is enough to wrap the phase
+        ratio[u] = simd::vmin<N>(simd::load<N>(v.ratio + l), simd::splat<N>(0.5f / maxInc));
+
+        if constexpr (OSC == OSC_MIXED) {
+            const I wave = simd::loadi<N>(v.waveform + l);
+            isSine[u]   = wave == (int32_t)Oscillator::SINE;
+            isSquare[u] = wave == (int32_t)Oscillator::SQUARE;
+            anySine = anySine || simd::any<N>(isSine[u]);
+        }
+        if constexpr (OSC == OSC_SOURCE || OSC == OSC_TABLE || OSC == OSC_MIXED) {
+            int32_t at[N];
+            for (int k = 0; k < N; ++k) at[k] = (l + k) * v.sourceStride;
+            sourceAt[u] = simd::loadi<N>(at);
+            const I wave = simd::loadi<N>(v.waveform + l);
+            isSource[u] = (wave == (int32_t)Oscillator::SAMPLE) | (wave == (int32_t)Oscillator::FM);
+            anySource = anySource || simd::any<N>(isSource[u]);
+        }
+        if constexpr (OSC == OSC_TABLE) {
+            int32_t offset[N];
+            for (int k = 0; k < N; ++k) {
+                const int level = Wavetables::levelFor(maxInc * ratio[u][k]);
+                const int32_t w = v.waveform[l + k];
+                offset[k] = isSourceWave(w) ? 0 : v.tables->offset((Oscillator::Waveform)w, level);
+            }
+            table[u] = simd::loadi<N>(offset);
+        }
+        if constexpr (FT != VoiceFilter::OFF) {
+            for (int k = 0; k < S; ++k) state[u][k] = simd::load<N>(v.filterState[k] + l);
+        }
+    }
+
+    auto loadEnvelopes = [&]() {
+        for (int u = 0; u < U; ++u) {
+            const int l = g + u * N;
+            env[u]  = simd::load<N>(v.env + l);
+            mul[u]  = simd::load<N>(v.envMul + l);
+            add[u]  = simd::load<N>(v.envAdd + l);
+            left[u] = simd::loadi<N>(v.envLeft + l);
+        }
+    };
+    auto storeEnvelopes = [&]() {
+        for (int u = 0; u < U; ++u) {
+            const int l = g + u * N;
+            simd::store<N>(v.env + l, env[u]);
+            simd::storei<N>(v.envLeft + l, left[u]);
+        }
+    };
+
+    const float* tableData = OSC == OSC_TABLE ? v.tables->data() : nullptr;
+
+    auto square = [](F p) {
+        return simd::select<N>(p < 0.5f, simd::splat<N>(1.0f), simd::splat<N>(-1.0f));
+    };
+    auto sourced = [&](int u, unsigned long frame) {
+        return simd::gather<N>(v.source, sourceAt[u] + (int32_t)frame);
+    };
+    auto oscillator = [&](int u, unsigned long frame) {
+        if constexpr (OSC == OSC_TABLE) {
+            const F x = phase[u] * (float)Wavetables::kSize;
+            I i = __builtin_convertvector(x, I);
+            i = simd::selecti<N>(i > Wavetables::kSize - 1, simd::splati<N>(Wavetables::kSize - 1), i);
+            const F frac = x - __builtin_convertvector(i, F);
+            const F a = simd::gather<N>(tableData, table[u] + i);
+            const F b = simd::gather<N>(tableData, table[u] + i + 1);
+            F osc = a + frac * (b - a);
+            if (anySource) osc = simd::select<N>(isSource[u], sourced(u, frame), osc);
+            return osc;
+        } else if constexpr (OSC == OSC_SAW) {
+            return 2.0f * phase[u] - 1.0f;
+        } else if constexpr (OSC == OSC_SQUARE) {
+            return square(phase[u]);
+        } else if constexpr (OSC == OSC_SINE) {
+            return simd::sin2pi<N>(phase[u]);
+        } else if constexpr (OSC == OSC_SOURCE) {
+            return sourced(u, frame);
+        } else {
+            // Saw by default, square/sine/source where selected
+            F osc = 2.0f * phase[u] - 1.0f;
+            osc = simd::select<N>(isSquare[u], square(phase[u]), osc);
+            if (anySine) osc = simd::select<N>(isSine[u], simd::sin2pi<N>(phase[u]), osc);
+            if (anySource) osc = simd::select<N>(isSource[u], sourced(u, frame), osc);
+            return osc;
+        }
+    };
+
+    auto advance = [&](int u, float inc) {
+        phase[u] += inc * ratio[u];
+        phase[u] = simd::select<N>(phase[u] >= 1.0f, phase[u] - 1.0f, phase[u]);
+    };
+
+    // One sample of vector u through the voice filter; c is the frame's
+    // coefficients, broadcast (see VoiceFilter::process for the maths)
+    auto filter = [&](int u, F x, const F* c) {
+        F* s = state[u];
+        if constexpr (FT == VoiceFilter::LADDER) {
+            const F fb = (((s[0] * c[0] + s[1]) * c[0] + s[2]) * c[0] + s[3]) * c[3];
+            F y = (x + c[1] * (x - fb)) * c[2];
+            for (int k = 0; k < 4; ++k) {
+                const F t = (y - s[k]) * c[0];
+                y = t + s[k];
+                s[k] = y + t;
+            }
+            return y;
+        } else {
+            const F v3 = x - s[1];
+            const F v1 = c[0] * s[0] + c[1] * v3;
+            const F v2 = s[1] + c[1] * s[0] + c[2] * v3;
+            s[0] = 2.0f * v1 - s[0];
+            s[1] = 2.0f * v2 - s[1];
+            if constexpr (FT == VoiceFilter::SVF_LOWPASS)  return v2;
+            if constexpr (FT == VoiceFilter::SVF_BANDPASS) return v1;
+            return x - c[3] * v1 - v2;
+        }
+    };
+    auto frameCoefs = [&](unsigned long i, F* c) {
+        for (int k = 0; k < VoiceFilter::kCoefs; ++k) c[k] = simd::splat<N>(coef[k][i]);
+    };
+
+    loadEnvelopes();
+
+    unsigned long i = 0;
+    while (i < len) {
+        int32_t next = simd::hmini<N>(left[0]);
+        for (int u = 1; u < U; ++u) {
+            const int32_t m = simd::hmini<N>(left[u]);
+            next = m < next ? m : next;
+        }
+        const unsigned long run = (unsigned long)next < len - i ? (unsigned long)next : len - i;
+
+        // Sustaining or silent lanes hold their level; when the whole group
+        // does, the multiply-add (a loop-carried chain) is skipped
+        bool constant = true;
+        for (int u = 0; u < U; ++u) {
+            constant = constant && !simd::any<N>((mul[u] != 1.0f) | (add[u] != 0.0f));
+        }
+
+        if (constant) {
+            F levelL[U], levelR[U];
+            for (int u = 0; u < U; ++u) {
+                levelL[u] = env[u] * gainL[u];
+                if constexpr (ST) levelR[u] = env[u] * gainR[u];
+            }
+            for (const unsigned long end = i + run; i < end; ++i) {
+                F sumL = F{}, sumR = F{};
+                F c[VoiceFilter::kCoefs];
+                if constexpr (FT != VoiceFilter::OFF) frameCoefs(i, c);
+                for (int u = 0; u < U; ++u) {
+                    F osc = oscillator(u, i);
+                    if constexpr (FT != VoiceFilter::OFF) osc = filter(u, osc, c);
+                    sumL += osc * levelL[u];
+                    if constexpr (ST) sumR += osc * levelR[u];
+                    advance(u, phaseInc[i]);
+                }
+                accL[i] += sumL;
+                if constexpr (ST) accR[i] += sumR;
+            }
+        }
+        else {
+            for (const unsigned long end = i + run; i < end; ++i) {
+                F sumL = F{}, sumR = F{};
+                F c[VoiceFilter::kCoefs];
+                if constexpr (FT != VoiceFilter::OFF) frameCoefs(i, c);
+                for (int u = 0; u < U; ++u) {
+                    F osc = oscillator(u, i);
+                    if constexpr (FT != VoiceFilter::OFF) osc = filter(u, osc, c);
+                    advance(u, phaseInc[i]);
+                    env[u] = env[u] * mul[u] + add[u];
+                    const F x = osc * env[u];
+                    sumL += x * gainL[u];
+                    if constexpr (ST) sumR += x * gainR[u];
+                }
+                accL[i] += sumL;
+                if constexpr (ST) accR[i] += sumR;
+            }
+        }
+
+        for (int u = 0; u < U; ++u) left[u] -= (int32_t)run;
+        if ((unsigned long)next == run) {
+            storeEnvelopes();
+            advanceEnvelopes(v, g, U * N);
+            loadEnvelopes();
+        }
+    }
+
+    for (int u = 0; u < U; ++u) simd::store<N>(v.phase + g + u * N, phase[u]);
+    storeEnvelopes();
+
+    // Flushing here, once per run, keeps decaying voices out of denormals
+    if constexpr (FT != VoiceFilter::OFF) {
+        for (int u = 0; u < U; ++u) {
+            for (int k = 0; k < S; ++k) {
+                const F x = state[u][k];
+                simd::store<N>(v.filterState[k] + g + u * N,
+                               simd::select<N>(simd::vabs<N>(x) < VoiceFilter::kFlush, F{}, x));
+            }
+        }
+    }
+}
+
+// True if any of lanes [g, g + count) is panned off centre
+inline bool panned(const VoiceLanes& v, int g, int count) {
+    for (int l = g; l < g + count; ++l) {
+        if (v.gainL[l] != v.gainR[l]) return true;
+    }
+    return false;
+}
+
+// OSC_SOURCE when every lane is pre-rendered; else OSC_TABLE with
+// wavetables, otherwise the lanes' shared naive shape, or OSC_MIXED.
+// Unused padding lanes count, and are usually saws.
+inline int oscClass(const VoiceLanes& v, int g, int count) {
+    const int32_t w = v.waveform[g];
+    bool same = true;
+    for (int l = g + 1; l < g + count; ++l) same = same && v.waveform[l] == w;
+    bool source = true;
+    for (int l = g; l < g + count; ++l) source = source && isSourceWave(v.waveform[l]);
+    if (source) return OSC_SOURCE;
+    if (v.tables) return OSC_TABLE;
+    if (!same || isSourceWave(w)) return OSC_MIXED;
+    return w == Oscillator::SAW ? OSC_SAW : w == Oscillator::SQUARE ? OSC_SQUARE : OSC_SINE;
+}
+
+template <int N>
+using GroupFn = void (*)(const VoiceLanes&, int, const float*, const float* const*, float,
+                         typename simd::Vec<N>::f*, typename simd::Vec<N>::f*, unsigned long);
+
+// Every renderGroup<N, U> instantiation, indexed by
+// (filter type * kOscClasses + oscillator class) * 2 + stereo
+template <int N, int U, size_t... K>
+constexpr std::array<GroupFn<N>, sizeof...(K)> makeGroupTable(std::index_sequence<K...>) {
+    return {{ &renderGroup<N, U, (int)(K / (2 * kOscClasses)), (int)(K / 2 % kOscClasses), K % 2 == 1>... }};
+}
+
+template <int N, int U>
+GroupFn<N> groupFn(int filter, int osc, bool stereo) {
+    static constexpr auto table = makeGroupTable<N, U>(std::make_index_sequence<kFilterTypes * kOscClasses * 2>{});
+    return table[(filter * kOscClasses + osc) * 2 + (stereo ? 1 : 0)];
+}
+
+// Picks each group's instantiation from the table once per chunk. The
+// generic variant resolves the waveform per lane and sample (OSC_MIXED),
+// as a kernel without the oscillator specializations would.
+template <int N, bool Generic>
+void renderVoiceLanes(const VoiceLanes& v, const float* phaseInc, float* outL, float* outR, unsigned long n) {
+    typedef typename simd::Vec<N>::f F;
+    static constexpr int U = 4;
+
+    // Centred groups share acc; panned ones add their own left and right
+    // on top, so an all-centred bank pays for one channel
+    F acc[kChunk], accL[kChunk], accR[kChunk];
+
+    const int filter = v.filterType >= 0 && v.filterType < kFilterTypes ? v.filterType : VoiceFilter::OFF;
+
+    for (unsigned long base = 0; base < n; base += kChunk) {
+        const unsigned long len = (n - base < kChunk) ? n - base : kChunk;
+        for (unsigned long i = 0; i < len; ++i) acc[i] = F{};
+
+        // Left/right accumulators are cleared on the first panned group
+        bool stereo = false;
+        auto stereoAcc = [&]() {
+            if (!stereo) {
+                for (unsigned long i = 0; i < len; ++i) accL[i] = accR[i] = F{};
+                stereo = true;
+            }
+            return accL;
+        };
+
+        // Mip levels are chosen per chunk, for its highest pitch
+        float maxInc = 0.0f;
+        for (unsigned long i = 0; i < len; ++i) maxInc = phaseInc[base + i] > maxInc ? phaseInc[base + i] : maxInc;
+
+        const float* coef[VoiceFilter::kCoefs];
+        for (int k = 0; k < VoiceFilter::kCoefs; ++k) coef[k] = filter != VoiceFilter::OFF ? v.filterCoef[k] + base : nullptr;
+
+        // Source audio is laid out per call; the groups index it per chunk
+        VoiceLanes lanes = v;
+        lanes.source = v.source + base;
+
+        const float* inc = phaseInc + base;
+        auto group = [&](GroupFn<N> (*fn)(int, int, bool), int g, int count) {
+            const int osc = Generic ? (v.tables ? OSC_TABLE : OSC_MIXED) : oscClass(v, g, count);
+            if (panned(v, g, count)) fn(filter, osc, true)(lanes, g, inc, coef, maxInc, stereoAcc(), accR, len);
+            else                     fn(filter, osc, false)(lanes, g, inc, coef, maxInc, acc, nullptr, len);
+        };
+        int g = 0;
+        for (; g + U * N <= v.count; g += U * N) group(groupFn<N, U>, g, U * N);
+        for (; g < v.count; g += N)              group(groupFn<N, 1>, g, N);
+
+        if (!stereo) {
+            for (unsigned long i = 0; i < len; ++i) {
+                const float x = simd::hsum<N>(acc[i]);
+                outL[base + i] += x;
+                outR[base + i] += x;
+            }
+            continue;
+        }
+        for (unsigned long i = 0; i < len; ++i) {
+            outL[base + i] += simd::hsum<N>(acc[i] + accL[i]);
+            outR[base + i] += simd::hsum<N>(acc[i] + accR[i]);
+        }
+    }
+}
+
+// Renders the FM lanes among lanes [g, g + N): all operators of algorithm
+// ALG, fixed per instantiation so the routing unrolls to straight-line
+// code with no per-sample lookups. Operator envelopes run as segments, as
+// in renderGroup. Only the FM lanes' rows of v.out are written.
+//
+// One vector at a time: with four sines per sample the loop is bound by
+// arithmetic, and a second vector in flight only spills registers.
+template <int N, int ALG>
+void renderFmGroup(const FmLanes& v, int g, const float* phaseInc, float maxInc, unsigned long n)
+{
+    typedef typename simd::Vec<N>::f F;
+    typedef typename simd::Vec<N>::i I;
+    constexpr int K = kFmOperators;
+    constexpr FmAlgorithm A = kFmAlgorithmTable[ALG];
+    constexpr float carrierGain = 1.0f / __builtin_popcount(A.carriers);
+
+    F phase[K], ratio[K], level[K], feedback[K], last0[K], last1[K], env[K], mul[K], add[K];
+    I left[K];
+
+    const F laneRatio = simd::load<N>(v.ratio + g);
+    for (int k = 0; k < K; ++k) {
+        const FmOperator& op = v.params->op[k];
+        phase[k] = simd::load<N>(v.phase[k] + g);
+        ratio[k] = simd::vmin<N>(laneRatio * op.ratio, simd::splat<N>(0.5f / maxInc));
+        level[k] = simd::splat<N>(op.level);
+        feedback[k] = simd::splat<N>(0.5f * op.feedback);
+        last0[k] = simd::load<N>(v.last[k][0] + g);
+        last1[k] = simd::load<N>(v.last[k][1] + g);
+    }
+
+    bool write[N];
+    for (int b = 0; b < N; ++b) write[b] = v.waveform[g + b] == Oscillator::FM;
+
+    auto loadEnvelopes = [&]() {
+        for (int k = 0; k < K; ++k) {
+            env[k]  = simd::load<N>(v.env[k] + g);
+            mul[k]  = simd::load<N>(v.envMul[k] + g);
+            add[k]  = simd::load<N>(v.envAdd[k] + g);
+            left[k] = simd::loadi<N>(v.envLeft[k] + g);
+        }
+    };
+    auto storeEnvelopes = [&]() {
+        for (int k = 0; k < K; ++k) {
+            simd::store<N>(v.env[k] + g, env[k]);
+            simd::storei<N>(v.envLeft[k] + g, left[k]);
+        }
+    };
+
+    loadEnvelopes();
+
+    unsigned long i = 0;
+    while (i < n) {
+        int32_t next = simd::hmini<N>(left[0]);
+        for (int k = 1; k < K; ++k) {
+            const int32_t m = simd::hmini<N>(left[k]);
+            next = m < next ? m : next;
+        }
+        const unsigned long run = (unsigned long)next < n - i ? (unsigned long)next : n - i;
+
+        for (const unsigned long end = i + run; i < end; ++i) {
+            F y[K];
+            F out = F{};
+            for (int k = K - 1; k >= 0; --k) {
+                F pm = phase[k] + feedback[k] * (last0[k] + last1[k]);
+                for (int j = k + 1; j < K; ++j) {
+                    if ((A.modulators[k] >> j) & 1) pm += y[j];
+                }
+                env[k] = env[k] * mul[k] + add[k];
+                y[k] = simd::sin2pi<N>(pm) * (env[k] * level[k]);
+                last1[k] = last0[k];
+                last0[k] = y[k];
+                if ((A.carriers >> k) & 1) out += y[k];
+
+                phase[k] += phaseInc[i] * ratio[k];
+                phase[k] = simd::select<N>(phase[k] >= 1.0f, phase[k] - 1.0f, phase[k]);
+            }
+            out *= carrierGain;
+            for (int b = 0; b < N; ++b) {
+                if (write[b]) v.out[(size_t)(g + b) * v.outStride + i] = out[b];
+            }
+        }
+
+        for (int k = 0; k < K; ++k) left[k] -= (int32_t)run;
+        if ((unsigned long)next == run) {
+            storeEnvelopes();
+            advanceFmEnvelopes(v, g, N);
+            loadEnvelopes();
+        }
+    }
+
+    for (int k = 0; k < K; ++k) {
+        simd::store<N>(v.phase[k] + g, phase[k]);
+        simd::store<N>(v.last[k][0] + g, last0[k]);
+        simd::store<N>(v.last[k][1] + g, last1[k]);
+    }
+    storeEnvelopes();
+}
+
+template <int N>
+using FmGroupFn = void (*)(const FmLanes&, int, const float*, float, unsigned long);
+
+template <int N, size_t... A>
+constexpr std::array<FmGroupFn<N>, sizeof...(A)> makeFmTable(std::index_sequence<A...>) {
+    return {{ &renderFmGroup<N, (int)A>... }};
+}
+
+// Groups without an FM lane are skipped
+template <int N>
+void renderFmLanes(const FmLanes& v, const float* phaseInc, unsigned long n) {
+    static constexpr auto table = makeFmTable<N>(std::make_index_sequence<kFmAlgorithms>{});
+    const int a = v.params->algorithm;
+    const FmGroupFn<N> fn = table[a >= 0 && a < kFmAlgorithms ? a : 0];
+
+    float maxInc = 0.0f;
+    for (unsigned long i = 0; i < n; ++i) maxInc = phaseInc[i] > maxInc ? phaseInc[i] : maxInc;
+
+    for (int g = 0; g < v.count; g += N) {
+        bool fm = false;
+        for (int l = g; l < g + N; ++l) fm = fm || v.waveform[l] == Oscillator::FM;
+        if (fm) fn(v, g, phaseInc, maxInc, n);
+    }
+}
+
+} // namespace
+
+#endif
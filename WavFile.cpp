@@ -0,0 +1,142 @@
+#include "WavFile.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+static void put16(std::FILE* f, uint16_t v) {
+    unsigned char b[2] = { (unsigned char)(v & 0xff), (unsigned char)(v >> 8) };
+    std::fwrite(b, 1, 2, f);
+}
+
+static void put32(std::FILE* f, uint32_t v) {
+    unsigned char b[4] = {
+        (unsigned char)(v & 0xff),         (unsigned char)((v >> 8) & 0xff),
+        (unsigned char)((v >> 16) & 0xff), (unsigned char)(v >> 24)
+    };
+    std::fwrite(b, 1, 4, f);
+}
+
+bool writeWav(const std::string& path,
+              const float* samples,
+              unsigned long frames,
+              int channels,
+              int sampleRate)
+{
+    std::FILE* f = std::fopen(path.c_str(), "wb");
+    if (!f) {
+        std::fprintf(stderr, "writeWav: cannot open %s\n", path.c_str());
+        return false;
+    }
+
+    const uint32_t dataBytes = (uint32_t)(frames * channels * sizeof(float));
+
+    std::fwrite("RIFF", 1, 4, f);
+    put32(f, 36 + dataBytes);
+    std::fwrite("WAVE", 1, 4, f);
+
+    std::fwrite("fmt ", 1, 4, f);
+    put32(f, 16);
+    put16(f, 3); // WAVE_FORMAT_IEEE_FLOAT
+    put16(f, (uint16_t)channels);
+    put32(f, (uint32_t)sampleRate);
+    put32(f, (uint32_t)(sampleRate * channels * sizeof(float)));
+    put16(f, (uint16_t)(channels * sizeof(float)));
+    put16(f, 32);
+
+    std::fwrite("data", 1, 4, f);
+    put32(f, dataBytes);
+
+    // Sample data goes out in host order; every host we build for is little-endian
+    const size_t n = (size_t)frames * channels;
+    const bool ok = std::fwrite(samples, sizeof(float), n, f) == n;
+
+    std::fclose(f);
+    if (!ok) std::fprintf(stderr, "writeWav: short write to %s\n", path.c_str());
+    return ok;
+}
+
+static uint32_t get16(const unsigned char* p) { return p[0] | (p[1] << 8); }
+static uint32_t get32(const unsigned char* p) { return get16(p) | (get16(p + 2) << 16); }
+
+bool parseWav(const unsigned char* file, size_t size, WavLayout& out, std::string& error) {
+    if (size < 12 || std::memcmp(file, "RIFF", 4) != 0 || std::memcmp(file + 8, "WAVE", 4) != 0) {
+        error = "not a WAV file";
+        return false;
+    }
+
+    bool haveFormat = false;
+    int format = 0;
+    for (size_t at = 12; at + 8 <= size;) {
+        const unsigned char* chunk = file + at;
+        const uint32_t bytes = get32(chunk + 4);
+        const size_t body = at + 8;
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && bytes >= 16 && body + 16 <= size) {
+            format = (int)get16(file + body);
+            out.channels = (int)get16(file + body + 2);
+            out.sampleRate = (int)get32(file + body + 4);
+            out.bits = (int)get16(file + body + 14);
+            // WAVE_FORMAT_EXTENSIBLE: the real format leads the sub-format GUID
+            if (format == 0xfffe && bytes >= 40 && body + 26 <= size) format = (int)get16(file + body + 24);
+            haveFormat = true;
+        }
+        else if (std::memcmp(chunk, "data", 4) == 0) {
+            if (!haveFormat) break;
+            const bool pcm = format == 1 && (out.bits == 16 || out.bits == 24);
+            const bool ieee = format == 3 && out.bits == 32;
+            if (!pcm && !ieee) {
+                error = "unsupported WAV format " + std::to_string(format) + ", " +
+                        std::to_string(out.bits) + " bits";
+                return false;
+            }
+            if (out.channels < 1 || out.sampleRate < 1) {
+                error = "bad WAV channel count or sample rate";
+                return false;
+            }
+            out.isFloat = ieee;
+            out.dataOffset = body;
+            const size_t frameBytes = (size_t)out.channels * (out.bits / 8);
+            out.frames = std::min<uint64_t>(bytes, size - body) / frameBytes;
+            return true;
+        }
+        at = body + bytes + (bytes & 1);  // chunks are padded to even sizes
+    }
+    error = haveFormat ? "WAV file has no data chunk" : "WAV file has no format chunk";
+    return false;
+}
+
+float wavSample(const unsigned char* p, const WavLayout& layout) {
+    if (layout.isFloat) {
+        float x;
+        std::memcpy(&x, p, 4);
+        return x;
+    }
+    if (layout.bits == 16) return (int16_t)(p[0] | p[1] << 8) * (1.0f / 32768.0f);
+    return ((int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) >> 8) * (1.0f / 8388608.0f);
+}
+
+bool readWav(const std::string& path, std::vector<float>& samples, WavLayout& layout, std::string& error) {
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::vector<unsigned char> file;
+    unsigned char buf[65536];
+    for (size_t n; (n = std::fread(buf, 1, sizeof(buf), f)) > 0;) file.insert(file.end(), buf, buf + n);
+    std::fclose(f);
+
+    if (!parseWav(file.data(), file.size(), layout, error)) {
+        error = path + ": " + error;
+        return false;
+    }
+    const int bytes = layout.bits / 8;
+    const unsigned char* p = file.data() + layout.dataOffset;
+    samples.resize((size_t)layout.frames * layout.channels);
+    for (float& s : samples) {
+        s = wavSample(p, layout);
+        p += bytes;
+    }
+    return true;
+}
@@ -0,0 +1,38 @@
+#ifndef WAVFILE_H
+#define WAVFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Writes interleaved float samples as a 32-bit IEEE float WAV file.
+bool writeWav(const std::string& path,
+              const float* samples,
+              unsigned long frames,
+              int channels,
+              int sampleRate);
+
+// Where a WAV file's sample data is and how it is stored, as found by
+// parseWav(). Samples are interleaved and little-endian.
+struct WavLayout {
+    int channels = 0;
+    int sampleRate = 0;
+    int bits = 0;          // 16 or 24 (integer PCM), or 32 (IEEE float)
+    bool isFloat = false;
+    size_t dataOffset = 0; // bytes from the start of the file
+    uint64_t frames = 0;
+};
+
+// Reads the header of the WAV file held in file[0, size): 16- or 24-bit
+// PCM or 32-bit float, plain or WAVE_FORMAT_EXTENSIBLE, any channel count.
+// A data chunk cut short by the end of the file is taken as far as it goes.
+bool parseWav(const unsigned char* file, size_t size, WavLayout& out, std::string& error);
+
+// One sample stored as the layout says, as a float in [-1, 1)
+float wavSample(const unsigned char* p, const WavLayout& layout);
+
+// Reads a whole WAV file parseWav() accepts into interleaved floats
+bool readWav(const std::string& path, std::vector<float>& samples, WavLayout& layout, std::string& error);
+
+#endif
@@ -0,0 +1,46 @@
+#include "Wavetable.h"
+#include <cmath>
+
+const Wavetables& Wavetables::get() {
+    static const Wavetables tables;
+    return tables;
+}
+
+Wavetables::Wavetables() {
+    // Exact sine of every table position; harmonic h of sample n is
+    // sinTab[(h * n) % kSize], so building is integer indexing plus adds
+    std::vector<double> sinTab(kSize);
+    for (int n = 0; n < kSize; ++n) sinTab[n] = std::sin(2.0 * M_PI * n / kSize);
+
+    // Sine is already band-limited: every level shares one table
+    int tables = 1;
+    for (int l = 0; l < kLevels; ++l) offset_[Oscillator::SINE][l] = 0;
+    for (int l = 0; l < kLevels; ++l) offset_[Oscillator::SQUARE][l] = kStride * tables++;
+    for (int l = 0; l < kLevels; ++l) offset_[Oscillator::SAW][l] = kStride * tables++;
+    data_.assign((size_t)kStride * tables, 0.0f);
+
+    auto build = [&](float* t, int harmonics, auto amplitude) {
+        std::vector<double> acc(kSize, 0.0);
+        for (int h = 1; h <= harmonics; ++h) {
+            const double a = amplitude(h);
+            if (a == 0.0) continue;
+            for (int n = 0; n < kSize; ++n) acc[n] += a * sinTab[((size_t)h * n) % kSize];
+        }
+        for (int n = 0; n < kSize; ++n) t[n] = (float)acc[n];
+        t[kSize] = t[0];
+    };
+
+    build(&data_[0], 1, [](int) { return 1.0; });
+
+    for (int l = 0; l < kLevels; ++l) {
+        const int harmonics = kMaxHarmonics >> l;
+
+        // Fourier series of the naive shapes in Oscillator::computeOscillatorSample
+        // square: +1 then -1        -> (4/pi) sum over odd h of sin(h x) / h
+        // saw:    2 * phase - 1     -> -(2/pi) sum over h of sin(h x) / h
+        build(&data_[offset_[Oscillator::SQUARE][l]], harmonics,
+              [](int h) { return (h & 1) ? 4.0 / (M_PI * h) : 0.0; });
+        build(&data_[offset_[Oscillator::SAW][l]], harmonics,
+              [](int h) { return -2.0 / (M_PI * h); });
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef WAVETABLE_H
+#define WAVETABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Oscillator.h"
+
+// Band-limited single-cycle tables for the Oscillator waveforms, one table
+// per octave ("mipmap level"). Level L holds at most kMaxHarmonics >> L, so
+// picking the level from the phase increment keeps every partial below
+// Nyquist. Tables are built once and shared read-only by all voices.
+class Wavetables {
+public:
+    static constexpr int kSize   = 4096;        // samples per cycle
+    static constexpr int kStride = kSize + 1;   // plus a guard point for interpolation
+    static constexpr int kMaxHarmonics = 1024;  // level 0; >= 4 samples per top partial
+    static constexpr int kLevels = 11;          // 1024 harmonics down to 1
+    static constexpr int kWaveforms = 3;        // Oscillator::Waveform, up to SAW
+
+    // Built on first use. Call once off the audio thread (Synth's
+    // constructor does) so the audio thread only ever reads.
+    static const Wavetables& get();
+
+    // Smallest level whose harmonics all stay below Nyquist at this increment
+    static int levelFor(float phaseInc) {
+        int level = 0;
+        float top = phaseInc * (2.0f * kMaxHarmonics);  // harmonics(0) * inc / 0.5
+        while (top > 1.0f && level < kLevels - 1) { top *= 0.5f; ++level; }
+        return level;
+    }
+
+    const float* data() const { return data_.data(); }
+    int32_t offset(Oscillator::Waveform w, int level) const { return offset_[w][level]; }
+
+    // Linearly interpolated lookup, phase in [0, 1)
+    float lookup(Oscillator::Waveform w, int level, float phase) const {
+        const float* t = data_.data() + offset_[w][level];
+        const float x = phase * kSize;
+        int i = (int)x;
+        if (i > kSize - 1) i = kSize - 1;
+        const float frac = x - (float)i;
+        return t[i] + frac * (t[i + 1] - t[i]);
+    }
+
+    size_t bytes() const { return data_.size() * sizeof(float); }
+
+private:
+    Wavetables();
+
+    std::vector<float> data_;
+    int32_t offset_[kWaveforms][kLevels];
+};
+
+#endif
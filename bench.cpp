@@ -0,0 +1,2284 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <time.h>
+#include "AudioBackend.h"
+#include "Convolver.h"
+#include "FastMath.h"
+#include "Fft.h"
+#include "Fm.h"
+#include "Governor.h"
+#include "LFO.h"
+#include "ModMatrix.h"
+#include "Oscillator.h"
+#include "Oversampler.h"
+#include "Patch.h"
+#include "RenderAhead.h"
+#include "Sampler.h"
+#include "Scope.h"
+#include "Synth.h"
+#include "VoiceBank.h"
+#include "WavFile.h"
+#include "Wavetable.h"
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+// --------------------------
+// Allocation counting
+// --------------------------
+static std::atomic<unsigned long> gAllocs{0};
+
+void* operator new(std::size_t n) {
+    gAllocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// --------------------------
+// Helpers
+// --------------------------
+struct Options {
+    float sampleRate = 48000.0f;
+    unsigned long block = 256;
+    double seconds = 1.0;
+    int maxVoices = 4096;
+    const char* kernel = nullptr;
+    bool verify = false;
+    bool naive = false;
+    int threads = 1;
+    bool parallel = false;
+    bool queues = false;
+    int controlRate = 32;
+    bool exhaustive = false;
+};
+
+// Handles of every voice in the synth: the initial one plus `count` added
+static std::vector<VoiceHandle> addVoices(Synth& synth, int count) {
+    std::vector<VoiceHandle> handles;
+    auto collect = [&] {
+        synth.processBlock(nullptr, 0);
+        SynthReply r;
+        while (synth.replyQ.pop(r))
+            if (r.type == SynthReply::VoiceAdded) handles.push_back(r.voice);
+    };
+    SynthCmd c{ SynthCmd::AddOsc, 0, 0.0f };
+    for (int i = 0; i < count; ++i) {
+        while (!synth.cmdQ.push(c)) collect();
+    }
+    collect();
+    return handles;
+}
+
+struct RunResult {
+    double nsPerBlock;
+    double allocsPerBlock;
+};
+
+static RunResult runBlocks(const Options& opt, Synth& synth) {
+    std::vector<float> out(opt.block * Synth::kChannels);
+
+    // Warm up past the attack stage and into steady state
+    for (int i = 0; i < 8; ++i) synth.processBlock(out.data(), opt.block);
+
+    unsigned long blocks = (unsigned long)(opt.seconds * opt.sampleRate / opt.block);
+    if (blocks < 16) blocks = 16;
+
+    const unsigned long allocsBefore = gAllocs.load();
+    const auto t0 = std::chrono::steady_clock::now();
+    for (unsigned long b = 0; b < blocks; ++b) synth.processBlock(out.data(), opt.block);
+    const auto t1 = std::chrono::steady_clock::now();
+    const unsigned long allocs = gAllocs.load() - allocsBefore;
+
+    const double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+    return { ns / blocks, (double)allocs / blocks };
+}
+
+static void benchVoices(const Options& opt, int voices) {
+    Synth synth(voices);
+    synth.setSampleRate(opt.sampleRate);
+    if (opt.kernel) synth.setVoiceKernel(opt.kernel);
+    synth.bandLimited.store(!opt.naive);
+    synth.setRenderThreads(opt.threads);
+    synth.controlRate.store(opt.controlRate);
+    addVoices(synth, voices - 1); // Synth starts with one oscillator
+
+    const RunResult r = runBlocks(opt, synth);
+    const double blockNs = opt.block / (double)opt.sampleRate * 1e9;
+
+    std::printf("%8d %14.3f %14.2f %14.3f\n",
+                voices,
+                r.nsPerBlock / (opt.block * (double)voices),
+                blockNs / r.nsPerBlock,
+                r.allocsPerBlock);
+}
+
+// Cost of a pool where most voices have finished their release should track
+// the sounding voices, not the allocated ones
+static void benchCulling(const Options& opt, int allocated, int sounding) {
+    Synth synth(allocated);
+    synth.setSampleRate(opt.sampleRate);
+    if (opt.kernel) synth.setVoiceKernel(opt.kernel);
+    synth.bandLimited.store(!opt.naive);
+    synth.setRenderThreads(opt.threads);
+    const std::vector<VoiceHandle> handles = addVoices(synth, allocated - 1);
+
+    for (int i = sounding; i < (int)handles.size(); ++i) {
+        SynthCmd c{ SynthCmd::ReleaseOsc, 0, 0.0f };
+        c.voice = handles[i];
+        while (!synth.cmdQ.push(c)) synth.processBlock(nullptr, 0);
+    }
+    std::vector<float> out(opt.block * Synth::kChannels);
+    const unsigned long releaseBlocks = (unsigned long)(0.2f * opt.sampleRate / opt.block) + 1;
+    for (unsigned long b = 0; b < releaseBlocks; ++b) synth.processBlock(out.data(), opt.block);
+
+    const RunResult r = runBlocks(opt, synth);
+    std::printf("%d allocated, %d sounding: %.0f ns/block\n", allocated, sounding, r.nsPerBlock);
+}
+
+// Per-block cost of the modulation path alone (one voice) by control rate
+static void benchControlRate(const Options& opt) {
+    std::printf("control rate (1 voice):");
+    for (int rate : { 1, 4, 16, 32, 64, 256 }) {
+        Synth synth(1);
+        synth.setSampleRate(opt.sampleRate);
+        synth.controlRate.store(rate);
+        const RunResult r = runBlocks(opt, synth);
+        std::printf("  %d: %.0f ns", rate, r.nsPerBlock);
+    }
+    std::printf(" per block\n");
+}
+
+// Block cost with the voices rendered at each oversampling factor, and the
+// decimator cascade alone per output frame
+static void benchOversampling(const Options& opt) {
+    const int voices = 64;
+    std::printf("oversampling (%d voices, %s decimators):", voices, Oversampler::kernelName());
+    for (int factor : { 1, 2, 4, 8 }) {
+        Synth synth(voices);
+        synth.setSampleRate(opt.sampleRate);
+        synth.bandLimited.store(!opt.naive);
+        synth.oversampling.store(factor);
+        addVoices(synth, voices - 1);
+        const RunResult r = runBlocks(opt, synth);
+
+        Oversampler os(opt.block);
+        os.setFactor(factor);
+        std::vector<float> in(opt.block * factor, 0.25f), out(opt.block);
+        const int reps = 2000;
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < reps; ++i) os.process(in.data(), out.data(), opt.block);
+        const auto t1 = std::chrono::steady_clock::now();
+        const double decNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / (reps * (double)opt.block);
+        std::printf("  %dx: %.0f ns/block (decimate %.2f ns/frame)", factor, r.nsPerBlock, decNs);
+    }
+    std::printf("\n");
+}
+
+// Per-voice cost of each filter type as polyphony grows; it should stay flat
+static void benchFilters(const Options& opt) {
+    static const char* names[] = { "off", "lowpass", "bandpass", "highpass", "ladder" };
+    std::printf("filters, ns/smp/voice:");
+    for (int v = 16; v <= 1024; v *= 4) std::printf(" %9d", v);
+    std::printf("\n");
+    for (int f : { (int)VoiceFilter::OFF, (int)VoiceFilter::SVF_LOWPASS, (int)VoiceFilter::LADDER }) {
+        std::printf("%21s:", names[f]);
+        for (int voices = 16; voices <= 1024; voices *= 4) {
+            Synth synth(voices);
+            synth.setSampleRate(opt.sampleRate);
+            synth.bandLimited.store(!opt.naive);
+            synth.filterType.store(f);
+            synth.lfoTarget.store(LFO::FILTER);
+            addVoices(synth, voices - 1);
+            const RunResult r = runBlocks(opt, synth);
+            std::printf(" %9.3f", r.nsPerBlock / (opt.block * (double)voices));
+        }
+        std::printf("\n");
+    }
+}
+
+// One held note per unison size against 16 Oscillator objects, which is
+// what clicking "Add Oscillator" 16 times used to render, and against 16
+// separate centred voices in the bank
+static void benchUnison(const Options& opt) {
+    const double blockNs = opt.block / (double)opt.sampleRate * 1e9;
+    std::printf("unison, ns/block (%% of block):");
+
+    std::vector<Oscillator> oscs(16);
+    for (auto& o : oscs) {
+        o.setSampleRate(opt.sampleRate);
+        o.setWaveform(Oscillator::SAW);
+        o.noteOn(440.0f);
+    }
+    std::vector<float> out(opt.block);
+    const int reps = 200;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps; ++r) {
+        for (unsigned long i = 0; i < opt.block; ++i) {
+            float x = 0.0f;
+            for (auto& o : oscs) x += o.processSample(440.0f);
+            out[i] = x;
+        }
+    }
+    const auto t1 = std::chrono::steady_clock::now();
+    const double scalarNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / reps;
+    std::printf(" 16 Oscillators %.0f (%.2f%%),", scalarNs, 100.0 * scalarNs / blockNs);
+
+    {
+        Synth synth(16);
+        synth.setSampleRate(opt.sampleRate);
+        synth.bandLimited.store(!opt.naive);
+        addVoices(synth, 15);
+        const RunResult r = runBlocks(opt, synth);
+        std::printf(" 16 voices %.0f (%.2f%%)\n", r.nsPerBlock, 100.0 * r.nsPerBlock / blockNs);
+    }
+
+    std::printf("%30s", "");
+    for (int lanes : { 1, 4, 8, 16 }) {
+        Synth synth(VoiceBank::kMaxUnison);
+        synth.setSampleRate(opt.sampleRate);
+        synth.bandLimited.store(!opt.naive);
+        synth.unisonVoices.store(lanes);
+        synth.unisonSpread.store(1.0f);
+        SynthCmd remove{ SynthCmd::RemoveOsc, 0, 0.0f };
+        remove.voice = addVoices(synth, 0).front();
+        synth.cmdQ.push(remove);
+        synth.cmdQ.push(SynthCmd{ SynthCmd::NoteOn, 57, 1.0f });
+        const RunResult r = runBlocks(opt, synth);
+        std::printf(" x%d %.0f (%.2f%%)%s", lanes, r.nsPerBlock, 100.0 * r.nsPerBlock / blockNs,
+                    lanes == 16 ? "\n" : ",");
+    }
+}
+
+// Naive saws through each kernel with the per-group shape specializations
+// and through its -generic twin, which selects the shape per lane
+static void benchDispatch(const Options& opt) {
+    const int voices = 256;
+    std::printf("dispatch (%d naive saws), ns/smp/voice:", voices);
+    const VoiceKernel* k[4];
+    const int n = availableVoiceKernels(k, 4);
+    for (int i = 0; i < n; ++i) {
+        Synth synth(voices);
+        synth.setSampleRate(opt.sampleRate);
+        synth.setVoiceKernel(k[i]->name);
+        synth.bandLimited.store(false);
+        addVoices(synth, voices - 1);
+        const RunResult r = runBlocks(opt, synth);
+        std::printf(" %s %.3f", k[i]->name, r.nsPerBlock / (opt.block * (double)voices));
+    }
+    std::printf("\n");
+}
+
+// Scalar envelope cost per sample, one sample at a time vs. whole runs
+static void benchEnvelope(const Options& opt) {
+    const int n = 1 << 20, block = 256;
+    std::vector<float> out(block);
+    volatile float sink = 0.0f;
+
+    auto time = [&](Envelope::Curve curve, bool runs) {
+        Envelope env;
+        env.setSampleRate(opt.sampleRate);
+        env.setCurve(curve);
+        env.setDecay(0.2f);
+        float acc = 0.0f;
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int b = 0; b < n / block; ++b) {
+            // Note on/off every 4096 samples keeps stages changing
+            if (b % 16 == 0) env.noteOn();
+            if (b % 16 == 8) env.noteOff();
+            if (runs) env.render(out.data(), block);
+            else      for (int i = 0; i < block; ++i) out[i] = env.next();
+            acc += out[block - 1];
+        }
+        const auto t1 = std::chrono::steady_clock::now();
+        sink = acc;
+        return std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+    };
+
+    std::printf("envelope: linear %.2f / %.2f ns, exponential %.2f / %.2f ns per sample (next / render)\n",
+                time(Envelope::LINEAR, false), time(Envelope::LINEAR, true),
+                time(Envelope::EXPONENTIAL, false), time(Envelope::EXPONENTIAL, true));
+    (void)sink;
+}
+
+// --------------------------
+// Parallel rendering
+// --------------------------
+static std::vector<float> renderWithThreads(const Options& opt, int voices, int threads,
+                                            unsigned long block, unsigned long blocks) {
+    Synth synth(voices);
+    synth.setSampleRate(opt.sampleRate);
+    synth.setRenderThreads(threads);
+    const std::vector<VoiceHandle> handles = addVoices(synth, voices - 1);
+
+    std::vector<float> out(block * blocks * Synth::kChannels);
+    for (unsigned long b = 0; b < blocks; ++b) {
+        // Stagger releases so lanes move between slices mid-run
+        if (b % 7 == 3) {
+            SynthCmd c{ SynthCmd::ReleaseOsc, 0, 0.0f };
+            c.voice = handles[b * 13 % handles.size()];
+            synth.cmdQ.push(c);
+        }
+        synth.processBlock(out.data() + b * block * Synth::kChannels, block);
+    }
+    return out;
+}
+
+static bool verifyParallel(const Options& opt) {
+    const int voices = 300;
+    const std::vector<float> one = renderWithThreads(opt, voices, 1, 256, 200);
+    const std::vector<float> many = renderWithThreads(opt, voices, 3, 256, 200);
+    const bool same = std::memcmp(one.data(), many.data(), one.size() * sizeof(float)) == 0;
+    std::printf("verify parallel 1 vs 3 threads, %d voices: %s\n", voices, same ? "bit-identical (ok)" : "FAIL");
+    return same;
+}
+
+// --------------------------
+// Timestamped commands
+// --------------------------
+// Notes and parameter changes scheduled at odd frames; the output must not
+// depend on how the timeline is cut into blocks. Naive shapes, since mip
+// levels are picked per render chunk. Finished lanes are culled per render
+// call, which reorders the mix, so allow for rounding; a command landing
+// even one frame off is orders of magnitude above the tolerance.
+static std::vector<float> renderScheduled(const Options& opt, unsigned long block) {
+    const unsigned long total = 48000;
+    Synth synth(64);
+    synth.setSampleRate(opt.sampleRate);
+    synth.bandLimited.store(false);
+    SynthCmd release{ SynthCmd::ReleaseOsc, 0, 0.0f };
+    release.voice = addVoices(synth, 0).front();
+    synth.cmdQ.push(release);
+
+    std::vector<float> out(total * Synth::kChannels);
+    uint64_t next = 101;
+    int note = 48;
+    for (unsigned long pos = 0; pos < total; pos += block) {
+        const unsigned long n = std::min(block, total - pos);
+        for (; next < pos + n; next += 997) {
+            synth.cmdQ.push(SynthCmd{ SynthCmd::NoteOn, note, 0.7f, next });
+            synth.cmdQ.push(SynthCmd{ SynthCmd::NoteOff, note - 5, 0.0f, next + 3 });
+            synth.cmdQ.push(SynthCmd{ SynthCmd::SetParam, SynthCmd::MasterPitch, 400.0f + note, next + 7 });
+            note = 48 + (note - 47) % 24;
+        }
+        synth.processBlock(out.data() + pos * Synth::kChannels, n);
+    }
+    return out;
+}
+
+static bool verifyScheduling(const Options& opt) {
+    const std::vector<float> small = renderScheduled(opt, 64);
+    const std::vector<float> large = renderScheduled(opt, 2048);
+    float maxErr = 0.0f;
+    for (size_t i = 0; i < small.size(); ++i) maxErr = std::max(maxErr, std::fabs(small[i] - large[i]));
+    const float tolerance = 1e-5f;
+    std::printf("verify scheduling block 64 vs 2048: max |err| = %.3g (%s)\n",
+                maxErr, maxErr <= tolerance ? "ok" : "FAIL");
+    return maxErr <= tolerance;
+}
+
+// --------------------------
+// Unison
+// --------------------------
+// Groups are added, stolen, released and removed whole; an unspread group
+// renders the same into both channels, a spread one does not
+static bool verifyUnison() {
+    const unsigned long block = 256;
+    VoiceBank bank;
+    bank.setCapacity(40);
+    bank.setUnison(16, 30.0f, 0.0f);
+    std::vector<float> inc(block, 220.0f / 48000.0f), l(block), r(block);
+
+    bool ok = true;
+    auto check = [&](bool cond, const char* what) {
+        if (!cond) std::printf("verify unison: %s (FAIL)\n", what);
+        ok = ok && cond;
+    };
+
+    const VoiceHandle a = bank.playNote(Oscillator::SAW, 60, 1.0f);
+    check(bank.size() == 16 && bank.sounding() == 16 && bank.stolen().empty(), "16 lanes per note");
+    std::fill(l.begin(), l.end(), 0.0f);
+    std::fill(r.begin(), r.end(), 0.0f);
+    bank.render(l.data(), r.data(), inc.data(), block);
+    check(std::memcmp(l.data(), r.data(), block * sizeof(float)) == 0, "unspread group differs between channels");
+
+    bank.setUnison(16, 30.0f, 1.0f);
+    const VoiceHandle b = bank.playNote(Oscillator::SAW, 64, 1.0f);
+    const VoiceHandle c = bank.add(Oscillator::SAW, 440.0f);
+    check(bank.stolen().size() == 1 && bank.stolen()[0] == a && !bank.contains(a), "oldest group stolen whole");
+    check(bank.size() == 32 && bank.contains(b) && bank.contains(c), "two groups after the steal");
+
+    std::fill(l.begin(), l.end(), 0.0f);
+    std::fill(r.begin(), r.end(), 0.0f);
+    bank.render(l.data(), r.data(), inc.data(), block);
+    check(std::memcmp(l.data(), r.data(), block * sizeof(float)) != 0, "spread group is not stereo");
+
+    bank.noteOff(b);
+    for (int i = 0; i < 100; ++i) bank.render(l.data(), r.data(), inc.data(), block);
+    check(bank.sounding() == 16, "released group still sounding");
+    check(bank.remove(c) && bank.size() == 16, "group not removed whole");
+
+    std::printf("verify unison groups and stereo spread: %s\n", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// --------------------------
+// Render ahead
+// --------------------------
+// Through the render thread and a simulated device the stream is the one
+// processBlock gives directly; a device that outruns the thread hears
+// silence and counts underruns.
+static void scheduleNotes(Synth& synth) {
+    for (int i = 0; i < 12; ++i) {
+        const uint64_t at = 301 + 2011 * i;
+        synth.cmdQ.push(SynthCmd{ SynthCmd::NoteOn, 48 + 5 * i % 24, 0.8f, at });
+        synth.cmdQ.push(SynthCmd{ SynthCmd::NoteOff, 48 + 5 * i % 24, 0.0f, at + 3000 });
+    }
+}
+
+static bool verifyRenderAhead(const Options& opt) {
+    const unsigned long block = 256;
+    const int blocks = 120;
+
+    Synth direct(64);
+    direct.setSampleRate(opt.sampleRate);
+    scheduleNotes(direct);
+    std::vector<float> expected(block * blocks * Synth::kChannels);
+    for (int b = 0; b < blocks; ++b)
+        direct.processBlock(expected.data() + b * block * Synth::kChannels, block);
+
+    Synth synth(64);
+    synth.setSampleRate(opt.sampleRate);
+    scheduleNotes(synth);
+    RenderAhead::Options options;
+    options.blockFrames = block;
+    options.lookahead = 3;
+    RenderAhead ahead(synth, opt.sampleRate, options);
+    SimulatedBackend device;
+    AudioBackend::Config config;
+    config.sampleRate = opt.sampleRate;
+    config.channels = Synth::kChannels;
+    config.framesPerBuffer = block;
+
+    bool ok = device.open(config, RenderAhead::deviceCallback, &ahead) && ahead.start() && device.start();
+    const size_t samples = block * Synth::kChannels;
+    bool same = ok;
+    for (int b = 0; b < blocks && same; ++b) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (ahead.queuedFrames() < block && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+        device.step();
+        same = std::memcmp(device.buffer().data(), expected.data() + b * samples, samples * sizeof(float)) == 0;
+    }
+    const uint64_t underrunsBefore = ahead.underruns();
+    ok = ok && same && underrunsBefore == 0;
+
+    // Without the render thread the ring runs dry
+    ahead.stop();
+    for (int i = 0; i <= RenderAhead::kMaxLookahead; ++i) device.step();
+    bool silent = true;
+    for (float v : device.buffer()) silent = silent && v == 0.0f;
+    const bool counted = ahead.underruns() > underrunsBefore;
+    ok = ok && silent && counted;
+
+    std::printf("verify render ahead: %s, underruns %s, lookahead %d: %s\n",
+                same ? "bit-identical" : "differs", counted && silent ? "counted" : "missed",
+                ahead.lookahead(), ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// --------------------------
+// Scope and spectrum
+// --------------------------
+// The real FFT against a direct DFT in double, over sizes that take the
+// scalar and the vector butterflies
+static bool verifyFft() {
+    bool ok = true;
+    for (int n : { 8, 64, 4096 }) {
+        RealFft fft(n);
+        std::vector<float> x(n), re(fft.bins()), im(fft.bins());
+        uint32_t seed = 12345;
+        for (float& v : x) {
+            seed = seed * 1664525u + 1013904223u;
+            v = (seed >> 8) * (2.0f / 16777216.0f) - 1.0f;
+        }
+        fft.forward(x.data(), re.data(), im.data());
+
+        double maxErr = 0.0;
+        for (int k = 0; k < fft.bins(); ++k) {
+            double dr = 0.0, di = 0.0;
+            for (int t = 0; t < n; ++t) {
+                const double a = -2.0 * M_PI * (double)k * t / n;
+                dr += x[t] * std::cos(a);
+                di += x[t] * std::sin(a);
+            }
+            maxErr = std::max(maxErr, std::hypot(re[k] - dr, im[k] - di));
+        }
+        // Relative to the rms bin magnitude of white noise, sqrt(n / 3)
+        const double rel = maxErr / std::sqrt(n / 3.0);
+
+        // And back, against the input
+        std::vector<float> y(n);
+        fft.inverse(re.data(), im.data(), y.data());
+        double backErr = 0.0;
+        for (int t = 0; t < n; ++t) backErr = std::max(backErr, std::fabs((double)y[t] / n - x[t]));
+
+        const bool good = rel < 1e-5 && backErr < 1e-5;
+        std::printf("verify fft %4d vs DFT: max rel err = %.3g, inverse max err = %.3g (%s)\n",
+                    n, rel, backErr, good ? "ok" : "FAIL");
+        ok = ok && good;
+    }
+    return ok;
+}
+
+// A sine through the tap shows up in the right band at the right level,
+// and silence stops new frames after one
+static bool verifyScope(const Options& opt) {
+    ScopeTap tap(opt.sampleRate);
+    const float hz = 1000.0f, amp = 0.5f;
+    const unsigned long block = 256;
+    std::vector<float> buf(block * 2);
+    double phase = 0.0;
+    for (int b = 0; b < 100; ++b) {
+        for (unsigned long i = 0; i < block; ++i) {
+            buf[2 * i] = buf[2 * i + 1] = amp * (float)std::sin(phase);
+            phase += 2.0 * M_PI * hz / opt.sampleRate;
+        }
+        tap.push(buf.data(), block, 2);
+    }
+    bool ok = tap.poll();
+
+    Spectrum spectrum;
+    spectrum.analyze(tap.latest());
+    int peak = 0;
+    for (int b = 1; b < spectrum.bands(); ++b)
+        if (spectrum.levelsDb()[b] > spectrum.levelsDb()[peak]) peak = b;
+    const float peakHz = spectrum.bandHz(peak), peakDb = spectrum.levelsDb()[peak];
+    const float expectDb = 20.0f * std::log10(amp);
+    // Between bins the Hann window reads up to 1.42 dB low
+    ok = ok && std::fabs(peakHz / hz - 1.0f) < 0.05f && peakDb <= expectDb + 0.1f && peakDb > expectDb - 1.5f;
+
+    std::fill(buf.begin(), buf.end(), 0.0f);
+    int frames = 0;
+    for (int b = 0; b < 400; ++b) {
+        tap.push(buf.data(), block, 2);
+        if (tap.poll()) ++frames;
+    }
+    // Frames until the history has emptied, then one silent one
+    const int expectFrames = (int)(ScopeFrame::kSamples / (opt.sampleRate / 2 / 60.0f)) + 1;
+    const bool quiet = std::abs(frames - expectFrames) <= 1 && !tap.poll();
+    ok = ok && quiet;
+
+    std::printf("verify scope: %.0f Hz sine peaks at %.0f Hz, %.2f dB (want %.2f), %d frames into silence: %s\n",
+                hz, peakHz, peakDb, expectDb, frames, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// Audio-side cost of the tap per block, and the GUI-side analysis per frame
+static void benchScope(const Options& opt) {
+    ScopeTap tap(opt.sampleRate);
+    std::vector<float> buf(opt.block * Synth::kChannels);
+    for (size_t i = 0; i < buf.size(); ++i) buf[i] = std::sin(0.01f * i);
+    const int blocks = 20000;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int b = 0; b < blocks; ++b) tap.push(buf.data(), opt.block, Synth::kChannels);
+    auto t1 = std::chrono::steady_clock::now();
+    const double pushNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / blocks;
+
+    Spectrum spectrum;
+    tap.poll();
+    const int runs = 500;
+    t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < runs; ++r) spectrum.analyze(tap.latest());
+    t1 = std::chrono::steady_clock::now();
+    const double analyzeUs = std::chrono::duration<double, std::micro>(t1 - t0).count() / runs;
+
+    std::printf("scope tap: %.0f ns per %lu-frame block (%.2f ns/frame); spectrum of %d samples: %.1f us\n\n",
+                pushNs, opt.block, pushNs / opt.block, ScopeFrame::kSamples, analyzeUs);
+}
+
+// --------------------------
+// Patches
+// --------------------------
+static Patch makePatch(int voices) {
+    Patch patch;
+    PatchParams& p = patch.params;
+    p.filterType = VoiceFilter::SVF_LOWPASS;
+    p.attackSec = 0.01f;
+    p.releaseSec = 0.3f;
+    p.envelopeCurve = Envelope::EXPONENTIAL;
+    p.controlRate = 16;
+    for (int i = 0; i < voices; ++i) {
+        PatchVoice v;
+        v.frequencyHz = 110.0f + 7.0f * i;
+        patch.voices.push_back(v);
+    }
+    return patch;
+}
+
+// Save and load round-trip exactly and damage is caught. A synth switched
+// to a patch renders what one set up by commands renders (the patch keeps
+// the smoothed parameters at their defaults, which commands would glide
+// to), and the switch allocates nothing on the audio thread.
+static bool verifyPatches(const Options& opt) {
+    const std::string path = "minisynth_verify.mspt";
+    const Patch patch = makePatch(300);
+    Patch loaded;
+    std::string error;
+    const bool saved = savePatch(path, patch, error) && loadPatch(path, loaded, error);
+    const bool same = saved && std::memcmp(&loaded.params, &patch.params, sizeof(PatchParams)) == 0 &&
+                      loaded.voices.size() == patch.voices.size() &&
+                      std::memcmp(loaded.voices.data(), patch.voices.data(),
+                                  patch.voices.size() * sizeof(PatchVoice)) == 0;
+
+    std::FILE* f = std::fopen(path.c_str(), "r+b");
+    if (f) {
+        std::fseek(f, sizeof(PatchHeader) + 5, SEEK_SET);
+        std::fputc(0x5a, f);
+        std::fclose(f);
+    }
+    const bool caught = !loadPatch(path, loaded, error);
+    std::remove(path.c_str());
+
+    const unsigned long block = 256;
+    const int blocks = 40;
+    Synth byCommands(512);
+    byCommands.setSampleRate(opt.sampleRate);
+    const PatchParams& p = patch.params;
+    byCommands.filterType.store(p.filterType);
+    byCommands.attackSec.store(p.attackSec);
+    byCommands.releaseSec.store(p.releaseSec);
+    byCommands.envelopeCurve.store(p.envelopeCurve);
+    byCommands.controlRate.store(p.controlRate);
+    const std::vector<VoiceHandle> handles = addVoices(byCommands, (int)patch.voices.size() - 1);
+    // The initial voice started with the default envelope
+    SynthCmd retrigger{ SynthCmd::TriggerOsc, 0, 0.0f };
+    retrigger.voice = handles[0];
+    byCommands.cmdQ.push(retrigger);
+    for (size_t i = 0; i < handles.size(); ++i) {
+        SynthCmd c{ SynthCmd::SetOscFreq, 0, patch.voices[i].frequencyHz };
+        c.voice = handles[i];
+        while (!byCommands.cmdQ.push(c)) byCommands.processBlock(nullptr, 0);
+    }
+    byCommands.processBlock(nullptr, 0);
+
+    Synth bySwap(512);
+    bySwap.setSampleRate(opt.sampleRate);
+    bySwap.submit(bySwap.prepare(patch, 7));
+    const unsigned long allocsBefore = gAllocs.load();
+    bySwap.processBlock(nullptr, 0);
+    const unsigned long allocs = gAllocs.load() - allocsBefore;
+    bool announced = false;
+    SynthReply r;
+    while (bySwap.replyQ.pop(r)) announced = announced || (r.type == SynthReply::PatchLoaded && r.tag == 7);
+
+    std::vector<float> a(block * Synth::kChannels), b(block * Synth::kChannels);
+    bool identical = true;
+    for (int i = 0; i < blocks && identical; ++i) {
+        byCommands.processBlock(a.data(), block);
+        bySwap.processBlock(b.data(), block);
+        identical = std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+    }
+    bySwap.reclaim();
+
+    const bool ok = same && caught && identical && announced && allocs == 0;
+    std::printf("verify patches: round trip %s, damage %s, switch vs commands %s, %lu allocs: %s\n",
+                same ? "exact" : "differs", caught ? "caught" : "missed",
+                identical ? "bit-identical" : "differs", allocs, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// Audio-thread cost of switching to a patch, against applying the same
+// voices as AddOsc commands
+static void benchPatches(const Options& opt) {
+    std::printf("%8s %14s %14s\n", "voices", "switch us", "commands us");
+    for (int voices : { 16, 256, 4096 }) {
+        Synth synth(voices);
+        synth.setSampleRate(opt.sampleRate);
+        const Patch patch = makePatch(voices);
+        double swapUs = 0.0, cmdUs = 0.0;
+        const int runs = 5;
+        for (int run = 0; run < runs; ++run) {
+            synth.submit(synth.prepare(patch, run));
+            auto t0 = std::chrono::steady_clock::now();
+            synth.processBlock(nullptr, 0);
+            auto t1 = std::chrono::steady_clock::now();
+            swapUs += std::chrono::duration<double, std::micro>(t1 - t0).count();
+
+            // Only what the engine spends on the commands, a queue at a time
+            SynthCmd c{ SynthCmd::AddOsc, 0, 0.0f };
+            for (int left = voices; left > 0;) {
+                const int n = std::min(left, (int)Synth::kCmdQueueSize);
+                for (int i = 0; i < n; ++i) synth.cmdQ.push(c);
+                t0 = std::chrono::steady_clock::now();
+                synth.processBlock(nullptr, 0);
+                t1 = std::chrono::steady_clock::now();
+                cmdUs += std::chrono::duration<double, std::micro>(t1 - t0).count();
+                SynthReply r;
+                while (synth.replyQ.pop(r)) {}
+                left -= n;
+            }
+        }
+        std::printf("%8d %14.2f %14.2f\n", voices, swapUs / runs, cmdUs / runs);
+    }
+    std::printf("\n");
+}
+
+// --------------------------
+// Modulation matrix
+// --------------------------
+// The vector pass against the same routes worked out lane by lane in
+// double; then a synth with per-voice routes renders, allocation-free, and
+// differently from one without, and envelope or velocity to the shared
+// cutoff is refused
+static bool verifyModMatrix(const Options& opt) {
+    const ModMatrix::Route routes[] = {
+        { ModMatrix::ENVELOPE, ModMatrix::PITCH, 7.0f, ModMatrix::SQUARED },
+        { ModMatrix::VELOCITY, ModMatrix::PITCH, -2.0f, ModMatrix::LINEAR },
+        { ModMatrix::LFO2, ModMatrix::AMP, 0.5f, ModMatrix::LINEAR },
+        { ModMatrix::VELOCITY, ModMatrix::AMP, -0.8f, ModMatrix::ROOT },
+        { ModMatrix::LFO3, ModMatrix::PAN, 0.3f, ModMatrix::SQUARED },
+        { ModMatrix::ENVELOPE, ModMatrix::PAN, -1.5f, ModMatrix::LINEAR },
+        { ModMatrix::LFO1, ModMatrix::CUTOFF, 2.0f, ModMatrix::LINEAR },
+    };
+    ModMatrix m;
+    bool ok = m.setRoutes(routes, (int)(sizeof(routes) / sizeof(routes[0])));
+    const float lfo[ModMatrix::kLfos] = { 0.25f, -0.6f, 0.9f, 0.0f };
+    m.evaluate(lfo);
+
+    const int lanes = 64;
+    std::vector<float> env(lanes), vel(lanes), ratio(lanes), gainL(lanes), gainR(lanes);
+    std::vector<float> modRatio(lanes), modL(lanes), modR(lanes);
+    uint32_t seed = 12345;
+    auto rnd = [&]() { seed = seed * 1664525u + 1013904223u; return (seed >> 8) * (1.0f / 16777216.0f); };
+    for (int l = 0; l < lanes; ++l) {
+        env[l] = rnd();
+        vel[l] = rnd();
+        ratio[l] = 0.5f + rnd();
+        gainL[l] = 0.2f * rnd();
+        gainR[l] = l % 3 ? gainL[l] : 0.2f * rnd();
+    }
+    m.apply({ env.data(), vel.data(), ratio.data(), gainL.data(), gainR.data(),
+              modRatio.data(), modL.data(), modR.data(), lanes });
+
+    double worst = 0.0;
+    for (int l = 0; l < lanes; ++l) {
+        double pitch = 0.0, amp = 1.0, pan = 0.0;
+        for (const ModMatrix::Route& rt : routes) {
+            const float x = rt.source == ModMatrix::ENVELOPE ? env[l]
+                          : rt.source == ModMatrix::VELOCITY ? vel[l] : lfo[rt.source - ModMatrix::LFO1];
+            const double v = rt.depth * (double)ModMatrix::shape(rt.curve, x);
+            if (rt.destination == ModMatrix::PITCH) pitch += v;
+            if (rt.destination == ModMatrix::AMP) amp += v;
+            if (rt.destination == ModMatrix::PAN) pan += v;
+        }
+        amp = std::max(0.0, amp);
+        pan = std::clamp(pan, -1.0, 1.0);
+        const double a = (pan + 1.0) * 0.785398163397;
+        const double expect[3] = { ratio[l] * std::exp2(pitch / 12.0),
+                                   gainL[l] * amp * std::sqrt(2.0) * std::cos(a),
+                                   gainR[l] * amp * std::sqrt(2.0) * std::sin(a) };
+        const float got[3] = { modRatio[l], modL[l], modR[l] };
+        for (int k = 0; k < 3; ++k) worst = std::max(worst, std::fabs(got[k] - expect[k]) / std::max(1e-3, std::fabs(expect[k])));
+    }
+    ok = ok && worst < 1e-5 && std::fabs(m.global(ModMatrix::CUTOFF) - 0.5f) < 1e-7f;
+
+    const ModMatrix::Route bad{ ModMatrix::ENVELOPE, ModMatrix::CUTOFF, 1.0f, ModMatrix::LINEAR };
+    const bool refused = !m.setRoutes(&bad, 1) && m.routes() == 0 && !m.perLane();
+
+    auto render = [&](bool modulated, unsigned long& allocs) {
+        Synth synth(256);
+        synth.setSampleRate(opt.sampleRate);
+        if (modulated) {
+            for (int i = 0; i < 6; ++i) {
+                synth.modSource[i].store(routes[i].source);
+                synth.modDestination[i].store(routes[i].destination);
+                synth.modDepth[i].store(routes[i].depth);
+                synth.modCurve[i].store(routes[i].curve);
+            }
+        }
+        for (int n = 0; n < 32; ++n) synth.cmdQ.push({ SynthCmd::NoteOn, 40 + n, (n + 1) / 32.0f });
+        std::vector<float> out(256 * Synth::kChannels * 20);
+        synth.processBlock(out.data(), 256);
+        const unsigned long before = gAllocs.load();
+        for (int b = 1; b < 20; ++b) synth.processBlock(out.data() + b * 256 * Synth::kChannels, 256);
+        allocs = gAllocs.load() - before;
+        return out;
+    };
+    unsigned long allocs = 0, unused;
+    const std::vector<float> plain = render(false, unused);
+    const std::vector<float> modulated = render(true, allocs);
+    bool finite = true;
+    for (float x : modulated) finite = finite && std::isfinite(x);
+    const bool differs = std::memcmp(plain.data(), modulated.data(), plain.size() * sizeof(float)) != 0;
+
+    ok = ok && refused && finite && differs && allocs == 0;
+    std::printf("verify mod matrix: max rel err %.2e, cutoff from envelope %s, synth %s, %lu allocs: %s\n",
+                worst, refused ? "refused" : "accepted", differs && finite ? "modulated" : "unchanged",
+                allocs, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// Block cost with 256 voices as per-voice routes are added; the per-lane
+// pass runs once per kModFrames, so the routes should barely register
+static void benchModulation(const Options& opt) {
+    const ModMatrix::Route routes[] = {
+        { ModMatrix::ENVELOPE, ModMatrix::PITCH, 0.5f, ModMatrix::LINEAR },
+        { ModMatrix::VELOCITY, ModMatrix::AMP, -0.5f, ModMatrix::SQUARED },
+        { ModMatrix::LFO2, ModMatrix::PAN, 0.5f, ModMatrix::LINEAR },
+        { ModMatrix::ENVELOPE, ModMatrix::AMP, 0.2f, ModMatrix::ROOT },
+        { ModMatrix::LFO3, ModMatrix::PITCH, 0.1f, ModMatrix::LINEAR },
+        { ModMatrix::VELOCITY, ModMatrix::PAN, 0.3f, ModMatrix::LINEAR },
+        { ModMatrix::LFO4, ModMatrix::AMP, 0.1f, ModMatrix::SQUARED },
+        { ModMatrix::ENVELOPE, ModMatrix::PITCH, 0.1f, ModMatrix::SQUARED },
+    };
+    std::printf("%8s %14s\n", "routes", "ns/voice/samp");
+    for (int count : { 0, 1, 2, 4, 8 }) {
+        Synth synth(256);
+        synth.setSampleRate(opt.sampleRate);
+        if (opt.kernel) synth.setVoiceKernel(opt.kernel);
+        synth.bandLimited.store(!opt.naive);
+        for (int i = 0; i < count; ++i) {
+            synth.modSource[i].store(routes[i].source);
+            synth.modDestination[i].store(routes[i].destination);
+            synth.modDepth[i].store(routes[i].depth);
+            synth.modCurve[i].store(routes[i].curve);
+        }
+        addVoices(synth, 255);
+        // Best of three; one route's share is below the run-to-run noise
+        double ns = runBlocks(opt, synth).nsPerBlock;
+        for (int run = 0; run < 2; ++run) ns = std::min(ns, runBlocks(opt, synth).nsPerBlock);
+        std::printf("%8d %14.3f\n", count, ns / (opt.block * 256.0));
+    }
+    std::printf("\n");
+}
+
+// --------------------------
+// Sampler
+// --------------------------
+// Page faults taken by the calling thread so far; 0 where not available
+static long threadFaults() {
+#if defined(__linux__)
+    rusage u;
+    getrusage(RUSAGE_THREAD, &u);
+    return u.ru_minflt + u.ru_majflt;
+#else
+    return 0;
+#endif
+}
+
+// A test sample, stereo float: two low sines in every channel
+static bool writeTestSample(const std::string& path, int rate, double seconds) {
+    const unsigned long frames = (unsigned long)(seconds * rate);
+    std::vector<float> wav(frames * 2);
+    for (unsigned long i = 0; i < frames; ++i) {
+        const double t = i / (double)rate;
+        wav[2 * i] = wav[2 * i + 1] = (float)(0.5 * std::sin(2.0 * M_PI * 50.0 * t) + 0.25 * std::sin(2.0 * M_PI * 130.0 * t));
+    }
+    return writeWav(path, wav.data(), frames, 2, rate);
+}
+
+// A sample at its root pitch plays back as written, through the resident
+// attack region and on through the streamed pages, and the rendering
+// thread takes no page faults doing it. Voices at other pitches end with
+// their samples and give their streams back. The prefetcher settles
+// between blocks, as in an offline render, so nothing may be missed.
+static bool verifySampler(const Options& opt) {
+    const std::string path = "minisynth_verify.wav";
+    const int rate = (int)opt.sampleRate;
+    const double seconds = 3.0;
+    Sampler sampler;
+    std::string error;
+    const bool loaded = writeTestSample(path, rate, seconds) && sampler.addZone(path, 69, 0, 127, error);
+    std::remove(path.c_str());
+    if (!loaded) {
+        std::printf("verify sampler: %s (FAIL)\n", error.c_str());
+        return false;
+    }
+    sampler.start();
+
+    const unsigned long block = 256;
+    VoiceBank bank;
+    bank.setCapacity(64);
+    bank.setSampleRate(opt.sampleRate);
+    Envelope::Params env;
+    env.attack = env.decay = 0.0f;
+    env.sustain = 1.0f;
+    bank.setEnvelope(env);
+    bank.setSampler(&sampler);
+    std::vector<float> inc(block, 440.0f / opt.sampleRate), l(block), r(block);
+
+    bank.playNote(Oscillator::SAMPLE, 69, 1.0f);
+    double maxErr = 0.0;
+    long faults = 0;
+    const unsigned long blocks = (unsigned long)(seconds * rate) / block - 1;
+    for (unsigned long b = 0; b < blocks; ++b) {
+        sampler.settle();
+        std::fill(l.begin(), l.end(), 0.0f);
+        std::fill(r.begin(), r.end(), 0.0f);
+        const long before = threadFaults();
+        bank.render(l.data(), r.data(), inc.data(), block);
+        if (b > 0) faults += threadFaults() - before;
+        for (unsigned long i = 0; i < block && b > 0; ++i) {
+            const double t = (b * block + i) / (double)rate;
+            const double want = 0.2 * (0.5 * std::sin(2.0 * M_PI * 50.0 * t) + 0.25 * std::sin(2.0 * M_PI * 130.0 * t));
+            maxErr = std::max(maxErr, std::fabs(l[i] - want));
+        }
+    }
+
+    // Half to double speed at once, until every sample has run out
+    for (int note = 57; note <= 81; note += 2) bank.playNote(Oscillator::SAMPLE, note, 0.5f);
+    const int started = bank.sounding();
+    for (unsigned long b = 0; b < 8 * blocks && bank.sounding() > 0; ++b) {
+        sampler.settle();
+        const long before = threadFaults();
+        bank.render(l.data(), r.data(), inc.data(), block);
+        faults += threadFaults() - before;
+    }
+    bank.render(l.data(), r.data(), inc.data(), block);
+    const bool ended = bank.sounding() == 0;
+
+    int opened[Sampler::kMaxStreams];
+    int streams = 0;
+    while (streams < Sampler::kMaxStreams && (opened[streams] = sampler.open(0)) >= 0) ++streams;
+    for (int i = 0; i < streams; ++i) sampler.close(opened[i]);
+
+    const uint64_t missed = sampler.missedFrames();
+    const bool ok = maxErr < 1e-4 && missed == 0 && faults == 0 && ended && streams == Sampler::kMaxStreams;
+    std::printf("verify sampler: max err %.2g over %.0f s (%.2f s streamed), %llu frames missed, "
+                "%ld page faults rendering, %d voices %s, %d/%d streams free: %s\n",
+                maxErr, seconds, seconds - Sampler::kAttackFrames / (double)rate, (unsigned long long)missed,
+                faults, started, ended ? "ended with their samples" : "still sounding", streams,
+                Sampler::kMaxStreams, ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// Streaming voices paced in real time, as a device pulls them, with no
+// settle(): the prefetch thread has to keep up on its own. Load is render
+// time over block time.
+static void benchSampler(const Options& opt) {
+    const std::string path = "minisynth_bench.wav";
+    Sampler sampler;
+    std::string error;
+    const bool loaded = writeTestSample(path, (int)opt.sampleRate, 20.0) && sampler.addZone(path, 60, 0, 127, error);
+    std::remove(path.c_str());
+    if (!loaded) {
+        std::printf("sampler: %s\n\n", error.c_str());
+        return;
+    }
+    sampler.start();
+
+    std::printf("%8s %14s %14s %14s\n", "streams", "load %", "missed", "faults");
+    for (int voices : { 16, 64, Sampler::kMaxStreams }) {
+        Synth synth(Sampler::kMaxStreams + 1);
+        synth.setSampleRate(opt.sampleRate);
+        if (opt.kernel) synth.setVoiceKernel(opt.kernel);
+        synth.setSampler(&sampler);
+        for (int i = 0; i < voices; ++i) {
+            SynthCmd c{ SynthCmd::NoteOn, 48 + i % 25, 0.5f };
+            while (!synth.cmdQ.push(c)) synth.processBlock(nullptr, 0);
+        }
+        std::vector<float> out(opt.block * Synth::kChannels);
+        synth.processBlock(out.data(), opt.block);
+
+        const uint64_t missedBefore = sampler.missedFrames();
+        const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(opt.block / opt.sampleRate));
+        const int blocks = (int)(opt.seconds * opt.sampleRate / opt.block);
+        long faults = 0;
+        double busy = 0.0;
+        auto next = std::chrono::steady_clock::now();
+        for (int b = 0; b < blocks; ++b) {
+            const long before = threadFaults();
+            const auto t0 = std::chrono::steady_clock::now();
+            synth.processBlock(out.data(), opt.block);
+            busy += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            faults += threadFaults() - before;
+            next += period;
+            std::this_thread::sleep_until(next);
+        }
+        std::printf("%8d %14.1f %14llu %14ld\n", voices, 100.0 * busy / (blocks * opt.block / opt.sampleRate),
+                    (unsigned long long)(sampler.missedFrames() - missedBefore), faults);
+    }
+    std::printf("\n");
+}
+
+// --------------------------
+// Convolution reverb
+// --------------------------
+static double threadCpuSeconds() {
+    timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Decaying noise, different per channel
+static void makeResponse(unsigned long frames, float sampleRate, std::vector<float>& left, std::vector<float>& right) {
+    left.resize(frames);
+    right.resize(frames);
+    uint32_t seed = 777;
+    for (unsigned long i = 0; i < frames; ++i) {
+        const float decay = std::exp(-3.0f * i / sampleRate);
+        seed = seed * 1664525u + 1013904223u;
+        left[i] = ((seed >> 8) * (2.0f / 16777216.0f) - 1.0f) * decay;
+        seed = seed * 1664525u + 1013904223u;
+        right[i] = ((seed >> 8) * (2.0f / 16777216.0f) - 1.0f) * decay;
+    }
+}
+
+// Noise through a response reaching well into the tail, in ragged blocks,
+// against direct convolution in double, latency() frames late. With the
+// tail thread, paced in real time, the output must match the inline
+// render bit for bit with no late blocks. A loaded file comes out at unit
+// energy.
+static bool verifyConvolution(const Options& opt) {
+    const unsigned long partition = 64, frames = 24000;
+    const unsigned long irFrames = 2 * partition * Convolver::kTailRatio * 3 + 123;
+    std::vector<float> ir[2];
+    makeResponse(irFrames, opt.sampleRate, ir[0], ir[1]);
+    std::vector<float> in[2] = { std::vector<float>(frames), std::vector<float>(frames) };
+    uint32_t seed = 99;
+    for (auto& c : in) {
+        for (float& v : c) {
+            seed = seed * 1664525u + 1013904223u;
+            v = (seed >> 8) * (2.0f / 16777216.0f) - 1.0f;
+        }
+    }
+
+    // Both channels, left then right
+    auto render = [&](bool threaded, uint64_t& late) {
+        Convolver conv(partition);
+        conv.setImpulse(ir[0], ir[1]);
+        if (threaded) conv.start();
+        std::vector<float> out(2 * frames);
+        const unsigned long blocks[] = { 1, 37, 256, 100, 64, 3 };
+        auto next = std::chrono::steady_clock::now();
+        for (unsigned long pos = 0, b = 0; pos < frames; ++b) {
+            const unsigned long n = std::min(blocks[b % 6], frames - pos);
+            conv.process(in[0].data() + pos, in[1].data() + pos, out.data() + pos, out.data() + frames + pos, n);
+            pos += n;
+            if (threaded) {
+                next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(n / opt.sampleRate));
+                std::this_thread::sleep_until(next);
+            }
+        }
+        late = conv.lateBlocks();
+        return out;
+    };
+    uint64_t lateInline = 0, lateThreaded = 0;
+    const std::vector<float> inline_ = render(false, lateInline);
+    const std::vector<float> threaded = render(true, lateThreaded);
+
+    double maxErr = 0.0, power = 0.0;
+    for (int ch = 0; ch < 2; ++ch) {
+        for (unsigned long t = partition; t < frames; ++t) {
+            const unsigned long y = t - partition;
+            double want = 0.0;
+            for (unsigned long k = 0; k <= std::min(y, irFrames - 1); ++k) want += (double)in[ch][y - k] * ir[ch][k];
+            maxErr = std::max(maxErr, std::fabs(inline_[ch * frames + t] - want));
+            power += want * want;
+        }
+    }
+    const double rel = maxErr / std::sqrt(power / (2.0 * (frames - partition)));
+    const bool same = threaded == inline_;
+
+    // A stereo file at half the rate comes back twice as long, at unit energy
+    const std::string path = "minisynth_verify_ir.wav";
+    std::vector<float> wav(2 * irFrames);
+    for (unsigned long i = 0; i < irFrames; ++i) {
+        wav[2 * i] = ir[0][i];
+        wav[2 * i + 1] = ir[1][i];
+    }
+    Convolver loaded;
+    std::string error;
+    const bool read = writeWav(path, wav.data(), irFrames, 2, (int)opt.sampleRate / 2) &&
+                      loaded.load(path, opt.sampleRate, error);
+    std::remove(path.c_str());
+    double energy = 0.0;
+    if (read) {
+        const unsigned long n = loaded.length() + loaded.latency();
+        std::vector<float> pulse(n, 0.0f), l(n), r(n);
+        pulse[0] = 1.0f;
+        loaded.process(pulse.data(), pulse.data(), l.data(), r.data(), n);
+        for (unsigned long i = 0; i < n; ++i) energy += 0.5 * ((double)l[i] * l[i] + (double)r[i] * r[i]);
+    }
+    const bool scaled = read && loaded.length() == 2 * irFrames - 1 && std::fabs(energy - 1.0) < 1e-3;
+
+    const bool ok = rel < 1e-5 && lateInline == 0 && lateThreaded == 0 && same && scaled;
+    std::printf("verify convolution %lu-frame response: max rel err vs direct = %.3g, tail thread %s "
+                "(%llu late), file load %s: %s\n",
+                irFrames, rel, same ? "bit-identical" : "differs", (unsigned long long)lateThreaded,
+                scaled ? "ok" : error.empty() ? "wrong length or level" : error.c_str(), ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// Cost by response length and partition (the block size here). Inline is
+// everything on the calling thread, against real time, and its worst block
+// carries a whole tail partition. With the tail thread, the audio side's
+// share and worst block; the bench runs faster than real time, so the
+// thread drops blocks, which the audio side does not feel. CPU time of
+// the calling thread, so preemption does not count.
+static void benchConvolution(const Options& opt) {
+    std::printf("%9s %8s %14s %14s %14s %14s\n", "partition", "IR s", "inline %", "inline max us",
+                "audio %", "audio max us");
+    for (double seconds : { 0.5, 2.0, 8.0 }) {
+        std::vector<float> ir[2];
+        makeResponse((unsigned long)(seconds * opt.sampleRate), opt.sampleRate, ir[0], ir[1]);
+        for (unsigned long partition : { 64ul, 128ul, 256ul, 512ul }) {
+            double load[2], worst[2];
+            for (int threaded = 0; threaded < 2; ++threaded) {
+                Convolver conv(partition);
+                conv.setImpulse(ir[0], ir[1]);
+                if (threaded) conv.start();
+                std::vector<float> l(partition, 0.1f), r(partition, -0.1f), wl(partition), wr(partition);
+                const unsigned long blocks = (unsigned long)(std::max(opt.seconds, 2.0 * seconds) * opt.sampleRate / partition);
+                double total = 0.0, most = 0.0;
+                for (unsigned long b = 0; b < blocks; ++b) {
+                    const double t0 = threadCpuSeconds();
+                    conv.process(l.data(), r.data(), wl.data(), wr.data(), partition);
+                    const double t = threadCpuSeconds() - t0;
+                    total += t;
+                    most = std::max(most, t);
+                }
+                load[threaded] = 100.0 * total / (blocks * partition / opt.sampleRate);
+                worst[threaded] = most * 1e6;
+            }
+            std::printf("%9lu %8.1f %14.2f %14.1f %14.2f %14.1f\n", partition, seconds, load[0], worst[0], load[1], worst[1]);
+        }
+    }
+    std::printf("\n");
+}
+
+// Double-precision model of an FM voice: the operators as renderFmGroup
+// runs them, on Envelope objects, through the voice envelope
+struct FmReference {
+    double phase[kFmOperators] = {};
+    double last[kFmOperators][2] = {};
+    Envelope op[kFmOperators];
+    Envelope voice;
+    double ratio = 1.0;
+
+    void start(const FmParams& p, const Envelope::Params& env, float sampleRate, double r) {
+        ratio = r;
+        voice.setSampleRate(sampleRate);
+        voice.setParams(env);
+        voice.noteOn();
+        for (int k = 0; k < kFmOperators; ++k) {
+            op[k].setSampleRate(sampleRate);
+            op[k].setParams(p.op[k].envelope);
+            op[k].noteOn();
+        }
+    }
+    void noteOn()  { voice.noteOn();  for (auto& e : op) e.noteOn(); }
+    void noteOff() { voice.noteOff(); for (auto& e : op) e.noteOff(); }
+
+    double next(const FmParams& p, double inc) {
+        const FmAlgorithm& a = kFmAlgorithmTable[p.algorithm];
+        double y[kFmOperators], out = 0.0;
+        int carriers = 0;
+        for (int k = kFmOperators - 1; k >= 0; --k) {
+            const FmOperator& o = p.op[k];
+            double pm = phase[k] + 0.5 * o.feedback * (last[k][0] + last[k][1]);
+            for (int j = k + 1; j < kFmOperators; ++j) {
+                if ((a.modulators[k] >> j) & 1) pm += y[j];
+            }
+            y[k] = std::sin(6.283185307179586 * pm) * op[k].next() * o.level;
+            last[k][1] = last[k][0];
+            last[k][0] = y[k];
+            if ((a.carriers >> k) & 1) {
+                out += y[k];
+                ++carriers;
+            }
+            phase[k] += inc * ratio * o.ratio;
+            phase[k] -= std::floor(phase[k]);
+        }
+        return out / carriers * voice.next();
+    }
+};
+
+// Operator settings with every operator different, so a routing mistake
+// shows
+static FmParams testFmParams(int algorithm) {
+    FmParams p;
+    p.algorithm = algorithm;
+    const float ratios[kFmOperators] = { 1.0f, 2.0f, 3.5f, 0.5f };
+    const float levels[kFmOperators] = { 0.8f, 0.6f, 0.4f, 0.3f };
+    const float feedback[kFmOperators] = { 0.0f, 0.2f, 0.0f, 0.4f };
+    for (int k = 0; k < kFmOperators; ++k) {
+        FmOperator& o = p.op[k];
+        o.ratio = ratios[k];
+        o.level = levels[k];
+        o.feedback = feedback[k];
+        o.envelope.attack = 0.002f * (k + 1);
+        o.envelope.decay = 0.02f * (k + 1);
+        o.envelope.sustain = 0.5f + 0.1f * k;
+        o.envelope.release = 0.03f + 0.01f * k;
+    }
+    return p;
+}
+
+// Every kernel and algorithm against the model, with notes released and
+// retriggered so operator envelopes change stage mid-block
+static bool verifyFm(const Options& opt) {
+    const int voices = 21;
+    const unsigned long block = 256, blocks = 120;
+    Envelope::Params env;
+    env.attack = 0.01f;
+    env.decay = 0.05f;
+    env.sustain = 0.7f;
+    env.release = 0.04f;
+
+    const VoiceKernel* k[4];
+    const int n = availableVoiceKernels(k, 4);
+    bool ok = true;
+    for (int i = 0; i < n; ++i) {
+        float maxErr = 0.0f;
+        for (int alg = 0; alg < kFmAlgorithms; ++alg) {
+            const FmParams p = testFmParams(alg);
+            VoiceBank bank;
+            bank.setCapacity(voices);
+            bank.setKernel(k[i]->name);
+            bank.setSampleRate(opt.sampleRate);
+            bank.setEnvelope(env);
+            bank.setFm(p);
+            std::vector<FmReference> ref(voices);
+            std::vector<VoiceHandle> handles(voices);
+            for (int v = 0; v < voices; ++v) {
+                handles[v] = bank.playNote(Oscillator::FM, 48 + v, 1.0f);
+                ref[v].start(p, env, opt.sampleRate, std::exp2((48 + v - 69) / 12.0));
+            }
+
+            std::vector<float> inc(block), got(block), gotR(block);
+            for (unsigned long b = 0; b < blocks; ++b) {
+                std::vector<double> want(block, 0.0);
+                for (unsigned long t = 0; t < block; ++t) {
+                    inc[t] = (220.0f + 50.0f * std::sin(0.0005f * (b * block + t))) / opt.sampleRate;
+                    got[t] = gotR[t] = 0.0f;
+                    for (auto& r : ref) want[t] += 0.2 * r.next(p, inc[t]);
+                }
+                bank.render(got.data(), gotR.data(), inc.data(), block);
+                for (unsigned long t = 0; t < block; ++t) {
+                    maxErr = std::max(maxErr, (float)std::fabs(got[t] - want[t]));
+                    maxErr = std::max(maxErr, (float)std::fabs(gotR[t] - want[t]));
+                }
+
+                if (b % 10 == 5 && (int)(b / 10) < voices) {
+                    bank.noteOff(handles[b / 10]);
+                    ref[b / 10].noteOff();
+                }
+                if (b % 30 == 6 && (int)(b / 10) < voices) {
+                    bank.noteOn(handles[b / 10]);
+                    ref[b / 10].noteOn();
+                }
+            }
+        }
+        // The kernel's float phases drift from the model's over the run
+        const float tolerance = 5e-4f;
+        std::printf("verify fm %-12s %d algorithms, %d voices: max |err| = %.3g (%s)\n",
+                    k[i]->name, kFmAlgorithms, voices, maxErr, maxErr <= tolerance ? "ok" : "FAIL");
+        ok = ok && maxErr <= tolerance;
+    }
+    return ok;
+}
+
+// Four-operator FM notes against saw notes stacked four lanes deep
+// (unison), the same number of oscillators, and against the model's
+// scalar std::sin loop
+static void benchFm(const Options& opt) {
+    const int notes = 64;
+    const double blockNs = opt.block / (double)opt.sampleRate * 1e9;
+    std::printf("fm, %d notes, ns/block (%% of block):", notes);
+
+    {
+        const FmParams p = testFmParams(0);
+        Envelope::Params env;
+        std::vector<FmReference> ref(notes);
+        for (int v = 0; v < notes; ++v) ref[v].start(p, env, opt.sampleRate, std::exp2((36 + v - 69) / 12.0));
+        volatile double sink = 0.0;
+        double acc = 0.0;
+        const int reps = 20;
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int r = 0; r < reps; ++r) {
+            for (unsigned long t = 0; t < opt.block; ++t) {
+                for (auto& v : ref) acc += v.next(p, 220.0 / opt.sampleRate);
+            }
+        }
+        sink = acc;
+        const auto t1 = std::chrono::steady_clock::now();
+        const double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / reps;
+        std::printf(" scalar std::sin %.0f (%.2f%%)\n", ns, 100.0 * ns / blockNs);
+    }
+
+    const VoiceKernel* k[4];
+    const int n = availableVoiceKernels(k, 4);
+    for (int i = 0; i < n; ++i) {
+        std::printf("%15s:", k[i]->name);
+        auto run = [&](int waveform, int lanes, int algorithm) {
+            Synth synth(notes * lanes + 1);
+            synth.setSampleRate(opt.sampleRate);
+            synth.setVoiceKernel(k[i]->name);
+            synth.bandLimited.store(!opt.naive);
+            synth.noteWaveform.store(waveform);
+            synth.unisonVoices.store(lanes);
+            synth.fmAlgorithm.store(algorithm);
+            for (int o = 0; o < kFmOperators; ++o) synth.fmLevel[o].store(0.5f);
+            for (int v = 0; v < notes; ++v) synth.cmdQ.push(SynthCmd{ SynthCmd::NoteOn, 36 + v, 1.0f });
+            return runBlocks(opt, synth).nsPerBlock;
+        };
+        const double saws = run(Oscillator::SAW, kFmOperators, 0);
+        std::printf(" saw x%d %.0f (%.2f%%)", kFmOperators, saws, 100.0 * saws / blockNs);
+        for (int alg : { 0, 5, 7 }) {
+            const double fm = run(Oscillator::FM, 1, alg);
+            std::printf(", fm alg %d %.0f (%.2f%%)", alg, fm, 100.0 * fm / blockNs);
+        }
+        std::printf("\n");
+    }
+    std::printf("\n");
+}
+
+// Synthetic load against the governor's decisions: a block costs a base
+// plus a cost per lane, less for each step in force, with a little noise
+static double governedCost(int lanes, int steps, uint32_t& noise) {
+    double perLane = 10000.0;
+    if (steps & Governor::SlowControl)      perLane *= 0.85;
+    if (steps & Governor::NoOversampling)   perLane *= 0.5;
+    if (steps & Governor::NaiveOscillators) perLane *= 0.8;
+    noise = noise * 1664525u + 1013904223u;
+    return (200000.0 + perLane * lanes) * (1.0 + 0.04 * ((noise >> 8) / 16777216.0 - 0.5));
+}
+
+static bool verifyGovernor(const Options& opt) {
+    const unsigned long block = 256;
+    const double blockNs = block / (double)opt.sampleRate * 1e9;
+    const Governor::Options go;
+    bool ok = true;
+
+    // Demand ramps up past what the top level can take, holds, falls back
+    // and idles. A quarter of the lanes are releasing, so that much is
+    // there to drop.
+    {
+        Governor g(opt.sampleRate);
+        const double budgetNs = blockNs * g.budget.load();
+        uint32_t noise = 1;
+        uint64_t frame = 0;
+        int level = 0, maxLevel = 0, changes = 0, lateEarly = 0, ungovernedLate = 0;
+        long dropped = 0;
+        std::vector<uint64_t> stepDowns;
+        auto run = [&](int demand) {
+            const Governor::Decision d = g.plan(frame, block, demand);
+            const int drop = std::min(d.dropLanes, demand / 4);
+            const int lanes = demand - drop;
+            const double ns = governedCost(lanes, d.steps, noise);
+            if (ns > budgetNs && level < Governor::kSteps) ++lateEarly;
+            if (governedCost(demand, 0, noise) > budgetNs) ++ungovernedLate;
+            g.measured((uint64_t)ns, lanes, drop);
+            if (g.level() != level) {
+                ++changes;
+                if (g.level() < level) stepDowns.push_back(frame);
+            }
+            level = g.level();
+            maxLevel = std::max(maxLevel, level);
+            dropped += drop;
+            frame += block;
+        };
+        for (int demand = 0; demand < 1200; demand += 4) run(demand);
+        for (int b = 0; b < 400; ++b) run(1200);
+        for (int demand = 1200; demand > 40; demand -= 4) run(demand);
+        for (int b = 0; b < (int)(6 * go.holdSec * opt.sampleRate / block); ++b) run(40);
+
+        int logged = 0, loggedSteps = 0;
+        GovernorEvent e;
+        while (g.poll(e)) {
+            ++logged;
+            loggedSteps += e.kind == GovernorEvent::StepUp || e.kind == GovernorEvent::StepDown;
+        }
+        bool spaced = true;
+        for (size_t i = 1; i < stepDowns.size(); ++i)
+            spaced = spaced && stepDowns[i] - stepDowns[i - 1] >= go.holdSec * opt.sampleRate;
+
+        const bool pass = maxLevel == Governor::kSteps && level == 0 && lateEarly == 0 && dropped > 0 &&
+                          spaced && loggedSteps == changes && logged > changes && g.logOverflows() == 0;
+        std::printf("verify governor ramp: levels to %d and back to %d, %d over budget before the top level "
+                    "(%d ungoverned), %ld lanes dropped, %d steps, %d events logged (%s)\n",
+                    maxLevel, level, lateEarly, ungovernedLate, dropped, changes, logged, pass ? "ok" : "FAIL");
+        ok = ok && pass;
+    }
+
+    // A load sitting at highWater, noise and all, steps up once and stays:
+    // the level below predicts over lowWater
+    {
+        Governor g(opt.sampleRate);
+        g.steps.store(Governor::SlowControl | Governor::NaiveOscillators);
+        const int lanes = (int)((blockNs * g.budget.load() * go.highWater - 200000.0) / 10000.0);
+        uint32_t noise = 7;
+        int level = 0, changes = 0, stray = 0;
+        for (int b = 0; b < 4000; ++b) {
+            const Governor::Decision d = g.plan((uint64_t)b * block, block, lanes);
+            stray += (d.steps & ~(Governor::SlowControl | Governor::NaiveOscillators)) != 0;
+            g.measured((uint64_t)governedCost(lanes, d.steps, noise), lanes, 0);
+            changes += g.level() != level;
+            level = g.level();
+        }
+        const bool pass = changes <= 2 && level > 0 && stray == 0;
+        std::printf("verify governor hysteresis: %d lanes at highWater, %d level changes in 4000 blocks, "
+                    "ends at %d (%s)\n", lanes, changes, level, pass ? "ok" : "FAIL");
+        ok = ok && pass;
+    }
+
+    // In the synth: idle, it changes nothing; over budget, it drops the
+    // released voices it is told to, answers for them, and never allocates
+    {
+        auto start = [&](Synth& s, int notes) {
+            s.setSampleRate(opt.sampleRate);
+            s.releaseSec.store(2.0f);
+            for (int n = 0; n < notes; ++n) {
+                SynthCmd c{ SynthCmd::NoteOn, 24 + n % 96, 0.5f };
+                while (!s.cmdQ.push(c)) s.processBlock(nullptr, 0);
+            }
+        };
+        std::vector<float> a(block * Synth::kChannels), b(block * Synth::kChannels);
+        Synth plain, governed;
+        Governor idle(opt.sampleRate);
+        idle.budget.store(1.0f);
+        governed.setGovernor(&idle);
+        start(plain, 16);
+        start(governed, 16);
+        bool same = true;
+        for (int i = 0; i < 200; ++i) {
+            plain.processBlock(a.data(), block);
+            governed.processBlock(b.data(), block);
+            same = same && a == b;
+        }
+
+        Synth busy(4096);
+        Governor g(opt.sampleRate);
+        g.budget.store(0.05f);
+        busy.setGovernor(&g);
+        busy.oversampling.store(4);
+        start(busy, 2048);
+        for (int n = 24; n < 72; ++n) {
+            SynthCmd c{ SynthCmd::NoteOff, n, 0.0f };
+            while (!busy.cmdQ.push(c)) busy.processBlock(nullptr, 0);
+        }
+        const unsigned long allocsBefore = gAllocs.load();
+        int maxLevel = 0;
+        for (int i = 0; i < 100; ++i) {
+            busy.processBlock(b.data(), block);
+            maxLevel = std::max(maxLevel, g.level());
+        }
+        const unsigned long allocs = gAllocs.load() - allocsBefore;
+        uint64_t ended = 0;
+        SynthReply r;
+        while (busy.replyQ.pop(r)) ended += r.type == SynthReply::VoiceEnded;
+        g.enabled.store(false);
+        busy.processBlock(b.data(), block);
+
+        const bool pass = same && idle.level() == 0 && maxLevel > 0 && g.droppedLanes() > 0 &&
+                          ended == g.droppedLanes() && allocs == 0 && g.level() == 0;
+        std::printf("verify governor synth: idle %s, busy to level %d, %llu lanes dropped, %llu ended, "
+                    "%lu allocs (%s)\n", same ? "identical" : "DIFFERS", maxLevel,
+                    (unsigned long long)g.droppedLanes(), (unsigned long long)ended, allocs, pass ? "ok" : "FAIL");
+        ok = ok && pass;
+    }
+    return ok;
+}
+
+// A polyphony spike with and without the governor: 1024 notes at 4x
+// oversampling, half of them released, against a budget of half what the
+// ungoverned synth takes
+static void benchGovernor(const Options& opt) {
+    const double blockNs = opt.block / (double)opt.sampleRate * 1e9;
+    {
+        Governor g(opt.sampleRate);
+        uint32_t noise = 3;
+        const int reps = 100000;
+        double sink = 0.0;
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < reps; ++i) {
+            const int lanes = 64 + i % 512;
+            const Governor::Decision d = g.plan((uint64_t)i * opt.block, opt.block, lanes);
+            sink += d.dropLanes;
+            g.measured((uint64_t)governedCost(lanes, d.steps, noise), lanes, 0);
+        }
+        const auto t1 = std::chrono::steady_clock::now();
+        GovernorEvent e;
+        while (g.poll(e)) sink += e.level;
+        const volatile double keep = sink;
+        (void)keep;
+        std::printf("governor: plan + measured %.0f ns per block\n",
+                    std::chrono::duration<double, std::nano>(t1 - t0).count() / reps);
+    }
+
+    const unsigned long blocks = std::max(64ul, (unsigned long)(opt.seconds * opt.sampleRate / opt.block));
+    float budget = 1.0f;
+    for (int governed = 0; governed < 2; ++governed) {
+        Synth synth(2048);
+        Governor g(opt.sampleRate);
+        g.budget.store(budget);
+        if (governed) synth.setGovernor(&g);
+        synth.setSampleRate(opt.sampleRate);
+        if (opt.kernel) synth.setVoiceKernel(opt.kernel);
+        synth.oversampling.store(4);
+        synth.releaseSec.store(2.0f);
+        std::vector<float> out(opt.block * Synth::kChannels);
+        for (int n = 0; n < 1024 + 48; ++n) {
+            SynthCmd c = n < 1024 ? SynthCmd{ SynthCmd::NoteOn, 24 + n % 96, 0.5f }
+                                  : SynthCmd{ SynthCmd::NoteOff, 24 + n - 1024, 0.0f };
+            while (!synth.cmdQ.push(c)) synth.processBlock(nullptr, 0);
+        }
+
+        double total = 0.0, most = 0.0;
+        unsigned long over = 0;
+        for (unsigned long b = 0; b < blocks; ++b) {
+            const auto t0 = std::chrono::steady_clock::now();
+            synth.processBlock(out.data(), opt.block);
+            const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count();
+            total += ns;
+            most = std::max(most, ns);
+            over += ns > budget * blockNs;
+            SynthReply r;
+            while (synth.replyQ.pop(r)) {}
+        }
+        std::printf("  %-10s mean %.0f us, max %.0f us", governed ? "governed" : "ungoverned",
+                    total / blocks * 1e-3, most * 1e-3);
+        if (governed) {
+            std::printf(", %lu of %lu blocks over the %.0f us budget, level %d, %llu lanes dropped\n", over, blocks,
+                        budget * blockNs * 1e-3, g.level(), (unsigned long long)g.droppedLanes());
+        } else {
+            std::printf(" of %.0f\n", blockNs * 1e-3);
+            budget = std::clamp((float)(0.5 * total / blocks / blockNs), 0.05f, 1.0f);
+        }
+    }
+    std::printf("\n");
+}
+
+static void benchParallel(const Options& opt) {
+    const int voices = std::min(opt.maxVoices, 2048);
+    const int cores = std::max(2, (int)std::thread::hardware_concurrency());
+    const unsigned long blocks[] = { 64, 128, 256, 512, 1024 };
+
+    std::printf("parallel render, %d voices, %d hardware threads\n", voices, (int)std::thread::hardware_concurrency());
+    std::printf("%8s %8s %14s %10s\n", "block", "threads", "ns/block", "speedup");
+    for (unsigned long block : blocks) {
+        double base = 0.0;
+        for (int t = 1; t <= cores; t *= 2) {
+            Options o = opt;
+            o.block = block;
+            o.threads = t;
+
+            Synth synth(voices);
+            synth.setSampleRate(o.sampleRate);
+            synth.setRenderThreads(t);
+            addVoices(synth, voices - 1);
+            const RunResult r = runBlocks(o, synth);
+            if (t == 1) base = r.nsPerBlock;
+            std::printf("%8lu %8d %14.0f %10.2f\n", block, t, r.nsPerBlock, base / r.nsPerBlock);
+        }
+    }
+}
+
+// --------------------------
+// Message queues
+// --------------------------
+// The command ring Synth used before MessageQueue.h, kept as the baseline
+template <typename T, size_t N>
+class ModuloRing {
+public:
+    bool push(const T& c) {
+        auto w = write_.load(std::memory_order_relaxed);
+        auto n = (w + 1) % N;
+        if (n == read_.load(std::memory_order_acquire)) return false;
+        buf_[w] = c;
+        write_.store(n, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& c) {
+        auto r = read_.load(std::memory_order_relaxed);
+        if (r == write_.load(std::memory_order_acquire)) return false;
+        c = buf_[r];
+        read_.store((r + 1) % N, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T buf_[N]{};
+    std::atomic<size_t> write_{0}, read_{0};
+};
+
+// Pops batches when the queue has them, single entries otherwise
+template <typename Q>
+static size_t drain(Q& q, SynthCmd* out, size_t max) {
+    if constexpr (std::is_same<Q, ModuloRing<SynthCmd, 256>>::value) {
+        size_t k = 0;
+        while (k < max && q.pop(out[k])) ++k;
+        return k;
+    } else {
+        return q.popBatch(out, max);
+    }
+}
+
+// `producers` threads each send `count` commands tagged with their id and
+// a sequence number. Returns messages per second, or 0 if the consumer saw
+// a message lost, duplicated or out of order within its producer.
+template <typename Q>
+static double queueThroughput(Q& q, int producers, int count) {
+    std::vector<std::thread> threads;
+    std::atomic<bool> go{false};
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+            for (int i = 0; i < count; ++i) {
+                const SynthCmd c{ SynthCmd::SetParam, p, (float)i };
+                while (!q.push(c)) std::this_thread::yield();
+            }
+        });
+    }
+
+    std::vector<int> expect(producers, 0);
+    SynthCmd batch[64];
+    bool ok = true;
+    const long total = (long)producers * count;
+    const auto t0 = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (long got = 0; got < total;) {
+        const size_t n = drain(q, batch, 64);
+        if (n == 0) std::this_thread::yield();
+        for (size_t i = 0; i < n; ++i) {
+            ok = ok && batch[i].index < producers && (int)batch[i].value == expect[batch[i].index]++;
+        }
+        got += (long)n;
+    }
+    const auto t1 = std::chrono::steady_clock::now();
+    for (auto& t : threads) t.join();
+    return ok ? total / std::chrono::duration<double>(t1 - t0).count() : 0.0;
+}
+
+// Round trip of one command through `there` and back through `back`, in ns
+template <typename Q, typename R>
+static double queueRoundTrip(Q& there, R& back, int trips) {
+    std::thread echo([&] {
+        SynthCmd c;
+        for (int i = 0; i < trips; ++i) {
+            while (!there.pop(c)) std::this_thread::yield();
+            while (!back.push(c)) std::this_thread::yield();
+        }
+    });
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < trips; ++i) {
+        SynthCmd c{ SynthCmd::SetParam, 0, (float)i };
+        while (!there.push(c)) std::this_thread::yield();
+        while (!back.pop(c)) std::this_thread::yield();
+    }
+    const auto t1 = std::chrono::steady_clock::now();
+    echo.join();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / trips;
+}
+
+static void benchQueues() {
+    const int count = 1 << 20;
+    const int trips = 20000;
+
+    std::printf("message queues, %d hardware threads, %zu-byte commands\n",
+                (int)std::thread::hardware_concurrency(), sizeof(SynthCmd));
+    std::printf("%-24s %12s %14s\n", "queue", "Mmsg/s", "round trip ns");
+    {
+        ModuloRing<SynthCmd, 256> q;
+        ModuloRing<SynthCmd, 256> b;
+        const double rate = queueThroughput(q, 1, count);
+        std::printf("%-24s %12.2f %14.0f\n", "modulo ring (old)", rate / 1e6, queueRoundTrip(q, b, trips));
+    }
+    {
+        SpscQueue<SynthCmd, 256> q;
+        SpscQueue<SynthCmd, 256> b;
+        const double rate = queueThroughput(q, 1, count);
+        std::printf("%-24s %12.2f %14.0f\n", "spsc", rate / 1e6, queueRoundTrip(q, b, trips));
+    }
+    for (int producers : { 1, 3 }) {
+        MpscQueue<SynthCmd, 256> q;
+        MpscQueue<SynthCmd, 256> b;
+        const double rate = queueThroughput(q, producers, count / producers);
+        char name[32];
+        std::snprintf(name, sizeof(name), "mpsc, %d producer(s)", producers);
+        if (producers == 1) std::printf("%-24s %12.2f %14.0f\n", name, rate / 1e6, queueRoundTrip(q, b, trips));
+        else std::printf("%-24s %12.2f %14s\n", name, rate / 1e6, "-");
+    }
+}
+
+// Several producers into the command queue while the consumer pops
+// batches and checks each producer's order; then overflow accounting
+static bool verifyQueues() {
+    MpscQueue<SynthCmd, 256> q;
+    const bool ordered = queueThroughput(q, 3, 100000) > 0.0;
+
+    SpscQueue<SynthReply, 4> r;
+    const SynthReply m[6]{};
+    const size_t pushed = r.pushBatch(m, 6);
+    MpscQueue<SynthCmd, 4> c;
+    const SynthCmd cmds[6]{};
+    const bool counted = pushed == 4 && !r.push(m[0]) && r.overflows() == 3 &&
+                         c.pushBatch(cmds, 3) == 3 && c.pushBatch(cmds, 3) == 1 && c.overflows() == 2;
+
+    const bool ok = ordered && counted;
+    std::printf("verify queues: 3 producers %s, overflow count %s (%s)\n",
+                ordered ? "in order" : "LOST/REORDERED", counted ? "right" : "WRONG", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// --------------------------
+// Oversampling
+// --------------------------
+// The polyphase SIMD decimator against a plain FIR over the full impulse
+// response, fed in uneven chunks; then each factor's cascade on tones that
+// would alias into the passband, which must be gone, and passband tones,
+// which must come through at unity gain.
+static bool verifyOversampling() {
+    bool ok = true;
+
+    HalfbandDecimator d;
+    d.design(71);
+    d.setMaxFrames(300);
+    const std::vector<float>& h = d.coefficients();
+    std::vector<float> x(2 * 2000), got(2000), want(2000, 0.0f);
+    uint32_t seed = 1;
+    for (float& v : x) {
+        seed = seed * 1664525u + 1013904223u;
+        v = (float)(seed >> 8) / 8388608.0f - 1.0f;
+    }
+    for (size_t m = 0; m < want.size(); ++m) {
+        double acc = 0.0;
+        for (size_t n = 0; n < h.size() && n <= 2 * m; ++n) acc += (double)h[n] * x[2 * m - n];
+        want[m] = (float)acc;
+    }
+    for (size_t pos = 0, step = 1; pos < got.size(); pos += step, step = step * 7 % 300 + 1) {
+        const size_t n = std::min(step, got.size() - pos);
+        d.process(x.data() + 2 * pos, got.data() + pos, n);
+    }
+    float maxErr = 0.0f;
+    for (size_t m = 0; m < got.size(); ++m) maxErr = std::max(maxErr, std::fabs(got[m] - want[m]));
+    const bool firOk = maxErr < 1e-5f;
+    std::printf("verify halfband %s vs direct FIR: max |err| = %.3g (%s)\n",
+                Oversampler::kernelName(), maxErr, firOk ? "ok" : "FAIL");
+    ok = ok && firOk;
+
+    // Tone at f (in output sample rates) through one factor; gain in dB
+    auto gainDb = [](int factor, double f) {
+        const size_t n = 1024, settle = 256;
+        Oversampler os(n);
+        os.setFactor(factor);
+        std::vector<float> in(n * factor), out(n);
+        double phase = 0.0, sum = 0.0;
+        for (int b = 0; b < 4; ++b) {
+            for (float& v : in) {
+                v = (float)std::sin(6.283185307179586 * phase);
+                phase += f / factor;
+                phase -= std::floor(phase);
+            }
+            os.process(in.data(), out.data(), n);
+            if (b == 0) continue;
+            for (size_t i = (b == 1 ? settle : 0); i < n; ++i) sum += (double)out[i] * out[i];
+        }
+        const double rms = std::sqrt(sum / (3 * n - settle));
+        return 20.0 * std::log10(std::max(rms, 1e-12) / std::sqrt(0.5));
+    };
+    for (int factor : { 2, 4, 8 }) {
+        double worstStop = -1000.0, worstPass = 0.0;
+        for (int m = 1; m <= factor / 2; ++m) {
+            for (double f : { m - 0.3, m + 0.3, m - 0.1 }) {
+                if (f < 0.55 || f >= factor * 0.5) continue;
+                worstStop = std::max(worstStop, gainDb(factor, f));
+            }
+        }
+        for (double f : { 0.01, 0.1, 0.3, 0.4 }) worstPass = std::max(worstPass, std::fabs(gainDb(factor, f)));
+        const bool factorOk = worstStop < -80.0 && worstPass < 0.05;
+        std::printf("verify oversample %dx: aliases %.1f dB, passband within %.3f dB (%s)\n",
+                    factor, worstStop, worstPass, factorOk ? "ok" : "FAIL");
+        ok = ok && factorOk;
+    }
+    return ok;
+}
+
+// --------------------------
+// Kernel vs. Oscillator reference
+// --------------------------
+// Drives VoiceBank and a std::vector<Oscillator> (the pre-SoA render path)
+// with the same LFO-modulated pitch, mixed waveforms and staggered note-offs,
+// and reports the worst per-sample difference of the mixes.
+// With tables, only sine voices are compared: band-limited square and saw
+// differ from the naive shapes by design and are checked in verifyWavetables.
+static bool verifyKernel(const VoiceKernel& k, float sampleRate, const Wavetables* tables,
+                         Envelope::Curve curve, VoiceFilter::Type filter = VoiceFilter::OFF) {
+    const int voices = 37;
+    const unsigned long block = 256, blocks = 400;
+    const Oscillator::Waveform waves[3] = { Oscillator::SINE, Oscillator::SQUARE, Oscillator::SAW };
+    const int kinds = tables ? 1 : 3;
+
+    // Short stages so segment ends fall all over the blocks
+    Envelope::Params env;
+    env.attack = 0.013f;
+    env.decay = 0.071f;
+    env.sustain = 0.6f;
+    env.release = 0.047f;
+    env.curve = curve;
+
+    VoiceBank bank;
+    bank.setCapacity(voices);
+    bank.setKernel(k.name);
+    bank.setWavetables(tables);
+    bank.setSampleRate(sampleRate);
+    bank.setEnvelope(env);
+    bank.setFilterType(filter);
+    std::vector<Oscillator> ref(voices);
+    std::vector<VoiceHandle> handles(voices);
+    for (int v = 0; v < voices; ++v) {
+        handles[v] = bank.add(waves[v % kinds], 440.0f);
+        ref[v].setSampleRate(sampleRate);
+        ref[v].setWaveform(waves[v % kinds]);
+        ref[v].setEnvelope(env);
+        ref[v].noteOn(440.0f);
+    }
+
+    LFO lfo;
+    lfo.setSampleRate(sampleRate);
+    lfo.setFrequency(3.0f);
+
+    // Filter coefficients change per block, the cutoff sweeping 4 octaves
+    std::vector<float> coef[VoiceFilter::kCoefs];
+    const float* coefFrames[VoiceFilter::kCoefs];
+    for (int c = 0; c < VoiceFilter::kCoefs; ++c) {
+        coef[c].resize(block);
+        coefFrames[c] = coef[c].data();
+    }
+
+    std::vector<float> inc(block), got(block), gotR(block), want(block);
+    float maxErr = 0.0f;
+    for (unsigned long b = 0; b < blocks; ++b) {
+        if (filter != VoiceFilter::OFF) {
+            float c[VoiceFilter::kCoefs];
+            VoiceFilter::coefficients(filter, 1000.0f * std::exp2(2.0f * std::sin(0.05f * b)), 0.7f, sampleRate, c);
+            for (int j = 0; j < VoiceFilter::kCoefs; ++j) std::fill(coef[j].begin(), coef[j].end(), c[j]);
+            for (auto& o : ref) o.setFilter(filter, c);
+        }
+        const float pitch = 110.0f + 7.0f * b;
+        for (unsigned long i = 0; i < block; ++i) {
+            const float f = pitch + lfo.computeSample() * 20.0f;
+            inc[i] = std::max(1.0f, f) / sampleRate;
+            got[i] = gotR[i] = 0.0f;
+            want[i] = 0.0f;
+            for (auto& o : ref) want[i] += o.processSample(f);
+        }
+        bank.render(got.data(), gotR.data(), inc.data(), block, filter != VoiceFilter::OFF ? coefFrames : nullptr);
+        for (unsigned long i = 0; i < block; ++i) {
+            maxErr = std::max(maxErr, std::fabs(got[i] - want[i]));
+            maxErr = std::max(maxErr, std::fabs(gotR[i] - want[i]));
+        }
+
+        if (b % 10 == 5 && (int)(b / 10) < voices) {
+            bank.noteOff(handles[b / 10]);
+            ref[b / 10].noteOff();
+        }
+        // Retrigger some of them part way through their release
+        if (b % 30 == 6 && (int)(b / 10) < voices) {
+            bank.noteOn(handles[b / 10]);
+            ref[b / 10].noteOn(440.0f);
+        }
+    }
+
+    static const char* filterNames[] = { "", " lowpass", " bandpass", " highpass", " ladder" };
+    char what[64];
+    std::snprintf(what, sizeof(what), "%s%s", curve == Envelope::LINEAR ? "linear" : "exponential", filterNames[filter]);
+    const float tolerance = 1e-4f;
+    std::printf("verify %-12s %-9s %-18s max |err| = %.3g over %d voices (%s)\n",
+                k.name, tables ? "wavetable" : "naive", what, maxErr, voices, maxErr <= tolerance ? "ok" : "FAIL");
+    return maxErr <= tolerance;
+}
+
+// A bank of single-shape groups (saws, then squares, then sines, then a
+// stretch of all three interleaved) rendered by a kernel and its -generic
+// twin, so the per-shape specializations are checked against the per-lane
+// selects; the output must not change at all
+static std::vector<float> renderShapes(const VoiceKernel& k, float sampleRate) {
+    const unsigned long block = 256;
+    VoiceBank bank;
+    bank.setCapacity(160);
+    bank.setKernel(k.name);
+    bank.setSampleRate(sampleRate);
+    bank.setFilterType(VoiceFilter::SVF_LOWPASS);
+    const Oscillator::Waveform waves[3] = { Oscillator::SAW, Oscillator::SQUARE, Oscillator::SINE };
+    for (int v = 0; v < 160; ++v) bank.add(v < 128 ? waves[v / 32 % 3] : waves[v % 3], 440.0f);
+
+    float c[VoiceFilter::kCoefs];
+    VoiceFilter::coefficients(VoiceFilter::SVF_LOWPASS, 3000.0f, 0.3f, sampleRate, c);
+    std::vector<float> coef[VoiceFilter::kCoefs];
+    const float* coefFrames[VoiceFilter::kCoefs];
+    for (int j = 0; j < VoiceFilter::kCoefs; ++j) {
+        coef[j].assign(block, c[j]);
+        coefFrames[j] = coef[j].data();
+    }
+
+    std::vector<float> inc(block), out(20 * block), right(block);
+    for (unsigned long b = 0; b < 20; ++b) {
+        for (unsigned long i = 0; i < block; ++i) inc[i] = (100.0f + 3.0f * (b * block + i) / block) / sampleRate;
+        bank.render(out.data() + b * block, right.data(), inc.data(), block, b % 2 ? coefFrames : nullptr);
+    }
+    return out;
+}
+
+static bool verifyDispatch(float sampleRate) {
+    const VoiceKernel* k[4];
+    const int n = availableVoiceKernels(k, 4);
+    bool ok = true;
+    for (int i = 0; i < n; ++i) {
+        const std::string generic = std::string(k[i]->name) + "-generic";
+        const VoiceKernel* g = findVoiceKernel(generic.c_str());
+        if (!g) continue;
+        const std::vector<float> a = renderShapes(*k[i], sampleRate);
+        const std::vector<float> b = renderShapes(*g, sampleRate);
+        const bool same = std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+        std::printf("verify %s vs %s, single-shape groups: %s\n", k[i]->name, g->name,
+                    same ? "bit-identical (ok)" : "FAIL");
+        ok = ok && same;
+    }
+    return ok;
+}
+
+// Every mip level against the exact Fourier partial sum it should hold.
+// Linear interpolation misses the top partials of level 0 (4 table samples
+// per cycle) by about -52 dB RMS; each level up is roughly 4x better.
+static bool verifyWavetables(const Wavetables& t) {
+    const Oscillator::Waveform waves[3] = { Oscillator::SINE, Oscillator::SQUARE, Oscillator::SAW };
+    const char* names[3] = { "sine", "square", "saw" };
+    const int points = 4999;
+    const double tolerance = 3e-3;
+    bool ok = true;
+
+    for (int w = 0; w < 3; ++w) {
+        double worst = 0.0;
+        for (int level = 0; level < Wavetables::kLevels; ++level) {
+            const int harmonics = waves[w] == Oscillator::SINE ? 1 : Wavetables::kMaxHarmonics >> level;
+            double sq = 0.0;
+            for (int k = 0; k < points; ++k) {
+                const float phase = (float)k / points;
+                double want = 0.0;
+                for (int h = 1; h <= harmonics; ++h) {
+                    const double s = std::sin(2.0 * M_PI * h * (double)phase) / h;
+                    if (waves[w] == Oscillator::SINE)   want += (h == 1) ? s : 0.0;
+                    if (waves[w] == Oscillator::SQUARE) want += (h & 1) ? 4.0 / M_PI * s : 0.0;
+                    if (waves[w] == Oscillator::SAW)    want -= 2.0 / M_PI * s;
+                }
+                const double e = t.lookup(waves[w], level, phase) - want;
+                sq += e * e;
+            }
+            worst = std::max(worst, std::sqrt(sq / points));
+        }
+
+        std::printf("verify tables %-6s worst rms err = %.3g over %d levels (%s)\n",
+                    names[w], worst, Wavetables::kLevels, worst <= tolerance ? "ok" : "FAIL");
+        ok = ok && worst <= tolerance;
+    }
+    return ok;
+}
+
+static void benchWavetables(const Wavetables& t) {
+    const int n = 1 << 20;
+    volatile float sink = 0.0f;
+
+    auto time = [&](auto fn) {
+        float phase = 0.0f, acc = 0.0f;
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < n; ++i) {
+            acc += fn(phase);
+            phase += 0.0123f;
+            if (phase >= 1.0f) phase -= 1.0f;
+        }
+        const auto t1 = std::chrono::steady_clock::now();
+        sink = acc;
+        return std::chrono::duration<double, std::nano>(t1 - t0).count() / n;
+    };
+
+    const double lookupNs = time([&](float p) { return t.lookup(Oscillator::SAW, 3, p); });
+    const double sinNs = time([](float p) { return std::sin(6.28318530718f * p); });
+    (void)sink;
+
+    std::printf("wavetables: %.1f KB, scalar lookup %.2f ns, std::sin %.2f ns\n",
+                t.bytes() / 1024.0, lookupNs, sinNs);
+}
+
+// --------------------------
+// Fast math
+// --------------------------
+// Each FastMath.h function over its whole documented range against libm in
+// double: every stride-th float, or every float with stride 1 (a few
+// minutes). Positive and negative floats are walked by bit pattern, so the
+// points are spread evenly over the exponents.
+template <typename Fn, typename Ref>
+static double mathError(float lo, float hi, uint32_t stride, int metric, Fn fn, Ref ref) {
+    typedef simd::Vec<4>::f F;
+    const int kBatch = 1024;
+    float x[kBatch], y[kBatch];
+    int count = 0;
+    double worst = 0.0;
+    auto flush = [&]() {
+        for (int i = 0; i < count; i += 4) simd::store<4>(y + i, fn(simd::load<4>(x + i)));
+        for (int i = 0; i < count; ++i) {
+            const double want = ref((double)x[i]);
+            // absolute, relative, or absolute up to 1 and relative past it
+            double err = std::fabs(y[i] - want);
+            if (metric == 1) err /= std::fabs(want);
+            if (metric == 2) err /= std::max(1.0, std::fabs(want));
+            worst = std::max(worst, err);
+        }
+        count = 0;
+    };
+    auto bitsOf = [](float v) { uint32_t b; std::memcpy(&b, &v, 4); return b; };
+    auto walk = [&](float from, float to, float sign) {
+        for (uint64_t b = bitsOf(from); b <= bitsOf(to); b += stride) {
+            uint32_t u = (uint32_t)b;
+            float v;
+            std::memcpy(&v, &u, 4);
+            x[count++] = sign * v;
+            if (count == kBatch) flush();
+        }
+    };
+    if (hi > 0.0f) walk(std::max(lo, 0.0f), hi, 1.0f);
+    if (lo < 0.0f) walk(std::max(-hi, 0.0f), -lo, -1.0f);
+    while (count % 4) x[count++] = hi;
+    flush();
+    return worst;
+}
+
+static bool verifyFastMath(bool exhaustive) {
+    typedef simd::Vec<4>::f F;
+    const uint32_t stride = exhaustive ? 1 : 997;
+    const double twoPi = 6.283185307179586;
+    auto frac = [](double x) { return x - std::nearbyint(x); };
+
+    enum { ABS, REL, MIXED };
+    static const char* const metrics[] = { "abs", "rel", "abs/rel" };
+    struct Case { const char* name; double err, bound; int metric; };
+    const Case cases[] = {
+        { "sin2pi", mathError(-4194304.0f, 4194304.0f, stride, ABS,
+                              [](F v) { return simd::sin2pi<4>(v); },
+                              [&](double x) { return std::sin(twoPi * frac(x)); }), 2e-7, ABS },
+        { "cos2pi", mathError(-4194304.0f, 4194304.0f, stride, ABS,
+                              [](F v) { return simd::cos2pi<4>(v); },
+                              [&](double x) { return std::cos(twoPi * frac(x)); }), 3e-7, ABS },
+        { "exp2", mathError(-126.0f, 127.0f, stride, REL,
+                            [](F v) { return simd::exp2<4>(v); },
+                            [](double x) { return std::exp2(x); }), 3e-7, REL },
+        { "log2", mathError(FLT_MIN, FLT_MAX, stride, MIXED,
+                            [](F v) { return simd::log2<4>(v); },
+                            [](double x) { return std::log2(x); }), 2.5e-7, MIXED },
+        { "tanh", mathError(-20.0f, 20.0f, stride, ABS,
+                            [](F v) { return simd::tanh<4>(v); },
+                            [](double x) { return std::tanh(x); }), 2.5e-7, ABS },
+    };
+
+    bool ok = true;
+    for (const Case& c : cases) {
+        const bool pass = c.err < c.bound;
+        ok = ok && pass;
+        std::printf("verify %-6s %s: max %s err %.3g (bound %.2g) %s\n", c.name,
+                    exhaustive ? "every float" : "1/997 floats", metrics[c.metric],
+                    c.err, c.bound, pass ? "ok" : "FAIL");
+    }
+
+    // pow is two-dimensional: a grid, with the error per unit of |y log2 x|
+    double powErr = 0.0;
+    for (int i = 0; i <= 400; ++i) {
+        const float x = std::exp2(-10.0f + 0.05f * i);
+        for (int j = 0; j <= 160; ++j) {
+            const float y = -4.0f + 0.05f * j;
+            const double want = std::pow((double)x, (double)y);
+            const double scale = std::fabs(y * std::log2((double)x)) + 1.0;
+            powErr = std::max(powErr, std::fabs(simd::pow(x, y) - want) / want / scale);
+        }
+    }
+    ok = ok && powErr < 2.5e-7;
+    std::printf("verify pow    grid: max rel err per unit %.3g (bound 2.5e-07) %s\n", powErr,
+                powErr < 2.5e-7 ? "ok" : "FAIL");
+
+    // Scalar forms are the vector ones
+    const bool scalar = simd::sin2pi(0.3f) == simd::sin2pi<4>(simd::splat<4>(0.3f))[0] &&
+                        simd::exp2(-3.7f) == simd::exp2<4>(simd::splat<4>(-3.7f))[0];
+
+    // Denormals flush inside a guard and only there. The products go
+    // through volatiles, or the compiler may move the multiply past the
+    // guard's constructor or destructor.
+    volatile float tiny = 1e-39f, product;
+    product = tiny * 0.5f;
+    const bool before = product != 0.0f;
+    bool inside;
+    {
+        DenormalGuard guard;
+        product = tiny * 0.5f;
+        inside = DenormalGuard::active() && product == 0.0f;
+    }
+    product = tiny * 0.5f;
+    const bool after = product != 0.0f && !DenormalGuard::active();
+#if defined(__x86_64__) || defined(__i386__) || defined(__aarch64__)
+    const bool flushed = before && inside && after;
+#else
+    const bool flushed = true;
+#endif
+    ok = ok && scalar && flushed;
+    std::printf("verify fast math scalar forms %s, denormal guard %s: %s\n", scalar ? "match" : "differ",
+                flushed ? "flushes" : "does not flush", ok ? "ok" : "FAIL");
+    return ok;
+}
+
+// ns per value, vector (4 wide, the baseline ISA) against libm in float
+static void benchFastMath() {
+    typedef simd::Vec<4>::f F;
+    const int n = 4096;
+    const int reps = 200;
+    std::vector<float> in(n), out(n);
+    for (int i = 0; i < n; ++i) in[i] = 0.001f + 3.0f * i / n;
+
+    auto timeVec = [&](auto fn) {
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int r = 0; r < reps; ++r) {
+            for (int i = 0; i < n; i += 4) simd::store<4>(out.data() + i, fn(simd::load<4>(in.data() + i)));
+        }
+        const auto t1 = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(t1 - t0).count() / ((double)n * reps);
+    };
+    auto timeLibm = [&](auto fn) {
+        const auto t0 = std::chrono::steady_clock::now();
+        for (int r = 0; r < reps; ++r) {
+            for (int i = 0; i < n; ++i) out[i] = fn(in[i]);
+        }
+        const auto t1 = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(t1 - t0).count() / ((double)n * reps);
+    };
+
+    std::printf("%8s %14s %14s\n", "function", "fast ns", "libm ns");
+    std::printf("%8s %14.3f %14.3f\n", "sin2pi", timeVec([](F v) { return simd::sin2pi<4>(v); }),
+                timeLibm([](float x) { return std::sin(6.28318530718f * x); }));
+    std::printf("%8s %14.3f %14.3f\n", "exp2", timeVec([](F v) { return simd::exp2<4>(v); }),
+                timeLibm([](float x) { return std::exp2(x); }));
+    std::printf("%8s %14.3f %14.3f\n", "log2", timeVec([](F v) { return simd::log2<4>(v); }),
+                timeLibm([](float x) { return std::log2(x); }));
+    std::printf("%8s %14.3f %14.3f\n", "tanh", timeVec([](F v) { return simd::tanh<4>(v); }),
+                timeLibm([](float x) { return std::tanh(x); }));
+    std::printf("%8s %14.3f %14.3f\n", "pow", timeVec([](F v) { return simd::pow<4>(v, simd::splat<4>(1.7f)); }),
+                timeLibm([](float x) { return std::pow(x, 1.7f); }));
+    std::printf("\n");
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        auto arg = [&](const char* name) { return std::strcmp(argv[i], name) == 0 && i + 1 < argc; };
+        if      (arg("--block"))      opt.block = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg("--seconds"))    opt.seconds = std::atof(argv[++i]);
+        else if (arg("--max-voices")) opt.maxVoices = std::atoi(argv[++i]);
+        else if (arg("--samplerate")) opt.sampleRate = (float)std::atof(argv[++i]);
+        else if (arg("--kernel"))     opt.kernel = argv[++i];
+        else if (std::strcmp(argv[i], "--verify") == 0) opt.verify = true;
+        else if (arg("--threads"))    opt.threads = std::max(1, std::atoi(argv[++i]));
+        else if (arg("--control-rate")) opt.controlRate = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--naive") == 0)    opt.naive = true;
+        else if (std::strcmp(argv[i], "--parallel") == 0) opt.parallel = true;
+        else if (std::strcmp(argv[i], "--queues") == 0)   opt.queues = true;
+        else if (std::strcmp(argv[i], "--exhaustive") == 0) opt.exhaustive = true;
+        else {
+            std::fprintf(stderr,
+                "usage: minisynth_bench [--block N] [--seconds S] [--max-voices N] [--samplerate HZ]\n"
+                "                       [--kernel NAME] [--naive] [--threads N] [--parallel] [--verify]\n"
+                "                       [--control-rate N] [--queues] [--exhaustive]\n");
+            return 2;
+        }
+    }
+    if (opt.block == 0) opt.block = 256;
+
+    if (opt.kernel && !findVoiceKernel(opt.kernel)) {
+        std::fprintf(stderr, "kernel '%s' is not available on this CPU\n", opt.kernel);
+        return 2;
+    }
+
+    // Every float through the fast math, alone; it takes minutes
+    if (opt.exhaustive) return verifyFastMath(true) ? 0 : 1;
+
+    if (opt.verify) {
+        const VoiceKernel* k[4];
+        const int n = availableVoiceKernels(k, 4);
+        bool ok = true;
+        for (int i = 0; i < n; ++i) {
+            ok = verifyKernel(*k[i], opt.sampleRate, nullptr, Envelope::LINEAR) && ok;
+            ok = verifyKernel(*k[i], opt.sampleRate, nullptr, Envelope::EXPONENTIAL) && ok;
+            ok = verifyKernel(*k[i], opt.sampleRate, &Wavetables::get(), Envelope::LINEAR) && ok;
+            for (int f = VoiceFilter::SVF_LOWPASS; f <= VoiceFilter::LADDER; ++f)
+                ok = verifyKernel(*k[i], opt.sampleRate, nullptr, Envelope::LINEAR, (VoiceFilter::Type)f) && ok;
+        }
+        ok = verifyDispatch(opt.sampleRate) && ok;
+        ok = verifyWavetables(Wavetables::get()) && ok;
+        ok = verifyParallel(opt) && ok;
+        ok = verifyScheduling(opt) && ok;
+        ok = verifyUnison() && ok;
+        ok = verifyRenderAhead(opt) && ok;
+        ok = verifyFft() && ok;
+        ok = verifyScope(opt) && ok;
+        ok = verifyPatches(opt) && ok;
+        ok = verifyModMatrix(opt) && ok;
+        ok = verifySampler(opt) && ok;
+        ok = verifyConvolution(opt) && ok;
+        ok = verifyFm(opt) && ok;
+        ok = verifyGovernor(opt) && ok;
+        ok = verifyQueues() && ok;
+        ok = verifyOversampling() && ok;
+        ok = verifyFastMath(false) && ok;
+        return ok ? 0 : 1;
+    }
+
+    if (opt.parallel) {
+        benchParallel(opt);
+        return 0;
+    }
+
+    if (opt.queues) {
+        benchQueues();
+        return 0;
+    }
+
+    benchWavetables(Wavetables::get());
+    benchFastMath();
+    benchControlRate(opt);
+    benchEnvelope(opt);
+    benchOversampling(opt);
+    benchFilters(opt);
+    benchUnison(opt);
+    benchDispatch(opt);
+    benchScope(opt);
+    benchPatches(opt);
+    benchModulation(opt);
+    benchSampler(opt);
+    benchConvolution(opt);
+    benchFm(opt);
+    benchGovernor(opt);
+    std::printf("kernel %s, %s oscillators, %d thread(s), block %lu frames @ %.0f Hz, %.2f s per run\n",
+                opt.kernel ? opt.kernel : bestVoiceKernel().name, opt.naive ? "naive" : "wavetable",
+                opt.threads, opt.block, opt.sampleRate, opt.seconds);
+    std::printf("%8s %14s %14s %14s\n", "voices", "ns/smp/voice", "realtime x", "allocs/block");
+    for (int v = 1; v <= opt.maxVoices; v *= 2) benchVoices(opt, v);
+
+    std::printf("\n");
+    benchCulling(opt, 16, 16);
+    benchCulling(opt, opt.maxVoices, 16);
+    return 0;
+}
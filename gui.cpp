@@ -1,8 +1,14 @@
 #include "gui.h"
+#include "Convolver.h"
+#include "Governor.h"
+#include "PatchLoader.h"
+#include "RenderAhead.h"
+#include "Scope.h"
 
 #include <vector>
 #include <algorithm> // std::clamp
 #include <cstdio>
+#include <string>
 
 // Dear ImGui
 #include <imgui.h>
@@ -15,7 +21,195 @@ static void glfwErrorCallback(int error, const char* desc) {
     std::fprintf(stderr, "GLFW error %d: %s\n", error, desc);
 }
 
-bool runGui(Synth& engine) {
+// Window events since the last frame. Installed before the ImGui backend,
+// which chains to them; GLFW calls them on the GUI thread.
+static int gEvents = 0;
+
+static void countEvents(GLFWwindow* window) {
+    glfwSetCursorPosCallback(window, [](GLFWwindow*, double, double) { ++gEvents; });
+    glfwSetCursorEnterCallback(window, [](GLFWwindow*, int) { ++gEvents; });
+    glfwSetMouseButtonCallback(window, [](GLFWwindow*, int, int, int) { ++gEvents; });
+    glfwSetScrollCallback(window, [](GLFWwindow*, double, double) { ++gEvents; });
+    glfwSetKeyCallback(window, [](GLFWwindow*, int, int, int, int) { ++gEvents; });
+    glfwSetCharCallback(window, [](GLFWwindow*, unsigned int) { ++gEvents; });
+    glfwSetWindowFocusCallback(window, [](GLFWwindow*, int) { ++gEvents; });
+    glfwSetWindowSizeCallback(window, [](GLFWwindow*, int, int) { ++gEvents; });
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow*) { ++gEvents; });
+}
+
+// Output waveform, triggered on a rising zero crossing so periodic sounds
+// stand still, and the spectrum of the same frame on a log-frequency axis
+static void drawScope(const ScopeTap& scope, const Spectrum& spectrum) {
+    if (!ImGui::CollapsingHeader("Scope", ImGuiTreeNodeFlags_DefaultOpen)) return;
+
+    const int kShown = 1024;
+    const ScopeFrame& f = scope.latest();
+    int start = ScopeFrame::kSamples - kShown;
+    for (int i = start - 1; i > ScopeFrame::kSamples - 2 * kShown; --i) {
+        if (f.samples[i - 1] < 0.0f && f.samples[i] >= 0.0f) {
+            start = i;
+            break;
+        }
+    }
+    char overlay[48];
+    std::snprintf(overlay, sizeof(overlay), "%.1f ms", kShown * 1000.0f / std::max(1.0f, f.sampleRate));
+    ImGui::PlotLines("##scope", f.samples + start, kShown, 0, overlay, -1.0f, 1.0f, ImVec2(-1, 100));
+
+    std::snprintf(overlay, sizeof(overlay), "%.0f Hz - %.1f kHz, 0 to -100 dB",
+                  spectrum.bandHz(0), spectrum.bandHz(spectrum.bands() - 1) / 1000.0f);
+    ImGui::PlotLines("##spectrum", spectrum.levelsDb(), spectrum.bands(), 0, overlay,
+                     -100.0f, 0.0f, ImVec2(-1, 100));
+}
+
+// LFOs 2.. and the modulation matrix's route slots
+static void drawModulation(Synth& engine) {
+    if (!ImGui::CollapsingHeader("Modulation")) return;
+
+    const char* waveNames[] = { "Sine", "Square", "Triangle", "Saw" };
+    for (int k = 0; k < ModMatrix::kLfos - 1; ++k) {
+        ImGui::PushID(k);
+        char label[32];
+        std::snprintf(label, sizeof(label), "LFO %d", k + 2);
+        int wave = engine.modLfoWaveform[k].load();
+        ImGui::PushItemWidth(100);
+        if (ImGui::Combo(label, &wave, waveNames, IM_ARRAYSIZE(waveNames))) engine.modLfoWaveform[k].store(wave);
+        ImGui::PopItemWidth();
+        ImGui::SameLine();
+        float rate = engine.modLfoRateHz[k].load();
+        if (ImGui::SliderFloat("Rate (Hz)", &rate, 0.0f, 20.0f, "%.2f")) engine.modLfoRateHz[k].store(rate);
+        ImGui::PopID();
+    }
+
+    const char* sourceNames[] = { "LFO 1", "LFO 2", "LFO 3", "LFO 4", "Envelope", "Velocity" };
+    const char* destNames[] = { "Pitch (st)", "Cutoff (oct)", "Amp", "Pan" };
+    const char* curveNames[] = { "Linear", "Squared", "Root" };
+    static_assert(IM_ARRAYSIZE(sourceNames) == ModMatrix::kSources, "source names");
+    for (int i = 0; i < ModMatrix::kMaxRoutes; ++i) {
+        ImGui::PushID(100 + i);
+        ImGui::PushItemWidth(90);
+        int source = engine.modSource[i].load();
+        if (ImGui::Combo("##source", &source, sourceNames, IM_ARRAYSIZE(sourceNames))) engine.modSource[i].store(source);
+        ImGui::SameLine();
+        int dest = engine.modDestination[i].load();
+        if (ImGui::Combo("##dest", &dest, destNames, IM_ARRAYSIZE(destNames))) engine.modDestination[i].store(dest);
+        ImGui::SameLine();
+        int curve = engine.modCurve[i].load();
+        if (ImGui::Combo("##curve", &curve, curveNames, IM_ARRAYSIZE(curveNames))) engine.modCurve[i].store(curve);
+        ImGui::SameLine();
+        float depth = engine.modDepth[i].load();
+        if (ImGui::SliderFloat("##depth", &depth, -24.0f, 24.0f, "%.2f")) engine.modDepth[i].store(depth);
+        ImGui::PopItemWidth();
+        ImGui::PopID();
+    }
+    ImGui::TextDisabled("zero depth turns a route off; envelope and velocity cannot move the cutoff");
+}
+
+// What notes play, and the FM operators: one row each, envelope below
+static void drawFm(Synth& engine) {
+    if (!ImGui::CollapsingHeader("FM")) return;
+
+    const char* noteNames[] = { "Saw", "Square", "Sine", "FM" };
+    const int noteWaves[] = { Oscillator::SAW, Oscillator::SQUARE, Oscillator::SINE, Oscillator::FM };
+    int note = 0;
+    for (int i = 0; i < IM_ARRAYSIZE(noteWaves); ++i) {
+        if (noteWaves[i] == engine.noteWaveform.load()) note = i;
+    }
+    if (ImGui::Combo("Notes Play", &note, noteNames, IM_ARRAYSIZE(noteNames))) engine.noteWaveform.store(noteWaves[note]);
+    if (engine.sampler()) ImGui::TextDisabled("the sampler plays notes while it is set");
+
+    const char* algorithmNames[] = { "3>2>1>0", "3+2>1>0", "3+(2>1)>0", "(3>2)+1>0",
+                                     "3>2, 1>0", "3>2+1+0", "3>2, 2 1 0 out", "all out" };
+    static_assert(IM_ARRAYSIZE(algorithmNames) == kFmAlgorithms, "algorithm names");
+    int algorithm = engine.fmAlgorithm.load();
+    if (ImGui::Combo("Algorithm", &algorithm, algorithmNames, IM_ARRAYSIZE(algorithmNames))) engine.fmAlgorithm.store(algorithm);
+
+    for (int k = kFmOperators - 1; k >= 0; --k) {
+        ImGui::PushID(200 + k);
+        ImGui::Text("Op %d", k);
+        ImGui::SameLine();
+        ImGui::PushItemWidth(90);
+        float ratio = engine.fmRatio[k].load();
+        if (ImGui::SliderFloat("##ratio", &ratio, 0.25f, 16.0f, "ratio %.2f", ImGuiSliderFlags_Logarithmic))
+            engine.fmRatio[k].store(ratio);
+        ImGui::SameLine();
+        float level = engine.fmLevel[k].load();
+        if (ImGui::SliderFloat("##level", &level, 0.0f, 4.0f, "level %.2f")) engine.fmLevel[k].store(level);
+        ImGui::SameLine();
+        float feedback = engine.fmFeedback[k].load();
+        if (ImGui::SliderFloat("##feedback", &feedback, 0.0f, 1.0f, "fb %.2f")) engine.fmFeedback[k].store(feedback);
+
+        float attack = engine.fmAttackSec[k].load();
+        if (ImGui::SliderFloat("##attack", &attack, 0.0f, 2.0f, "A %.3f s")) engine.fmAttackSec[k].store(attack);
+        ImGui::SameLine();
+        float decay = engine.fmDecaySec[k].load();
+        if (ImGui::SliderFloat("##decay", &decay, 0.0f, 2.0f, "D %.3f s")) engine.fmDecaySec[k].store(decay);
+        ImGui::SameLine();
+        float sustain = engine.fmSustainLevel[k].load();
+        if (ImGui::SliderFloat("##sustain", &sustain, 0.0f, 1.0f, "S %.2f")) engine.fmSustainLevel[k].store(sustain);
+        ImGui::SameLine();
+        float release = engine.fmReleaseSec[k].load();
+        if (ImGui::SliderFloat("##release", &release, 0.0f, 5.0f, "R %.3f s")) engine.fmReleaseSec[k].store(release);
+        ImGui::PopItemWidth();
+        ImGui::PopID();
+    }
+}
+
+// DSP load, latency percentiles and xruns from the last telemetry window
+static void drawTelemetry(const Telemetry& telemetry, const RenderAhead* ahead) {
+    if (!ImGui::CollapsingHeader("DSP Load", ImGuiTreeNodeFlags_DefaultOpen)) return;
+
+    const TelemetryStats s = telemetry.stats();
+    char overlay[32];
+    std::snprintf(overlay, sizeof(overlay), "%.1f%% (peak %.0f%%)", s.loadPercent, s.peakLoadPercent);
+    ImGui::ProgressBar((float)std::min(1.0, s.loadPercent / 100.0), ImVec2(-1, 0), overlay);
+
+    ImGui::Text("callback p50 %.0f / p95 %.0f / p99 %.0f / max %.0f us, budget %.0f us",
+                s.p50Us, s.p95Us, s.p99Us, s.maxUs, s.budgetUs);
+    ImGui::Text("xruns %llu (total %llu), voices %d, queue %d, dropped %llu",
+                (unsigned long long)s.xruns, (unsigned long long)s.totalXruns,
+                s.voicesMax, s.queueMax, (unsigned long long)s.dropped);
+
+    float hist[TelemetryStats::kHistogramBuckets];
+    for (int b = 0; b < TelemetryStats::kHistogramBuckets; ++b) hist[b] = (float)s.histogram[b];
+    ImGui::PlotHistogram("##callback_us", hist, TelemetryStats::kHistogramBuckets, 0,
+                         "callback time, log2 us", 0.0f, 3.4e38f, ImVec2(0, 60));
+
+    if (ahead) {
+        ImGui::Text("render ahead %d blocks (%llu frames queued), jitter %.0f us, underruns %llu",
+                    ahead->lookahead(), (unsigned long long)ahead->queuedFrames(),
+                    ahead->jitterUs(), (unsigned long long)ahead->underruns());
+    }
+}
+
+// CPU budget: what the governor may do and what it is doing
+static void drawGovernor(Governor& governor) {
+    if (!ImGui::CollapsingHeader("CPU Budget")) return;
+
+    bool enabled = governor.enabled.load();
+    if (ImGui::Checkbox("Governor", &enabled)) governor.enabled.store(enabled);
+    ImGui::SameLine();
+    float budget = governor.budget.load() * 100.0f;
+    if (ImGui::SliderFloat("Budget", &budget, 5.0f, 100.0f, "%.0f%% of block")) governor.budget.store(budget / 100.0f);
+
+    int allowed = governor.steps.load();
+    const int active = governor.activeSteps();
+    const char* stepLabels[] = { "Drop released", "Slow control", "No oversampling", "Naive oscillators" };
+    for (int b = 0; b < Governor::kSteps; ++b) {
+        if (b) ImGui::SameLine();
+        if (ImGui::CheckboxFlags(stepLabels[b], &allowed, 1 << b)) governor.steps.store(allowed);
+        if (active & (1 << b)) {
+            ImGui::SameLine(0, 2);
+            ImGui::TextUnformatted("*");
+        }
+    }
+
+    ImGui::Text("level %d, load %.0f%%, next block %.0f of %.0f us", governor.level(), governor.loadPercent(),
+                governor.predictedUs(), governor.budgetUs());
+    ImGui::Text("overruns %llu, lanes dropped %llu", (unsigned long long)governor.overruns(),
+                (unsigned long long)governor.droppedLanes());
+}
+
+bool runGui(Synth& engine, const Telemetry* telemetry, const RenderAhead* ahead, ScopeTap* scope) {
     glfwSetErrorCallback(glfwErrorCallback);
 
     if (!glfwInit()) {
@@ -36,7 +230,7 @@ bool runGui(Synth& engine) {
     const char* glsl_version = "#version 130";
 #endif
 
-    GLFWwindow* window = glfwCreateWindow(800, 500, "Minimal Synth GUI", nullptr, nullptr);
+    GLFWwindow* window = glfwCreateWindow(800, 700, "Minimal Synth GUI", nullptr, nullptr);
     if (!window) {
         std::fprintf(stderr, "glfwCreateWindow() failed\n");
         glfwTerminate();
@@ -45,6 +239,7 @@ bool runGui(Synth& engine) {
 
     glfwMakeContextCurrent(window);
     glfwSwapInterval(1);
+    countEvents(window);
 
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -67,14 +262,79 @@ bool runGui(Synth& engine) {
         return false;
     }
 
-    // GUI-side shadow list for selection + per-osc freq UI
-    std::vector<float> guiOscFreqs;
-    guiOscFreqs.push_back(engine.masterPitchHz.load());
+    // GUI-side shadow list for selection + per-osc freq UI, kept in step
+    // with the engine through its replies (the initial voice arrives as one)
+    struct GuiOsc {
+        VoiceHandle voice;
+        float freq;
+    };
+    std::vector<GuiOsc> guiOscs;
 
     int selectedOsc = 0;
+    Spectrum spectrum;
+
+    // Patches are read and prepared on the loader's thread
+    PatchLoader loader(engine);
+    char patchPath[256] = "patch.mspt";
+    std::string patchStatus;
+    int patchTag = 0, nextPatchTag = 1, switchedTag = 0;
+    PatchLoader::Result patchResult;
+
+    // Redraw at vsync for a few frames after anything changes (ImGui needs
+    // a frame or two to settle after input), then sleep until input, a new
+    // scope frame shows up at the next wake, or the telemetry panel is due
+    const int kBusyFrames = 3;
+    const double kIdleRedrawSec = 0.5;
+    int busyFrames = kBusyFrames;
 
     while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
+        if (busyFrames > 0) glfwPollEvents();
+        else glfwWaitEventsTimeout(kIdleRedrawSec);
+        bool changed = gEvents > 0;
+        gEvents = 0;
+
+        if (scope && scope->poll()) {
+            spectrum.analyze(scope->latest());
+            changed = true;
+        }
+
+        SynthReply r;
+        while (engine.replyQ.pop(r)) {
+            changed = true;
+            if (r.type == SynthReply::VoiceAdded) {
+                guiOscs.push_back(GuiOsc{ r.voice, engine.masterPitchHz.load() });
+                selectedOsc = (int)guiOscs.size() - 1;
+            } else if (r.type == SynthReply::PatchLoaded) {
+                switchedTag = r.tag;
+            } else {
+                guiOscs.erase(std::remove_if(guiOscs.begin(), guiOscs.end(),
+                                             [&](const GuiOsc& o) { return o.voice == r.voice; }),
+                              guiOscs.end());
+            }
+        }
+        // The loader's result and the engine's switch can come in either
+        // order; the voice list changes once both are in
+        PatchLoader::Result loaded;
+        while (loader.poll(loaded)) {
+            if (loaded.tag != patchTag) continue;
+            if (loaded.ok) {
+                patchResult = std::move(loaded);
+            } else {
+                patchStatus = "load failed: " + loaded.error;
+                patchTag = 0;
+            }
+        }
+        if (patchTag != 0 && switchedTag == patchTag && patchResult.tag == patchTag) {
+            guiOscs.clear();
+            for (size_t i = 0; i < patchResult.voices.size(); ++i)
+                guiOscs.push_back(GuiOsc{ patchResult.voices[i], patchResult.patch.voices[i].frequencyHz });
+            selectedOsc = 0;
+            patchStatus = "loaded " + std::to_string(guiOscs.size()) + " voices";
+            patchTag = 0;
+        }
+        if (patchTag != 0) changed = true;
+
+        selectedOsc = guiOscs.empty() ? 0 : std::clamp(selectedOsc, 0, (int)guiOscs.size() - 1);
 
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
@@ -82,6 +342,10 @@ bool runGui(Synth& engine) {
 
         ImGui::Begin("Synth Controls");
 
+        if (telemetry) drawTelemetry(*telemetry, ahead);
+        if (engine.governor()) drawGovernor(*engine.governor());
+        if (scope) drawScope(*scope, spectrum);
+
         // Master pitch
         float pitch = engine.masterPitchHz.load();
         if (ImGui::SliderFloat("Master Pitch (Hz)", &pitch, 50.0f, 2000.0f, "%.1f")) {
@@ -99,41 +363,190 @@ bool runGui(Synth& engine) {
         if (ImGui::SliderFloat("LFO Depth (Hz)", &depth, 0.0f, 50.0f, "%.1f")) {
             engine.lfoDepthHz.store(depth);
         }
+        int lfoWave = engine.lfoWaveform.load();
+        const char* lfoWaveNames[] = { "Sine", "Square", "Triangle", "Saw" };
+        if (ImGui::Combo("LFO Waveform", &lfoWave, lfoWaveNames, IM_ARRAYSIZE(lfoWaveNames))) {
+            engine.lfoWaveform.store(lfoWave);
+        }
+
+        // Modulation/smoothing tick
+        int controlRate = engine.controlRate.load();
+        if (ImGui::SliderInt("Control Rate (samples)", &controlRate, 1, Synth::kMaxControlRate)) {
+            engine.controlRate.store(controlRate);
+        }
+
+        bool bandLimited = engine.bandLimited.load();
+        if (ImGui::Checkbox("Band-limited oscillators", &bandLimited)) {
+            engine.bandLimited.store(bandLimited);
+        }
+
+        // Voices render at 1/2/4/8x and are decimated back down
+        int osIndex = 0;
+        while ((2 << osIndex) <= engine.oversampling.load() && osIndex < 3) ++osIndex;
+        const char* osNames[] = { "1x", "2x", "4x", "8x" };
+        if (ImGui::Combo("Oversampling", &osIndex, osNames, IM_ARRAYSIZE(osNames))) {
+            engine.oversampling.store(1 << osIndex);
+        }
+
+        // Per-voice filter, and where the LFO goes
+        int filter = engine.filterType.load();
+        const char* filterNames[] = { "Off", "SVF Lowpass", "SVF Bandpass", "SVF Highpass", "Ladder" };
+        if (ImGui::Combo("Filter", &filter, filterNames, IM_ARRAYSIZE(filterNames))) {
+            engine.filterType.store(filter);
+        }
+        float cutoff = engine.filterCutoffHz.load();
+        if (ImGui::SliderFloat("Cutoff (Hz)", &cutoff, 20.0f, 20000.0f, "%.0f", ImGuiSliderFlags_Logarithmic)) {
+            engine.filterCutoffHz.store(cutoff);
+        }
+        float resonance = engine.filterResonance.load();
+        if (ImGui::SliderFloat("Resonance", &resonance, 0.0f, 1.0f, "%.2f")) {
+            engine.filterResonance.store(resonance);
+        }
+        int lfoTarget = engine.lfoTarget.load();
+        const char* lfoTargetNames[] = { "None", "Pitch", "Amp (unused)", "Filter" };
+        if (ImGui::Combo("LFO Target", &lfoTarget, lfoTargetNames, IM_ARRAYSIZE(lfoTargetNames))) {
+            engine.lfoTarget.store(lfoTarget);
+        }
+        float lfoOctaves = engine.filterLfoOctaves.load();
+        if (ImGui::SliderFloat("LFO Filter Depth (oct)", &lfoOctaves, 0.0f, 4.0f, "%.2f")) {
+            engine.filterLfoOctaves.store(lfoOctaves);
+        }
+
+        // Unison: each added oscillator or note becomes this many detuned lanes
+        int unison = engine.unisonVoices.load();
+        if (ImGui::SliderInt("Unison Voices", &unison, 1, VoiceBank::kMaxUnison)) {
+            engine.unisonVoices.store(unison);
+        }
+        float detune = engine.unisonDetuneCents.load();
+        if (ImGui::SliderFloat("Unison Detune (cents)", &detune, 0.0f, 100.0f, "%.1f")) {
+            engine.unisonDetuneCents.store(detune);
+        }
+        float spread = engine.unisonSpread.load();
+        if (ImGui::SliderFloat("Stereo Spread", &spread, 0.0f, 1.0f, "%.2f")) {
+            engine.unisonSpread.store(spread);
+        }
+
+        // Voice stealing when the pool is full
+        int steal = engine.stealPolicy.load();
+        const char* stealNames[] = { "Oldest", "Quietest", "Released first" };
+        if (ImGui::Combo("Voice Stealing", &steal, stealNames, IM_ARRAYSIZE(stealNames))) {
+            engine.stealPolicy.store(steal);
+        }
+
+        // Voice envelope
+        ImGui::Separator();
+        float attack = engine.attackSec.load();
+        if (ImGui::SliderFloat("Attack (s)", &attack, 0.0f, 2.0f, "%.3f")) {
+            engine.attackSec.store(attack);
+        }
+        float decay = engine.decaySec.load();
+        if (ImGui::SliderFloat("Decay (s)", &decay, 0.0f, 2.0f, "%.3f")) {
+            engine.decaySec.store(decay);
+        }
+        float sustain = engine.sustainLevel.load();
+        if (ImGui::SliderFloat("Sustain", &sustain, 0.0f, 1.0f, "%.2f")) {
+            engine.sustainLevel.store(sustain);
+        }
+        float release = engine.releaseSec.load();
+        if (ImGui::SliderFloat("Release (s)", &release, 0.0f, 5.0f, "%.3f")) {
+            engine.releaseSec.store(release);
+        }
+        int curve = engine.envelopeCurve.load();
+        const char* curveNames[] = { "Linear", "Exponential" };
+        if (ImGui::Combo("Envelope Curve", &curve, curveNames, IM_ARRAYSIZE(curveNames))) {
+            engine.envelopeCurve.store(curve);
+        }
+
+        // Master bus reverb, when started with one (--reverb)
+        if (const Convolver* reverb = engine.reverb()) {
+            ImGui::Separator();
+            float level = engine.reverbLevel.load();
+            if (ImGui::SliderFloat("Reverb Level", &level, 0.0f, 1.0f, "%.2f")) {
+                engine.reverbLevel.store(level);
+            }
+            ImGui::TextDisabled("late tail blocks: %llu", (unsigned long long)reverb->lateBlocks());
+        }
+
+        drawModulation(engine);
+        drawFm(engine);
+
+        ImGui::Separator();
+        ImGui::InputText("Patch File", patchPath, sizeof(patchPath));
+        if (ImGui::Button("Save Patch")) {
+            Patch patch;
+            patch.params = engine.patchParams();
+            for (const GuiOsc& o : guiOscs) {
+                PatchVoice v;
+                v.frequencyHz = o.freq;
+                patch.voices.push_back(v);
+            }
+            std::string error;
+            patchStatus = savePatch(patchPath, patch, error)
+                ? "saved " + std::to_string(patch.voices.size()) + " voices"
+                : "save failed: " + error;
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Load Patch") && patchTag == 0) {
+            patchTag = nextPatchTag++;
+            patchStatus = "loading...";
+            loader.load(patchPath, patchTag);
+        }
+        if (!patchStatus.empty()) {
+            ImGui::SameLine();
+            ImGui::TextUnformatted(patchStatus.c_str());
+        }
 
         ImGui::Separator();
-        ImGui::Text("Oscillators");
+        ImGui::Text("Oscillators (max %d)", engine.maxVoices());
+        ImGui::TextDisabled("queue overflows: commands %llu, replies %llu",
+                            (unsigned long long)engine.cmdQ.overflows(),
+                            (unsigned long long)engine.replyQ.overflows());
 
         if (ImGui::Button("Add Oscillator")) {
             SynthCmd c{};
             c.type = SynthCmd::AddOsc;
-            c.index = -1;
+            c.index = 0;
             c.value = 0.0f;
-
-            if (engine.cmdQ.push(c)) {
-                guiOscFreqs.push_back(pitch);
-                selectedOsc = (int)guiOscFreqs.size() - 1;
-            }
+            engine.cmdQ.push(c);  // listed once the VoiceAdded reply comes back
         }
 
         ImGui::SameLine();
 
         if (ImGui::Button("Delete Selected")) {
-            if (!guiOscFreqs.empty() && selectedOsc >= 0 && selectedOsc < (int)guiOscFreqs.size()) {
+            if (!guiOscs.empty() && selectedOsc >= 0 && selectedOsc < (int)guiOscs.size()) {
                 SynthCmd c{};
                 c.type = SynthCmd::RemoveOsc;
-                c.index = selectedOsc;
+                c.voice = guiOscs[selectedOsc].voice;
                 c.value = 0.0f;
 
                 if (engine.cmdQ.push(c)) {
-                    guiOscFreqs.erase(guiOscFreqs.begin() + selectedOsc);
-                    if (guiOscFreqs.empty()) selectedOsc = 0;
-                    else selectedOsc = std::clamp(selectedOsc, 0, (int)guiOscFreqs.size() - 1);
+                    guiOscs.erase(guiOscs.begin() + selectedOsc);
+                    if (guiOscs.empty()) selectedOsc = 0;
+                    else selectedOsc = std::clamp(selectedOsc, 0, (int)guiOscs.size() - 1);
                 }
             }
         }
 
+        if (!guiOscs.empty() && selectedOsc >= 0 && selectedOsc < (int)guiOscs.size()) {
+            ImGui::SameLine();
+            if (ImGui::Button("Release")) {
+                SynthCmd c{};
+                c.type = SynthCmd::ReleaseOsc;
+                c.voice = guiOscs[selectedOsc].voice;
+                engine.cmdQ.push(c);
+            }
+
+            ImGui::SameLine();
+            if (ImGui::Button("Retrigger")) {
+                SynthCmd c{};
+                c.type = SynthCmd::TriggerOsc;
+                c.voice = guiOscs[selectedOsc].voice;
+                engine.cmdQ.push(c);
+            }
+        }
+
         ImGui::BeginChild("osc_list", ImVec2(250, 250), true);
-        for (int i = 0; i < (int)guiOscFreqs.size(); ++i) {
+        for (int i = 0; i < (int)guiOscs.size(); ++i) {
             char label[64];
             std::snprintf(label, sizeof(label), "Osc %d", i);
             if (ImGui::Selectable(label, selectedOsc == i)) selectedOsc = i;
@@ -145,14 +558,14 @@ bool runGui(Synth& engine) {
         ImGui::BeginGroup();
         ImGui::Text("Selected Osc: %d", selectedOsc);
 
-        if (!guiOscFreqs.empty() && selectedOsc >= 0 && selectedOsc < (int)guiOscFreqs.size()) {
-            float f = guiOscFreqs[selectedOsc];
+        if (!guiOscs.empty() && selectedOsc >= 0 && selectedOsc < (int)guiOscs.size()) {
+            float f = guiOscs[selectedOsc].freq;
             if (ImGui::SliderFloat("Osc Freq (Hz)", &f, 20.0f, 5000.0f, "%.1f")) {
-                guiOscFreqs[selectedOsc] = f;
+                guiOscs[selectedOsc].freq = f;
 
                 SynthCmd c{};
                 c.type = SynthCmd::SetOscFreq;
-                c.index = selectedOsc;
+                c.voice = guiOscs[selectedOsc].voice;
                 c.value = f;
                 engine.cmdQ.push(c);
             }
@@ -162,6 +575,8 @@ bool runGui(Synth& engine) {
 
         ImGui::EndGroup();
         ImGui::End();
+        if (ImGui::IsAnyItemActive()) changed = true;
+        busyFrames = changed ? kBusyFrames : busyFrames - 1;
 
         ImGui::Render();
         int display_w = 0, display_h = 0;
@@ -2,7 +2,15 @@
 #define GUI_H
 
 #include "Synth.h"
+#include "Telemetry.h"
 
-bool runGui(Synth& engine);
+class RenderAhead;
+class ScopeTap;
+
+// telemetry may be null (no DSP load panel); ahead adds its lookahead,
+// jitter and underruns to the panel; scope adds waveform and spectrum
+// plots. Redraws only while something changes.
+bool runGui(Synth& engine, const Telemetry* telemetry = nullptr, const RenderAhead* ahead = nullptr,
+            ScopeTap* scope = nullptr);
 
 #endif
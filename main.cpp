@@ -1,46 +1,118 @@
-#include <portaudio.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include "AudioBackend.h"
+#include "Convolver.h"
+#include "Governor.h"
+#include "PortAudioBackend.h"
+#include "RenderAhead.h"
+#include "Scope.h"
 #include "Synth.h"
+#include "Telemetry.h"
 #include "gui.h"
 
-static int audioCallback(
-    const void*,
-    void* output,
-    unsigned long frameCount,
-    const PaStreamCallbackTimeInfo*,
-    PaStreamCallbackFlags,
-    void* userData)
-{
-    auto* synth = static_cast<Synth*>(userData);
-    float* out = static_cast<float*>(output);
-    synth->processBlock(out, frameCount);
-    return paContinue;
+static void usage() {
+    std::fprintf(stderr,
+        "usage: minisynth [--telemetry out.jsonl] [--backend portaudio|null|file out.wav]\n"
+        "                 [--lookahead blocks] [--fixed-lookahead] [--reverb ir.wav]\n"
+        "                 [--budget fraction] [--no-governor] [--governor-log out.jsonl]\n");
 }
 
-int main() {
-    Pa_Initialize();
+int main(int argc, char** argv) {
+    // --telemetry <file>: append a JSON line of DSP load stats every 500 ms
+    // --backend: the sound card, a free-running null device, or a WAV file
+    // --lookahead <n>: blocks rendered ahead of the device (the starting
+    //   point unless --fixed-lookahead)
+    // --reverb <file>: impulse response for the master bus reverb
+    // --budget <fraction>: of each block's audio time the synth may spend
+    //   before the governor sheds load; --no-governor turns it off
+    // --governor-log <file>: append a JSON line per governor decision
+    std::string telemetryPath;
+    std::string reverbPath;
+    std::string governorLogPath;
+    float budget = 0.75f;
+    bool governed = true;
+    std::string backendName = "portaudio";
+    std::string wavPath;
+    RenderAhead::Options aheadOptions;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--telemetry") == 0 && i + 1 < argc) telemetryPath = argv[++i];
+        else if (std::strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            backendName = argv[++i];
+            if (backendName == "file") {
+                if (i + 1 >= argc) { usage(); return 2; }
+                wavPath = argv[++i];
+            }
+        }
+        else if (std::strcmp(argv[i], "--lookahead") == 0 && i + 1 < argc) aheadOptions.lookahead = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--fixed-lookahead") == 0) aheadOptions.adaptive = false;
+        else if (std::strcmp(argv[i], "--reverb") == 0 && i + 1 < argc) reverbPath = argv[++i];
+        else if (std::strcmp(argv[i], "--budget") == 0 && i + 1 < argc) budget = (float)std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--no-governor") == 0) governed = false;
+        else if (std::strcmp(argv[i], "--governor-log") == 0 && i + 1 < argc) governorLogPath = argv[++i];
+        else {
+            usage();
+            return 2;
+        }
+    }
+
+    std::unique_ptr<AudioBackend> backend;
+    if (backendName == "portaudio") backend.reset(new PortAudioBackend());
+    else if (backendName == "null") backend.reset(new NullBackend());
+    else if (backendName == "file") backend.reset(new NullBackend(wavPath));
+    else {
+        usage();
+        return 2;
+    }
+
+    AudioBackend::Config config;
+    config.sampleRate = 48000.0f;
+    config.channels = Synth::kChannels;
+    config.framesPerBuffer = 256;
+    aheadOptions.blockFrames = config.framesPerBuffer;
+
+    // The tail thread keeps long responses off the render thread
+    Convolver reverb;
+    if (!reverbPath.empty()) {
+        std::string error;
+        if (!reverb.load(reverbPath, config.sampleRate, error)) {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        reverb.start();
+    }
 
     Synth synth;
-    synth.setSampleRate(48000.0f);
-
-    PaStream* stream = nullptr;
-    Pa_OpenDefaultStream(
-        &stream,
-        0,
-        1,
-        paFloat32,
-        48000,
-        256,
-        audioCallback,
-        &synth
-    );
-
-    Pa_StartStream(stream);
+    synth.setSampleRate(config.sampleRate);
+    if (!reverbPath.empty()) synth.setReverb(&reverb);
+
+    Governor governor(config.sampleRate);
+    governor.budget.store(budget);
+    if (governed) synth.setGovernor(&governor);
+    if (!governorLogPath.empty()) governor.startLog(governorLogPath);
+
+    Telemetry telemetry(config.sampleRate);
+    telemetry.start(telemetryPath);
+
+    // The render thread fills the lookahead before the device asks for any
+    RenderAhead ahead(synth, config.sampleRate, aheadOptions, &telemetry);
+    ScopeTap scope(config.sampleRate);
+    ahead.setScope(&scope);
+    if (!backend->open(config, RenderAhead::deviceCallback, &ahead) || !ahead.start() || !backend->start()) {
+        ahead.stop();
+        backend->stop();
+        telemetry.stop();
+        return 1;
+    }
 
     // GUI runs on main thread (important on macOS)
-    runGui(synth);
+    runGui(synth, &telemetry, &ahead, &scope);
+
+    backend->stop();
+    ahead.stop();
 
-    Pa_StopStream(stream);
-    Pa_CloseStream(stream);
-    Pa_Terminate();
+    telemetry.stop();
     return 0;
 }
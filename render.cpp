@@ -0,0 +1,75 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Convolver.h"
+#include "Sampler.h"
+#include "Session.h"
+#include "Synth.h"
+#include "Telemetry.h"
+#include "WavFile.h"
+
+static void usage() {
+    std::fprintf(stderr, "usage: minisynth_render [--telemetry out.jsonl] <session.txt> <out.wav>\n");
+}
+
+int main(int argc, char** argv) {
+    std::string telemetryPath;
+    if (argc == 5 && std::strcmp(argv[1], "--telemetry") == 0) {
+        telemetryPath = argv[2];
+        argv += 2;
+        argc -= 2;
+    }
+    if (argc != 3) {
+        usage();
+        return 2;
+    }
+
+    Session session;
+    std::string error;
+    if (!session.load(argv[1], error)) {
+        std::fprintf(stderr, "%s: %s\n", argv[1], error.c_str());
+        return 1;
+    }
+
+    // Declared first, so they outlive the synth that plays them
+    Sampler sampler;
+    for (const Session::SampleFile& s : session.samples) {
+        if (!sampler.addZone(s.path, s.root, s.low, s.high, error)) {
+            std::fprintf(stderr, "%s: %s\n", argv[1], error.c_str());
+            return 1;
+        }
+    }
+
+    Convolver reverb;
+    if (!session.reverbPath.empty() && !reverb.load(session.reverbPath, session.sampleRate, error)) {
+        std::fprintf(stderr, "%s: %s\n", argv[1], error.c_str());
+        return 1;
+    }
+
+    Synth synth(session.maxVoices);
+    synth.setRenderThreads(session.renderThreads);
+    if (sampler.zones() > 0) {
+        sampler.start();
+        synth.setSampler(&sampler);
+    }
+    if (!session.reverbPath.empty()) synth.setReverb(&reverb);
+    std::vector<float> audio;
+
+    Telemetry telemetry(session.sampleRate);
+    if (!telemetryPath.empty() && !telemetry.start(telemetryPath, 100)) return 1;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    const unsigned long frames = session.render(synth, audio, telemetryPath.empty() ? nullptr : &telemetry);
+    const auto t1 = std::chrono::steady_clock::now();
+
+    telemetry.stop();
+    if (!writeWav(argv[2], audio.data(), frames, Synth::kChannels, (int)session.sampleRate)) return 1;
+
+    const double wall  = std::chrono::duration<double>(t1 - t0).count();
+    const double audioSec = frames / (double)session.sampleRate;
+    std::printf("rendered %.2f s in %.3f s (%.1fx realtime) -> %s\n",
+                audioSec, wall, wall > 0.0 ? audioSec / wall : 0.0, argv[2]);
+    return 0;
+}